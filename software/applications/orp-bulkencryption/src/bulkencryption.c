@@ -134,8 +134,7 @@ void bulkencryption_ecc_genkey(uint8_t *seed, uint8_t *prv, uint8_t *pub) {
 
   prng_init(&prng, AES_128, tmp, ((uint64_t*)tmp)[2], ((uint64_t*)tmp)[3]);
 
-  for (int i = 0; i < ECC_SCALAR_LEN; i += AES_BLOCK_SIZE)
-    prng_output(&prng, &prv[i]);
+  prng_generate(&prng, prv, ECC_SCALAR_LEN);
 
   /* Generate the public key*/
   msel_memcpy(pub, bulkencryption_curve_base_point, ECC_POINT_LEN);
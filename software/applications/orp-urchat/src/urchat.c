@@ -23,6 +23,7 @@
 #include <msel/malloc.h>
 #include <msel/stdc.h>
 #include <msel/ffs.h>
+#include <msel/trng.h>
 
 #include <crypto/prng.h>
 #include <crypto/kdf.h>
@@ -118,6 +119,7 @@ typedef struct {
   uint8_t key_prv[ECC_SCALAR_LEN];
   uint8_t key_pub[ECC_POINT_LEN];
   uint8_t key_pub_hash[SHA256_OUTPUT_LEN];
+  uint8_t prng_key[SHA256_OUTPUT_LEN]; /* the prng only keeps a pointer to its key */
   prng_ctx_t prng;
   seeking_t seeking[SEEKS_SIZE];
   uint32_t seeking_active_count;
@@ -147,8 +149,7 @@ void chat_ecc_genkey(uint8_t *seed, uint8_t *prv, uint8_t *pub) {
   prng_init(&prng, AES_128, tmp, ((uint64_t*)tmp)[2], ((uint64_t*)tmp)[3]);
   msel_memset(tmp, 0, SHA256_OUTPUT_LEN);
 
-  for (int i = 0; i < ECC_SCALAR_LEN; i += AES_BLOCK_SIZE)
-    prng_output(&prng, &prv[i]);
+  prng_generate(&prng, prv, ECC_SCALAR_LEN);
   for (int i = 0; i < ECC_SCALAR_LEN - CHAT_PRVKEY_LEN; i++)
     prv[i] = 0;
 
@@ -191,13 +192,13 @@ int chat_process_login(chat_context_t *ctx, ffs_packet_t *pkt) {
     uint8_t seed[SHA256_OUTPUT_LEN];
     sha256_hash(pkt->data, SHA256_OUTPUT_LEN, seed);
     uint8_t r[SHA256_OUTPUT_LEN];
-    for (int i = 0; i < SHA256_OUTPUT_LEN; i++)
-      msel_svc(MSEL_SVC_TRNG, &r[i]);
+    msel_trng_read(r, SHA256_OUTPUT_LEN);
     sha256_hash(r, SHA256_OUTPUT_LEN, r);
     for (int i = 0; i < SHA256_OUTPUT_LEN; i++)
       seed[i] ^= r[i];
     sha256_hash(seed, SHA256_OUTPUT_LEN, seed);
-    prng_init(&ctx->prng, AES_128, seed, ((uint64_t*)seed)[2], ((uint64_t*)seed)[3]);
+    msel_memcpy(ctx->prng_key, seed, SHA256_OUTPUT_LEN);
+    prng_init(&ctx->prng, AES_128, ctx->prng_key, ((uint64_t*)seed)[2], ((uint64_t*)seed)[3]);
   }
 
   /* Format the response */
@@ -65,6 +65,12 @@ void aes_ecb_encrypt(aes_ctx_t *ctx, void *data_in, void *data_out);
 /** @brief Performs decryption (electronic codebook mode) of the given data in the given context. */
 void aes_ecb_decrypt(aes_ctx_t *ctx, void *data_in, void *data_out);
 
+/** @brief Encrypts several blocks (electronic codebook mode) in one system call. */
+void aes_ecb_encrypt_blocks(aes_ctx_t *ctx, void *data_in, uint32_t block_count, void *data_out);
+
+/** @brief Decrypts several blocks (electronic codebook mode) in one system call. */
+void aes_ecb_decrypt_blocks(aes_ctx_t *ctx, void *data_in, uint32_t block_count, void *data_out);
+
 /** @addtogroup aes_driver
  *  @{
  */
@@ -0,0 +1,65 @@
+/** @file aes_ctr.h
+ *
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _AES_CTR_H_
+#define _AES_CTR_H_
+
+#include <stdint.h>
+#include <crypto/aes.h>
+
+/** @ingroup aes
+ *  @{
+ */
+
+/** @defgroup ctr Counter Mode
+ *  @{
+ */
+
+/** @brief Counter blocks encrypted per system call. */
+#define AES_CTR_BATCH_BLOCKS 8
+
+/** @brief AES CTR context object. */
+typedef struct aes_ctr_ctx_s {
+	aes_ctx_t e_ctx;
+	uint8_t ctr[AES_BLOCK_SIZE];  /**< @brief Next counter block, incremented as a 128-bit big-endian number. */
+	uint8_t ks[AES_CTR_BATCH_BLOCKS * AES_BLOCK_SIZE]; /**< @brief Keystream not used yet. */
+	uint32_t ks_pos;              /**< @brief Bytes of ks already used. */
+} aes_ctr_ctx_t;
+
+/** @brief Increments a big-endian 128-bit counter block. */
+void aes_ctr_inc(uint8_t *ctr);
+
+/** @brief Encrypts block_count consecutive counter blocks starting at ctr, and advances ctr past them. */
+void aes_ctr_keystream(aes_ctx_t *ctx, uint8_t *ctr, uint32_t block_count, void *data_out);
+
+/** @brief Set key and initial counter block in CTR context. */
+void aes_ctr_setkey(aes_ctr_ctx_t *ctx, aes_algo_t algo, void *key, void *iv);
+
+/** @brief AES CTR encrypt or decrypt (they are the same). Any length, and may be called repeatedly on a stream. */
+void aes_ctr_crypt(aes_ctr_ctx_t *ctx, void *data_in, uint32_t data_len, void *data_out);
+
+/** @brief Wipes the buffered keystream and counter. */
+void aes_ctr_clear(aes_ctr_ctx_t *ctx);
+
+/** @} */
+
+/** @} */
+
+
+#endif /* _AES_CTR_H_ */
@@ -49,6 +49,9 @@ typedef uint32_t aes_xts_algo_t;
 /** @brief Size of AES XTS 256 key in bytes. */
 #define AES_XTS_256_KEY_SIZE (256 * 2 / 8)
 
+/** @brief Blocks aes_xts_encrypt/aes_xts_decrypt pass to AES in one call. */
+#define AES_XTS_BATCH_BLOCKS 8
+
 /** @brief AES XTS context object. */
 typedef struct aes_xts_ctx_s {
 	aes_xts_algo_t algo;
@@ -0,0 +1,81 @@
+/** @file ctr_drbg.h
+ *
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _CTR_DRBG_H_
+#define _CTR_DRBG_H_
+
+#include <stdint.h>
+#include <crypto/aes.h>
+#include <crypto/aes_ctr.h>
+
+/** @ingroup crypto
+ *  @{
+ */
+
+/** @defgroup ctr_drbg CTR_DRBG (NIST SP 800-90A) random bit generator
+ *
+ *  Without a derivation function, so seeds must be full entropy. Output
+ *  is made AES_CTR_BATCH_BLOCKS blocks at a time, which is followed by
+ *  the usual update of the key and V. What a request doesn't use is
+ *  kept (and wiped as it is handed out) for the next one.
+ *
+ *  @{
+ */
+
+/** @brief Largest key the DRBG uses (AES-256). */
+#define CTR_DRBG_KEY_MAX AES_256_KEY_SIZE
+
+/** @brief Largest seed the DRBG takes: a key and a block. */
+#define CTR_DRBG_SEED_MAX (CTR_DRBG_KEY_MAX + AES_BLOCK_SIZE)
+
+/** @brief Batches of output between reseeds. */
+#define CTR_DRBG_RESEED_INTERVAL ((uint32_t) 1 << 24)
+
+/** @brief Size (in bytes) of the seed for a given algo: key plus block. */
+#define CTR_DRBG_SEED_SIZE(algo) (((AES_256 == (algo)) ? AES_256_KEY_SIZE : \
+                                   (AES_192 == (algo)) ? AES_192_KEY_SIZE : AES_128_KEY_SIZE) + AES_BLOCK_SIZE)
+
+/** @brief CTR_DRBG context object. */
+typedef struct ctr_drbg_ctx_s {
+	aes_ctx_t aes;
+	uint8_t key[CTR_DRBG_KEY_MAX];
+	uint8_t v[AES_BLOCK_SIZE];
+	uint32_t seed_len;
+	uint32_t reseed_counter;
+	uint8_t buf[AES_CTR_BATCH_BLOCKS * AES_BLOCK_SIZE]; /**< @brief Output not handed out yet. */
+	uint32_t buf_pos;
+} ctr_drbg_ctx_t;
+
+/** @brief Instantiates the DRBG. entropy and pers (which may be NULL) are CTR_DRBG_SEED_SIZE(algo) bytes. */
+void ctr_drbg_init(ctr_drbg_ctx_t *ctx, aes_algo_t algo, const void *entropy, const void *pers);
+
+/** @brief Reseeds the DRBG. entropy and add (which may be NULL) are CTR_DRBG_SEED_SIZE(algo) bytes. */
+void ctr_drbg_reseed(ctr_drbg_ctx_t *ctx, const void *entropy, const void *add);
+
+/** @brief Generates data_len random bytes. Returns 0, or -1 once the DRBG has to be reseeded. */
+int ctr_drbg_generate(ctr_drbg_ctx_t *ctx, void *data_out, uint32_t data_len);
+
+/** @brief Wipes the DRBG state. */
+void ctr_drbg_clear(ctr_drbg_ctx_t *ctx);
+
+/** @} */
+
+/** @} */
+
+#endif /* _CTR_DRBG_H_ */
@@ -29,9 +29,17 @@
 
 
 /** @defgroup prng Psudo-random number generation routines
+ *
+ *  An ANSI X9.31-style generator. Its output for a given key and v is
+ *  fixed, since keys are derived from it deterministically; code that only
+ *  needs random bytes should use @ref ctr_drbg instead.
+ *
  *  @{
  */
 
+/** @brief Blocks whose I = E(DT) prng_generate makes in one AES call. */
+#define PRNG_BATCH_BLOCKS 8
+
 /** @brief The context structure for the psudo-random number generator. */
 typedef struct prng_ctx_s {
   aes_ctx_t aes;
@@ -40,7 +48,8 @@ typedef struct prng_ctx_s {
 } prng_ctx_t;
 
 /** @brief Initialize a PRNG context, specifying which AES variant to use
- *         and providing an initial seed.
+ *         and providing an initial seed. Only a pointer to k is kept, so
+ *         it must stay valid while the context is in use.
  */
 void prng_init(prng_ctx_t *ctx, aes_algo_t algo, uint8_t *k, uint64_t v_lo, uint64_t v_hi);
 
@@ -48,6 +57,12 @@ void prng_init(prng_ctx_t *ctx, aes_algo_t algo, uint8_t *k, uint64_t v_lo, uint
  */
 void prng_output(prng_ctx_t *ctx, uint8_t *data_out);
 
+/** @brief Generate data_len random bytes within the given context. These
+ *         are the bytes successive prng_output calls would give; what is
+ *         left of the last block is dropped.
+ */
+void prng_generate(prng_ctx_t *ctx, uint8_t *data_out, uint32_t data_len);
+
 /** @} */
 
 /** @} */
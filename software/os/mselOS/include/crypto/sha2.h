@@ -59,6 +59,23 @@ typedef struct sha_data_s
     uint8_t din[64];
 } sha_data_t;
 
+/** @brief Most blocks one MSEL_SVC_SHA_BLOCKS call hashes, which bounds
+    the time spent in the kernel */
+#define SHA256_BLOCKS_MAX 64
+
+/** @brief Data for hashing consecutive blocks in one call */
+typedef struct sha_blocks_s
+{
+    /** @brief Initialization vector/output hash (32 bytes) */
+    uint8_t* iv;
+
+    /** @brief Input data to hash, block_count 64-byte blocks */
+    const uint8_t* din;
+
+    /** @brief Number of blocks at din, at most SHA256_BLOCKS_MAX */
+    uint32_t block_count;
+} sha_blocks_t;
+
 /** @} */
 
 
@@ -57,6 +57,27 @@ typedef struct ffs_packet_s
     uint8_t data[FFS_DATA_SIZE];
 } ffs_packet_t;
 
+/** @brief Outgoing traffic counters for a faux filesystem session
+
+    Delays are measured in system ticks, from the moment a packet is queued
+    until it is written to RFILE.  Packets that go straight out without
+    being queued count as sent but add nothing to the delay.
+ */
+typedef struct ffs_session_stats_s
+{
+    /** @brief Number of packets written to RFILE */
+    uint32_t sent;
+
+    /** @brief Sum of the queueing delays of all sent packets */
+    uint32_t delay_total;
+
+    /** @brief Longest queueing delay seen by a single packet */
+    uint32_t delay_max;
+
+    /** @brief Most packets ever waiting in the outgoing queue at once */
+    uint32_t depth_max;
+} ffs_session_stats_t;
+
 /** @} */
 
 #endif
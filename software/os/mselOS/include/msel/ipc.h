@@ -0,0 +1,100 @@
+/** @file include/msel/ipc.h
+
+    Message channels between tasks
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _INC_MSEL_IPC_H_
+#define _INC_MSEL_IPC_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <msel.h>
+
+/** @brief Names a channel. Channels are created before msel_start and
+    their ids handed to the tasks that use them, e.g. in the task's
+    arg. Any task may send or receive on any channel. */
+typedef uint8_t msel_ipc_id;
+
+/** @brief Largest message that is copied through a channel. Bigger
+    data should be lent a page at a time with msel_ipc_lend. */
+#define MSEL_IPC_MSG_MAX 64
+
+/** @brief Argument for the IPC system calls */
+typedef struct {
+    msel_ipc_id ch;    /**< [in] channel */
+    uint8_t     lent;  /**< [out] receive: non-zero if buf is a lent page */
+    void*       buf;   /**< [in] send: the data, or the page to lend. receive: where to copy to. [out] receive: the lent page */
+    size_t      len;   /**< [in] bytes to send, or room in buf. [out] receive: bytes received */
+} msel_ipc_args;
+
+/** @brief Create a channel. Like msel_task_create, this may only be
+    called from privileged code before msel_start.
+
+    @return MSEL_OK, or MSEL_ERESOURCE if all channels are in use
+*/
+msel_status msel_ipc_create(msel_ipc_id *ch);
+
+/** @brief Send a copy of up to MSEL_IPC_MSG_MAX bytes, sleeping while
+    the channel is full.
+
+    @return MSEL_OK, MSEL_EINVAL for a bad channel or length, or
+    MSEL_EBUSY if task 0 would have to wait
+*/
+msel_status msel_ipc_send(msel_ipc_id ch, const void *buf, size_t len);
+
+/** @brief Lend one page of the caller's own heap to whoever receives
+    the message, instead of copying it. The page must be page aligned
+    and wholly inside the heap, e.g. carved out of a malloc of two
+    pages. Sleeps while the channel is full or too many pages are out
+    on loan already.
+
+    From now until msel_ipc_reclaim returns, the page is read-only to
+    both tasks. Writing it before then is a page fault.
+
+    @param len how much of the page the receiver should look at
+
+    @return MSEL_OK, MSEL_EINVAL if the page can't be lent, or
+    MSEL_EBUSY if task 0 would have to wait
+*/
+msel_status msel_ipc_lend(msel_ipc_id ch, const void *page, size_t len);
+
+/** @brief Receive the oldest message, sleeping while there is none.
+
+    @param buf where a copied message goes
+    @param len [in] room in buf, longer messages are cut short. [out] the message length
+    @param lent [out] the page, if the message was lent, otherwise NULL.
+    A lent page must be handed back with msel_ipc_return.
+
+    @return MSEL_OK, MSEL_EINVAL for a bad channel, or MSEL_EBUSY if
+    task 0 would have to wait
+*/
+msel_status msel_ipc_recv(msel_ipc_id ch, void *buf, size_t *len, const void **lent);
+
+/** @brief Give a lent page back to its owner
+
+    @return MSEL_OK, or MSEL_EINVAL if the caller isn't holding it
+*/
+msel_status msel_ipc_return(const void *page);
+
+/** @brief Sleep until a page the caller lent out has been returned,
+    after which it is writable again. Returns straight away if it
+    isn't out on loan. */
+msel_status msel_ipc_reclaim(const void *page);
+
+#endif
@@ -0,0 +1,82 @@
+/** @file kv.h */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MSEL_INC_KV_H_
+#define _MSEL_INC_KV_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <msel.h>
+
+/** @defgroup kv Persistent key-value store
+
+    Small values that have to survive a reset, such as long-lived key
+    pairs, kept in flash. Each application has a namespace of its own
+    (tied to its endpoint, or for tasks started by main to its task
+    number) and can't see anyone else's entries.
+
+    Entries are encrypted and authenticated under a key derived from
+    the master key, so re-provisioning the device forgets all of them.
+
+ *  @{
+ */
+
+/** @brief Longest key */
+#define MSEL_KV_KEY_MAX 32
+
+/** @brief Longest value */
+#define MSEL_KV_VAL_MAX 256
+
+/** @brief Argument for the key-value system calls */
+typedef struct {
+    const void* key;     /**< [in] the key */
+    size_t      key_len; /**< [in] 1 to MSEL_KV_KEY_MAX bytes */
+    void*       val;     /**< [in] put: the value. get: where it goes */
+    size_t      val_len; /**< [in] put: bytes in val. get: room in val. [out] get: the value's length */
+} msel_kv_args;
+
+/** @brief Store a value, replacing any under the same key. It is in
+    flash by the time this returns.
+
+    @return MSEL_OK, MSEL_EINVAL for a bad key or value length,
+    MSEL_ENOMEM if the store is full, MSEL_ERESOURCE if there are too
+    many keys, MSEL_EEXIST in the unlikely case that another key of
+    this task's has the same hash, or MSEL_ENOTIMPL if there is no
+    storage for it
+*/
+msel_status msel_kv_put(const void *key, size_t key_len, const void *val, size_t val_len);
+
+/** @brief Fetch a value
+
+    @param val_len [in] room in val. [out] the value's length
+
+    @return MSEL_OK, MSEL_EBADF if there is no such key, MSEL_ENOMEM
+    if val is too small (val_len says how big it needs to be), or
+    MSEL_EUNKNOWN if the entry failed its integrity check
+*/
+msel_status msel_kv_get(const void *key, size_t key_len, void *val, size_t *val_len);
+
+/** @brief Remove a value
+
+    @return MSEL_OK, or MSEL_EBADF if there is no such key
+*/
+msel_status msel_kv_delete(const void *key, size_t key_len);
+
+/** @} */
+
+#endif
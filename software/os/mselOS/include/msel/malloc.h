@@ -25,6 +25,24 @@
 
 #define ALIGN_SIZE 16 // in bytes, must be a power of 2
 
+/** @brief Usage counters kept in every heap. Sizes are in bytes and
+    include the allocator's own headers, so in_use plus the free space
+    always adds up to size. */
+typedef struct {
+    uint32_t size;         /**< total space managed by the heap */
+    uint32_t in_use;       /**< space currently allocated */
+    uint32_t peak;         /**< high-water mark of in_use */
+    uint32_t allocs;       /**< successful allocations since heap_init */
+    uint32_t failed;       /**< allocations that could not be satisfied */
+    uint32_t largest_free; /**< largest single allocation that would fit right now */
+} heap_stats_t;
+
+/** @brief Argument for the MSEL_SVC_HEAP_STATS system call */
+typedef struct {
+    uint8_t tasknum;       /**< [in] task whose heap to read */
+    heap_stats_t stats;    /**< [out] counters for that heap */
+} msel_heap_stats_args;
+
 /* @brief This will attempt to allocate 'sz' bytes on the current
    thread's heap and return a pointer to the new allocation.
 
@@ -124,6 +142,15 @@ extern void *heap_realloc(void *base_ptr, void *ptr, uint32_t size);
 */
 extern void heap_free(void *base_ptr, void *ptr);
 
+/** @brief Read the usage counters of the given heap.
+
+   @param base_ptr Which heap structure to read. "heap_init" must have
+   been previously invoked on this pointer.
+
+   @param stats Filled in with the counters
+*/
+extern void heap_stats(void *base_ptr, heap_stats_t *stats);
+
 #ifdef HEAP_DEBUG
 extern void heap_print(void *base_ptr);
 extern int valid_fail(void *base_ptr, void **ptrs, uint32_t n_ptrs, void *fail_ptr, uint32_t fail_alloc);
@@ -34,7 +34,25 @@ typedef uint64_t mtc_t;
  * "msel_provision") is to return the current value and increment it
  * transparently. This ensures that every call made to this function
  * will return a unique value called until 2^64 times or the device is
- * re-provisioned. */
+ * re-provisioned. Values are reserved from flash in blocks, so most
+ * calls don't write the flash at all; a reset skips the rest of the
+ * current block. */
 msel_status mtc_read_increment(mtc_t* val);
 
+/** @brief Argument for the MSEL_SVC_MTC_RESERVE system call */
+typedef struct {
+    uint32_t count; /**< [in] number of values wanted */
+    mtc_t    first; /**< [out] the first of them */
+} msel_mtc_reserve_args;
+
+/** @brief Reserve count consecutive counter values, first to
+ * first+count-1, at the cost of a single flash write. They belong to
+ * the caller alone and are all greater than anything handed out
+ * before. Values the caller doesn't get round to using are simply
+ * skipped; they will not be handed out again, even after a reset.
+ *
+ * @return MSEL_OK, MSEL_EINVAL if count is 0, or MSEL_ERESOURCE if the
+ * counter would run out */
+msel_status mtc_reserve(uint32_t count, mtc_t* first);
+
 #endif
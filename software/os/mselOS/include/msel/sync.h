@@ -0,0 +1,108 @@
+/** @file include/msel/sync.h
+
+    Mutexes, counting semaphores and event flags for synchronizing
+    tasks with each other
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _INC_MSEL_SYNC_H_
+#define _INC_MSEL_SYNC_H_
+
+#include <stdint.h>
+#include <msel.h>
+
+/** @brief Names a mutex, semaphore or event flag group. Objects are
+    created before msel_start and their ids handed to the tasks that
+    share them, e.g. in the task's arg. */
+typedef uint8_t msel_sync_id;
+
+/** @name Event Wait Modes
+ *  @{
+ */
+#define MSEL_EVENT_ANY   0x00 /**< wake when any of the flags is set */
+#define MSEL_EVENT_ALL   0x01 /**< wake when all of the flags are set */
+#define MSEL_EVENT_CLEAR 0x02 /**< clear the waited-for flags on wake */
+/** @} */
+
+/** @brief Argument for the synchronization system calls */
+typedef struct {
+    msel_sync_id id;   /**< [in] object to operate on */
+    uint8_t      mode; /**< [in] MSEL_EVENT_* for an event wait */
+    uint32_t     mask; /**< [in] flags for the event calls */
+} msel_sync_args;
+
+/** @brief Create a mutex. Like msel_task_create, this may only be
+    called from privileged code before msel_start.
+
+    @return MSEL_OK, or MSEL_ERESOURCE if all MSEL_SYNC_MAX objects
+    are in use
+*/
+msel_status msel_mutex_create(msel_sync_id *id);
+
+/** @brief Create a counting semaphore with the given count. See
+    msel_mutex_create. */
+msel_status msel_sem_create(msel_sync_id *id, uint16_t count);
+
+/** @brief Create a group of 32 event flags, all clear. See
+    msel_mutex_create. */
+msel_status msel_event_create(msel_sync_id *id);
+
+/** @brief Lock a mutex, sleeping until it is free. Mutexes aren't
+    recursive, and task 0 never sleeps.
+
+    @return MSEL_OK once locked, MSEL_EINVAL if the caller holds it
+    already, or MSEL_EBUSY if task 0 would have to wait
+*/
+msel_status msel_mutex_acquire(msel_sync_id id);
+
+/** @brief Unlock a mutex, handing it straight to the task that has
+    waited longest.
+
+    @return MSEL_OK, or MSEL_EBADF if the caller doesn't hold it
+*/
+msel_status msel_mutex_release(msel_sync_id id);
+
+/** @brief Take one from a semaphore, sleeping while it is zero.
+
+    @return MSEL_OK, or MSEL_EBUSY if task 0 would have to wait
+*/
+msel_status msel_sem_wait(msel_sync_id id);
+
+/** @brief Give one to a semaphore, waking the task that has waited
+    longest if there is one.
+
+    @return MSEL_OK, or MSEL_ERESOURCE if the count would overflow
+*/
+msel_status msel_sem_post(msel_sync_id id);
+
+/** @brief Sleep until the flags in mask are set.
+
+    @param mode MSEL_EVENT_ANY or MSEL_EVENT_ALL, optionally with
+    MSEL_EVENT_CLEAR
+
+    @return MSEL_OK, or MSEL_EBUSY if task 0 would have to wait
+*/
+msel_status msel_event_wait(msel_sync_id id, uint32_t mask, uint8_t mode);
+
+/** @brief Set flags, waking every task whose wait is now satisfied */
+msel_status msel_event_set(msel_sync_id id, uint32_t mask);
+
+/** @brief Clear flags */
+msel_status msel_event_clear(msel_sync_id id, uint32_t mask);
+
+#endif
@@ -50,27 +50,84 @@ typedef enum {
     MSEL_SVC_EXIT,            
     /** @brief does nothing */
     MSEL_SVC_DEBUG,           
+    /** @brief read the heap usage counters of a task */
+    MSEL_SVC_HEAP_STATS,
+    /** @brief read the CPU time counters of a task */
+    MSEL_SVC_TASK_STATS,
+
+    /* Synchronization */
+
+    /** @brief lock a mutex, sleeping while it is held */
+    MSEL_SVC_MUTEX_LOCK,
+    /** @brief unlock a mutex */
+    MSEL_SVC_MUTEX_UNLOCK,
+    /** @brief take from a semaphore, sleeping while it is zero */
+    MSEL_SVC_SEM_WAIT,
+    /** @brief give to a semaphore */
+    MSEL_SVC_SEM_POST,
+    /** @brief sleep until event flags are set */
+    MSEL_SVC_EVENT_WAIT,
+    /** @brief set event flags */
+    MSEL_SVC_EVENT_SET,
+    /** @brief clear event flags */
+    MSEL_SVC_EVENT_CLEAR,
+
+    /* Inter-task messages */
+
+    /** @brief copy a message into a channel, sleeping while it is full */
+    MSEL_SVC_IPC_SEND,
+    /** @brief lend a page through a channel, sleeping while it is full */
+    MSEL_SVC_IPC_LEND,
+    /** @brief take a message from a channel, sleeping while it is empty */
+    MSEL_SVC_IPC_RECV,
+    /** @brief give a lent page back */
+    MSEL_SVC_IPC_RETURN,
+    /** @brief wait for a lent page to be given back */
+    MSEL_SVC_IPC_RECLAIM,
+
+    /* Persistent storage */
+
+    /** @brief store a value under a key */
+    MSEL_SVC_KV_PUT,
+    /** @brief fetch the value stored under a key */
+    MSEL_SVC_KV_GET,
+    /** @brief remove a key */
+    MSEL_SVC_KV_DELETE,
 
     /* MMIO devices */
 
     /** @brief generate a random number */ 
     MSEL_SVC_TRNG,            
+    /** @brief fill a buffer with random bytes */
+    MSEL_SVC_TRNG_READ,
     /** @brief encrypt/decrypt with AES */
     MSEL_SVC_AES,             
     /** @brief hash using SHA-256 */
     MSEL_SVC_SHA,             
+    /** @brief hash several consecutive blocks using SHA-256 */
+    MSEL_SVC_SHA_BLOCKS,
     /** @brief point-scalar ECC multiply */
     MSEL_SVC_ECC,             
     /** @brief receive the next incoming data packet for a session */
     MSEL_SVC_FFS_SESSION_RECV,
     /** @brief send data from a session */
     MSEL_SVC_FFS_SESSION_SEND,
+    /** @brief borrow the next incoming data packet for a session in place */
+    MSEL_SVC_FFS_SESSION_RECV_LEND,
+    /** @brief borrow an empty packet buffer to build an outgoing packet in */
+    MSEL_SVC_FFS_PKT_ALLOC,
+    /** @brief give a borrowed packet buffer back without sending it */
+    MSEL_SVC_FFS_PKT_RELEASE,
+    /** @brief read the outgoing traffic counters for a session */
+    MSEL_SVC_FFS_SESSION_STATS,
 
     /** @brief Debug output over serial (write-only API) */
     MSEL_SVC_UART_WRITE,
 
     /** @brief Accessing the monotonic counter */
     MSEL_SVC_MTC_READ_INC,
+    /** @brief Reserve a range of monotonic counter values */
+    MSEL_SVC_MTC_RESERVE,
 
     /** @brief Allows tasks to re-provision the system */
     MSEL_SVC_PROVISION,
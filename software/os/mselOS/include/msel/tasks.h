@@ -30,26 +30,78 @@
 /** @brief fn pointer to a thread's entry routine */
 typedef void (*msel_thread_entry)(void *arg, const size_t arg_sz);
 
+/** @brief The memory a task is created with */
+typedef struct {
+    size_t stack_sz;  /**< bytes of stack */
+    size_t heap_sz;   /**< bytes of heap, including the allocator's own header */
+} msel_task_profile;
+
+/** @brief CPU time used by a task. Cycles are counted with the same
+    clock as the trace timestamps (arch_timestamp). */
+typedef struct {
+    uint64_t user_cycles;   /**< time spent running the task itself */
+    uint64_t kernel_cycles; /**< time spent in syscalls and interrupts taken while the task ran */
+    uint32_t syscalls;      /**< system calls made */
+    uint32_t voluntary;     /**< switches away because it yielded or blocked */
+    uint32_t involuntary;   /**< switches away because its time slice ran out */
+} msel_task_stats;
+
+/** @brief Argument for the MSEL_SVC_TASK_STATS system call */
+typedef struct {
+    uint8_t tasknum;        /**< [in] task whose counters to read */
+    msel_task_stats stats;  /**< [out] counters for that task */
+} msel_task_stats_args;
+
 /** @brief add a new thread to the task struct. This can only be
     called from privileged code running from the main stack. Currently
     the only way to do this is after a fresh reset before the main
     task is started.
+
+    The task gets the memory profile registered for its entry point
+    with msel_task_register_profile, or else the default stack and
+    heap sizes from the linker script.
   
     @param entry the function to execute in its own thread
 
-    @param stack_sz amount of stack to alloccate. HW mem mgmt, if available, will be used to enforce r/w boundaries
+    @param arg an arbirary block of data to be copied onto the new thread's heap and passed to it on its initial invocation.
 
-    @param heap_sz amount of heap space dediated to this thread. HW mem mgmt, if available, will be used to enforce r/w boundaries
+    @param arg_sz the size of arg
 
-    @param arg an arbirary word of data to be passed to the thread on its initial invocation.
+    @param tid if not NULL, receives the number of the new task
 
     @return On success, MSEL_OK.  Fails with `MSEL_ERESOURCE` if the
-    number of tasks exceeds MSEL_TASKS_MAX. Fails with `MSEL_EINVAL`
-    when thread is NULL, thread->entry is NULL, or heap/stack size are greater
-    than the maximum values.
+    number of tasks exceeds MSEL_TASKS_MAX, or `MSEL_ENOMEM` if there
+    is no room left for its stack and heap. `MSEL_EBUSY` means the only
+    room is memory of an exited task that hasn't been cleared yet, and
+    a later try will succeed. Fails with `MSEL_EINVAL`
+    when entry is NULL, or arg doesn't fit on the heap.
 */
 msel_status msel_task_create(const msel_thread_entry, void *arg, size_t arg_sz, uint8_t* tid);
 
+/** @brief add a new thread with a given stack and heap size. See
+    msel_task_create.
+
+    Task memory comes from a single area shared by all tasks, so one
+    task with a large heap leaves less room for the rest. The sizes are
+    rounded up to what the memory protection hardware can enforce
+    (whole pages, or on ARM an eighth of the next power of two), and
+    any slack is given to the heap.
+
+    @param profile the stack and heap sizes for the thread. HW mem mgmt, if available, will be used to enforce r/w boundaries
+*/
+msel_status msel_task_create_profile(const msel_thread_entry, void *arg, size_t arg_sz,
+                                     const msel_task_profile *profile, uint8_t* tid);
+
+/** @brief Set the memory profile used whenever a task is created with
+    the given entry point through msel_task_create. This is meant for
+    tasks that are started on demand, such as FFS session tasks, and
+    should be called before msel_start.
+
+    @return MSEL_OK, or MSEL_ERESOURCE if too many profiles have
+    already been registered
+*/
+msel_status msel_task_register_profile(const msel_thread_entry, const msel_task_profile *profile);
+
 /** @brief Terminates execution of the currently running thread */
 void msel_task_exit();
 
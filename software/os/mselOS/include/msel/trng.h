@@ -0,0 +1,48 @@
+/** @file trng.h
+
+    Random numbers from the hardware RNG
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MSEL_INC_TRNG_H_
+#define _MSEL_INC_TRNG_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <msel.h>
+
+/** @brief Most bytes one MSEL_SVC_TRNG_READ call returns */
+#define MSEL_TRNG_READ_MAX 256
+
+/** @brief Argument for the MSEL_SVC_TRNG_READ system call */
+typedef struct {
+    void*  buf;  /**< [in] where the random bytes go */
+    size_t len;  /**< [in] up to MSEL_TRNG_READ_MAX */
+} msel_trng_args;
+
+/** @brief Fill a buffer with random bytes. These come from the kernel's
+    entropy pool, which conditions the hardware RNG's output with
+    SHA-256 and tests the raw source as it goes.
+
+    @return MSEL_OK, MSEL_EINVAL for a NULL buffer, or MSEL_EUNKNOWN
+    if the hardware RNG keeps failing its health tests
+*/
+msel_status msel_trng_read(void *buf, size_t len);
+
+#endif
@@ -0,0 +1,317 @@
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+   Host-side symbolizer for the sampling profiler (see src/os/profile.h).
+
+   Reads a captured UART log, picks out the "prof TT PPPPPPPP" lines,
+   looks every PC up in the symbol table of the mselOS ELF it came from
+   and prints a flat profile for each task.
+
+   Build with: cc -o profsym profsym.c
+   Usage:      profsym mselOS.elf [uart.log]
+
+   Both the or1k (big-endian) and ARM (little-endian) images are
+   understood.
+*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+
+#define MAX_TASKS 256
+
+typedef struct {
+    uint32_t    addr;
+    uint32_t    size;
+    const char* name;
+} sym_t;
+
+typedef struct {
+    size_t   sym;
+    uint32_t count;
+} hit_t;
+
+static uint8_t* elf;
+static size_t   elf_sz;
+static int      elf_msb;
+
+static sym_t*   syms;
+static size_t   num_syms;
+
+static uint16_t get16(const void *p)
+{
+    const uint8_t *b = p;
+    return elf_msb ? (b[0] << 8) | b[1] : (b[1] << 8) | b[0];
+}
+
+static uint32_t get32(const void *p)
+{
+    const uint8_t *b = p;
+    return elf_msb ? ((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3]
+                   : ((uint32_t)b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+}
+
+static int sym_cmp(const void *a, const void *b)
+{
+    const sym_t *sa = a, *sb = b;
+    if(sa->addr != sb->addr)
+        return sa->addr < sb->addr ? -1 : 1;
+    /* prefer the sized (i.e. real function) symbol at an address */
+    return sa->size < sb->size ? 1 : sa->size > sb->size ? -1 : 0;
+}
+
+static int hit_cmp(const void *a, const void *b)
+{
+    const hit_t *ha = a, *hb = b;
+    return ha->count < hb->count ? 1 : ha->count > hb->count ? -1 : 0;
+}
+
+/* Collect every code symbol from the ELF's symbol table */
+static void load_symbols(const char *path)
+{
+    int          fd;
+    struct stat  fstats;
+    Elf32_Ehdr*  ehdr;
+    Elf32_Shdr*  shdrs;
+    size_t       i, j, n;
+    int          thumb;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0 || fstat(fd, &fstats) < 0)
+    {
+        perror("open elffile");
+        exit(-1);
+    }
+    elf_sz = fstats.st_size;
+
+    elf = mmap(NULL, elf_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(elf == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(-1);
+    }
+    close(fd);
+
+    ehdr = (Elf32_Ehdr*)elf;
+    if(elf_sz < sizeof(*ehdr) ||
+       memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+       ehdr->e_ident[EI_CLASS] != ELFCLASS32)
+    {
+        printf("Invalid ELF\n");
+        exit(-1);
+    }
+    elf_msb = ehdr->e_ident[EI_DATA] == ELFDATA2MSB;
+    thumb   = get16(&ehdr->e_machine) == EM_ARM;
+
+    n = get16(&ehdr->e_shnum);
+    if(elf_sz < get32(&ehdr->e_shoff) + n * sizeof(Elf32_Shdr))
+    {
+        printf("ELF File too small\n");
+        exit(-1);
+    }
+    shdrs = (Elf32_Shdr*)(elf + get32(&ehdr->e_shoff));
+
+    for(i = 0; i < n; i++)
+    {
+        Elf32_Sym*  sym;
+        const char* strtab;
+        size_t      count;
+
+        if(get32(&shdrs[i].sh_type) != SHT_SYMTAB)
+            continue;
+
+        sym    = (Elf32_Sym*)(elf + get32(&shdrs[i].sh_offset));
+        count  = get32(&shdrs[i].sh_size) / sizeof(Elf32_Sym);
+        strtab = (const char*)elf + get32(&shdrs[get32(&shdrs[i].sh_link)].sh_offset);
+
+        syms = realloc(syms, (num_syms + count) * sizeof(sym_t));
+        if(syms == NULL)
+        {
+            perror("realloc");
+            exit(-1);
+        }
+
+        for(j = 0; j < count; j++)
+        {
+            uint16_t    shndx = get16(&sym[j].st_shndx);
+            int         type  = ELF32_ST_TYPE(sym[j].st_info);
+            const char* name  = strtab + get32(&sym[j].st_name);
+
+            if(shndx == SHN_UNDEF || shndx >= n)
+                continue;
+            if(!(get32(&shdrs[shndx].sh_flags) & SHF_EXECINSTR))
+                continue;
+
+            /* Assembly labels (e.g. context_save) have no type, but
+             * skip ARM mapping symbols and local labels */
+            if(type != STT_FUNC && type != STT_NOTYPE)
+                continue;
+            if(name[0] == '\0' || name[0] == '$' || name[0] == '.')
+                continue;
+
+            syms[num_syms].addr = get32(&sym[j].st_value);
+            syms[num_syms].size = get32(&sym[j].st_size);
+            syms[num_syms].name = name;
+            if(thumb)
+                syms[num_syms].addr &= ~1u;
+            num_syms++;
+        }
+    }
+
+    if(num_syms == 0)
+    {
+        printf("No symbols in %s\n", path);
+        exit(-1);
+    }
+
+    qsort(syms, num_syms, sizeof(sym_t), sym_cmp);
+}
+
+/* Index of the symbol a PC falls in, or num_syms if none */
+static size_t lookup(uint32_t pc)
+{
+    size_t lo = 0, hi = num_syms;
+
+    /* find the last symbol starting at or before pc */
+    while(hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if(syms[mid].addr <= pc)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    if(syms[lo].addr > pc)
+        return num_syms;
+
+    /* The first symbol at an address is the sized one, if any */
+    while(lo > 0 && syms[lo - 1].addr == syms[lo].addr)
+        lo--;
+
+    if(syms[lo].size && pc >= syms[lo].addr + syms[lo].size)
+        return num_syms;
+
+    return lo;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE*     in = stdin;
+    char      line[256];
+    char*     rec;
+    unsigned  task, pc, lost;
+    uint32_t* counts[MAX_TASKS] = { NULL };
+    uint32_t  totals[MAX_TASKS] = { 0 };
+    uint32_t  total_lost = 0;
+    hit_t*    hits;
+    size_t    i, n;
+
+    if(argc != 2 && argc != 3)
+    {
+        printf("argv[1] should be a path to the mselOS ELF file\n");
+        printf("argv[2] should be a path to a UART log (default stdin)\n");
+        exit(-1);
+    }
+
+    load_symbols(argv[1]);
+
+    if(argc == 3)
+    {
+        in = fopen(argv[2], "r");
+        if(in == NULL)
+        {
+            perror("open log");
+            exit(-1);
+        }
+    }
+
+    while(fgets(line, sizeof(line), in))
+    {
+        rec = strstr(line, "prof ");
+        if(rec == NULL)
+            continue;
+
+        if(sscanf(rec, "prof lost %8x", &lost) == 1)
+        {
+            total_lost += lost;
+            continue;
+        }
+        if(sscanf(rec, "prof %2x %8x", &task, &pc) != 2 || task >= MAX_TASKS)
+            continue;
+
+        if(counts[task] == NULL)
+        {
+            counts[task] = calloc(num_syms + 1, sizeof(uint32_t));
+            if(counts[task] == NULL)
+            {
+                perror("calloc");
+                exit(-1);
+            }
+        }
+        counts[task][lookup(pc)]++;
+        totals[task]++;
+    }
+
+    hits = malloc((num_syms + 1) * sizeof(hit_t));
+    if(hits == NULL)
+    {
+        perror("malloc");
+        exit(-1);
+    }
+
+    if(total_lost)
+        printf("%u samples lost (UART too slow, try fewer samples per tick)\n\n", total_lost);
+
+    for(task = 0; task < MAX_TASKS; task++)
+    {
+        if(totals[task] == 0)
+            continue;
+
+        for(i = 0, n = 0; i <= num_syms; i++)
+        {
+            if(counts[task][i] == 0)
+                continue;
+            hits[n].sym   = i;
+            hits[n].count = counts[task][i];
+            n++;
+        }
+        qsort(hits, n, sizeof(hit_t), hit_cmp);
+
+        printf("task %u: %u samples\n", task, totals[task]);
+        printf("  %%time  samples  function\n");
+        for(i = 0; i < n; i++)
+            printf("%7.2f %8u  %s\n", 100.0 * hits[i].count / totals[task], hits[i].count,
+                   hits[i].sym < num_syms ? syms[hits[i].sym].name : "??");
+        printf("\n");
+
+        free(counts[task]);
+    }
+
+    free(hits);
+    free(syms);
+    munmap(elf, elf_sz);
+    if(in != stdin)
+        fclose(in);
+    return 0;
+}
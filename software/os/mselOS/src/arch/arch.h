@@ -37,6 +37,7 @@
 
 #include "config.h"
 #include "os/task.h"
+#include "os/mutex.h"
 
 /* Arch-generic driver includes define APIs between os and libarch */
 #include "driver/gpio.h"
@@ -60,11 +61,24 @@
 /* Arch-specific helper functions */
 void arch_init_isr();
 
+/* MMIO access: every location is touched exactly once, in order, and
+ * whole words are used only when dst, src and sz are all word aligned */
+void arch_mmio_copy(volatile void *dst, const volatile void *src, size_t sz);
+void arch_mmio_set(volatile void *dst, uint8_t val, size_t sz);
+
 /* System Module */
 void        arch_systick_handler();
 void        arch_task_setup_mm(msel_tcb*);
-msel_status arch_mutex_lock();
+void        arch_mm_invalidate(void *addr, size_t sz);
+/* For pages lent between tasks: take away (or give back) the owner's
+ * write access, or give (or take away) a borrower read access */
+void        arch_mm_page_readonly(uint8_t tasknum, void *page, int readonly);
+void        arch_mm_page_borrow(uint8_t tasknum, void *page, int borrow);
+msel_status arch_mutex_lock(msel_mutex*, msel_tcb*);
 void        arch_platform_init();
+/* Free-running count of CPU cycles since boot, wraps around. Only
+ * valid with interrupts off. */
+uint32_t    arch_timestamp();
 
 /* Task Module */
 void        arch_init_task();
@@ -72,11 +86,21 @@ msel_status arch_task_create(msel_tcb*);
 void        arch_task_launch_main(msel_tcb*);
 void        arch_task_cleanup(msel_tcb*);
 void*       arch_get_task_heap();
+/* Where the task will resume, from its saved context */
+uint32_t    arch_task_pc(msel_tcb*);
+/* Set what a task sleeping in a syscall gets back when it resumes */
+void        arch_task_set_result(msel_tcb*, msel_status);
+/* Round a task's memory up to a region the MMU/MPU can protect on its
+ * own, returning the size and the alignment it needs. If span isn't 0
+ * the region also mustn't cross a multiple of span. */
+size_t      arch_taskmem_region_size(size_t sz, size_t *align, size_t *span);
 
 /* UART module */
 int  arch_init_uart();
 void arch_uart_putc(char c);
 int  arch_uart_is_writable();
+/* Enable or disable the transmitter empty interrupt */
+void arch_uart_tx_irq(int enable);
 
 /* GPIO module */
 void   arch_gpio_config(gpioid_t ios, gpioconf_t conf);
@@ -87,9 +111,29 @@ gpio_t arch_gpio_read(gpioid_t ios);
 void arch_init_led();
 void arch_led_set(ledio_t led, ledstatus_t val);
 
-/* MTC module */
-msel_status arch_mtc_read_increment(mtc_t* val);
+/* MTC module. arch_mtc_reserve may return MSEL_EBUSY, meaning the
+ * flash is still being written; arch_mtc_poll then returns MSEL_EBUSY
+ * until the reservation is done and gives its result. Only one
+ * reservation may be in progress at a time. */
 msel_status arch_mtc_write(mtc_t* val);
+msel_status arch_mtc_reserve(uint32_t count, mtc_t* first);
+msel_status arch_mtc_poll(mtc_t* first);
+
+/* Non-volatile storage for the key-value store: a few erase segments
+ * of the same size. Writes only clear bits (erased is all 0xff) and are
+ * durable by the time arch_nvm_write returns. arch_nvm_segments is 0
+ * where there is no such storage. */
+size_t      arch_nvm_segments();
+size_t      arch_nvm_segment_size();
+msel_status arch_nvm_read(size_t seg, size_t off, void* dst, size_t len);
+msel_status arch_nvm_write(size_t seg, size_t off, const void* src, size_t len);
+msel_status arch_nvm_erase(size_t seg);
+
+/* arch_nvm_erase_start begins erasing a segment and leaves it running;
+ * arch_nvm_poll then returns MSEL_EBUSY until it is done and gives its
+ * result. Nothing else may touch the storage in the meantime. */
+msel_status arch_nvm_erase_start(size_t seg);
+msel_status arch_nvm_poll();
 
 /* Master Key Module */
 msel_status arch_master_key_read(mkey_ptr_t val);
@@ -115,6 +159,7 @@ msel_status arch_hw_ecc_mul(ecc_ctx_t* ctx);
 
 */
 msel_status arch_ffs_wfile_read(ffs_packet_t *pkt);
+msel_status arch_ffs_wfile_read_hdr(uint16_t *session);
 void        arch_ffs_wfile_set_status(uint8_t status, uint8_t nonce);
 uint8_t     arch_ffs_wfile_get_status();
 msel_status arch_ffs_rfile_write(ffs_packet_t *pkt);
@@ -13,9 +13,12 @@
    See the License for the specific language governing permissions and
    limitations under the License.
 */
+#include <msel/stdc.h>
+
 #include "arch.h"
 #include "os/task.h"
 #include "os/mutex.h"
+#include "os/system.h"
 #include "m3.h"
 
 
@@ -63,4 +66,57 @@ void arch_systick_handler()
     /* Nothing platform-specific here. SysTick automatically resets itself */
 }
 
+uint32_t arch_timestamp()
+{
+    /* SysTick counts down from the reload value to 0 */
+    uint32_t reload = *SYSTICK_RV_REG + 1;
+    uint32_t ctr    = *SYSTICK_CV_REG;
+    uint32_t irqs   = msel_timer_irqs;
+
+    /* Count a wrap that the SysTick exception hasn't handled yet */
+    if(*MSEL_ICSR & PENDSTSET)
+    {
+        irqs++;
+        ctr = *SYSTICK_CV_REG;
+    }
+
+    return irqs * reload + (reload - 1 - ctr);
+}
+
+
+
+/* The key-value store isn't backed by eNVM yet */
+size_t arch_nvm_segments()
+{
+    return 0;
+}
+
+size_t arch_nvm_segment_size()
+{
+    return 0;
+}
 
+msel_status arch_nvm_read(size_t seg, size_t off, void* dst, size_t len)
+{
+    return MSEL_ENOTIMPL;
+}
+
+msel_status arch_nvm_write(size_t seg, size_t off, const void* src, size_t len)
+{
+    return MSEL_ENOTIMPL;
+}
+
+msel_status arch_nvm_erase(size_t seg)
+{
+    return MSEL_ENOTIMPL;
+}
+
+msel_status arch_nvm_erase_start(size_t seg)
+{
+    return MSEL_ENOTIMPL;
+}
+
+msel_status arch_nvm_poll()
+{
+    return MSEL_ENOTIMPL;
+}
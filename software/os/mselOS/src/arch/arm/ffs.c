@@ -21,6 +21,11 @@ msel_status arch_ffs_wfile_read(ffs_packet_t *pkt)
     return MSEL_ENOTIMPL;
 }
 
+msel_status arch_ffs_wfile_read_hdr(uint16_t *session)
+{
+    return MSEL_ENOTIMPL;
+}
+
 void arch_ffs_wfile_set_status(uint8_t status, uint8_t nonce)
 {}
 
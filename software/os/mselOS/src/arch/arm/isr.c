@@ -21,6 +21,8 @@
 #include "os/system.h"
 #include "os/syscall.h"
 #include "os/task.h"
+#include "os/trace.h"
+#include "os/profile.h"
 #include "isr.h"
 #include "config.h"
 
@@ -38,7 +40,7 @@ void arch_init_isr()
     *BFSR = 0;
 
     /* Setup system timer */
-    *SYSTICK_RV_REG = ( 10 * CLK_FREQ / MSEL_TIMER_FREQ ) - 1UL;
+    *SYSTICK_RV_REG = ( 10 * CLK_FREQ / MSEL_TIMER_FREQ / PROFILE_TIMER_DIV ) - 1UL;
 
     *SYSTICK_CS_REG = SYSTICK_CLKSOURCE | SYSTICK_TICKINT | SYSTICK_ENABLE;
 
@@ -153,7 +155,8 @@ void svc_handler()
     arm_saved_regs* regs      = (arm_saved_regs*)curr_task->stack;
 
     msel_status retval;
-    
+
+    curr_task->ctrs.stats.syscalls++;
     retval = msel_svc_handler((msel_svc_number)regs->r0, (void *)regs->r1);
 
     /* Make sure to use regs from saved TCB... msel_active_task may have been rescheduled */
@@ -163,7 +166,9 @@ void svc_handler()
 /** @brief Handles the exception that triggers when SYSTICK expires */
 void systick_handler() 
 {
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_ENTER, 15);
     msel_systick_handler();
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_EXIT, 15);
 }
 
 void debugmon_handler()
@@ -22,6 +22,7 @@
 #ifndef _MSEL_M3_H_
 #define _MSEL_M3_H_
 
+#define RAM_SIZE  0x10000 /* as in link.ld */
 #define PAGE_SIZE 4096 /* m3 doesn't really use pages, but define the smallest chunk of task mem here */
 #define CLK_FREQ 50000000
 
@@ -68,6 +69,7 @@
 #define MPU_RASR_A2           ((uint32_t*)0xE000EDB0)
 #define MPU_RBAR_A3           ((uint32_t*)0xE000EDB4)
 #define MPU_RASR_A3           ((uint32_t*)0xE000EDB8)
+#define MPU_NUM_REGIONS       8
 #define MPU_AP_NONE_NONE      (0ul)
 #define MPU_AP_RW_NONE        (1ul)
 #define MPU_AP_RW_RO          (2ul)
@@ -133,6 +135,10 @@
 #define BUSFAULTACT    (1ul << 1)
 #define MEMFAULTACT    (1ul)
 
+/* Interrupt control and state */
+#define MSEL_ICSR      ((uint32_t*)0xE000ED04)
+#define PENDSTSET      (1ul << 26)
+
 /* Other defs */
 #define NVIC_PRIO_BITS          4
 
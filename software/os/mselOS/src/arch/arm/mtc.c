@@ -16,12 +16,17 @@
 #include <msel.h>
 #include "driver/mtc.h"
 
-msel_status arch_mtc_read_increment(mtc_t* val)    
+msel_status arch_mtc_write(mtc_t* val)
 {
     return MSEL_ENOTIMPL;
 }
 
-msel_status arch_mtc_write(mtc_t* val)
+msel_status arch_mtc_reserve(uint32_t count, mtc_t* first)
+{
+    return MSEL_ENOTIMPL;
+}
+
+msel_status arch_mtc_poll(mtc_t* first)
 {
     return MSEL_ENOTIMPL;
 }
@@ -0,0 +1,183 @@
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <stdlib.h> /* for size_t only */
+#include <stdint.h>
+
+#include <msel/stdc.h>
+
+#include "arch.h"
+
+/* The M3 copes with unaligned LDR/STR, but only slowly, so copies are
+ * split into a byte-wise head up to a word boundary, a 16-byte unrolled
+ * body, single words, and a byte-wise tail. If the two buffers can't be
+ * aligned at the same time it's bytes all the way. */
+
+/* Below this many bytes aligning isn't worth the trouble */
+#define WORD_COPY_MIN 8
+
+#define IS_WORD_ALIGNED(p) ((((uintptr_t)(p)) & 3) == 0)
+
+void* msel_memset(void *dst, int val, size_t sz)
+{
+    uint8_t  *dst_c = dst;
+    uint32_t *dst_w;
+    uint32_t  word;
+
+    if(sz >= WORD_COPY_MIN)
+    {
+        while(!IS_WORD_ALIGNED(dst_c))
+        {
+            *dst_c++ = (uint8_t)val;
+            sz--;
+        }
+
+        word  = (uint8_t)val;
+        word |= word << 8;
+        word |= word << 16;
+
+        dst_w = (uint32_t*)dst_c;
+        for(; sz >= 16; sz -= 16, dst_w += 4)
+        {
+            dst_w[0] = word;
+            dst_w[1] = word;
+            dst_w[2] = word;
+            dst_w[3] = word;
+        }
+        for(; sz >= 4; sz -= 4)
+            *dst_w++ = word;
+
+        dst_c = (uint8_t*)dst_w;
+    }
+
+    while(sz--)
+        *dst_c++ = (uint8_t)val;
+
+    return dst;
+}
+
+void* msel_memcpy(void *dst, const void *src, size_t sz)
+{
+    const uint8_t  *src_c = src;
+    uint8_t        *dst_c = dst;
+    const uint32_t *src_w;
+    uint32_t       *dst_w;
+
+    if(sz >= WORD_COPY_MIN && IS_WORD_ALIGNED((uintptr_t)dst_c ^ (uintptr_t)src_c))
+    {
+        while(!IS_WORD_ALIGNED(dst_c))
+        {
+            *dst_c++ = *src_c++;
+            sz--;
+        }
+
+        src_w = (const uint32_t*)src_c;
+        dst_w = (uint32_t*)dst_c;
+        for(; sz >= 16; sz -= 16, src_w += 4, dst_w += 4)
+        {
+            dst_w[0] = src_w[0];
+            dst_w[1] = src_w[1];
+            dst_w[2] = src_w[2];
+            dst_w[3] = src_w[3];
+        }
+        for(; sz >= 4; sz -= 4)
+            *dst_w++ = *src_w++;
+
+        src_c = (const uint8_t*)src_w;
+        dst_c = (uint8_t*)dst_w;
+    }
+
+    while(sz--)
+        *dst_c++ = *src_c++;
+
+    return dst;
+}
+
+int msel_memcmp(const void *a, const void *b, size_t sz)
+{
+    const uint8_t  *a_c = a;
+    const uint8_t  *b_c = b;
+    const uint32_t *a_w;
+    const uint32_t *b_w;
+
+    if(sz >= WORD_COPY_MIN && IS_WORD_ALIGNED((uintptr_t)a_c ^ (uintptr_t)b_c))
+    {
+        while(!IS_WORD_ALIGNED(a_c) && *a_c == *b_c)
+        {
+            a_c++; b_c++;
+            sz--;
+        }
+
+        /* Skip over matching words; the first difference (if any) is
+         * then found byte by byte since the M3 is little-endian */
+        if(IS_WORD_ALIGNED(a_c))
+        {
+            a_w = (const uint32_t*)a_c;
+            b_w = (const uint32_t*)b_c;
+            for(; sz >= 4 && *a_w == *b_w; sz -= 4)
+            {
+                a_w++; b_w++;
+            }
+            a_c = (const uint8_t*)a_w;
+            b_c = (const uint8_t*)b_w;
+        }
+    }
+
+    for(; sz > 0; sz--, a_c++, b_c++)
+    {
+        if(*a_c < *b_c)
+            return -1;
+        if(*b_c < *a_c)
+            return 1;
+    }
+    return 0;
+}
+
+void arch_mmio_copy(volatile void *dst, const volatile void *src, size_t sz)
+{
+    if(IS_WORD_ALIGNED((uintptr_t)dst | (uintptr_t)src | sz))
+    {
+        volatile uint32_t       *dst_w = dst;
+        const volatile uint32_t *src_w = src;
+        for(; sz > 0; sz -= 4)
+            *dst_w++ = *src_w++;
+    }
+    else
+    {
+        volatile uint8_t       *dst_c = dst;
+        const volatile uint8_t *src_c = src;
+        for(; sz > 0; sz--)
+            *dst_c++ = *src_c++;
+    }
+}
+
+void arch_mmio_set(volatile void *dst, uint8_t val, size_t sz)
+{
+    if(IS_WORD_ALIGNED((uintptr_t)dst | sz))
+    {
+        volatile uint32_t *dst_w = dst;
+        uint32_t word = val;
+        word |= word << 8;
+        word |= word << 16;
+        for(; sz > 0; sz -= 4)
+            *dst_w++ = word;
+    }
+    else
+    {
+        volatile uint8_t *dst_c = dst;
+        for(; sz > 0; sz--)
+            *dst_c++ = val;
+    }
+}
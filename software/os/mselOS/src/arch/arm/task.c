@@ -19,6 +19,8 @@
 #include "m3.h"
 #include "os/util.h"
 #include "os/taskmem.h"
+#include "driver/ffs_pool.h"
+#include "os/ipc.h"
 
 void arch_init_task(msel_tcb* task)
 {
@@ -30,6 +32,16 @@ void arch_task_cleanup(msel_tcb* task)
     /* nothing additional required */
 }
 
+uint32_t arch_task_pc(msel_tcb* task)
+{
+    return ((arm_saved_regs*)task->stack)->pc;
+}
+
+void arch_task_set_result(msel_tcb* task, msel_status result)
+{
+    ((arm_saved_regs*)task->stack)->r0 = (uint32_t)result;
+}
+
 msel_status arch_task_create(msel_tcb* task)
 {
     arm_saved_regs* regs;
@@ -81,6 +93,17 @@ void arch_task_launch_main(msel_tcb* task)
     
 }
 
+/* An MPU region must be a power of two of at least 4k (the smallest
+ * size arm_mpu_set handles), aligned to its own size */
+static size_t arm_mpu_region_size(size_t sz)
+{
+    size_t region = PAGE_SIZE;
+
+    while(region < sz)
+        region <<= 1;
+    return region;
+}
+
 void arm_mpu_set(size_t slot, void* addr, size_t size, uint32_t perm)
 {
     uint32_t rasr=0;
@@ -119,6 +142,7 @@ extern int rom_start;
 extern int rom_size;
 extern int ram_start;
 extern int ram_size;
+extern int _kernel_private_beg;
 
 void arch_task_setup_mm(msel_tcb* task)
 {
@@ -127,32 +151,79 @@ void arch_task_setup_mm(msel_tcb* task)
 
     /* Slot 1: All ram: Read only (to allow access to .data and .bss) */
     arm_mpu_set(1, &ram_start, (size_t)&ram_size, MSEL_SRAM_MEM_MODE | MPU_RASR_XN | MPU_RASR_ACCESS(MPU_AP_RW_RO));
+
+    /* Slot 2: .kernel_private: no user access, carved out of slot 1 */
+    arm_mpu_set(2, &_kernel_private_beg, PAGE_SIZE, MSEL_SRAM_MEM_MODE | MPU_RASR_XN | MPU_RASR_ACCESS(MPU_AP_RW_NONE));
     
-    /* Slot 2: Task RAM: RW, no execute */
+    /* Slot 3: Task RAM: RW, no execute. The region around it has the
+     * subregions outside the task's memory disabled. */
     void * addr = taskmem_stack_bottom(task->num);
     size_t sz = taskmem_stack_size(task->num) + taskmem_heap_size(task->num);
-    arm_mpu_set(2, addr, sz, MSEL_SRAM_MEM_MODE | MPU_RASR_XN | MPU_RASR_ACCESS(MPU_AP_RW_RW));
+    size_t region = arm_mpu_region_size(sz), sub;
+    uint8_t *window = (uint8_t*)((uintptr_t)addr & ~(region - 1));
+    uint32_t srd = 0;
+    for(sub = 0; sub < 8; ++sub)
+        if(window + sub * (region / 8) < (uint8_t*)addr ||
+           window + sub * (region / 8) >= (uint8_t*)addr + sz)
+            srd |= MPU_RASR_SUBREGION(sub);
+    arm_mpu_set(3, window, region, MSEL_SRAM_MEM_MODE | MPU_RASR_XN | MPU_RASR_ACCESS(MPU_AP_RW_RW) | srd);
+
+    /* Remaining slots: FFS pool pages currently lent to the task: RW, no execute */
+    size_t slot = 4, page;
+    for(page = 0; (addr = msel_ffs_pool_page(page)) != NULL && slot < MPU_NUM_REGIONS; ++page)
+        if(msel_ffs_pool_page_owner(addr) == task->num)
+            arm_mpu_set(slot++, addr, PAGE_SIZE, MSEL_SRAM_MEM_MODE | MPU_RASR_XN | MPU_RASR_ACCESS(MPU_AP_RW_RW));
+
+    /* Then pages lent by or to the task through IPC: read-only, which
+     * takes priority over slot 3 for the lender */
+    for(page = 0; (addr = msel_ipc_task_page(task->num, page)) != NULL && slot < MPU_NUM_REGIONS; ++page)
+        arm_mpu_set(slot++, addr, PAGE_SIZE, MSEL_SRAM_MEM_MODE | MPU_RASR_XN | MPU_RASR_ACCESS(MPU_AP_RW_RO));
+
+    for(; slot < MPU_NUM_REGIONS; ++slot)
+    {
+        *MPU_RNR  = slot;
+        *MPU_RASR = 0;
+    }
     
     __asm__ volatile ("dsb"); /* flush data cache */
 
 }
 
+void arch_mm_invalidate(void *addr, size_t sz)
+{
+    /* The MPU has no cached translations; just rebuild the active task's
+     * regions in case the range was mapped into it */
+    if(msel_active_task != NULL)
+        arch_task_setup_mm(msel_active_task);
+}
+
+/* The regions are rebuilt from the IPC lend table */
+void arch_mm_page_readonly(uint8_t tasknum, void *page, int readonly)
+{
+    arch_mm_invalidate(page, PAGE_SIZE);
+}
+
+void arch_mm_page_borrow(uint8_t tasknum, void *page, int borrow)
+{
+    arch_mm_invalidate(page, PAGE_SIZE);
+}
+
 void* arch_get_task_heap()
 {
-    volatile register uint32_t heapptr;
+    /* Task memory isn't a fixed size any more, so the stack pointer
+     * can't be used to find the heap. The active TCB is in .bss, which
+     * slot 1 lets every task read. */
+    return msel_active_task->heap;
+}
 
-    /* Note that for this technique to work properly, the heap must
-     * immediately follow the stack and sizeof heap must be >= sizeof
-     * stack */
-    
-    asm volatile (
-        "add %0, sp, 0x800   \n" // add sizeof(stack) to sp to generate a ptr within the heap
-        "mov r4, #0          \n"
-        "sub r4, r4, 0x800   \n" // mask = 0xfffff800
-        "and %0, %0, r4      \n" 
-        :"=r"(heapptr)
-        ::"r4"
-    );
+/* Each region has eight subregions that can be switched off, so a task
+ * only needs as many eighths of the region as it uses, at any eighth
+ * inside it. That wastes at most an eighth rather than up to half. */
+size_t arch_taskmem_region_size(size_t sz, size_t *align, size_t *span)
+{
+    size_t region = arm_mpu_region_size(sz);
 
-    return (void *)heapptr;
+    *align = region / 8;
+    *span  = region;
+    return (sz + *align - 1) & ~(*align - 1);
 }
@@ -37,6 +37,11 @@ int arch_uart_is_writable()
     return 0; /* TODO */
 }
 
+void arch_uart_tx_irq(int enable)
+{
+    /* TODO */
+}
+
 int arch_init_uart()
 {
     return 0; /* disabled for now */
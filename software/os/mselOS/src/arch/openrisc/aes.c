@@ -23,7 +23,7 @@
 msel_status arch_do_hw_aes(aes_driver_ctx_t* ctx)
 {
     // Load the key
-    msel_memcpy(AES_KEY_ADDR, ctx->key, (ctx->key_size + 2 ) * 8);
+    arch_mmio_copy(AES_KEY_ADDR, ctx->key, (ctx->key_size + 2 ) * 8);
     
     // Set up the ctrl register
     uint32_t ctrl = 1; // go bit set
@@ -41,7 +41,7 @@ msel_status arch_do_hw_aes(aes_driver_ctx_t* ctx)
     for(i = 0; i < ctx->data_len; i += 16)
     {
         // Write data to be processed
-        msel_memcpy(AES_DIN_ADDR, ctx->din + i, 16);
+        arch_mmio_copy(AES_DIN_ADDR, ctx->din + i, 16);
 
         // Start the encryption/decryption
         *(AES_CTRL_ADDR) = ctrl;
@@ -50,7 +50,7 @@ msel_status arch_do_hw_aes(aes_driver_ctx_t* ctx)
         while (*(AES_CTRL_ADDR) & (1 << 16)) { /* wait */ }
 
         // Read processed data
-        msel_memcpy(ctx->dout + i, AES_DOUT_ADDR, 16);
+        arch_mmio_copy(ctx->dout + i, AES_DOUT_ADDR, 16);
     } 
 
     // Reset
@@ -26,6 +26,51 @@
 #include "or1k.h"
 #include "arch.h"
 
+extern int _data_beg;
+extern int _bss_end;
+
+/* Data TLB permissions for every page of RAM, per task. These are
+ * worked out once when the task is created, so that neither a context
+ * switch nor DTLBMiss has to go through the address ranges again. */
+static uint32_t task_dtlb_tr[MSEL_TASKS_MAX][RAM_PAGES];
+
+static void dtlb_precompute(msel_tcb* task)
+{
+    uint32_t *tr     = task_dtlb_tr[task->num];
+    uint32_t  bottom = (uint32_t)taskmem_stack_bottom(task->num);
+    uint32_t  top    = (uint32_t)taskmem_heap_end(task->num);
+    uint32_t  vaddr;
+    size_t    page;
+
+    for(page = 0; page < RAM_PAGES; page++)
+    {
+        vaddr = RAM_START + page * PAGE_SIZE;
+
+        /* Supervisor can read/write entire ram space */
+        tr[page] = TLBTR_SRE | TLBTR_SWE;
+
+        /* Task 0 can r/w entire ram space */
+        if(task->num == MSEL_TASK_MAIN)
+        {
+            tr[page] |= TLBTR_URE | TLBTR_UWE;
+            continue;
+        }
+
+        /* User tasks access their own ram (always whole pages) */
+        if(vaddr >= bottom && vaddr < top)
+            tr[page] |= TLBTR_URE | TLBTR_UWE;
+
+        /* User tasks can still read bss & data to avoid linking nightmares */
+        if(vaddr + PAGE_SIZE > (uint32_t)&_data_beg && vaddr < (uint32_t)&_bss_end)
+            tr[page] |= TLBTR_URE;
+    }
+}
+
+uint32_t or1k_dtlb_ram_perms(size_t tasknum, uint32_t vaddr)
+{
+    return task_dtlb_tr[tasknum][(vaddr - RAM_START) >> PAGE_BITS];
+}
+
 void arch_init_task()
 {
 }
@@ -43,6 +88,11 @@ msel_status arch_task_create(msel_tcb* task)
     /* initialize registers */
     msel_memset(regs, 0, sizeof(*regs));
 
+    /* Tag the task's TLB entries with its own context, and get its
+     * page permissions ready for arch_task_setup_mm */
+    task->arch.ctx_id = task->num;
+    dtlb_precompute(task);
+
     /* Initialize the status register for the new task */
     regs->sr |= SPR_SR_IEE; /* interrupt enable */
     regs->sr |= SPR_SR_TEE; /* timer enable */
@@ -67,6 +117,16 @@ void arch_task_cleanup(msel_tcb* task)
 {
 }
 
+uint32_t arch_task_pc(msel_tcb* task)
+{
+    return ((or1k_saved_regs*)task->stack)->pc;
+}
+
+void arch_task_set_result(msel_tcb* task, msel_status result)
+{
+    ((or1k_saved_regs*)task->stack)->r11 = (uint32_t)result;
+}
+
 void arch_task_launch_main(msel_tcb* task)
 {
 
@@ -82,10 +142,15 @@ void arch_task_launch_main(msel_tcb* task)
     /* Never reached */
 }
 
-msel_status arch_mutex_lock()
+msel_status arch_mutex_lock(msel_mutex* mut, msel_tcb* who)
 {
-    /* TODO! */
-    return MSEL_ENOTIMPL;
+    /* Kernel code runs with interrupts off and a single core, so a
+     * plain test and set can't be interrupted */
+    if(*mut != (msel_mutex)MSEL_MUTEX_UNLOCKED)
+        return MSEL_EBUSY;
+
+    *mut = (msel_mutex)who;
+    return MSEL_OK;
 }
 
 void arch_platform_init()
@@ -93,20 +158,6 @@ void arch_platform_init()
     /* Most system init for openrisc happens in arch_init_isr() */
 }
 
-void arch_nvm_write(uint8_t* dest, const uint8_t* src, uint32_t len)
-{
-    (void)dest;
-    (void)src;
-    (void)len;
-}
-
-void arch_nvm_read(uint8_t* dest, uint8_t* src, uint32_t len)
-{
-    (void)dest;
-    (void)src;
-    (void)len;
-}
-
 /* Initialize system timer interrupt (see OpenRisc Arch 1.1, Chapter 14)*/
 void arch_init_tick_timer()
 {
@@ -118,7 +169,7 @@ void arch_init_tick_timer()
     spr_write(SPR_TTCR, 0);
     
     /* TTMR[TP] = ticks_per_intr, TODO: figure out reasonable value for non-sim environment */
-    SPR_TTMR_TP_SET(500000);
+    SPR_TTMR_TP_SET(TIMER_CYCLES);
 
     /* TTMR[M] = 0x1; auto-restart timer on expire */
     SPR_TTMR_M_SET(1);
@@ -139,6 +190,25 @@ void arch_systick_handler()
     SPR_TTMR_IP_SET(0);
 }
 
+uint32_t arch_timestamp()
+{
+    uint32_t irqs = msel_timer_irqs;
+    uint32_t pend = SPR_TTMR_IP_GET();
+    uint32_t ctr  = spr_read(SPR_TTCR);
+
+    /* TTCR restarts at 0 when the timer fires, which may be before
+     * msel_systick_handler has had a chance to count it */
+    if(!pend && SPR_TTMR_IP_GET())
+    {
+        pend = 1;
+        ctr  = spr_read(SPR_TTCR);
+    }
+    if(pend)
+        irqs++;
+
+    return irqs * TIMER_CYCLES + ctr;
+}
+
 /*
   There are two MMUs because of the harvard arch, DMMU and IMMU.
 
@@ -172,12 +242,79 @@ extern int end;
 /* This must be called from an interrupt context with MMU disabled */
 void arch_task_setup_mm(msel_tcb *task)
 {
-    /* The only user page permissions that ever change are for each's
-     * tasks private memory areas. Currently, these are all page
-     * aligned and no shared memory is possible in between tasks. If
-     * that changes we'll probably want to invalidate the cache
-     * entries for the entire private area here before restoring
-     * context */
+    /* Every RAM page has its own TLB set, so all of the task's pages are
+     * loaded up front rather than faulted in one at a time after every
+     * switch. ROM and MMIO entries are the same for every task and are
+     * left to DTLBMiss.
+     *
+     * Any other RAM entry still cached may carry another task's
+     * permissions and has to go, unless it is tagged with this task's
+     * context (e.g. an FFS pool page lent to it, which is invalidated
+     * whenever it changes hands). Sets shared with a ROM page are left
+     * alone if that's what they hold. */
+    uint32_t *tr = task_dtlb_tr[task->num];
+    uint32_t  ctx = (uint32_t)task->arch.ctx_id << 2;
+    uint32_t  vaddr, mr;
+    size_t    page;
+
+    for(page = 0; page < RAM_PAGES; page++)
+    {
+        vaddr = RAM_START + page * PAGE_SIZE;
+
+        if(tr[page] & TLBTR_URE)
+        {
+            spr_write(SPR_DTLBW0MR(TLB_ENTRY(vaddr)), vaddr | TLBMR_V | ctx);
+            spr_write(SPR_DTLBW0TR(TLB_ENTRY(vaddr)), vaddr | tr[page]);
+        }
+        else
+        {
+            mr = spr_read(SPR_DTLBW0MR(TLB_ENTRY(vaddr)));
+            if((mr & VPN_MASK) == vaddr && (mr & TLBMR_CID_MASK) != ctx)
+                spr_write(SPR_DTLBW0MR(TLB_ENTRY(vaddr)), 0);
+        }
+    }
+}
+
+/* Lent pages are handled by editing the precomputed permissions, so
+ * arch_task_setup_mm and DTLBMiss pick them up. Task 0 can read and
+ * write everything anyway. */
+void arch_mm_page_readonly(uint8_t tasknum, void *page, int readonly)
+{
+    uint32_t *tr = &task_dtlb_tr[tasknum][((uint32_t)page - RAM_START) >> PAGE_BITS];
+
+    if(tasknum == MSEL_TASK_MAIN)
+        return;
+
+    if(readonly)
+        *tr &= ~TLBTR_UWE;
+    else
+        *tr |= TLBTR_UWE;
+    arch_mm_invalidate(page, PAGE_SIZE);
+}
+
+void arch_mm_page_borrow(uint8_t tasknum, void *page, int borrow)
+{
+    uint32_t *tr = &task_dtlb_tr[tasknum][((uint32_t)page - RAM_START) >> PAGE_BITS];
+
+    if(tasknum == MSEL_TASK_MAIN)
+        return;
+
+    if(borrow)
+        *tr |= TLBTR_URE;
+    else
+        *tr &= ~TLBTR_URE;
+    arch_mm_invalidate(page, PAGE_SIZE);
+}
+
+/* Drop any cached translations for a range of memory so that the next
+ * access goes back through DTLBMiss */
+void arch_mm_invalidate(void *addr, size_t sz)
+{
+    uint32_t vaddr = (uint32_t)addr & VPN_MASK;
+    uint32_t last = (uint32_t)addr + sz;
+
+    for(; vaddr < last; vaddr += PAGE_SIZE)
+        spr_write(SPR_DTLBW0MR(TLB_ENTRY(vaddr)), 0);
 }
 
 
@@ -192,6 +329,7 @@ void arch_init_isr()
 
     /* Init hw interrupts */
     uint32_t intrs = 0;
+    intrs |= (1<<2);  /* UART */
     intrs |= (1<<16);
     intrs |= (1<<17);
     spr_write(SPR_PICMR, intrs);
@@ -199,52 +337,33 @@ void arch_init_isr()
 
 inline void* arch_get_task_heap() 
 {
-    register void*    heapptr;
-
-    /* assume 2k stacks, calc heap pointer from value of current stack ptr */
-    __asm __volatile(
-        "l.addi  %0, r1, 0x0800   \n"
-        "l.movhi r29, 0xffff      \n"
-        "l.ori   r29, r29, 0xf800 \n"
-        "l.and   %0, %0, r29      \n"
-        :"=r"(heapptr)
-        ::"r29"
-    );
-
-    return heapptr;
+    /* Task memory isn't a fixed size any more, so the stack pointer
+     * can't be used to find the heap. The active TCB is in .bss, which
+     * every task may read. */
+    return msel_active_task->heap;
 }
 
-int or1k_save_context()
+/* Task memory is protected page by page */
+size_t arch_taskmem_region_size(size_t sz, size_t *align, size_t *span)
 {
-    /* interrupted task's SP saved via context_save */
-    register uint32_t task_sp asm("r31");
+    *align = PAGE_SIZE;
+    *span  = 0;
+    return (sz + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
 
-    const int        save_sz = 0x108; /* x80 for regs x80 for res space, 8 for frame */
-    or1k_saved_regs *regs    = (or1k_saved_regs*)((uint8_t*)0x220000 - save_sz);
-    size_t           task    = msel_active_task_num;
+/* Called from the exception entry in init.s when the interrupted
+ * task's SP doesn't leave room to save its registers. Nothing of the
+ * task has been saved, and we're running on the kernel stack. */
+void or1k_stack_fault()
+{
+    size_t task = msel_active_task_num;
 
-    /* Ensure the stack for interrupted task is valid */
-    if( (task_sp <= (uint32_t)taskmem_stack_bottom(task)+save_sz) ||
-       (task_sp > (uint32_t)taskmem_stack_top(task)) )
+    if(task != MSEL_TASK_MAIN)
     {
-        if(task != MSEL_TASK_MAIN)
-        {
-            msel_task_force_kill(task, "Stack error");
-            /* Indicate that the handler should *NOT* be called */
-            return 0;
-        }
-        else
-        {
-            msel_panic("Stack error in task0");
-        }
+        msel_task_force_kill(task, "Stack error");
+    }
+    else
+    {
+        msel_panic("Stack error in task0");
     }
-
-    /* Update saved stack ptr in task struct */
-    msel_active_task->stack = (void*)task_sp - save_sz;
-
-    /* Copy saved reg values */
-    msel_memcpy(msel_active_task->stack, regs, sizeof(*regs));
-
-    /* Indicate that the handler should be called */
-    return 1;
 }
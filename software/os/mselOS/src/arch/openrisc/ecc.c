@@ -20,8 +20,8 @@
 
 msel_status arch_hw_ecc_mul(ecc_ctx_t* ctx) {
     // Load the point and the scalar
-    msel_memcpy(ECC_SCALAR_ADDR, ctx->scalar, 128);
-    msel_memcpy(ECC_POINT_ADDR, ctx->point, 128);
+    arch_mmio_copy(ECC_SCALAR_ADDR, ctx->scalar, 128);
+    arch_mmio_copy(ECC_POINT_ADDR, ctx->point, 128);
     
     // Start the multiplication
     *(ECC_CTRL_ADDR) = 1;
@@ -30,7 +30,7 @@ msel_status arch_hw_ecc_mul(ecc_ctx_t* ctx) {
     while (*(ECC_CTRL_ADDR) & (1 << 16)) { /* wait */ }
 
     // Read processed data
-    msel_memcpy(ctx->point, ECC_POINT_ADDR, 128);
+    arch_mmio_copy(ctx->point, ECC_POINT_ADDR, 128);
 
     // Reset
     *(ECC_CTRL_ADDR) = (1 << 8);
@@ -25,9 +25,16 @@ static uint8_t curr_wfile_status = FFS_CHANNEL_READY;
 // Write a packet to wfile
 msel_status arch_ffs_wfile_read(ffs_packet_t *pkt)
 {
-    msel_memcpy(&(pkt->session), FFS_RECV_DATA_ADDR, 2);
-    msel_memcpy(&(pkt->nonce), FFS_RECV_DATA_ADDR + 2, 1);
-    msel_memcpy(pkt->data, FFS_RECV_DATA_ADDR + FFS_HDR_SIZE, FFS_DATA_SIZE);
+    arch_mmio_copy(&(pkt->session), FFS_RECV_DATA_ADDR, 2);
+    arch_mmio_copy(&(pkt->nonce), FFS_RECV_DATA_ADDR + 2, 1);
+    arch_mmio_copy(pkt->data, FFS_RECV_DATA_ADDR + FFS_HDR_SIZE, FFS_DATA_SIZE);
+    return MSEL_OK;
+}
+
+// Peek at the session a packet in wfile is destined for
+msel_status arch_ffs_wfile_read_hdr(uint16_t *session)
+{
+    arch_mmio_copy(session, FFS_RECV_DATA_ADDR, 2);
     return MSEL_OK;
 }
 
@@ -61,14 +68,14 @@ msel_status arch_ffs_rfile_write(ffs_packet_t *pkt)
 	// Set the header/nonce to 0 while the data write is occuring; the android
 	// application should not read the data until the header has been filled in
 	// and the nonce matches
-	msel_memcpy(FFS_SEND_DATA_ADDR, &hdr, FFS_HDR_SIZE);
+	arch_mmio_copy(FFS_SEND_DATA_ADDR, &hdr, FFS_HDR_SIZE);
 
 	// Copy the data over
-    msel_memcpy(FFS_SEND_DATA_ADDR + FFS_HDR_SIZE, pkt->data, FFS_DATA_SIZE);
+    arch_mmio_copy(FFS_SEND_DATA_ADDR + FFS_HDR_SIZE, pkt->data, FFS_DATA_SIZE);
 
 	// Now set the header
     hdr = (pkt->session << 16) | ((0xff & (uint32_t)nonce) << 8);
-    msel_memcpy(FFS_SEND_DATA_ADDR, &hdr, FFS_HDR_SIZE);
+    arch_mmio_copy(FFS_SEND_DATA_ADDR, &hdr, FFS_HDR_SIZE);
 
     return MSEL_OK;
 }
@@ -76,7 +83,7 @@ msel_status arch_ffs_rfile_write(ffs_packet_t *pkt)
 
 void arch_ffs_rfile_clear()
 {
-    msel_memset(FFS_SEND_DATA_ADDR, 0, FFS_HDR_SIZE + FFS_DATA_SIZE);
+    arch_mmio_set(FFS_SEND_DATA_ADDR, 0, FFS_HDR_SIZE + FFS_DATA_SIZE);
 }
 
 extern int hasSeenReadAck;
@@ -15,64 +15,107 @@
 */
 #include <msel/stdc.h>
 #include "flash.h"
+#include "mtc.h"
+#include "arch.h"
 
-/* WARNING: This interface is *not* for concurrent access */
+/* WARNING: This interface is *not* for concurrent access. The only
+ * operations left running between calls are an MTC append (see mtc.c)
+ * and an nvm erase (see arch_nvm_erase_start); everything else waits
+ * for the flash, so the nvm and master key code calls mtc_drain before
+ * touching it. */
 
-/* Whole pages must be written at a time, so we must buffer in order
- * to perform partial writes. TODO: It may be safe to just drop this
- * buffer and use the page register from the controller directly. */
-static uint8_t flash_scratch_page[FLASH_PAGE_BYTES];
+/* Whole pages must be written at a time, so writes are gathered in a
+ * one page write-back cache. A page is only programmed when some other
+ * page is needed, or on flash_flush/flash_barrier, so a run of small
+ * writes to the same page costs a single program. */
+static uint32_t flash_scratch_page[FLASH_PAGE_BYTES / sizeof(uint32_t)];
 
 /* Tracks the bank/page currently in the buffers */
 static int32_t flash_current_bank = -1;
 static int32_t flash_current_page = -1;
 
-msel_status flash_erase_bank(size_t banknum)
+/* The buffer holds writes that haven't been programmed yet */
+static int     flash_dirty = 0;
+
+int flash_busy()
 {
-    msel_status retval = MSEL_EUNKNOWN;
+    return FLASH_IS_BUSY;
+}
+
+msel_status flash_result()
+{
+    if(FLASH_IS_BUSY)
+        return MSEL_EBUSY;
+    return FLASH_HAD_ERROR ? MSEL_EUNKNOWN : MSEL_OK;
+}
+
+msel_status flash_flush()
+{
+    if(!flash_dirty)
+        return MSEL_OK;
+
+    flash_flush_page(flash_current_bank, flash_current_page);
+    return MSEL_OK;
+}
+
+msel_status flash_barrier()
+{
+    flash_flush();
+
+    while(FLASH_IS_BUSY);
+
+    return flash_result();
+}
+
+msel_status flash_erase_bank_start(size_t banknum)
+{
+    if(banknum >= FLASH_PART_BANKS)
+        return MSEL_EINVAL;
 
-    if(banknum > FLASH_PART_BANKS)
-    {
-        retval = MSEL_EINVAL;
-        goto rethook;
-    }
-    
     if(FLASH_IS_BUSY)
+        return MSEL_EBUSY;
+
+    /* Writes meant for another bank go out first. Ask again once
+     * they're done. */
+    if(flash_dirty && flash_current_bank != banknum)
     {
-        retval = MSEL_EBUSY;
-        goto rethook;
+        flash_flush();
+        return MSEL_EBUSY;
     }
 
-    /* Drop cache */
+    /* Drop cache, including anything not yet written to this bank */
     flash_current_bank = -1;
     flash_current_page = -1;
-    
-    /* Initiate the block erase */
+    flash_dirty = 0;
+
+    /* Initiate the block erase, and leave it running */
     *FLASH_REG_ERASE_BANK = banknum;
 
-    /* we must block here until the entire op finishes or else mutex
-     * all other IO */
-    while(FLASH_IS_BUSY);
+    return MSEL_OK;
+}
 
-    /* Check for hw errors */
-    if(FLASH_HAD_ERROR)
-        return MSEL_EUNKNOWN;
+msel_status flash_erase_bank(size_t banknum)
+{
+    msel_status retval;
 
-    retval = MSEL_OK;
-    
-rethook:
-    return retval;
+    while((retval = flash_erase_bank_start(banknum)) == MSEL_EBUSY);
+
+    if(retval != MSEL_OK)
+        return retval;
+
+    /* Wait for the entire op to finish, then check for hw errors */
+    return flash_barrier();
 }
 
 void flash_read_page(size_t bank, size_t page)
 {
-    uint8_t* ptr = FLASH_CTRL_ADDR;
-    size_t i;
-
     /* Return cached result if applicable */
     if(flash_current_bank == bank && flash_current_page == page)
         return;
 
+    /* Write back whatever the buffer holds first */
+    flash_flush();
+
     /* Drop cache */
     flash_current_bank = -1;
     flash_current_page = -1;
@@ -86,9 +129,8 @@ void flash_read_page(size_t bank, size_t page)
     /* wait for read to complete */
     while(FLASH_IS_BUSY);
 
-    /* Copy to buffer */ 
-    for(i=0; i<sizeof(flash_scratch_page); i+=4)
-        *((uint32_t*)(flash_scratch_page+i)) = *((uint32_t*)(ptr+i));
+    /* Copy to buffer a word at a time */
+    arch_mmio_copy(flash_scratch_page, FLASH_CTRL_ADDR, FLASH_PAGE_BYTES);
 
     /* Update cache info */
     flash_current_bank = bank;
@@ -97,27 +139,24 @@ void flash_read_page(size_t bank, size_t page)
 
 void flash_flush_page(size_t bank, size_t page)
 {
-    uint8_t* ptr = FLASH_CTRL_ADDR;
-    size_t i;
-
     /* wait for pending to complete */
     while(FLASH_IS_BUSY);    
 
-    /* no caching on writes */
-
-    for(i=0; i<sizeof(flash_scratch_page); i+=4)
-        *((uint32_t*)(ptr+i)) = *((uint32_t*)(flash_scratch_page+i));
+    arch_mmio_copy(FLASH_CTRL_ADDR, flash_scratch_page, FLASH_PAGE_BYTES);
 
+    /* Start the program and leave it running; the next operation (or
+     * flash_barrier) waits for it */
     *FLASH_REG_WRITE_PAGE = (uint32_t)FLASH_PAGE_ADDR(bank, page);
 
-    /* wait for read to complete */
-    while(FLASH_IS_BUSY);    
+    if(flash_current_bank == bank && flash_current_page == page)
+        flash_dirty = 0;
 }
 
 
 
 /* Buffering memcpy into flash that satisfys the requirement that all
- * writes consist of in-order writes of complete pages only */
+ * writes consist of in-order writes of complete pages only. Nothing
+ * reaches the flash until the page is evicted or flushed. */
 msel_status flash_writemem(void* dst, void* src, size_t sz)
 {
     size_t count = 0;
@@ -148,11 +187,10 @@ msel_status flash_writemem(void* dst, void* src, size_t sz)
             tmpcnt = sz - count;
 
         /* Copy snippet into current buffered page */
-        msel_memcpy(flash_scratch_page+offset, (uint8_t*)src+count, tmpcnt);
+        msel_memcpy((uint8_t*)flash_scratch_page+offset, (uint8_t*)src+count, tmpcnt);
+        flash_dirty = 1;
 
         count += tmpcnt; /* dst+count should now be aligned if sz-count>0 */
-
-        flash_flush_page(bank, page);
     }
 
     return MSEL_OK;
@@ -190,7 +228,7 @@ msel_status flash_readmem(void* dst, void* src, size_t sz)
             tmpcnt = sz - count;
 
         /* Copy snippet into current buffered page */
-        msel_memcpy((uint8_t*)dst+count, flash_scratch_page+offset, tmpcnt);
+        msel_memcpy((uint8_t*)dst+count, (uint8_t*)flash_scratch_page+offset, tmpcnt);
 
         count += tmpcnt; /* dst+count should now be aligned if sz-count>0 */
 
@@ -198,3 +236,66 @@ msel_status flash_readmem(void* dst, void* src, size_t sz)
 
     return MSEL_OK;
 }
+
+/* The key-value store gets a run of whole banks below the MTC */
+#define NVM_BANK_FIRST 1010 /* 0xE7e40000 - 0xE7ebffff */
+#define NVM_BANKS      4
+
+size_t arch_nvm_segments()
+{
+    return NVM_BANKS;
+}
+
+size_t arch_nvm_segment_size()
+{
+    return FLASH_PAGE_BYTES * FLASH_BANK_PAGES;
+}
+
+msel_status arch_nvm_read(size_t seg, size_t off, void* dst, size_t len)
+{
+    if(seg >= NVM_BANKS || off + len > arch_nvm_segment_size())
+        return MSEL_EINVAL;
+
+    mtc_drain();
+    return flash_readmem(dst, (uint8_t*)FLASH_ADDR(NVM_BANK_FIRST + seg, 0, 0) + off, len);
+}
+
+msel_status arch_nvm_write(size_t seg, size_t off, const void* src, size_t len)
+{
+    msel_status ret;
+
+    if(seg >= NVM_BANKS || off + len > arch_nvm_segment_size())
+        return MSEL_EINVAL;
+
+    mtc_drain();
+    ret = flash_writemem((uint8_t*)FLASH_ADDR(NVM_BANK_FIRST + seg, 0, 0) + off, (void*)src, len);
+    if(ret != MSEL_OK)
+        return ret;
+    return flash_barrier();
+}
+
+msel_status arch_nvm_erase(size_t seg)
+{
+    if(seg >= NVM_BANKS)
+        return MSEL_EINVAL;
+
+    mtc_drain();
+    return flash_erase_bank(NVM_BANK_FIRST + seg);
+}
+
+msel_status arch_nvm_erase_start(size_t seg)
+{
+    msel_status ret;
+
+    if(seg >= NVM_BANKS)
+        return MSEL_EINVAL;
+
+    mtc_drain();
+    while((ret = flash_erase_bank_start(NVM_BANK_FIRST + seg)) == MSEL_EBUSY);
+    return ret;
+}
+
+msel_status arch_nvm_poll()
+{
+    return flash_result();
+}
@@ -116,5 +116,25 @@ void          flash_flush_page(size_t bank, size_t page);
 msel_status   flash_writemem(void* dst, void* src, size_t sz);
 msel_status   flash_readmem(void* dst, void* src, size_t sz);
 
+/* Writes only go to a one page write-back cache; flash_flush starts
+ * programming it and flash_barrier waits until everything written so
+ * far is in the flash. Erases and programs are left running, so callers
+ * that mustn't stall can poll flash_busy and pick the result up with
+ * flash_result. */
+
+/** @brief Non-zero while an erase, program or read is in progress */
+int           flash_busy();
+/** @brief Outcome of the last operation: MSEL_OK, MSEL_EUNKNOWN on a
+    hardware error, or MSEL_EBUSY if it hasn't finished */
+msel_status   flash_result();
+/** @brief Start programming the cached page if it has unwritten data */
+msel_status   flash_flush();
+/** @brief Flush and wait for the controller to finish */
+msel_status   flash_barrier();
+/** @brief Start erasing a bank without waiting for it. MSEL_EBUSY
+    means the controller is busy (or has just been given the cached
+    page to write back) and the call should be repeated later. */
+msel_status   flash_erase_bank_start(size_t banknum);
+
 #endif
 
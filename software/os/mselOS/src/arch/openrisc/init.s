@@ -27,55 +27,83 @@ _reset_vector:
 		l.jr    r3
 		l.nop
 
+/* Offsets into msel_tcb (see os/task.h) and the size of the frame that
+	is pushed onto a task's stack on every exception:
+
+	128 bytes reserved by leaf functions w/o stack frames
+
+	8 bytes for stack frame (saved ret and prev fp)
+
+	128 bytes for 32 regs (r2-r31 + ESR + EPC)
+*/
+	.set TCB_STACK,     0x00
+	.set TCB_STACK_TOP, 0x04
+	.set TCB_STACK_SZ,  0x08
+	.set SAVE_SZ,       0x108
+
+/* This macro checks the SP (r1) of the interrupted task and, if it
+	leaves room for a frame, points r1 at a new (or1k_saved_regs*) on
+	the task's stack with r31 holding the task's SP. Otherwise the task
+	is killed through stack_fault.
+
+	SP comes from an un-trusted task, so nothing may be stored through
+	it until it has been checked against active_task->stack_top and
+	stack_sz. Only r1 and r31 (reserved for the kernel by -ffixed-r31)
+	are free at this point, so the check is done on the distance below
+	stack_top, which also catches SPs above the stack as huge values.
+*/
+.macro enter_task_frame
+	l.addi  r31, r1, 0
+	l.movhi r1,     hi( msel_active_task )
+	l.ori   r1, r1, lo( msel_active_task )
+	l.lwz   r1, 0(r1)                   /* r1  = msel_active_task   */
+	l.lwz   r1, TCB_STACK_TOP(r1)
+	l.sub   r31, r1, r31                /* r31 = stack_top - SP     */
+
+	l.movhi r1,     hi( msel_active_task )
+	l.ori   r1, r1, lo( msel_active_task )
+	l.lwz   r1, 0(r1)
+	l.lwz   r1, TCB_STACK_SZ(r1)
+	l.addi  r1, r1, -SAVE_SZ
+	l.sfgeu r31, r1                     /* no room left for a frame? */
+	l.bf    stack_fault
+	l.movhi r1,     hi( msel_active_task )
+
+	l.ori   r1, r1, lo( msel_active_task )
+	l.lwz   r1, 0(r1)
+	l.lwz   r1, TCB_STACK_TOP(r1)
+	l.sub   r31, r1, r31                /* r31 = SP again           */
+	l.addi  r1, r31, -SAVE_SZ           /* r1  = (or1k_saved_regs*) */
+.endm
+
 /* This macro defines an interrupt handler that will save context,
 	jump to a C handler, restore context and return from the
-	interrupt. Since each handler only gets 0x100 of space and fast
-	context switching is not implemented in OR1200, the actual context
-	save/restore code is contained in a helper stub in .text because
-	just 32 pushes and 32 pops is already 0x100 bytes of code..
+	interrupt. Registers are saved straight onto the stack of the
+	interrupted task. Since each handler only gets 0x100 of space,
+	the rest of the context save/restore code is contained in a
+	helper stub in .text.
 */
 .macro handler symname orgaddr
 	.org \orgaddr
 
-	/*
-
-	SP (r1) comes from an un-trusted task - DO NOT USE
-
-	save r1 in r31 pending validation
-
-	save registers to end of ram
-	
-	*/
-
-	l.addi r31, r1, 0
-	l.movhi r1,     hi( end )
-	l.ori   r1, r1, lo( end )
-
-    /* make some room on the stack.
-
-	   128 bytes reserved by leaf functions w/o stack frames
-
-	   8 bytes for stack frame (saved ret and prev fp)
-	
-	   128 bytes for 32 regs (r2-r31 + ESR + EPC)
-	*/ 
-    l.addi r1,r1,-0x108         /* r1 is now (arch_saved_regs*) */
+	enter_task_frame
 
 	/* save the first few regs so we can save the addr of the handler */
-    l.sw 0x00(r1), r2
-    l.sw 0x04(r1), r3
+	l.sw 0x00(r1), r2
+	l.sw 0x04(r1), r3
 	l.sw 0x08(r1), r4
-    l.sw 0x0c(r1), r5
-    l.sw 0x10(r1), r6
-    l.sw 0x14(r1), r7
-    l.sw 0x18(r1), r8
-    l.sw 0x1c(r1), r9
-    l.sw 0x20(r1), r10
-    l.sw 0x24(r1), r11
-    l.sw 0x28(r1), r12
-    l.sw 0x2c(r1), r13
-    l.sw 0x30(r1), r14
-    l.sw 0x34(r1), r15
+	l.sw 0x0c(r1), r5
+	l.sw 0x10(r1), r6
+	l.sw 0x14(r1), r7
+	l.sw 0x18(r1), r8
+	l.sw 0x1c(r1), r9
+	l.sw 0x20(r1), r10
+	l.sw 0x24(r1), r11
+	l.sw 0x28(r1), r12
+	l.sw 0x2c(r1), r13
+	l.sw 0x30(r1), r14
+	l.sw 0x34(r1), r15
+	l.sw 0x70(r1), r30
 
 	/* Save the addr of the handler in r30 since it will be preserved in any C fn calls */
 	l.movhi r30,     hi( \symname )
@@ -83,9 +111,39 @@ _reset_vector:
 
 	/* Goto save_context */
 	l.j context_save
-	
 	l.nop
-.endm	
+.endm
+
+/* System calls are made through msel_svc, which tells the compiler
+	that l.sys clobbers every call-clobbered register. Only the
+	callee-saved registers (plus r9 and r10) are saved here, and if the
+	call returns straight to the same task syscall_return only restores
+	those and r11, zeroing the rest so no kernel values leak out.
+*/
+.macro syscall_handler symname orgaddr
+	.org \orgaddr
+
+	enter_task_frame
+
+	l.sw 0x00(r1), r2
+	l.sw 0x1c(r1), r9
+	l.sw 0x20(r1), r10
+	l.sw 0x30(r1), r14
+	l.sw 0x38(r1), r16
+	l.sw 0x40(r1), r18
+	l.sw 0x48(r1), r20
+	l.sw 0x50(r1), r22
+	l.sw 0x58(r1), r24
+	l.sw 0x60(r1), r26
+	l.sw 0x68(r1), r28
+	l.sw 0x70(r1), r30
+	l.sw 0x74(r1), r31
+
+	/* r3 and r4 (svc number and arg) are still live */
+	l.j syscall_save
+	l.nop
+.endm
+	
 
 	
 /* General Interrupts */
@@ -99,7 +157,7 @@ handler ExternalInterrupt,      0x000800
 handler DTLBMiss,               0x000900
 handler ITLBMiss,               0x000a00
 handler RangeException,         0x000b00
-handler SystemCallHandler,      0x000c00
+syscall_handler SystemCallHandler, 0x000c00
 handler FloatingPointException, 0x000d00
 handler TrapException,          0x000e00
 handler FauxFileSystemWrite,    0x001000
@@ -197,8 +255,9 @@ jump_to_main:
         l.nop
 
 
-	/* r13  is set by the interrupt vector before branching here and
-	contains the addr of the C handler to call */
+	/* r30 is set by the interrupt vector before branching here and
+	contains the addr of the C handler to call. r1 points at the frame
+	on the task's stack and r31 holds the task's SP */
 context_save:
 	/* Continue saving registers at r16 */
     l.sw 0x38(r1), r16
@@ -216,7 +275,6 @@ context_save:
     l.sw 0x64(r1), r27
     l.sw 0x68(r1), r28
     l.sw 0x6c(r1), r29
-    l.sw 0x70(r1), r30
     l.sw 0x74(r1), r31
 
     /* Also save exception status registers */
@@ -225,28 +283,27 @@ context_save:
     l.sw 0x78(r1), r14
     l.sw 0x7c(r1), r15
 
+	/* active_task->stack = frame */
+	l.movhi r15,      hi(msel_active_task)
+	l.ori   r15, r15, lo(msel_active_task)
+	l.lwz   r15, 0(r15)
+	l.sw    TCB_STACK(r15), r1
+
+	/* The C handler runs on the kernel stack */
+	l.movhi r1,     hi(end)
+	l.ori   r1, r1, lo(end)
+
 	/* Clear link register to keep gdb sane */
 	l.addi   r9, r0, 0
 
-	/* Save context to task struct */
-	l.movhi  r15,      hi(or1k_save_context)
-	l.ori    r15, r15, lo(or1k_save_context)
-	l.jalr   r15
-	l.nop
-	
-	/* skip the handler if zero retval... schedule was called, just restore the next task */
-	l.sfeq   r11, r0
-	l.bf     context_restore
+	/* Update perf counters on entry */
+	l.movhi r15,      hi(msel_task_update_ctrs_enter)
+	l.ori   r15, r15, lo(msel_task_update_ctrs_enter)
+	l.jalr  r15
 	l.nop
-	
-	/* restore C fn params for handler (e.g. for svcalls) */
-    l.lwz r3, 0x04(r1) 
-    l.lwz r4, 0x08(r1) 
-    l.lwz r5, 0x0c(r1) 
-    l.lwz r6, 0x10(r1) 
-    l.lwz r7, 0x14(r1) 
-    l.lwz r8, 0x18(r1)
-	
+
+	l.addi   r9, r0, 0
+
 	/* Call the C exception handler */
 	l.jalr r30
 	l.nop
@@ -314,10 +371,111 @@ context_restore:
     l.lwz r30, 0x70(r1)
     l.lwz r31, 0x74(r1)
 
-    l.addi r1, r1, 0x108    /* restore stack ptr */
+    l.addi r1, r1, SAVE_SZ  /* restore stack ptr */
 
     l.rfe                   /* restore SR and PC */
 
+/* The task's SP didn't leave room for a frame. Nothing has been saved,
+	so kill the task (or panic for task 0) from the kernel stack and
+	resume whoever is scheduled next */
+stack_fault:
+	l.movhi r1,     hi(end)
+	l.ori   r1, r1, lo(end)
+	l.addi  r9, r0, 0
+
+	l.movhi r15,      hi(or1k_stack_fault)
+	l.ori   r15, r15, lo(or1k_stack_fault)
+	l.jalr  r15
+	l.nop
 
+	l.j     context_restore
+	l.nop
+
+
+	/* r1 points at the frame on the task's stack, r3 and r4 hold the
+	svc number and arg */
+syscall_save:
+    l.mfspr r14, r0, 64
+    l.mfspr r16, r0, 32
+    l.sw 0x78(r1), r14
+    l.sw 0x7c(r1), r16
+
+	/* Keep the calling task and its frame in callee-saved registers to
+	tell whether the call returns straight back to it */
+	l.movhi r30,      hi(msel_active_task)
+	l.ori   r30, r30, lo(msel_active_task)
+	l.lwz   r30, 0(r30)                      /* r30 = calling task */
+	l.sw    TCB_STACK(r30), r1
+	l.addi  r28, r1, 0                       /* r28 = its frame */
+
+	l.movhi r1,     hi(end)
+	l.ori   r1, r1, lo(end)
+	l.addi  r9, r0, 0
+
+	l.movhi r15,      hi(SystemCallHandler)
+	l.ori   r15, r15, lo(SystemCallHandler)
+	l.jalr  r15
+	l.nop
+
+	/* If the call blocked, killed the task or otherwise scheduled
+	something else, do a full restore of whatever runs next */
+	l.movhi r14,      hi(msel_active_task)
+	l.ori   r14, r14, lo(msel_active_task)
+	l.lwz   r14, 0(r14)
+	l.sfne  r14, r30
+	l.bf    context_restore
+	l.lwz   r14, TCB_STACK(r30)              /* delay slot */
+	l.sfne  r14, r28
+	l.bf    context_restore
+	l.nop
+
+syscall_return:
+	/* Update perf counters on resume */
+	l.movhi r15,      hi(msel_task_update_ctrs_resume)
+	l.ori   r15, r15, lo(msel_task_update_ctrs_resume)
+	l.jalr  r15
+	l.nop
+
+	l.addi  r1, r28, 0
+
+	l.lwz r4,0x7c(r1)
+	l.lwz r3,0x78(r1)
+	l.mtspr r0, r4, 32
+	l.mtspr r0, r3, 64
+
+	l.lwz r2, 0x00(r1)
+	l.lwz r9, 0x1c(r1)
+	l.lwz r10, 0x20(r1)
+	l.lwz r11, 0x24(r1)                      /* svc result */
+	l.lwz r14, 0x30(r1)
+	l.lwz r16, 0x38(r1)
+	l.lwz r18, 0x40(r1)
+	l.lwz r20, 0x48(r1)
+	l.lwz r22, 0x50(r1)
+	l.lwz r24, 0x58(r1)
+	l.lwz r26, 0x60(r1)
+	l.lwz r28, 0x68(r1)
+	l.lwz r30, 0x70(r1)
+	l.lwz r31, 0x74(r1)
+
+	l.ori r3, r0, 0
+	l.ori r4, r0, 0
+	l.ori r5, r0, 0
+	l.ori r6, r0, 0
+	l.ori r7, r0, 0
+	l.ori r8, r0, 0
+	l.ori r12, r0, 0
+	l.ori r13, r0, 0
+	l.ori r15, r0, 0
+	l.ori r17, r0, 0
+	l.ori r19, r0, 0
+	l.ori r21, r0, 0
+	l.ori r23, r0, 0
+	l.ori r25, r0, 0
+	l.ori r27, r0, 0
+	l.ori r29, r0, 0
+
+	l.addi r1, r1, SAVE_SZ  /* restore stack ptr */
+
+	l.rfe                   /* restore SR and PC */
 
-	
@@ -20,17 +20,18 @@
 #include "os/taskmem.h"
 #include "os/system.h"
 #include "os/syscall.h"
+#include "os/trace.h"
 
 #include "driver/ffs_driver.h"
 #include "driver/ffs_session.h"
+#include "driver/ffs_pool.h"
+#include "driver/uart.h"
 
 #include "mmio.h"
 #include "or1k.h"
 
 /* Linker symbol indicating end of .data & .bss sections and the start of the heap */
 extern int end;
-extern int _data_beg;
-extern int _bss_end;
 
 /* Fw decls */
 extern int hasSeenReadAck;
@@ -40,9 +41,14 @@ void FauxFileSystemReadAck();
 void SystemCallHandler(msel_svc_number num, void* arg)
 {
     msel_tcb* task = msel_active_task;
+    msel_status retval;
+
+    /* syscall entry skips context_save, so account for it here */
+    msel_task_update_ctrs_enter();
+    task->ctrs.stats.syscalls++;
 
     /* task may change mid SVC due to suspended calls, etc */ 
-    msel_status retval = msel_svc_handler(num, arg);
+    retval = msel_svc_handler(num, arg);
 
     /* save the result, no matter if it will actually return to the original task */
     ((or1k_saved_regs*)task->stack)->r11 = (uint32_t)retval;
@@ -50,7 +56,9 @@ void SystemCallHandler(msel_svc_number num, void* arg)
 
 void TickTimerHandler()
 {
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_ENTER, 0x5);
     msel_systick_handler();
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_EXIT, 0x5);
 }
 
 void BusError()
@@ -106,6 +114,16 @@ void ExternalInterrupt()
 
     uint32_t picsr = spr_read(SPR_PICSR);
 
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_ENTER, 0x8);
+
+    if(picsr & (1<<2))
+    {
+        /* Refilling the FIFO (or masking the interrupt) deasserts the line */
+        uart_tx_isr();
+        picsr &= ~((uint32_t)1<<2);
+        spr_write(SPR_PICSR,picsr);
+    }
+
     if(picsr & (1<<16))
     {
         FauxFileSystemWrite();
@@ -129,7 +147,8 @@ void ExternalInterrupt()
             i++;
         } while((i < 1024) && (picsr & (1<<17)));
     }
-    
+
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_EXIT, 0x8);
 }
 
 void DTLBMiss()
@@ -161,29 +180,14 @@ void DTLBMiss()
     }
     else if(eear >= RAM_START && eear < RAM_START + RAM_SIZE)
     {
-        /* Supervisor can read/write entire ram space */
-        perms |= TLBTR_SRE | TLBTR_SWE;
+        /* Worked out for each task when it was created */
+        perms |= or1k_dtlb_ram_perms(msel_active_task_num, eear);
 
-        /* Task 0 can r/w entire ram space */
-        if(msel_active_task_num == MSEL_TASK_MAIN)
-        {
-            perms |= TLBTR_UWE | TLBTR_URE;
-        }
-        else
+        if(msel_active_task_num != MSEL_TASK_MAIN &&
+           msel_ffs_pool_page_owner((void*)eear) == msel_active_task_num)
         {
-            if((void*)eear >= taskmem_stack_bottom(msel_active_task_num) &&
-               (void*)eear < taskmem_heap_end(msel_active_task_num))
-            {
-                /* User tasks access ram  thier own ram */
-                perms |= TLBTR_URE | TLBTR_UWE;
-            }
-
-            if((int*)eear >= &_data_beg && (int*)eear < &_bss_end)
-            {
-                /* User tasks can still read bss & data to avoid linking nightmares */
-                perms |= TLBTR_URE;
-            }
-            
+            /* Packet buffers lent out of the ffs pool */
+            perms |= TLBTR_URE | TLBTR_UWE;
         }
     } 
     /* handle MMIO ranges */
@@ -318,17 +322,21 @@ void TrapException()
 
 void FauxFileSystemWrite()
 {
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_ENTER, 0x10);
     msel_wfile_get_packet();
     (*FFS_CTRL_ADDR) |= 1;
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_EXIT, 0x10);
 }
 
 int hasSeenReadAck = 0;
 
 void FauxFileSystemReadAck()
 {
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_ENTER, 0x11);
     hasSeenReadAck = 1;
     uint8_t status = msel_ffs_rfile_get_status();
     if (status == FFS_CHANNEL_READY || status == FFS_CHANNEL_LAST_SUCC)
         msel_rfile_step_queue();
     (*FFS_CTRL_ADDR) |= 2;
+    MSEL_TRACE(TRACE_CAT_ISR, TRACE_ISR_EXIT, 0x11);
 }
@@ -19,18 +19,29 @@
 #include <msel/stdc.h>
 #include <msel/master_key.h>
 #include "flash.h"
+#include "mtc.h"
 
 #define MKEY_BANK_NUM 1022 /* 0xE7FC0000 - 0xE7FCffff */
 
 msel_status arch_master_key_read(mkey_ptr_t val)
 {
-    flash_readmem(val, FLASH_ADDR(MKEY_BANK_NUM,0,0), MASTER_KEY_SIZE);
-    return MSEL_OK;
+    mtc_drain();
+    return flash_readmem(val, FLASH_ADDR(MKEY_BANK_NUM,0,0), MASTER_KEY_SIZE);
 }
 
 msel_status arch_master_key_write(mkey_ptr_t val)
 {
-    flash_erase_bank(MKEY_BANK_NUM);
-    return flash_writemem((void*)FLASH_ADDR(MKEY_BANK_NUM,0,0), val, MASTER_KEY_SIZE);
+    msel_status ret;
+
+    mtc_drain();
+    ret = flash_erase_bank(MKEY_BANK_NUM);
+    if(ret != MSEL_OK)
+        return ret;
+    ret = flash_writemem((void*)FLASH_ADDR(MKEY_BANK_NUM,0,0), val, MASTER_KEY_SIZE);
+    if(ret != MSEL_OK)
+        return ret;
+
+    /* Only report success once the key is really in flash */
+    return flash_barrier();
 }
 
@@ -19,108 +19,266 @@
 #include "mtc.h"
 #include "flash.h"
 
-/* cached location of next mtc address */
-static mtc_t* first_unused = NULL;
+/* RAM copy of the head of the log, filled in from flash on first use.
+ * mtc_head is the highest value handed out so far (MTC_ENTRY_UNUSED if
+ * none, so that mtc_head+1 is 0) and the next entry goes at index
+ * mtc_next_idx of bank mtc_cur_bank. */
+static int      mtc_loaded = 0;
+static mtc_t    mtc_head;
+static size_t   mtc_cur_bank;
+static size_t   mtc_next_idx;
 
-mtc_t* mtc_find_first_unused()
+static inline mtc_t* mtc_entry_addr(size_t bank, size_t idx)
 {
-    mtc_t scratch;
-    
-    if(!first_unused)
-        first_unused = MTC_START_ADDR;
+    return (mtc_t*)FLASH_ADDR(MTC_BANK_FIRST + bank,
+                              idx / MTC_PAGE_ENTRIES,
+                              (idx % MTC_PAGE_ENTRIES) * sizeof(mtc_t));
+}
 
-    size_t page = FLASH_PAGE(first_unused);
-    size_t offset = FLASH_OFFSET(first_unused);
+static mtc_t mtc_read_entry(size_t bank, size_t idx)
+{
+    mtc_t val;
 
-    /* foreach page in bank */
-    for(;page<FLASH_BANK_PAGES;page++)
+    flash_readmem(&val, mtc_entry_addr(bank, idx), sizeof(val));
+    return val;
+}
+
+/* Entries are only ever written in order from the start of a bank, so
+ * the written ones are a prefix and the first erased one can be found
+ * by bisection */
+static size_t mtc_bank_used(size_t bank)
+{
+    size_t lo = 0, hi = MTC_BANK_ENTRIES, mid;
+
+    while(lo < hi)
     {
-        /* foreach mtc in page */
-        for(;offset<FLASH_PAGE_BYTES/sizeof(mtc_t);offset+=sizeof(mtc_t))
+        mid = (lo + hi) / 2;
+        if(mtc_read_entry(bank, mid) == MTC_ENTRY_UNUSED)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/* The head is the last entry of whichever bank's last entry is
+ * highest. Older banks only ever hold lower values, since
+ * arch_mtc_write erases all of them before going backwards. */
+static void mtc_load()
+{
+    size_t bank, used;
+    mtc_t  last;
+
+    mtc_head     = MTC_ENTRY_UNUSED;
+    mtc_cur_bank = 0;
+    mtc_next_idx = 0;
+
+    for(bank = 0; bank < MTC_BANKS; bank++)
+    {
+        used = mtc_bank_used(bank);
+        if(used == 0)
+            continue;
+
+        last = mtc_read_entry(bank, used - 1);
+        if(mtc_head == MTC_ENTRY_UNUSED || last > mtc_head)
         {
-            mtc_t* check = (mtc_t*)FLASH_ADDR(MTC_BANK_NUM, page, offset);
-            flash_readmem(&scratch, check, sizeof(scratch));
-            if(scratch == MTC_ENTRY_UNUSED)
-            {
-                first_unused = check;
-                return first_unused;
-            }
+            mtc_head     = last;
+            mtc_cur_bank = bank;
+            mtc_next_idx = used;
         }
-        offset = 0;
     }
 
-    /* No unused value was found, so we wrap back to page=0 offset=0
-     * which will trigger a complete erase cycle before writing */
-    first_unused = MTC_START_ADDR;
-    return first_unused;
+    mtc_loaded = 1;
 }
 
-msel_status mtc_increment_store(mtc_t forced_next, mtc_t *retval)
-{
-    mtc_t* lastptr;
-    mtc_t  lastmtc;
-    mtc_t* nextptr;
-    mtc_t  nextmtc;
+/* Appending an entry takes an erase (when the log moves on to the
+ * next bank) and a page program. Both are left running on the flash
+ * controller, and mtc_step moves the append along each time it is
+ * called until it is done, so the caller never spins on the flash. */
+typedef enum {
+    MTC_IDLE = 0,
+    MTC_ERASE,
+    MTC_PROGRAM,
+    MTC_DONE
+} mtc_state;
 
+static struct {
+    uint8_t     state;    /* mtc_state */
+    uint8_t     started;  /* the flash operation for state was issued */
+    size_t      bank;
+    size_t      idx;
+    mtc_t       val;      /* the new head */
+    mtc_t       first;    /* what to hand back when it is done */
+    msel_status result;   /* once MTC_DONE */
+} mtc_op;
+
+static msel_status mtc_step()
+{
     msel_status ret;
 
-    /* Next is the first still-erased mtc in the reserved flash space */
-    nextptr = mtc_find_first_unused();
+    while(1)
+    {
+        switch(mtc_op.state)
+        {
+        case MTC_ERASE:
+            if(!mtc_op.started)
+            {
+                ret = flash_erase_bank_start(MTC_BANK_FIRST + mtc_op.bank);
+                if(ret == MSEL_EBUSY)
+                    return MSEL_EBUSY;
+                if(ret != MSEL_OK)
+                    goto done;
+                mtc_op.started = 1;
+                return MSEL_EBUSY;
+            }
+            if((ret=flash_result()) == MSEL_EBUSY)
+                return MSEL_EBUSY;
+            if(ret != MSEL_OK)
+                goto done;
 
-    /* Last is the mtc ptr immediately before next, but it may wrap around */
-    lastptr = nextptr-1;
-    if(lastptr < MTC_START_ADDR)
-        lastptr = FLASH_ADDR(MTC_BANK_NUM,FLASH_BANK_PAGES,FLASH_PAGE_BYTES-sizeof(mtc_t));
-    
-    flash_readmem(&lastmtc,lastptr,sizeof(lastmtc));
+            mtc_op.state   = MTC_PROGRAM;
+            mtc_op.started = 0;
+            break;
 
-    /* force the value if it is being set explicitly, else just increment */
-    if(forced_next != 0 && forced_next!=MTC_ENTRY_UNUSED)
-        nextmtc = forced_next;
-    else
-        nextmtc = lastmtc+1;
+        case MTC_PROGRAM:
+            if(!mtc_op.started)
+            {
+                if(flash_busy())
+                    return MSEL_EBUSY;
+                ret = flash_writemem(mtc_entry_addr(mtc_op.bank, mtc_op.idx), &mtc_op.val, sizeof(mtc_op.val));
+                if(ret != MSEL_OK)
+                    goto done;
+                flash_flush();
+                mtc_op.started = 1;
+                return MSEL_EBUSY;
+            }
+            if((ret=flash_result()) == MSEL_EBUSY)
+                return MSEL_EBUSY;
+            if(ret != MSEL_OK)
+                goto done;
 
-    /* Skip to next mtc in the rare case of a u64 wrapping */
-    if(nextmtc == MTC_ENTRY_UNUSED)
-        nextmtc=0;
+            /* The old head stayed where it was until now, so a power
+             * loss at any point leaves a valid head in flash */
+            mtc_head     = mtc_op.val;
+            mtc_cur_bank = mtc_op.bank;
+            mtc_next_idx = mtc_op.idx + 1;
+            goto done;
 
-    /* if we are starting fresh on a bank, erase it first */
-    if(nextptr == MTC_START_ADDR)
-    {
-        if((ret=flash_erase_bank(MTC_BANK_NUM)) != MSEL_OK)
-            return ret; 
+        default:
+            return mtc_op.state == MTC_DONE ? mtc_op.result : MSEL_EINVAL;
+        }
     }
 
-    /* let the flash layer perform the write */
-    ret = flash_writemem(nextptr, &nextmtc, sizeof(nextmtc));
-    if(ret != MSEL_OK)
-        return ret;
+done:
+    mtc_op.state  = MTC_DONE;
+    mtc_op.result = ret;
+    return ret;
+}
 
-    if(retval)
-        *retval = nextmtc;
+/* Start appending a new head to the log. A full bank moves the log on
+ * to the next one, which is erased first. */
+static void mtc_append(mtc_t val)
+{
+    mtc_op.bank    = mtc_cur_bank;
+    mtc_op.idx     = mtc_next_idx;
+    mtc_op.val     = val;
+    mtc_op.started = 0;
 
-    return MSEL_OK;
+    if(mtc_op.idx == MTC_BANK_ENTRIES)
+    {
+        mtc_op.bank = (mtc_op.bank + 1) % MTC_BANKS;
+        mtc_op.idx  = 0;
+    }
+
+    mtc_op.state = mtc_op.idx == 0 ? MTC_ERASE : MTC_PROGRAM;
 }
 
-msel_status arch_mtc_read_increment(mtc_t* val)
-    
+void mtc_drain()
+{
+    while(mtc_op.state != MTC_IDLE && mtc_step() == MSEL_EBUSY);
+}
+
+msel_status arch_mtc_poll(mtc_t* first)
 {
     msel_status ret;
-    
-    if(!val)
+
+    if(mtc_op.state == MTC_IDLE)
         return MSEL_EINVAL;
-    *val = MTC_ENTRY_UNUSED;
-    
-    /* Increment and write-back updated mtc value. This might possibly
-     * fail if a block gets marked as bad or potentially if something
-     * else is already performing a flash operation. */
-    if((ret=mtc_increment_store(0,val)) != MSEL_OK)
-        return ret;
 
-    return MSEL_OK;
+    if((ret=mtc_step()) == MSEL_EBUSY)
+        return MSEL_EBUSY;
+
+    if(ret == MSEL_OK)
+        *first = mtc_op.first;
+    mtc_op.state = MTC_IDLE;
+    return ret;
+}
+
+msel_status arch_mtc_reserve(uint32_t count, mtc_t* first)
+{
+    mtc_t start;
+
+    if(!first || count == 0)
+        return MSEL_EINVAL;
+
+    /* One at a time */
+    if(mtc_op.state != MTC_IDLE)
+        return MSEL_EBUSY;
+
+    if(!mtc_loaded)
+        mtc_load();
+
+    /* The whole range must fit below MTC_ENTRY_UNUSED */
+    start = mtc_head + 1;
+    if(MTC_ENTRY_UNUSED - start < count)
+        return MSEL_ERESOURCE;
+
+    /* Record the end of the range before handing any of it out. Values
+     * the caller never uses are skipped after a reset, never reissued. */
+    mtc_op.first = start;
+    mtc_append(start + count - 1);
+    return arch_mtc_poll(first);
 }
 
+/* Set the counter to any value, even a lower one. Every bank is erased
+ * so that no stale higher value can win in mtc_load. This is only done
+ * when provisioning, so it simply waits for the flash. */
 msel_status arch_mtc_write(mtc_t* val)
 {
-    return mtc_increment_store(*val, NULL);
+    size_t      bank;
+    msel_status ret;
+
+    /* Zero (or an invalid value) just means carry on counting */
+    if(*val == 0 || *val == MTC_ENTRY_UNUSED)
+    {
+        mtc_t ignored;
+
+        ret = arch_mtc_reserve(1, &ignored);
+        while(ret == MSEL_EBUSY)
+            ret = arch_mtc_poll(&ignored);
+        return ret;
+    }
+
+    if(!mtc_loaded)
+        mtc_load();
+
+    mtc_drain();
+
+    for(bank = 0; bank < MTC_BANKS; bank++)
+    {
+        if((ret=flash_erase_bank(MTC_BANK_FIRST + bank)) != MSEL_OK)
+            return ret;
+    }
+
+    /* Start the log over in the (now erased) first bank */
+    ret = flash_writemem(mtc_entry_addr(0, 0), val, sizeof(*val));
+    if(ret == MSEL_OK)
+        ret = flash_barrier();
+    if(ret != MSEL_OK)
+        return ret;
+
+    mtc_head     = *val;
+    mtc_cur_bank = 0;
+    mtc_next_idx = 1;
+    return MSEL_OK;
 }
@@ -16,18 +16,23 @@
 #ifndef _MSEL_ARCH_OR1K_MTC_H_
 #define _MSEL_ARCH_OR1K_MTC_H_
 
-/* The MTC reserves an entire bank of the flash memory because a bank
- * is the smallest unit which may be erased. One bank is a block of 64
- * 2k pages for a total of 128k of space. An mtc value is simply a 64
- * bit integer, so space exists for 2048 saved mtc values before an
- * erase is required.
- * 
- * MTC values are just written plain to a mtc_t[2048] array. Instead
- * of maintaining status to determine which value is current,
- * convention dictates new values be written in order from offset 0 of
- * the bank, and 0xffffffffffffffff is not a valid counter value. This
- * guarantees the last used mtc is the first non-erased uint64_t
- * inside the bank.
+/* The MTC is kept as an append-only log of 64 bit values in flash.
+ * A bank is the smallest unit which may be erased, and one bank is a
+ * block of 64 2k pages for a total of 128k of space, so a bank holds
+ * 16384 entries. The log is striped across MTC_BANKS banks used in
+ * turn, which spreads the erases over all of them.
+ *
+ * Each entry is the highest counter value handed out when it was
+ * written. Reserving a range of values (mtc_reserve) writes the end of
+ * the range once and then hands the values out without touching
+ * flash again; whatever is left over when the system resets is
+ * skipped, so a value is never issued twice.
+ *
+ * Entries are written in order from offset 0 of a bank, and
+ * 0xffffffffffffffff is not a valid counter value, so the written
+ * entries in a bank are always a prefix and its last one can be found
+ * by bisection. The current head is the highest last entry of any
+ * bank. It is read once after reset and kept in RAM from then on.
  *
  * However, one does not simply write a uint64_t to flash. The minimum
  * write size is a whole page (2048 bytes). The whole page must be
@@ -39,12 +44,17 @@
 
 #include <msel/mtc.h>
 
-#define MTC_BANK_NUM     1020 /* 0xE7f80000 - 0xE7f9ffff */
+#define MTC_BANK_FIRST   1017 /* 0xE7f20000 - 0xE7f9ffff */
+#define MTC_BANKS        4
 #define MTC_ENTRY_UNUSED ((mtc_t)0xffffffffffffffff)
-#define MTC_START_ADDR   ((mtc_t*)FLASH_ADDR(MTC_BANK_NUM,0,0))
 
-mtc_t*      mtc_find_first_unused();
-msel_status mtc_increment_store(mtc_t, mtc_t*);
+#define MTC_PAGE_ENTRIES (FLASH_PAGE_BYTES / sizeof(mtc_t))
+#define MTC_BANK_ENTRIES (FLASH_BANK_PAGES * MTC_PAGE_ENTRIES)
+
+/* Wait for an append in progress to finish, keeping its result for
+ * arch_mtc_poll. Anything else that uses the flash calls this first,
+ * since it shares the controller's status and the page cache. */
+void mtc_drain();
 
 #endif
 
@@ -17,6 +17,7 @@
 #define _MSEL_ARCH_OR1K_H
 
 #include "spr.h"
+#include "os/profile.h"
 
 /* Make sure this is in sync with the linker script */
 #define ROM_START 0x00100000
@@ -39,6 +40,14 @@
 #define TLB_ENTRY_MASK   ((uint32_t)((TLB_ENTRIES-1)<<PAGE_BITS))
 #define TLB_ENTRY(vaddr) ((vaddr&TLB_ENTRY_MASK) >> PAGE_BITS)
 
+/* Each page of RAM falls into a different TLB set */
+#define RAM_PAGES        (RAM_SIZE / PAGE_SIZE)
+
+/* CPU cycles per system tick, and between tick timer interrupts
+ * (which come faster while profiling) */
+#define TICK_CYCLES      500000
+#define TIMER_CYCLES     (TICK_CYCLES / PROFILE_TIMER_DIV)
+
 typedef struct
 {
     uint8_t ctx_id; /* The HW context ID of this task, note that this may change independantly of the index into msel_task_list */
@@ -83,16 +92,23 @@ typedef struct {
     uint32_t pc;
 } or1k_saved_regs;
 
-/* r2,r3 must be preloaded with syscall number and void* params */
+/* r3,r4 must be preloaded with syscall number and void* params. The
+ * kernel only preserves callee-saved registers across l.sys and
+ * zeroes the rest, see syscall_handler in init.s */
 #define ARCH_DO_SYSCALL(res) __asm __volatile__ (    \
         "l.sys 0             \n"                     \
         "l.addi %0, r11, 0   \n"                     \
-        :"=r"(res)::"r11")
+        :"=r"(res)::"r3","r4","r5","r6","r7","r8",   \
+          "r11","r12","r13","r15","r17","r19","r21", \
+          "r23","r25","r27","r29","memory")
 
 #define ARCH_EMIT_BREAKPOINT() __asm __volatile__ ("l.trap 0\n"); 
 
 #define ARCH_ENABLE_INTERRUPTS()  SPR_SR_IEE_SET(1)
 #define ARCH_DISABLE_INTERRUPTS() SPR_SR_IEE_SET(0)
 
+/* Precomputed DTLB permissions (TLBTR bits) of a RAM page for a task */
+uint32_t or1k_dtlb_ram_perms(size_t tasknum, uint32_t vaddr);
+
 
 #endif
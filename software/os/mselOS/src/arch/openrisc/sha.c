@@ -21,17 +21,17 @@
 msel_status arch_do_hw_sha(sha_data_t *data)
 {
     // Copy in the initial IV
-    msel_memcpy(SHA_IV_ADDR, data->iv, 32);
+    arch_mmio_copy(SHA_IV_ADDR, data->iv, 32);
     
     // Copy next bit of data 
-    msel_memcpy(SHA_DIN_ADDR, data->din, 64);
+    arch_mmio_copy(SHA_DIN_ADDR, data->din, 64);
     *(SHA_CTRL_ADDR) = 1;
     
     // Poll busy until done
     while (*(SHA_CTRL_ADDR) & (1 << 16)) { /* wait */ }
     
     // Copy out the resulting hash
-    msel_memcpy(data->iv, SHA_IV_ADDR, 32);
+    arch_mmio_copy(data->iv, SHA_IV_ADDR, 32);
     
     // Reset the core
     *(SHA_CTRL_ADDR) = (1 << 8);
@@ -165,6 +165,7 @@ void spr_write(uint32_t, uint32_t);
 
 #define TLBMR_V             1
 #define TLBMR_PL1           (1 << 1)
+#define TLBMR_CID_MASK      (0xf << 2)
 #define TLBTR_CC            1
 #define TLBTR_CI            (1<<1)
 #define TLBTR_WBC           (1<<2)
@@ -0,0 +1,313 @@
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	Memory copy/fill/compare routines for or1k.
+
+	or1k faults on unaligned word accesses, so each routine copies a few
+	bytes until the destination is word aligned, works 16 bytes at a time,
+	then 4, then finishes off any tail a byte at a time. When the two
+	buffers can never be word aligned at the same time it's bytes all the
+	way. Anything under 8 bytes isn't worth aligning.
+
+	Arguments arrive in r3-r5 and the result goes back in r11. Only
+	caller-saved temporaries (r13-r19) are used. r31 is reserved by the
+	kernel (-ffixed-r31) and must not be touched.
+
+	Remember that the instruction after every jump or branch is in the
+	delay slot and always executes.
+*/
+
+.section .text
+
+/* void* msel_memcpy(void *dst, const void *src, size_t sz) */
+	.global msel_memcpy
+	.type   msel_memcpy, @function
+msel_memcpy:
+	l.or     r11, r3, r0            /* return dst */
+	l.sfltui r5, 8
+	l.bf     .Lcpy_bytes
+	l.xor    r13, r3, r4            /* delay: can dst and src both be aligned? */
+	l.andi   r13, r13, 3
+	l.sfne   r13, r0
+	l.bf     .Lcpy_bytes
+	l.nop
+
+.Lcpy_head:
+	l.andi   r13, r3, 3
+	l.sfeq   r13, r0
+	l.bf     .Lcpy_blocks
+	l.nop
+	l.lbz    r13, 0(r4)
+	l.sb     0(r3), r13
+	l.addi   r4, r4, 1
+	l.addi   r3, r3, 1
+	l.j      .Lcpy_head
+	l.addi   r5, r5, -1
+
+.Lcpy_blocks:
+	l.sfltui r5, 16
+	l.bf     .Lcpy_words
+	l.nop
+	l.lwz    r13, 0(r4)
+	l.lwz    r15, 4(r4)
+	l.lwz    r17, 8(r4)
+	l.lwz    r19, 12(r4)
+	l.sw     0(r3), r13
+	l.sw     4(r3), r15
+	l.sw     8(r3), r17
+	l.sw     12(r3), r19
+	l.addi   r4, r4, 16
+	l.addi   r5, r5, -16
+	l.j      .Lcpy_blocks
+	l.addi   r3, r3, 16
+
+.Lcpy_words:
+	l.sfltui r5, 4
+	l.bf     .Lcpy_bytes
+	l.nop
+	l.lwz    r13, 0(r4)
+	l.sw     0(r3), r13
+	l.addi   r4, r4, 4
+	l.addi   r5, r5, -4
+	l.j      .Lcpy_words
+	l.addi   r3, r3, 4
+
+.Lcpy_bytes:
+	l.sfeq   r5, r0
+	l.bf     .Lcpy_done
+	l.nop
+	l.lbz    r13, 0(r4)
+	l.sb     0(r3), r13
+	l.addi   r4, r4, 1
+	l.addi   r5, r5, -1
+	l.j      .Lcpy_bytes
+	l.addi   r3, r3, 1
+
+.Lcpy_done:
+	l.jr     r9
+	l.nop
+	.size   msel_memcpy, .-msel_memcpy
+
+
+/* void* msel_memset(void *dst, int val, size_t sz) */
+	.global msel_memset
+	.type   msel_memset, @function
+msel_memset:
+	l.or     r11, r3, r0            /* return dst */
+	l.andi   r4, r4, 0xff
+	l.sfltui r5, 8
+	l.bf     .Lset_bytes
+	l.slli   r13, r4, 8             /* delay: replicate the byte into a word */
+	l.or     r13, r13, r4
+	l.slli   r15, r13, 16
+	l.or     r13, r13, r15
+
+.Lset_head:
+	l.andi   r15, r3, 3
+	l.sfeq   r15, r0
+	l.bf     .Lset_blocks
+	l.nop
+	l.sb     0(r3), r4
+	l.addi   r3, r3, 1
+	l.j      .Lset_head
+	l.addi   r5, r5, -1
+
+.Lset_blocks:
+	l.sfltui r5, 16
+	l.bf     .Lset_words
+	l.nop
+	l.sw     0(r3), r13
+	l.sw     4(r3), r13
+	l.sw     8(r3), r13
+	l.sw     12(r3), r13
+	l.addi   r5, r5, -16
+	l.j      .Lset_blocks
+	l.addi   r3, r3, 16
+
+.Lset_words:
+	l.sfltui r5, 4
+	l.bf     .Lset_bytes
+	l.nop
+	l.sw     0(r3), r13
+	l.addi   r5, r5, -4
+	l.j      .Lset_words
+	l.addi   r3, r3, 4
+
+.Lset_bytes:
+	l.sfeq   r5, r0
+	l.bf     .Lset_done
+	l.nop
+	l.sb     0(r3), r4
+	l.addi   r5, r5, -1
+	l.j      .Lset_bytes
+	l.addi   r3, r3, 1
+
+.Lset_done:
+	l.jr     r9
+	l.nop
+	.size   msel_memset, .-msel_memset
+
+
+/* int msel_memcmp(const void *a, const void *b, size_t sz) */
+	.global msel_memcmp
+	.type   msel_memcmp, @function
+msel_memcmp:
+	l.sfltui r5, 8
+	l.bf     .Lcmp_bytes
+	l.xor    r13, r3, r4            /* delay: can a and b both be aligned? */
+	l.andi   r13, r13, 3
+	l.sfne   r13, r0
+	l.bf     .Lcmp_bytes
+	l.nop
+
+.Lcmp_head:
+	l.andi   r13, r3, 3
+	l.sfeq   r13, r0
+	l.bf     .Lcmp_words
+	l.nop
+	l.lbz    r13, 0(r3)
+	l.lbz    r15, 0(r4)
+	l.sfne   r13, r15
+	l.bf     .Lcmp_diff
+	l.addi   r3, r3, 1
+	l.addi   r4, r4, 1
+	l.j      .Lcmp_head
+	l.addi   r5, r5, -1
+
+	/* or1k is big-endian, so an unsigned word compare orders the same
+	way as comparing its four bytes one at a time */
+.Lcmp_words:
+	l.sfltui r5, 4
+	l.bf     .Lcmp_bytes
+	l.nop
+	l.lwz    r13, 0(r3)
+	l.lwz    r15, 0(r4)
+	l.sfne   r13, r15
+	l.bf     .Lcmp_diff
+	l.addi   r3, r3, 4
+	l.addi   r4, r4, 4
+	l.j      .Lcmp_words
+	l.addi   r5, r5, -4
+
+.Lcmp_bytes:
+	l.sfeq   r5, r0
+	l.bf     .Lcmp_done
+	l.or     r11, r0, r0            /* delay: equal so far */
+	l.lbz    r13, 0(r3)
+	l.lbz    r15, 0(r4)
+	l.sfne   r13, r15
+	l.bf     .Lcmp_diff
+	l.addi   r3, r3, 1
+	l.addi   r4, r4, 1
+	l.j      .Lcmp_bytes
+	l.addi   r5, r5, -1
+
+.Lcmp_diff:
+	l.sfltu  r13, r15
+	l.bf     .Lcmp_done
+	l.addi   r11, r0, -1            /* delay: a < b */
+	l.addi   r11, r0, 1
+
+.Lcmp_done:
+	l.jr     r9
+	l.nop
+	.size   msel_memcmp, .-msel_memcmp
+
+
+/*
+	void arch_mmio_copy(volatile void *dst, const volatile void *src, size_t sz)
+
+	For copies to or from device registers. Every location is accessed
+	exactly once, in ascending order, and never beyond sz bytes. Words
+	are used only when both sides are word aligned throughout.
+*/
+	.global arch_mmio_copy
+	.type   arch_mmio_copy, @function
+arch_mmio_copy:
+	l.or     r13, r3, r4
+	l.or     r13, r13, r5
+	l.andi   r13, r13, 3
+	l.sfne   r13, r0
+	l.bf     .Lmmio_bytes
+	l.nop
+
+.Lmmio_words:
+	l.sfeq   r5, r0
+	l.bf     .Lmmio_done
+	l.nop
+	l.lwz    r13, 0(r4)
+	l.sw     0(r3), r13
+	l.addi   r4, r4, 4
+	l.addi   r5, r5, -4
+	l.j      .Lmmio_words
+	l.addi   r3, r3, 4
+
+.Lmmio_bytes:
+	l.sfeq   r5, r0
+	l.bf     .Lmmio_done
+	l.nop
+	l.lbz    r13, 0(r4)
+	l.sb     0(r3), r13
+	l.addi   r4, r4, 1
+	l.addi   r5, r5, -1
+	l.j      .Lmmio_bytes
+	l.addi   r3, r3, 1
+
+.Lmmio_done:
+	l.jr     r9
+	l.nop
+	.size   arch_mmio_copy, .-arch_mmio_copy
+
+
+/* void arch_mmio_set(volatile void *dst, uint8_t val, size_t sz)
+
+	Fills device memory under the same rules as arch_mmio_copy */
+	.global arch_mmio_set
+	.type   arch_mmio_set, @function
+arch_mmio_set:
+	l.andi   r4, r4, 0xff
+	l.or     r13, r3, r5
+	l.andi   r13, r13, 3
+	l.sfne   r13, r0
+	l.bf     .Lmset_bytes
+	l.slli   r13, r4, 8             /* delay: replicate the byte into a word */
+	l.or     r13, r13, r4
+	l.slli   r15, r13, 16
+	l.or     r13, r13, r15
+
+.Lmset_words:
+	l.sfeq   r5, r0
+	l.bf     .Lmset_done
+	l.nop
+	l.sw     0(r3), r13
+	l.addi   r5, r5, -4
+	l.j      .Lmset_words
+	l.addi   r3, r3, 4
+
+.Lmset_bytes:
+	l.sfeq   r5, r0
+	l.bf     .Lmset_done
+	l.nop
+	l.sb     0(r3), r4
+	l.addi   r5, r5, -1
+	l.j      .Lmset_bytes
+	l.addi   r3, r3, 1
+
+.Lmset_done:
+	l.jr     r9
+	l.nop
+	.size   arch_mmio_set, .-arch_mmio_set
@@ -75,6 +75,12 @@ int arch_uart_is_writable()
     return !!(or1k_uart_inb(UART16550_LINE_STAT) & 0x20);
 }
 
+void arch_uart_tx_irq(int enable)
+{
+    /* IER bit 1: transmitter holding register empty */
+    or1k_uart_outb(UART16550_INTR_EN, enable ? 0x02 : 0x00);
+}
+
 int arch_init_uart()
 {
     /* Check presence via scratch reg */
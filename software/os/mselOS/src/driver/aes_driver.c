@@ -43,17 +43,12 @@ msel_status msel_do_aes(aes_driver_ctx_t* ctx)
     sw_aes_ctx_t sw;
     msel_memset(&sw, 0, sizeof(sw));
     sw_aes_setkey(&sw, ctx->key_size, ctx->key);
-    uint32_t i = 0;
-    for (i = 0; i < ctx->data_len; i += AES_BLOCK_SIZE) {
-      uint8_t din[AES_BLOCK_SIZE];
-      uint8_t dout[AES_BLOCK_SIZE];
-      msel_memcpy(din, ctx->din + i, AES_BLOCK_SIZE);
-      if (ctx->enc)
-        sw_aes_ecb_encrypt(&sw, din, dout);
-      else
-        sw_aes_ecb_decrypt(&sw, din, dout);
-      msel_memcpy(ctx->dout + i, dout, AES_BLOCK_SIZE);
-    }
+    // The whole request in one call, so a bitsliced build can pair blocks up
+    if (ctx->enc)
+      sw_aes_ecb_encrypt_blocks(&sw, ctx->din, ctx->data_len / AES_BLOCK_SIZE, ctx->dout);
+    else
+      sw_aes_ecb_decrypt_blocks(&sw, ctx->din, ctx->data_len / AES_BLOCK_SIZE, ctx->dout);
+    msel_memset(&sw, 0, sizeof(sw));
     return MSEL_OK;
 #else /* USE_SW_AES */
     return arch_do_hw_aes(ctx);
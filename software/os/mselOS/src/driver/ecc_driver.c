@@ -46,8 +46,12 @@ msel_status msel_ecc_mul(ecc_ctx_t* ctx)
 	int y_sign = ctx->point[0] & 0x01;
 	point_uncompress(&in, compressed, y_sign);
 
-	// Do the multiply
-	point_scalar(&out, &in, scalar);
+	// Do the multiply, from the precomputed table if it's the base point
+	if (point_is_base(&in))
+		point_scalar_base(&out, scalar);
+	else
+		point_scalar(&out, &in, scalar);
+	msel_memset(scalar, 0, sizeof(scalar));
 
 	// Compress the point -- this removes from mont. form
 	point_compress(compressed, &y_sign, &out);
@@ -30,6 +30,11 @@ msel_status msel_ffs_wfile_read(ffs_packet_t *pkt)
     return arch_ffs_wfile_read(pkt);
 }
 
+msel_status msel_ffs_wfile_read_hdr(uint16_t *session)
+{
+    return arch_ffs_wfile_read_hdr(session);
+}
+
 void msel_ffs_wfile_set_status(uint8_t status, uint8_t nonce)
 {
     return arch_ffs_wfile_set_status(status, nonce);
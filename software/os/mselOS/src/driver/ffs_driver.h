@@ -43,6 +43,16 @@
  */
 msel_status msel_ffs_wfile_read(ffs_packet_t *pkt);
 
+/** @brief Read only the session ID of the packet waiting in WFILE, so that the
+ *  caller can pick a destination buffer before reading the whole packet.
+ *  This function should be called from an interrupt context
+ *
+ *  @param[out] session The session ID the packet is addressed to
+ *  @return MSEL status value:
+ *    - MSEL_OK for successful operation
+ */
+msel_status msel_ffs_wfile_read_hdr(uint16_t *session);
+
 /** @brief Acknowledge receipt of the last packet written to WFILE
  *
  *  @param status The status (success or failure) of the packet transmission
@@ -0,0 +1,290 @@
+/** @file ffs_pool.c
+ *
+ *  This file contains the packet buffer pool shared by all faux filesystem (FFS) sessions.
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <msel/stdc.h>
+
+#include "arch.h"
+
+#include "ffs_pool.h"
+
+/** @addtogroup ffs_pool
+ *  @{
+ */
+
+/** @name Internal Packet Pool Parameters
+ *  @{
+ */
+
+/** @brief The number of packet buffers in the pool: enough to fill every
+ *  session queue and the outbound queue up to their guaranteed depth */
+#define FFS_POOL_SIZE ((FFS_NUM_SESSIONS + 1) * FFS_QUEUE_DEPTH)
+
+/** @brief The number of packet buffers sharing one page of memory */
+#define FFS_POOL_PAGE_BUFS (PAGE_SIZE / sizeof(ffs_packet_t))
+
+/** @brief The number of pages of RAM reserved for the pool */
+#define FFS_POOL_PAGES ((FFS_POOL_SIZE + FFS_POOL_PAGE_BUFS - 1) / FFS_POOL_PAGE_BUFS)
+
+/** @brief Owner of pages that only the kernel may touch, either because they
+ *  hold buffers for several tasks or because their task has gone away */
+#define FFS_POOL_KERNEL 0xfe
+
+/** @} */
+
+/** @brief Possible states for a pool buffer */
+typedef enum
+{
+    FFS_BUF_FREE = 0,   /* In the pool */
+    FFS_BUF_QUEUED,     /* Referenced by a session queue */
+    FFS_BUF_LENT        /* In the hands of the owning task */
+} ffs_buf_state_t;
+
+/** @brief Bookkeeping for a single pool buffer */
+typedef struct
+{
+    uint8_t state;
+    uint8_t dirty;      /* holds data left behind by the page's last owner */
+} ffs_buf_t;
+
+/** @brief Bookkeeping for a single pool page */
+typedef struct
+{
+    uint8_t owner;      /* task that may access the page, if any */
+    uint8_t last_owner; /* task whose data may still be in the page */
+    uint8_t used;       /* number of buffers not in the pool */
+} ffs_page_t;
+
+/** @} */
+
+// The buffers are page aligned and kept out of .data/.bss, so no task can see
+// them until a page is handed to it
+static ffs_packet_t pool[FFS_POOL_PAGES * FFS_POOL_PAGE_BUFS]
+    __attribute__((section(".ffs_pool"), aligned(PAGE_SIZE)));
+
+// configure works out FFS_POOL_RAM from what the linker script leaves over
+// after task memory; this catches FFS_QUEUE_DEPTH set by hand
+typedef char ffs_pool_fits_in_ram[(FFS_POOL_PAGES * PAGE_SIZE <= FFS_POOL_RAM) ? 1 : -1];
+
+static ffs_buf_t  bufs[FFS_POOL_PAGES * FFS_POOL_PAGE_BUFS];
+static ffs_page_t pages[FFS_POOL_PAGES];
+static size_t     num_free;
+
+/** @brief Convert a pointer into a buffer index, or -1 if it isn't a pool buffer */
+static int buf_index(const ffs_packet_t *pkt)
+{
+    if (pkt < pool || pkt >= pool + FFS_POOL_PAGES * FFS_POOL_PAGE_BUFS)
+        return -1;
+
+    // Reject pointers into the middle of a buffer
+    if (((const uint8_t*)pkt - (const uint8_t*)pool) % sizeof(ffs_packet_t) != 0)
+        return -1;
+
+    return pkt - pool;
+}
+
+/** @brief Check whether any buffer in a page is lent out */
+static int page_has_lent(size_t page)
+{
+    size_t i;
+    for (i = page * FFS_POOL_PAGE_BUFS; i < (page + 1) * FFS_POOL_PAGE_BUFS; ++i)
+        if (bufs[i].state == FFS_BUF_LENT) return 1;
+    return 0;
+}
+
+/** @brief Bind a free page to a new owner, scrubbing anything left by the last one */
+static void page_claim(size_t page, uint8_t tasknum)
+{
+    size_t i;
+
+    if (pages[page].last_owner != tasknum)
+    {
+        for (i = page * FFS_POOL_PAGE_BUFS; i < (page + 1) * FFS_POOL_PAGE_BUFS; ++i)
+        {
+            if (bufs[i].dirty)
+                msel_memset(&pool[i], 0, sizeof(ffs_packet_t));
+            bufs[i].dirty = 0;
+        }
+    }
+
+    pages[page].owner = tasknum;
+    pages[page].last_owner = tasknum;
+}
+
+void msel_ffs_pool_init()
+{
+    size_t i;
+
+    for (i = 0; i < FFS_POOL_PAGES; ++i)
+    {
+        pages[i].owner = FFS_POOL_NO_OWNER;
+        pages[i].last_owner = FFS_POOL_KERNEL;
+        pages[i].used = 0;
+    }
+
+    // The pool isn't part of .bss, so make sure every buffer gets scrubbed
+    // before its first use
+    for (i = 0; i < FFS_POOL_PAGES * FFS_POOL_PAGE_BUFS; ++i)
+    {
+        bufs[i].state = FFS_BUF_FREE;
+        bufs[i].dirty = 1;
+    }
+    num_free = FFS_POOL_PAGES * FFS_POOL_PAGE_BUFS;
+}
+
+ffs_packet_t* msel_ffs_pool_alloc(uint8_t tasknum)
+{
+    size_t page, i;
+
+    // Prefer a page the task already owns, then fall back to an unused one
+    for (page = 0; page < FFS_POOL_PAGES; ++page)
+        if (pages[page].owner == tasknum && pages[page].used < FFS_POOL_PAGE_BUFS)
+            break;
+
+    if (page == FFS_POOL_PAGES)
+    {
+        for (page = 0; page < FFS_POOL_PAGES; ++page)
+            if (pages[page].used == 0) break;
+
+        if (page < FFS_POOL_PAGES)
+            page_claim(page, tasknum);
+    }
+
+    // As a last resort, share a page with other tasks.  Nobody but the kernel
+    // may touch a shared page, so its buffers can be queued but not lent.
+    if (page == FFS_POOL_PAGES)
+    {
+        for (page = 0; page < FFS_POOL_PAGES; ++page)
+            if (pages[page].used < FFS_POOL_PAGE_BUFS && !page_has_lent(page)) break;
+
+        if (page == FFS_POOL_PAGES)
+            return NULL;
+
+        if (pages[page].owner != FFS_POOL_KERNEL)
+        {
+            pages[page].owner = FFS_POOL_KERNEL;
+            pages[page].last_owner = FFS_POOL_KERNEL;
+            arch_mm_invalidate(&pool[page * FFS_POOL_PAGE_BUFS], PAGE_SIZE);
+        }
+    }
+
+    for (i = page * FFS_POOL_PAGE_BUFS; i < (page + 1) * FFS_POOL_PAGE_BUFS; ++i)
+        if (bufs[i].state == FFS_BUF_FREE) break;
+
+    bufs[i].state = FFS_BUF_QUEUED;
+    bufs[i].dirty = 1;
+    pages[page].used++;
+    num_free--;
+    return &pool[i];
+}
+
+void msel_ffs_pool_free(ffs_packet_t *pkt)
+{
+    int idx = buf_index(pkt);
+    size_t page;
+
+    if (idx < 0 || bufs[idx].state == FFS_BUF_FREE)
+        return;
+
+    page = idx / FFS_POOL_PAGE_BUFS;
+    bufs[idx].state = FFS_BUF_FREE;
+    num_free++;
+
+    // Once a page is empty, revoke any access its owner had to it
+    if (--pages[page].used == 0)
+    {
+        pages[page].owner = FFS_POOL_NO_OWNER;
+        arch_mm_invalidate(&pool[page * FFS_POOL_PAGE_BUFS], PAGE_SIZE);
+    }
+}
+
+size_t msel_ffs_pool_available()
+{
+    return num_free;
+}
+
+msel_status msel_ffs_pool_lend(ffs_packet_t *pkt)
+{
+    int idx = buf_index(pkt);
+    if (idx < 0 || bufs[idx].state == FFS_BUF_FREE)
+        return MSEL_EINVAL;
+
+    if (pages[idx / FFS_POOL_PAGE_BUFS].owner == FFS_POOL_KERNEL)
+        return MSEL_EPERM;
+
+    bufs[idx].state = FFS_BUF_LENT;
+    return MSEL_OK;
+}
+
+void msel_ffs_pool_reclaim(ffs_packet_t *pkt)
+{
+    int idx = buf_index(pkt);
+    if (idx >= 0 && bufs[idx].state == FFS_BUF_LENT)
+        bufs[idx].state = FFS_BUF_QUEUED;
+}
+
+int msel_ffs_pool_is_lent(const ffs_packet_t *pkt, uint8_t tasknum)
+{
+    int idx = buf_index(pkt);
+    return idx >= 0 && bufs[idx].state == FFS_BUF_LENT &&
+           pages[idx / FFS_POOL_PAGE_BUFS].owner == tasknum;
+}
+
+uint8_t msel_ffs_pool_page_owner(const void *addr)
+{
+    const uint8_t *start = (const uint8_t*)pool;
+
+    if ((const uint8_t*)addr < start || (const uint8_t*)addr >= start + FFS_POOL_PAGES * PAGE_SIZE)
+        return FFS_POOL_NO_OWNER;
+
+    return pages[((const uint8_t*)addr - start) / PAGE_SIZE].owner;
+}
+
+void* msel_ffs_pool_page(size_t page)
+{
+    if (page >= FFS_POOL_PAGES)
+        return NULL;
+
+    return &pool[page * FFS_POOL_PAGE_BUFS];
+}
+
+void msel_ffs_pool_release_task(uint8_t tasknum)
+{
+    size_t page, i;
+
+    for (page = 0; page < FFS_POOL_PAGES; ++page)
+    {
+        if (pages[page].owner != tasknum)
+            continue;
+
+        // Anything the task was still holding goes straight back to the pool
+        for (i = page * FFS_POOL_PAGE_BUFS; i < (page + 1) * FFS_POOL_PAGE_BUFS; ++i)
+            if (bufs[i].state == FFS_BUF_LENT)
+                msel_ffs_pool_free(&pool[i]);
+
+        // Packets still waiting in a queue are kept until they drain, but the
+        // task number may be reused before then, so nobody gets the page
+        if (pages[page].used > 0)
+        {
+            pages[page].owner = FFS_POOL_KERNEL;
+            pages[page].last_owner = FFS_POOL_KERNEL;
+            arch_mm_invalidate(&pool[page * FFS_POOL_PAGE_BUFS], PAGE_SIZE);
+        }
+    }
+}
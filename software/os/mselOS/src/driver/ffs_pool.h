@@ -0,0 +1,126 @@
+/** @file ffs_pool.h
+ *
+ *  This file contains declarations for the faux filesystem packet buffer pool
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _FFS_POOL_H
+#define _FFS_POOL_H
+
+#include <msel/ffs.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @defgroup ffs_pool Faux Filesystem Packet Pool
+
+    All packets queued by the session manager live in a single kernel pool of
+    ffs_packet_t buffers, and the session queues only pass references to them.
+    Incoming packets are copied by the FFS device straight into a pool buffer,
+    and outgoing packets are copied straight out of one.
+
+    Buffers may also be lent to the task that owns them, in which case the
+    task reads or writes the packet in place instead of copying it through its
+    own heap.  Memory protection works on whole pages (TLB pages on or1k, MPU
+    regions on ARM), so every pool page is bound to a single task while any of
+    its buffers are in use, and a task is only ever granted access to pages
+    that it owns outright.  When a page changes hands, any stale data left in
+    it by the previous owner is wiped before the new owner can see it.
+
+    If every page is taken, a buffer may still be queued in a page belonging
+    to another task.  The page then becomes kernel-only until it drains, and
+    its buffers cannot be lent.
+
+ *  @{
+ */
+
+/** @brief Marks a buffer or pool page that is not owned by any task */
+#define FFS_POOL_NO_OWNER 0xff
+
+/** @brief Initialize the packet pool, marking every buffer as free */
+void msel_ffs_pool_init(void);
+
+/** @brief Take a buffer from the pool on behalf of a task
+
+    Buffers are only taken from pool pages that are either unused or already
+    owned by the given task.
+
+    @param tasknum The task that will own the buffer
+    @return A pointer to the buffer, or NULL if the pool is exhausted
+ */
+ffs_packet_t* msel_ffs_pool_alloc(uint8_t tasknum);
+
+/** @brief Return a buffer to the pool
+
+    @param pkt A buffer previously returned from msel_ffs_pool_alloc
+ */
+void msel_ffs_pool_free(ffs_packet_t *pkt);
+
+/** @brief Get the number of buffers left in the pool
+
+    Note that a free buffer may still be unavailable to a particular task if
+    every page with room in it has been lent to some other task.
+ */
+size_t msel_ffs_pool_available(void);
+
+/** @brief Lend a buffer to its owner so it can be accessed in place
+
+    @param pkt A pool buffer
+    @return MSEL status value:
+      - MSEL_OK on success
+      - MSEL_EINVAL if pkt is not an allocated pool buffer
+      - MSEL_EPERM if the buffer lives in a page shared with other tasks
+ */
+msel_status msel_ffs_pool_lend(ffs_packet_t *pkt);
+
+/** @brief Take a lent buffer back from its owner (e.g. to queue it) */
+void msel_ffs_pool_reclaim(ffs_packet_t *pkt);
+
+/** @brief Check whether a pointer is a pool buffer currently lent to a task
+
+    @param pkt The pointer to check (may point anywhere)
+    @param tasknum The task that should be holding the buffer
+    @return non-zero if pkt is a pool buffer lent to tasknum
+ */
+int msel_ffs_pool_is_lent(const ffs_packet_t *pkt, uint8_t tasknum);
+
+/** @brief Find the task that owns the pool page containing an address
+
+    This is used by the memory management code to decide whether a task
+    may access a pool page.
+
+    @param addr Any address
+    @return The owning task number, or FFS_POOL_NO_OWNER if addr is not
+      in the pool or the page is unused
+ */
+uint8_t msel_ffs_pool_page_owner(const void *addr);
+
+/** @brief Get the address of a pool page, for mapping it into a task
+
+    @param page Index of the page
+    @return The start of the page, or NULL if the index is out of range
+ */
+void* msel_ffs_pool_page(size_t page);
+
+/** @brief Return every buffer owned by a task to the pool
+
+    @param tasknum The task being cleaned up
+ */
+void msel_ffs_pool_release_task(uint8_t tasknum);
+
+/** @} */
+
+#endif // _FFS_POOL_H
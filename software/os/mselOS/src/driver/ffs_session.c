@@ -24,9 +24,11 @@
 #include <msel/stdc.h>
 
 #include "os/task.h"
+#include "os/trace.h"
 
 #include "ffs_session.h"
 #include "ffs_driver.h"
+#include "ffs_pool.h"
 
 /** @addtogroup ffs_session
  *  @{
@@ -36,11 +38,15 @@
  *  @{
  */
 
-/** @brief The maximum number of messages a session queue can hold */
-#define MAX_QUEUE_SIZE 2
+/** @brief The number of messages a session queue is always able to hold (low watermark) */
+#define QUEUE_LOW_WATER FFS_QUEUE_DEPTH
+
+/** @brief The maximum number of messages a session queue can hold by borrowing
+ *  pool space that other sessions aren't using (high watermark) */
+#define QUEUE_HIGH_WATER FFS_QUEUE_MAX
 
 /** @brief The maximum number of sessions that can exist at a time */
-#define MAX_NUM_SESSIONS 5
+#define MAX_NUM_SESSIONS FFS_NUM_SESSIONS
 
 /** @brief Instruct the session manager to start a new application/session */
 #define CMD_START_SESSION 0x1
@@ -51,17 +57,23 @@
 /** @brief Number of bytes for the session manager commands */
 #define S0_CMD_SIZE 1
 
+/** @brief Credit (in packets) each session with outbound data gets per round
+ *  of the deficit round-robin scheduler.  Every packet fills the whole RFILE
+ *  window, so all packets cost the same single unit of credit. */
+#define OUT_QUANTUM 1
+
 /** @} */
 
 /** @brief Message queue for a FFS session */
 typedef struct ffs_queue_s
 {
-    ffs_packet_t data[MAX_QUEUE_SIZE];
+    // The packets themselves live in the packet pool; queues only hold references
+    ffs_packet_t *data[QUEUE_HIGH_WATER];
 
     // The queue is stored as a circular array
     uint8_t size;
-    ffs_packet_t *start;
-    ffs_packet_t *end;
+    ffs_packet_t **start;
+    ffs_packet_t **end;
 
     // Data about the task corresponing to this queue
     uint16_t task_id;
@@ -72,10 +84,28 @@ typedef struct ffs_queue_s
     uint8_t active;
 } ffs_queue_t;
 
+/** @brief Outgoing message queue and scheduling state for a FFS session */
+typedef struct ffs_outq_s
+{
+    // References to pool buffers, and the tick at which each one was queued
+    ffs_packet_t *data[QUEUE_HIGH_WATER];
+    uint32_t queued_at[QUEUE_HIGH_WATER];
+
+    // The queue is stored as a circular array
+    uint8_t size;
+    ffs_packet_t **start;
+    ffs_packet_t **end;
+
+    // Unspent deficit round-robin credit
+    uint8_t deficit;
+
+    ffs_session_stats_t stats;
+} ffs_outq_t;
+
 /** @brief Special outgoing queue for session 0 (the session manager) */
 struct
 {
-    uint32_t data[MAX_QUEUE_SIZE];
+    uint32_t data[QUEUE_LOW_WATER];
     uint8_t size;
     uint32_t *start;
     uint32_t *end;
@@ -83,32 +113,131 @@ struct
 
 /** @} */
 
+#define CBUF_LEN(buf) (sizeof(buf.data) / sizeof(buf.data[0]))
+
 #define CBUF_ADD(buf) { \
     ++buf.end; ++buf.size; \
-    if (buf.end >= buf.data + MAX_QUEUE_SIZE) \
+    if (buf.end >= buf.data + CBUF_LEN(buf)) \
         buf.end = buf.data; \
 }
 
 #define CBUF_REM(buf) { \
     --buf.size; ++buf.start; \
-     if (buf.start >= buf.data + MAX_QUEUE_SIZE) \
+     if (buf.start >= buf.data + CBUF_LEN(buf)) \
          buf.start = buf.data; \
 }
 
 static int rfile_empty;    // Is there anything in RFILE?
-static ffs_queue_t rq;     // The outbound (RFILE) queue
 static ffs_queue_t wq[MAX_NUM_SESSIONS];   // The incoming (WFILE) queues 
+static ffs_outq_t  oq[MAX_NUM_SESSIONS];   // The outbound (RFILE) queues
 
-// 1-indexed array for convenient access without session-ID translation issues
-// NEVER access wq_1[0]!!
+// 1-indexed arrays for convenient access without session-ID translation issues
+// NEVER access wq_1[0] or oq_1[0]!!
 static ffs_queue_t *wq_1 = wq - 1;
+static ffs_outq_t  *oq_1 = oq - 1;
+
+static uint16_t out_size = 0;   // Total messages across all outbound queues
+static uint16_t out_cursor = 0; // Session currently being served by the scheduler
 
 // Data is read into s0 before being routed to the appropriate session
 static ffs_packet_t s0;
 
+// Session owned by each task (0 for none), so the syscalls don't have to
+// search the session table on every call
+static uint16_t task_session[MSEL_TASKS_MAX];
+
 static uint16_t num_sessions = 0;
 static uint16_t retry_session_id = MAX_NUM_SESSIONS + 1;
 
+/** @brief Check whether a session may take a pool buffer beyond its low watermark
+
+    Every active session's incoming queue, and the outbound queues as a whole,
+    are entitled to QUEUE_LOW_WATER buffers.  Anything left over once those
+    claims are set aside can be borrowed.
+
+    @param sid The session that wants to borrow (its own claim is not set aside)
+ */
+static int pool_can_borrow(uint16_t sid)
+{
+    uint16_t s;
+    size_t reserved = 0;
+
+    for (s = 1; s <= MAX_NUM_SESSIONS; ++s)
+        if (s != sid && wq_1[s].active && wq_1[s].size < QUEUE_LOW_WATER)
+            reserved += QUEUE_LOW_WATER - wq_1[s].size;
+
+    if (out_size < QUEUE_LOW_WATER)
+        reserved += QUEUE_LOW_WATER - out_size;
+
+    return msel_ffs_pool_available() > reserved;
+}
+
+/** @brief Check whether a session's incoming queue can take another message */
+static int queue_has_room(uint16_t sid)
+{
+    if (wq_1[sid].size >= QUEUE_HIGH_WATER)
+        return 0;
+
+    return wq_1[sid].size < QUEUE_LOW_WATER || pool_can_borrow(sid);
+}
+
+/** @brief Check whether a session's outgoing queue can take another message
+
+    @param lent Whether the message is already in a pool buffer
+ */
+static int outq_has_room(uint16_t sid, int lent)
+{
+    if (oq_1[sid].size >= QUEUE_HIGH_WATER)
+        return 0;
+
+    return lent || out_size < QUEUE_LOW_WATER || pool_can_borrow(sid);
+}
+
+/** @brief Pick the session whose outgoing message should be sent next
+
+    Sessions are served by deficit round-robin, so a session streaming bulk
+    data can't hold up the others for more than OUT_QUANTUM packets at a time.
+
+    @return The session ID, or 0 if every outgoing queue is empty
+ */
+static uint16_t outq_next()
+{
+    uint16_t i;
+
+    if (out_size == 0)
+        return 0;
+
+    // Keep serving the current session while it still has credit
+    if (out_cursor > 0 && oq_1[out_cursor].size > 0 && oq_1[out_cursor].deficit > 0)
+        return out_cursor;
+
+    for (i = 0; i < MAX_NUM_SESSIONS; ++i)
+    {
+        out_cursor = (out_cursor % MAX_NUM_SESSIONS) + 1;
+        if (oq_1[out_cursor].size > 0)
+        {
+            oq_1[out_cursor].deficit += OUT_QUANTUM;
+            return out_cursor;
+        }
+
+        // Idle sessions don't get to bank credit
+        oq_1[out_cursor].deficit = 0;
+    }
+
+    return 0;
+}
+
+/** @brief Return every message in a session's outgoing queue to the pool */
+static void outq_flush(uint16_t sid)
+{
+    while (oq_1[sid].size > 0)
+    {
+        msel_ffs_pool_free(*oq_1[sid].start);
+        CBUF_REM(oq_1[sid]);
+        --out_size;
+    }
+}
+
 /** @brief If the last message was "retry", signal ready for a new write */
 static void clear_retry_id()
 {
@@ -144,6 +273,11 @@ static uint16_t init_session(uint16_t task_id, const uint8_t* endpoint, uint16_t
     wq_1[sid].endpoint = endpoint;
     wq_1[sid].port = port;
     wq_1[sid].active = 1;
+    task_session[task_id] = sid;
+
+    msel_memset(&(oq_1[sid]), 0, sizeof(ffs_outq_t));
+    oq_1[sid].start = oq_1[sid].data;
+    oq_1[sid].end = oq_1[sid].data;
 
     num_sessions++;
     return sid;     
@@ -156,62 +290,208 @@ static uint16_t init_session(uint16_t task_id, const uint8_t* endpoint, uint16_t
  */
 static void end_session(uint16_t sid)
 {
+    // Give back any packets the task never got around to reading
+    while (wq_1[sid].size > 0)
+    {
+        msel_ffs_pool_free(*wq_1[sid].start);
+        CBUF_REM(wq_1[sid]);
+    }
+    outq_flush(sid);
+
     msel_task_force_kill(wq_1[sid].task_id, "Force quit by Android");
+    task_session[wq_1[sid].task_id] = 0;
     msel_memset(&(wq_1[sid]), 0, sizeof(ffs_queue_t));
     --num_sessions;
 
     if (sid == retry_session_id) clear_retry_id();
 }
 
+/** @brief Find the session belonging to the active task
+
+    @return The session ID, or MAX_NUM_SESSIONS + 1 if the task has no session
+ */
+static uint16_t active_session()
+{
+    uint8_t task_id = msel_active_task_num;
+    uint16_t sid = task_session[task_id];
+
+    if (sid == 0 || !wq_1[sid].active || wq_1[sid].task_id != task_id)
+        return MAX_NUM_SESSIONS + 1;
+    return sid;
+}
+
+/** @brief Take the next packet off a session's incoming queue
+
+    @return The pool buffer holding the packet, or NULL if the queue is empty
+ */
+static ffs_packet_t* dequeue_incoming(uint16_t sid)
+{
+    ffs_packet_t *buf;
+
+    if (sid == 0 || sid > MAX_NUM_SESSIONS || wq_1[sid].size == 0)
+        return NULL;
+
+    buf = *wq_1[sid].start;
+    CBUF_REM(wq_1[sid]);
+
+    // If the peripheral was told to retry, now we can say that we're ready
+    if (sid == retry_session_id && queue_has_room(sid))
+        clear_retry_id();
+
+    return buf;
+}
+
 msel_status msel_ffs_session_send(ffs_packet_t *pkt)
 {
+    ffs_packet_t *buf;
+    uint16_t sid = active_session();
+    int lent = msel_ffs_pool_is_lent(pkt, msel_active_task_num);
+
     // Make sure the task isn't trying to impersonate an invalid session 
-    uint8_t task_id = msel_active_task_num;
-    for (pkt->session = 1; pkt->session <= MAX_NUM_SESSIONS; ++(pkt->session))
-        if (wq_1[pkt->session].active && wq_1[pkt->session].task_id == task_id) break;
+    if (sid == 0 || sid > MAX_NUM_SESSIONS || !outq_has_room(sid, lent))
+        return MSEL_ERESOURCE;
 
-    // Copy the message to RFILE
-    if (pkt->session > 0 && pkt->session <= MAX_NUM_SESSIONS && rq.size < MAX_QUEUE_SIZE)
+    // If nothing is waiting ahead of this packet and the peripheral is ready,
+    // write it straight to RFILE instead of staging it in the pool
+    if (!lent && rfile_empty && out_size == 0 && s0_rq.size == 0)
     {
-        msel_memcpy(rq.end, pkt, sizeof(ffs_packet_t));
-        CBUF_ADD(rq);
-
-        // Don't have to acknowledge before receiving first packet
-        if (rfile_empty) msel_rfile_step_queue();
+        pkt->session = sid;
+        if (msel_ffs_rfile_write(pkt) == MSEL_OK)
+        {
+            MSEL_TRACE(TRACE_CAT_FFS, TRACE_FFS_OUT, sid);
+            rfile_empty = 0;
+            oq_1[sid].stats.sent++;
+            return MSEL_OK;
+        }
+    }
 
-        return MSEL_OK;
+    // A buffer lent out of the pool is queued as-is, anything else has to be
+    // copied into the pool first
+    if (lent)
+    {
+        buf = pkt;
+        msel_ffs_pool_reclaim(buf);
+    }
+    else
+    {
+        if ((buf = msel_ffs_pool_alloc(msel_active_task_num)) == NULL)
+            return MSEL_ERESOURCE;
+        msel_memcpy(buf, pkt, sizeof(ffs_packet_t));
     }
-    else return MSEL_ERESOURCE;
+
+    buf->session = sid;
+    *oq_1[sid].end = buf;
+    oq_1[sid].queued_at[oq_1[sid].end - oq_1[sid].data] = (uint32_t)msel_systicks;
+    CBUF_ADD(oq_1[sid]);
+    ++out_size;
+    MSEL_TRACE(TRACE_CAT_FFS, TRACE_FFS_QUEUE, sid);
+
+    if (oq_1[sid].size > oq_1[sid].stats.depth_max)
+        oq_1[sid].stats.depth_max = oq_1[sid].size;
+
+    // Don't have to acknowledge before receiving first packet
+    if (rfile_empty) msel_rfile_step_queue();
+
+    return MSEL_OK;
 }
 
 msel_status msel_ffs_session_recv(ffs_packet_t *pkt)
 {
-    // Find out which queue to get the next message from
-    uint8_t sid; uint8_t task_id = msel_active_task_num;
-    for (sid = 1; sid <= MAX_NUM_SESSIONS; ++sid)
-        if (wq_1[sid].active && wq_1[sid].task_id == task_id) break;
+    // Copy the message and give the buffer back to the pool (the data's now in
+    // the task's hands, if it throws it away there's no getting it back).
+    ffs_packet_t *buf = dequeue_incoming(active_session());
+    if (buf == NULL)
+        return MSEL_ERESOURCE;
+
+    msel_memcpy(pkt, buf, sizeof(ffs_packet_t));
+    msel_ffs_pool_free(buf);
+    return MSEL_OK;
+}
 
-    // Copy the message and advance the array index (the data's now in the task's
-    // hands, if it throws it away there's no getting it back).
-    if (sid > 0 && sid <= MAX_NUM_SESSIONS && wq_1[sid].size > 0)
-    {
-        msel_memcpy(pkt, wq_1[sid].start, sizeof(ffs_packet_t));
+msel_status msel_ffs_session_recv_lend(ffs_packet_t **pkt)
+{
+    uint16_t sid = active_session();
+    msel_status ret;
 
-        // If the peripheral was told to retry, now we can say that we're ready
-        if (sid == retry_session_id) 
-            clear_retry_id();
+    if (sid == 0 || sid > MAX_NUM_SESSIONS || wq_1[sid].size == 0)
+        return MSEL_ERESOURCE;
 
-        CBUF_REM(wq_1[sid]);
-        return MSEL_OK;
+    // A lent buffer stays out of the pool like one from msel_ffs_pkt_alloc,
+    // so it has to be one the session may borrow
+    if (!pool_can_borrow(sid))
+        return MSEL_EPERM;
+
+    // Only pages that belong to the task can be handed over; otherwise the
+    // packet stays queued and the task has to fall back to a copying receive
+    if ((ret = msel_ffs_pool_lend(*wq_1[sid].start)) != MSEL_OK)
+        return ret;
+
+    *pkt = dequeue_incoming(sid);
+    return MSEL_OK;
+}
+
+msel_status msel_ffs_pkt_alloc(ffs_packet_t **pkt)
+{
+    ffs_packet_t *buf;
+
+    // Buffers in the task's hands count against the pool like a deeper queue
+    uint16_t sid = active_session();
+    if (sid == 0 || sid > MAX_NUM_SESSIONS || !pool_can_borrow(sid))
+        return MSEL_ERESOURCE;
+
+    if ((buf = msel_ffs_pool_alloc(msel_active_task_num)) == NULL)
+        return MSEL_ERESOURCE;
+
+    if (msel_ffs_pool_lend(buf) != MSEL_OK)
+    {
+        msel_ffs_pool_free(buf);
+        return MSEL_ERESOURCE;
     }
-    else return MSEL_ERESOURCE;
+
+    *pkt = buf;
+    return MSEL_OK;
+}
+
+msel_status msel_ffs_session_stats(ffs_session_stats_t *stats)
+{
+    uint16_t sid = active_session();
+    if (sid == 0 || sid > MAX_NUM_SESSIONS)
+        return MSEL_ERESOURCE;
+
+    msel_memcpy(stats, &(oq_1[sid].stats), sizeof(ffs_session_stats_t));
+    return MSEL_OK;
+}
+
+const uint8_t* msel_ffs_session_endpoint(uint8_t task_id)
+{
+    uint16_t sid;
+
+    if (task_id >= MSEL_TASKS_MAX)
+        return NULL;
+
+    sid = task_session[task_id];
+    if (sid == 0 || sid > MAX_NUM_SESSIONS || !wq_1[sid].active || wq_1[sid].task_id != task_id)
+        return NULL;
+
+    return wq_1[sid].endpoint;
+}
+
+msel_status msel_ffs_pkt_release(ffs_packet_t *pkt)
+{
+    if (!msel_ffs_pool_is_lent(pkt, msel_active_task_num))
+        return MSEL_EINVAL;
+
+    msel_ffs_pool_free(pkt);
+    return MSEL_OK;
 }
 
 void msel_rfile_step_queue()
 {
     rfile_empty = 0;
 
-    // Messages from session 0 pre-empt anything in rq
+    uint16_t sid;
+
+    // Messages from session 0 pre-empt anything in the session queues
     if (s0_rq.size > 0)
     {
         msel_memset(&s0, 0, sizeof(ffs_packet_t));
@@ -220,13 +500,29 @@ void msel_rfile_step_queue()
         if (msel_ffs_rfile_write(&s0) == MSEL_OK)
             CBUF_REM(s0_rq);
     }
-    else if (rq.size > 0)
+    else if ((sid = outq_next()) > 0)
     {
+        ffs_outq_t *q = &oq_1[sid];
+
         // Remember, the host writes to rfile and reads from wfile
         //
         // Only advance the queue if the peripheral is ready for the next packet
-        if (msel_ffs_rfile_write(rq.start) == MSEL_OK)
-            CBUF_REM(rq);
+        if (msel_ffs_rfile_write(*q->start) == MSEL_OK)
+        {
+            uint32_t delay = (uint32_t)msel_systicks - q->queued_at[q->start - q->data];
+
+            MSEL_TRACE_TASK(TRACE_CAT_FFS, TRACE_FFS_OUT, wq_1[sid].task_id, sid);
+
+            q->stats.sent++;
+            q->stats.delay_total += delay;
+            if (delay > q->stats.delay_max)
+                q->stats.delay_max = delay;
+
+            msel_ffs_pool_free(*q->start);
+            CBUF_REM((*q));
+            --out_size;
+            --q->deficit;
+        }
     }
     else
     {
@@ -237,11 +533,27 @@ void msel_rfile_step_queue()
 
 void msel_wfile_get_packet()
 {
-    // Remember, the host writes to rfile and reads from wfile
-    msel_ffs_wfile_read(&s0);
-    uint16_t sid = s0.session;
+    ffs_packet_t *buf = &s0;
+    uint16_t sid = 0;
     uint16_t status = FFS_CHANNEL_LAST_SUCC;
-    uint8_t in_nonce = s0.nonce;
+    uint8_t in_nonce;
+
+    // Packets for an application are read by the device straight into a pool
+    // buffer, so peek at the session first to find out where this one goes.
+    // Anything else lands in s0: session 0 commands are handled from there,
+    // and an application packet that couldn't get a buffer (or whose header
+    // couldn't be peeked at) is dropped and the host told to retry
+    if (msel_ffs_wfile_read_hdr(&sid) == MSEL_OK &&
+        sid > 0 && sid <= MAX_NUM_SESSIONS && wq_1[sid].active && queue_has_room(sid))
+    {
+        buf = msel_ffs_pool_alloc(wq_1[sid].task_id);
+        if (buf == NULL) buf = &s0;
+    }
+
+    // Remember, the host writes to rfile and reads from wfile
+    msel_ffs_wfile_read(buf);
+    sid = buf->session;
+    in_nonce = buf->nonce;
 
     msel_ffs_wfile_set_status(FFS_CHANNEL_READY, in_nonce);
 
@@ -258,7 +570,7 @@ void msel_wfile_get_packet()
         {
             // The protocol requires that we return the session ID on the rfile channel,
             // so if this buffer is full then we need to try again later
-            if (s0_rq.size >= MAX_QUEUE_SIZE)
+            if (s0_rq.size >= CBUF_LEN(s0_rq))
                 { status = FFS_CHANNEL_LAST_RETRY; goto cleanup; }
 
             // Make sure there's an available session
@@ -270,14 +582,20 @@ void msel_wfile_get_packet()
                 uint8_t task_id; uint16_t port; 
                 const uint8_t* endpoint = NULL;
                 void (*task_fn)(void *arg, const size_t arg_sz) = NULL;
+                msel_status ret;
 
                 // Check that the endpoint is valid
                 get_task(&endpoint, &task_fn, &port, s0.data + S0_CMD_SIZE);
                 if (endpoint == NULL || task_fn == NULL)
                     { status = FFS_CHANNEL_LAST_FAIL; goto cleanup; }
 
-                // Try to create the task
-                if (msel_task_create(task_fn, NULL, 0, &task_id) != MSEL_OK)
+                // Try to create the task. MSEL_EBUSY only means the memory it
+                // needs is still being wiped after an earlier task, so the
+                // host can try again shortly
+                ret = msel_task_create(task_fn, NULL, 0, &task_id);
+                if (ret == MSEL_EBUSY)
+                    { status = FFS_CHANNEL_LAST_RETRY; goto cleanup; }
+                else if (ret != MSEL_OK)
                     { status = FFS_CHANNEL_LAST_FAIL; goto cleanup; }
 
                 sid = init_session(task_id, endpoint, port);
@@ -313,22 +631,29 @@ void msel_wfile_get_packet()
     {
         // Invalid session ID
         if (sid == 0 || sid > MAX_NUM_SESSIONS || !wq_1[sid].active)
-            { status = FFS_CHANNEL_LAST_FAIL; goto cleanup; }
+        {
+            MSEL_TRACE(TRACE_CAT_FFS, TRACE_FFS_IN_FAIL, sid);
+            status = FFS_CHANNEL_LAST_FAIL;
+            goto cleanup;
+        }
 
-        // Too much data in the buffer
-        else if (wq_1[sid].size >= MAX_QUEUE_SIZE) 
+        // Too much data in the buffer, or nowhere in the pool to keep it
+        else if (buf == &s0) 
         {
+            MSEL_TRACE(TRACE_CAT_FFS, TRACE_FFS_IN_FAIL, sid);
             retry_session_id = sid;
             status = FFS_CHANNEL_LAST_RETRY;
             goto cleanup;
         }
 
-        // Copy the data to the buffer
+        // Hand the buffer to the session
         else
         {
-            msel_memcpy(wq_1[sid].end, &s0, sizeof(ffs_packet_t));
+            *wq_1[sid].end = buf;
+            buf = &s0;
 
             CBUF_ADD(wq_1[sid]);
+            MSEL_TRACE_TASK(TRACE_CAT_FFS, TRACE_FFS_IN, wq_1[sid].task_id, sid);
             goto cleanup;
         }
 
@@ -336,6 +661,8 @@ void msel_wfile_get_packet()
     }
 
 cleanup:
+    // A pool buffer that didn't make it into a queue goes straight back
+    if (buf != &s0) msel_ffs_pool_free(buf);
     msel_ffs_wfile_set_status(status, in_nonce);
 }
 
@@ -343,8 +670,11 @@ int hasSeenReadAck;
 
 void msel_init_ffs_queues()
 {
-    msel_memset(&rq, 0, sizeof(ffs_queue_t));
-    rq.start = rq.data; rq.end = rq.data;
+    msel_ffs_pool_init();
+
+    msel_memset(oq, 0, sizeof(ffs_outq_t) * MAX_NUM_SESSIONS);
+    out_size = 0;
+    out_cursor = 0;
     s0_rq.start = s0_rq.data;
     s0_rq.end = s0_rq.data;
     s0_rq.size = 0;
@@ -352,6 +682,7 @@ void msel_init_ffs_queues()
     hasSeenReadAck = 0;
     
     msel_memset(wq, 0, sizeof(ffs_queue_t) * MAX_NUM_SESSIONS);
+    msel_memset(task_session, 0, sizeof(task_session));
     msel_ffs_wfile_set_status(FFS_CHANNEL_READY, 0x00);
     msel_ffs_rfile_clear();
 }
@@ -28,17 +28,26 @@
 
     Any data sent to and from sessions (applications) in mselOS get routed through the FFS
     session manager.  The session manager maintains several circular buffers for incoming
-    and outgoing data.  All outgoing data enters one single circular buffer; whereas incoming
-    data is routed to a circular buffer corresponding to the particular session indicated
-    in the packet header.
-
-    Applications are assigned session IDs from 1..MAX_NUM_SESSIONS, and each one has a
-    circular buffer queue of MAX_QUEUE_SIZE messages.  Session ID 0 corresponds to the 
+    and outgoing data.  Every session has one circular buffer for each direction: incoming
+    data is routed to the buffer for the session indicated in the packet header, and
+    outgoing buffers are drained onto RFILE by deficit round-robin so that no session can
+    hold the channel for long while others are waiting.
+
+    Applications are assigned session IDs from 1..FFS_NUM_SESSIONS, and each one has a
+    circular buffer queue that is guaranteed room for FFS_QUEUE_DEPTH messages (its low
+    watermark).  A busy session may keep queueing past that, up to FFS_QUEUE_MAX messages
+    (its high watermark), for as long as the pool has buffers that no other active session
+    is entitled to.  All three limits are set at configure time with --with-ffs-sessions,
+    --with-ffs-queue-depth and --with-ffs-queue-max.  The queues hold references to
+    packets kept in the @ref ffs_pool "packet pool", so a packet is only copied when it
+    crosses into or out of an application's own memory.  Applications that want to
+    avoid even that copy can borrow pool buffers with MSEL_SVC_FFS_SESSION_RECV_LEND
+    and MSEL_SVC_FFS_PKT_ALLOC.  Session ID 0 corresponds to the 
     session manager, which is in charge of starting new sessions and killing existing 
     sessions.
 
     (Note: Session 0, the session manager, has a special outgoing queue for messages.  
-    Outbound messages from S0 pre-empt any other outbound messages)
+    Outbound messages from S0 have strict priority over any other outbound messages)
 
  *  @{
  */
@@ -73,6 +82,10 @@
 /** @brief Send a message from an application to the Android device.
  *  Call this function with the MSEL_SVC_FFS_SESSION_SEND syscall.
  *
+ *  If pkt was borrowed with MSEL_SVC_FFS_PKT_ALLOC or MSEL_SVC_FFS_SESSION_RECV_LEND
+ *  it is queued in place and returned to the pool once sent; the application must
+ *  not touch it again.
+ *
  *  @param pkt A pointer to the data packet to be transmitted
  *  @return MSEL status value:
  *    - MSEL_OK on successful operation
@@ -91,6 +104,58 @@ msel_status msel_ffs_session_send(ffs_packet_t *pkt);
  */
 msel_status msel_ffs_session_recv(ffs_packet_t *pkt);
 
+/** @brief Borrow the next incoming message without copying it.
+ *  Call this function with the MSEL_SVC_FFS_SESSION_RECV_LEND syscall.
+ *
+ *  The application may read and modify the packet in place, and must either
+ *  send it with MSEL_SVC_FFS_SESSION_SEND or give it back with
+ *  MSEL_SVC_FFS_PKT_RELEASE.
+ *
+ *  @param[out] pkt Set to the borrowed packet
+ *  @return MSEL status value:
+ *    - MSEL_OK on successful operation
+ *    - MSEL_ERESOURCE if the session ID is invalid or there's no data to read
+ *    - MSEL_EPERM if the packet can't be lent right now, because its page
+ *      isn't the task's or the session holds all the pool it may borrow; it
+ *      stays queued and can still be read with MSEL_SVC_FFS_SESSION_RECV
+ */
+msel_status msel_ffs_session_recv_lend(ffs_packet_t **pkt);
+
+/** @brief Borrow an empty packet buffer to build an outgoing message in.
+ *  Call this function with the MSEL_SVC_FFS_PKT_ALLOC syscall.
+ *
+ *  @param[out] pkt Set to the borrowed packet
+ *  @return MSEL status value:
+ *    - MSEL_OK on successful operation
+ *    - MSEL_ERESOURCE if the task has no session or no buffer can be lent
+ */
+msel_status msel_ffs_pkt_alloc(ffs_packet_t **pkt);
+
+/** @brief Read the outgoing traffic counters for the calling application's session.
+ *  Call this function with the MSEL_SVC_FFS_SESSION_STATS syscall.
+ *
+ *  @param[out] stats The session's counters
+ *  @return MSEL status value:
+ *    - MSEL_OK on successful operation
+ *    - MSEL_ERESOURCE if the application has no session
+ */
+msel_status msel_ffs_session_stats(ffs_session_stats_t *stats);
+
+/** @brief The endpoint (ENDPT_HASH_SIZE bytes) of the application a task
+ *  was started for, or NULL if the task has no session.
+ */
+const uint8_t* msel_ffs_session_endpoint(uint8_t task_id);
+
+/** @brief Give back a borrowed packet buffer without sending it.
+ *  Call this function with the MSEL_SVC_FFS_PKT_RELEASE syscall.
+ *
+ *  @param pkt A packet borrowed by the calling application
+ *  @return MSEL status value:
+ *    - MSEL_OK on successful operation
+ *    - MSEL_EINVAL if pkt isn't a buffer lent to the application
+ */
+msel_status msel_ffs_pkt_release(ffs_packet_t *pkt);
+
 /** @brief Advance the RFILE message queue
  *
  *  This is called when the Android device signals that it's ready for another
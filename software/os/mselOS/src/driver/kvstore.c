@@ -0,0 +1,1134 @@
+/* @file kvstore.c
+
+   A small log-structured key-value store.
+
+   The storage is split into erase segments. Records are only ever
+   appended, to one active segment at a time; a newer record for a key
+   supersedes the older ones and deleting writes a tombstone. When the
+   active segment fills up the next one is taken from the erased
+   segments, and if that was the last, the full segment with the least
+   live data is garbage collected into the new one and erased. Every so
+   often the least worn segment is collected instead so that its
+   (probably static) data doesn't keep it from being erased. The erase
+   is left running in the background; calls made before it is done
+   sleep until msel_kv_worker has finished it.
+
+   A RAM index maps each (namespace, key) to the location of its latest
+   record. It is rebuilt the first time the store is used after a
+   reset, by reading every record header once.
+
+   Record bodies (the key, then the value) are AES-CTR encrypted with a
+   per-namespace key, and carry an HMAC-SHA256 tag over the header and
+   body, both keys derived from the master key. Only a hash of the key
+   is stored in the clear.
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <msel.h>
+#include <msel/stdc.h>
+#include <msel/syscalls.h>
+#include <msel/master_key.h>
+#include <msel/endpoints.h>
+
+#include "os/task.h"
+#include "kvstore.h"
+#include "aes_driver.h"
+#include "sha_driver.h"
+#include "ffs_session.h"
+#include "arch.h"
+
+#define KV_SEG_MAGIC  0x4b565347 /* "KVSG" */
+#define KV_REC_MAGIC  0x4b56     /* "KV" */
+#define KV_ERASED32   0xffffffff
+
+/* Flag bits start out set (erased) and are cleared when true */
+#define KV_FLAG_COMMIT 0x01      /* cleared once the whole record is written */
+#define KV_FLAG_LIVE   0x02      /* cleared in a tombstone */
+
+#define KV_SEGS_MAX   8
+#define KV_NONE       0xff
+
+/* At the start of every segment. gen and retiring are written later,
+ * by clearing bits. */
+typedef struct {
+    uint32_t magic;
+    uint32_t erase_count;
+    uint32_t gen;         /* order in which segments became active */
+    uint32_t retiring;    /* not erased once garbage collection started */
+} kv_seg_hdr;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t  flags;
+    uint8_t  key_len;
+    uint16_t val_len;
+    uint16_t reserved;
+    uint32_t seq;         /* write order, the newest record for a key wins */
+    uint32_t ns;          /* namespace id */
+    uint32_t id;          /* keyed hash of the key */
+    uint8_t  tag[8];
+} kv_rec_hdr;
+
+#define KV_FLAGS_OFF  2
+#define KV_REC_SIZE(key_len, val_len) ((sizeof(kv_rec_hdr) + (key_len) + (val_len) + 7) & ~7)
+#define KV_REC_MAX    KV_REC_SIZE(MSEL_KV_KEY_MAX, MSEL_KV_VAL_MAX)
+
+typedef enum {
+    KV_SEG_ERASED = 0,
+    KV_SEG_ACTIVE,
+    KV_SEG_FULL,
+    KV_SEG_ERASING        /* collected, the erase is still running */
+} kv_seg_state;
+
+static struct {
+    uint32_t erase_count;
+    uint32_t gen;
+    uint32_t used;        /* bytes from the start, including the header */
+    uint32_t live;        /* bytes of records the index points to */
+    uint32_t min_seq;     /* oldest record in it */
+    uint8_t  state;       /* kv_seg_state */
+    uint8_t  retiring;
+} kv_segs[KV_SEGS_MAX];
+
+typedef enum {
+    KV_SLOT_FREE = 0,
+    KV_SLOT_LIVE,
+    KV_SLOT_DELETED
+} kv_slot_state;
+
+typedef struct {
+    uint32_t ns;
+    uint32_t id;
+    uint32_t seq;
+    uint32_t off;
+    uint16_t size;
+    uint8_t  seg;
+    uint8_t  state;       /* kv_slot_state */
+} kv_slot;
+
+static kv_slot  kv_index[KV_INDEX_SLOTS];
+static size_t   kv_index_used;
+
+static int      kv_loaded = 0;
+static size_t   kv_nsegs;
+static uint32_t kv_seg_size;
+static size_t   kv_active;
+static uint32_t kv_seq;
+static uint32_t kv_gen;
+static size_t   kv_erasing = KV_NONE;
+
+/* Derived from the master key the first time the store is used, and
+ * kept where no task can read it */
+static uint8_t  kv_root[32] MSEL_KERNEL_PRIVATE;
+
+/* One record at a time, big enough for any of them */
+static uint32_t kv_buf[KV_REC_MAX / sizeof(uint32_t)];
+
+/* The caller's namespace */
+typedef struct {
+    uint8_t  enc[16];     /* AES-128 key for record bodies */
+    uint8_t  mac[12];     /* prefix for the tag and key hashes */
+    uint32_t id;
+} kv_ns;
+
+/*** SHA-256 and AES-CTR on the kernel side of the drivers ***/
+
+static const uint8_t kv_sha_iv[32] =
+  { 0x6a, 0x09, 0xe6, 0x67, 0xbb, 0x67, 0xae, 0x85,
+    0x3c, 0x6e, 0xf3, 0x72, 0xa5, 0x4f, 0xf5, 0x3a,
+    0x51, 0x0e, 0x52, 0x7f, 0x9b, 0x05, 0x68, 0x8c,
+    0x1f, 0x83, 0xd9, 0xab, 0x5b, 0xe0, 0xcd, 0x19
+  };
+
+typedef struct {
+    sha_data_t data;
+    uint32_t   pos;
+    uint32_t   len;
+} kv_sha_ctx;
+
+static void kv_sha_init(kv_sha_ctx *ctx)
+{
+    msel_memcpy(ctx->data.iv, kv_sha_iv, sizeof(ctx->data.iv));
+    ctx->pos = 0;
+    ctx->len = 0;
+}
+
+static void kv_sha_update(kv_sha_ctx *ctx, const void *buf, uint32_t len)
+{
+    const uint8_t *in = buf;
+    uint32_t       n;
+
+    ctx->len += len;
+    while(len)
+    {
+        n = sizeof(ctx->data.din) - ctx->pos;
+        if(n > len)
+            n = len;
+        msel_memcpy(&ctx->data.din[ctx->pos], in, n);
+        ctx->pos += n;
+        in       += n;
+        len      -= n;
+
+        if(ctx->pos == sizeof(ctx->data.din))
+        {
+            msel_do_sha(&ctx->data);
+            ctx->pos = 0;
+        }
+    }
+}
+
+static void kv_sha_final(kv_sha_ctx *ctx, uint8_t out[32])
+{
+    uint64_t bits = (uint64_t)ctx->len << 3;
+    int      i;
+
+    ctx->data.din[ctx->pos++] = 0x80;
+    if(ctx->pos > sizeof(ctx->data.din) - 8)
+    {
+        msel_memset(&ctx->data.din[ctx->pos], 0, sizeof(ctx->data.din) - ctx->pos);
+        msel_do_sha(&ctx->data);
+        ctx->pos = 0;
+    }
+    msel_memset(&ctx->data.din[ctx->pos], 0, sizeof(ctx->data.din) - ctx->pos);
+    for(i = 0; i < 8; i++)
+        ctx->data.din[sizeof(ctx->data.din) - 1 - i] = bits >> (8 * i);
+
+    msel_do_sha(&ctx->data);
+    msel_memcpy(out, ctx->data.iv, 32);
+}
+
+static inline uint32_t kv_get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void kv_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* Encrypt or decrypt a record body. The counter block is unique to the
+ * record, since seq is never reused. */
+static void kv_ctr(const kv_ns *ns, const kv_rec_hdr *hdr, uint8_t *buf, size_t len)
+{
+    uint8_t          ctr[AES_BLOCK_SIZE], ks[AES_BLOCK_SIZE];
+    aes_driver_ctx_t aes;
+    uint32_t         blk;
+    size_t           i, n;
+
+    aes.enc      = 1;
+    aes.key_size = AES_128;
+    aes.key      = (uint8_t*)ns->enc;
+    aes.din      = ctr;
+    aes.dout     = ks;
+    aes.data_len = AES_BLOCK_SIZE;
+
+    for(blk = 0; len > 0; blk++)
+    {
+        kv_put32(ctr,      hdr->seq);
+        kv_put32(ctr + 4,  hdr->ns);
+        kv_put32(ctr + 8,  hdr->id);
+        kv_put32(ctr + 12, blk);
+        msel_do_aes(&aes);
+
+        n = len < AES_BLOCK_SIZE ? len : AES_BLOCK_SIZE;
+        for(i = 0; i < n; i++)
+            buf[i] ^= ks[i];
+        buf += n;
+        len -= n;
+    }
+    msel_memset(ks, 0, sizeof(ks));
+}
+
+/* HMAC-SHA256 over the header (as first written, without the tag) and
+ * body, cut down to 8 bytes */
+static void kv_tag(const kv_ns *ns, const kv_rec_hdr *hdr, uint8_t tag[8])
+{
+    kv_sha_ctx ctx;
+    kv_rec_hdr h = *hdr;
+    uint8_t    pad[64], out[32];
+    size_t     i;
+
+    h.flags |= KV_FLAG_COMMIT;
+    msel_memset(h.tag, 0, sizeof(h.tag));
+
+    msel_memset(pad, 0, sizeof(pad));
+    msel_memcpy(pad, ns->mac, sizeof(ns->mac));
+    for(i = 0; i < sizeof(pad); i++)
+        pad[i] ^= 0x36;
+
+    kv_sha_init(&ctx);
+    kv_sha_update(&ctx, pad, sizeof(pad));
+    kv_sha_update(&ctx, &h, sizeof(h));
+    kv_sha_update(&ctx, hdr + 1, hdr->key_len + hdr->val_len);
+    kv_sha_final(&ctx, out);
+
+    for(i = 0; i < sizeof(pad); i++)
+        pad[i] ^= 0x36 ^ 0x5c;
+
+    kv_sha_init(&ctx);
+    kv_sha_update(&ctx, pad, sizeof(pad));
+    kv_sha_update(&ctx, out, sizeof(out));
+    kv_sha_final(&ctx, out);
+    msel_memcpy(tag, out, 8);
+
+    msel_memset(pad, 0, sizeof(pad));
+    msel_memset(out, 0, sizeof(out));
+}
+
+static uint32_t kv_key_id(const kv_ns *ns, const void *key, size_t key_len)
+{
+    kv_sha_ctx ctx;
+    uint8_t    out[32];
+
+    kv_sha_init(&ctx);
+    kv_sha_update(&ctx, ns->mac, sizeof(ns->mac));
+    kv_sha_update(&ctx, key, key_len);
+    kv_sha_final(&ctx, out);
+    return kv_get32(out);
+}
+
+/* The active task's namespace: its endpoint if it has a session, else
+ * its task number */
+static void kv_namespace(kv_ns *ns)
+{
+    kv_sha_ctx     ctx;
+    uint8_t        name[1 + ENDPT_HASH_SIZE];
+    uint8_t        out[32];
+    const uint8_t *endpoint = msel_ffs_session_endpoint(msel_active_task_num);
+
+    msel_memset(name, 0, sizeof(name));
+    if(endpoint)
+    {
+        name[0] = 'e';
+        msel_memcpy(name + 1, endpoint, ENDPT_HASH_SIZE);
+    }
+    else
+    {
+        name[0] = 't';
+        name[1] = msel_active_task_num;
+    }
+
+    kv_sha_init(&ctx);
+    kv_sha_update(&ctx, kv_root, sizeof(kv_root));
+    kv_sha_update(&ctx, name, sizeof(name));
+    kv_sha_final(&ctx, out);
+
+    msel_memcpy(ns->enc, out, sizeof(ns->enc));
+    msel_memcpy(ns->mac, out + 16, sizeof(ns->mac));
+    ns->id = kv_get32(out + 28);
+    msel_memset(out, 0, sizeof(out));
+}
+
+/*** RAM index ***/
+
+static inline size_t kv_hash(uint32_t ns, uint32_t id)
+{
+    return ((ns ^ id) * 2654435761u) >> 26 & (KV_INDEX_SLOTS - 1);
+}
+
+/* The slot for a key, or the free slot where it would go */
+static size_t kv_index_find(uint32_t ns, uint32_t id)
+{
+    size_t i = kv_hash(ns, id);
+
+    while(kv_index[i].state != KV_SLOT_FREE &&
+          (kv_index[i].ns != ns || kv_index[i].id != id))
+        i = (i + 1) & (KV_INDEX_SLOTS - 1);
+    return i;
+}
+
+/* Linear probing: pull later entries back over the hole so that
+ * lookups don't stop early */
+static void kv_index_remove(size_t i)
+{
+    size_t j = i, k;
+
+    kv_index[i].state = KV_SLOT_FREE;
+    kv_index_used--;
+
+    while(1)
+    {
+        j = (j + 1) & (KV_INDEX_SLOTS - 1);
+        if(kv_index[j].state == KV_SLOT_FREE)
+            return;
+
+        k = kv_hash(kv_index[j].ns, kv_index[j].id);
+        if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+
+        kv_index[i] = kv_index[j];
+        kv_index[j].state = KV_SLOT_FREE;
+        i = j;
+    }
+}
+
+/* Point the index at a record unless it already has a newer one.
+ * MSEL_ERESOURCE if it is a new key and the index is full. */
+static msel_status kv_index_apply(const kv_rec_hdr *hdr, size_t seg, uint32_t off, uint32_t size)
+{
+    size_t   i    = kv_index_find(hdr->ns, hdr->id);
+    kv_slot *slot = &kv_index[i];
+
+    if(slot->state != KV_SLOT_FREE)
+    {
+        /* On a tie this is a copy left by interrupted garbage
+         * collection; keep the first one found */
+        if(slot->seq >= hdr->seq)
+            return MSEL_OK;
+        kv_segs[slot->seg].live -= slot->size;
+    }
+    else
+    {
+        /* Keep a free slot so that probing ends */
+        if(kv_index_used >= KV_INDEX_SLOTS - 1)
+            return MSEL_ERESOURCE;
+        kv_index_used++;
+    }
+
+    slot->ns    = hdr->ns;
+    slot->id    = hdr->id;
+    slot->seq   = hdr->seq;
+    slot->seg   = seg;
+    slot->off   = off;
+    slot->size  = size;
+    slot->state = (hdr->flags & KV_FLAG_LIVE) ? KV_SLOT_LIVE : KV_SLOT_DELETED;
+    kv_segs[seg].live += size;
+    return MSEL_OK;
+}
+
+/*** Segments ***/
+
+static msel_status kv_write_seg_field(size_t seg, size_t field, uint32_t val)
+{
+    return arch_nvm_write(seg, field * sizeof(uint32_t), &val, sizeof(val));
+}
+
+/* Start off a freshly erased segment */
+static msel_status kv_format_hdr(size_t seg, uint32_t erase_count)
+{
+    kv_seg_hdr  shdr;
+    msel_status ret;
+
+    shdr.magic       = KV_SEG_MAGIC;
+    shdr.erase_count = erase_count;
+    shdr.gen         = KV_ERASED32;
+    shdr.retiring    = KV_ERASED32;
+    if((ret=arch_nvm_write(seg, 0, &shdr, sizeof(shdr))) != MSEL_OK)
+        return ret;
+
+    kv_segs[seg].erase_count = erase_count;
+    kv_segs[seg].gen         = 0;
+    kv_segs[seg].used        = sizeof(shdr);
+    kv_segs[seg].live        = 0;
+    kv_segs[seg].min_seq     = KV_ERASED32;
+    kv_segs[seg].state       = KV_SEG_ERASED;
+    kv_segs[seg].retiring    = 0;
+    return MSEL_OK;
+}
+
+static msel_status kv_format(size_t seg, uint32_t erase_count)
+{
+    msel_status ret;
+
+    if((ret=arch_nvm_erase(seg)) != MSEL_OK)
+        return ret;
+    return kv_format_hdr(seg, erase_count);
+}
+
+/* Leave an emptied segment erasing; kv_erase_poll puts its header on */
+static msel_status kv_erase_start(size_t seg)
+{
+    msel_status ret;
+
+    if((ret=arch_nvm_erase_start(seg)) != MSEL_OK)
+        return ret;
+
+    kv_segs[seg].erase_count++;
+    kv_segs[seg].used    = kv_seg_size;
+    kv_segs[seg].live    = 0;
+    kv_segs[seg].min_seq = KV_ERASED32;
+    kv_segs[seg].state   = KV_SEG_ERASING;
+    kv_erasing = seg;
+    return MSEL_OK;
+}
+
+/* Finish the erase in flight, if any. MSEL_EBUSY until it is done. */
+static msel_status kv_erase_poll()
+{
+    size_t      seg = kv_erasing;
+    msel_status ret;
+
+    if(seg == KV_NONE)
+        return MSEL_OK;
+    if((ret=arch_nvm_poll()) == MSEL_EBUSY)
+        return MSEL_EBUSY;
+
+    kv_erasing = KV_NONE;
+    if(ret == MSEL_OK)
+        ret = kv_format_hdr(seg, kv_segs[seg].erase_count);
+    if(ret != MSEL_OK)
+    {
+        /* Nothing lives in it, so garbage collection tries again */
+        kv_segs[seg].state    = KV_SEG_FULL;
+        kv_segs[seg].retiring = 1;
+    }
+    return ret;
+}
+
+static msel_status kv_activate(size_t seg)
+{
+    msel_status ret;
+
+    if((ret=kv_write_seg_field(seg, 2, ++kv_gen)) != MSEL_OK)
+        return ret;
+
+    kv_segs[seg].gen   = kv_gen;
+    kv_segs[seg].state = KV_SEG_ACTIVE;
+    kv_active = seg;
+    return MSEL_OK;
+}
+
+/* The erased segment that has been erased least, KV_NONE if none */
+static size_t kv_least_worn_erased()
+{
+    size_t seg, best = KV_NONE;
+
+    for(seg = 0; seg < kv_nsegs; seg++)
+        if(kv_segs[seg].state == KV_SEG_ERASED &&
+           (best == KV_NONE || kv_segs[seg].erase_count < kv_segs[best].erase_count))
+            best = seg;
+    return best;
+}
+
+/* Whether the garbage collector has a spare segment, or will have once
+ * the erase in flight is done */
+static int kv_have_spare()
+{
+    return kv_erasing != KV_NONE || kv_least_worn_erased() != KV_NONE;
+}
+
+/* Append a whole record to the active segment. It only counts once the
+ * commit flag is cleared, after the rest is in. */
+static msel_status kv_write_rec(kv_rec_hdr *hdr, uint32_t size, uint32_t *off)
+{
+    msel_status ret;
+
+    *off = kv_segs[kv_active].used;
+    if(*off + size > kv_seg_size)
+        return MSEL_ENOMEM;
+
+    hdr->flags |= KV_FLAG_COMMIT;
+    ret = arch_nvm_write(kv_active, *off, hdr, size);
+
+    /* The space is gone either way */
+    kv_segs[kv_active].used += size;
+    if(ret != MSEL_OK)
+        return ret;
+
+    hdr->flags &= ~KV_FLAG_COMMIT;
+    if((ret=arch_nvm_write(kv_active, *off + KV_FLAGS_OFF, &hdr->flags, 1)) != MSEL_OK)
+        return ret;
+
+    if(hdr->seq < kv_segs[kv_active].min_seq)
+        kv_segs[kv_active].min_seq = hdr->seq;
+    return MSEL_OK;
+}
+
+/* A tombstone can go once no other segment could hold an older record
+ * for its key */
+static int kv_tombstone_droppable(const kv_slot *slot)
+{
+    size_t seg;
+
+    for(seg = 0; seg < kv_nsegs; seg++)
+        if(seg != slot->seg && kv_segs[seg].state != KV_SEG_ERASED &&
+           kv_segs[seg].min_seq <= slot->seq)
+            return 0;
+    return 1;
+}
+
+/* Copy everything the index still needs out of a segment, then start
+ * erasing it */
+static msel_status kv_collect(size_t victim)
+{
+    kv_rec_hdr *hdr = (kv_rec_hdr*)kv_buf;
+    kv_slot    *slot;
+    uint32_t    off;
+    size_t      i;
+    msel_status ret;
+
+    /* One erase at a time, and the flash is no use until it is done */
+    while(kv_erase_poll() == MSEL_EBUSY);
+
+    for(i = 0; i < KV_INDEX_SLOTS; )
+    {
+        slot = &kv_index[i];
+        if(slot->state == KV_SLOT_FREE || slot->seg != victim)
+        {
+            i++;
+            continue;
+        }
+
+        if(slot->state == KV_SLOT_DELETED && kv_tombstone_droppable(slot))
+        {
+            kv_segs[victim].live -= slot->size;
+            kv_index_remove(i);  /* something else may have moved into i */
+            continue;
+        }
+
+        /* Copied as is; the tag doesn't cover where it lives */
+        if((ret=arch_nvm_read(victim, slot->off, hdr, slot->size)) != MSEL_OK ||
+           (ret=kv_write_rec(hdr, slot->size, &off)) != MSEL_OK)
+            return ret;
+
+        kv_segs[victim].live    -= slot->size;
+        kv_segs[kv_active].live += slot->size;
+        slot->seg = kv_active;
+        slot->off = off;
+        i++;
+    }
+
+    return kv_erase_start(victim);
+}
+
+/* The full segment with the least live data, or now and then the least
+ * worn one so that it takes its turn being erased */
+static msel_status kv_gc()
+{
+    size_t      seg, best = KV_NONE, coldest = KV_NONE;
+    uint32_t    most_worn = 0;
+    msel_status ret;
+
+    for(seg = 0; seg < kv_nsegs; seg++)
+    {
+        if(kv_segs[seg].erase_count > most_worn)
+            most_worn = kv_segs[seg].erase_count;
+        if(kv_segs[seg].state != KV_SEG_FULL)
+            continue;
+        if(best == KV_NONE || kv_segs[seg].live < kv_segs[best].live)
+            best = seg;
+        if(coldest == KV_NONE || kv_segs[seg].erase_count < kv_segs[coldest].erase_count)
+            coldest = seg;
+    }
+
+    if(coldest != KV_NONE && kv_segs[coldest].erase_count + KV_WEAR_SPREAD < most_worn &&
+       kv_segs[coldest].live <= kv_seg_size - kv_segs[kv_active].used)
+        best = coldest;
+
+    if(best == KV_NONE || kv_segs[best].live > kv_seg_size - kv_segs[kv_active].used)
+        return MSEL_ENOMEM;
+
+    /* Should power go now, the next boot finishes the job */
+    if((ret=kv_write_seg_field(best, 3, 0)) != MSEL_OK)
+        return ret;
+    kv_segs[best].retiring = 1;
+
+    return kv_collect(best);
+}
+
+/* Move on from a full active segment, keeping one erased segment spare
+ * for the garbage collector */
+static msel_status kv_next_active()
+{
+    size_t      seg;
+    msel_status ret;
+
+    seg = kv_least_worn_erased();
+    if(seg == KV_NONE)
+        return MSEL_ENOMEM;
+
+    kv_segs[kv_active].state = KV_SEG_FULL;
+    if((ret=kv_activate(seg)) != MSEL_OK)
+        return ret;
+
+    while(!kv_have_spare())
+        if((ret=kv_gc()) != MSEL_OK)
+            return ret;
+    return MSEL_OK;
+}
+
+/* Read every record header in a segment into the index. A key that
+ * doesn't fit in the index fails the whole load, since garbage
+ * collection would otherwise drop its record without a trace. */
+static msel_status kv_scan(size_t seg)
+{
+    kv_rec_hdr  hdr;
+    uint32_t    off = sizeof(kv_seg_hdr), size;
+    msel_status ret;
+
+    while(off + sizeof(hdr) <= kv_seg_size)
+    {
+        if(arch_nvm_read(seg, off, &hdr, sizeof(hdr)) != MSEL_OK)
+        {
+            off = kv_seg_size;
+            break;
+        }
+
+        /* The rest is erased */
+        if(hdr.magic == (uint16_t)KV_ERASED32)
+            break;
+
+        /* Garbage (a torn write); don't append after it */
+        size = KV_REC_SIZE(hdr.key_len, hdr.val_len);
+        if(hdr.magic != KV_REC_MAGIC || hdr.key_len > MSEL_KV_KEY_MAX ||
+           hdr.val_len > MSEL_KV_VAL_MAX || off + size > kv_seg_size)
+        {
+            off = kv_seg_size;
+            break;
+        }
+
+        /* Never reuse a sequence number, even from an unfinished record */
+        if(hdr.seq >= kv_seq)
+            kv_seq = hdr.seq + 1;
+
+        if(!(hdr.flags & KV_FLAG_COMMIT))
+        {
+            if((ret=kv_index_apply(&hdr, seg, off, size)) != MSEL_OK)
+                return ret;
+            if(hdr.seq < kv_segs[seg].min_seq)
+                kv_segs[seg].min_seq = hdr.seq;
+        }
+        off += size;
+    }
+
+    kv_segs[seg].used = off;
+    return MSEL_OK;
+}
+
+static msel_status kv_load()
+{
+    kv_seg_hdr  shdr;
+    uint8_t     blank[KV_SEGS_MAX];
+    uint32_t    most_worn = 0;
+    size_t      seg, pass, best;
+    msel_status ret;
+
+    kv_nsegs    = arch_nvm_segments();
+    kv_seg_size = arch_nvm_segment_size();
+    if(kv_nsegs > KV_SEGS_MAX)
+        kv_nsegs = KV_SEGS_MAX;
+
+    /* An active segment, one being collected and one spare */
+    if(kv_nsegs < 3 || kv_seg_size < sizeof(kv_seg_hdr) + KV_REC_MAX)
+        return MSEL_ENOTIMPL;
+
+    /* Left over from a load that failed part way */
+    while(kv_erase_poll() == MSEL_EBUSY);
+
+    msel_memset(kv_index, 0, sizeof(kv_index));
+    msel_memset(kv_segs, 0, sizeof(kv_segs));
+    kv_index_used = 0;
+    kv_seq = 0;
+    kv_gen = 0;
+
+    for(seg = 0; seg < kv_nsegs; seg++)
+    {
+        kv_segs[seg].min_seq = KV_ERASED32;
+        blank[seg] = arch_nvm_read(seg, 0, &shdr, sizeof(shdr)) != MSEL_OK ||
+                     shdr.magic != KV_SEG_MAGIC;
+        if(blank[seg])
+            continue;
+
+        kv_segs[seg].erase_count = shdr.erase_count;
+        kv_segs[seg].gen         = shdr.gen == KV_ERASED32 ? 0 : shdr.gen;
+        kv_segs[seg].retiring    = shdr.retiring != KV_ERASED32;
+        if(shdr.erase_count > most_worn)
+            most_worn = shdr.erase_count;
+        if(kv_segs[seg].gen > kv_gen)
+            kv_gen = kv_segs[seg].gen;
+    }
+
+    /* Scan segments that were being collected last, so that the copies
+     * already made of their records win */
+    for(pass = 0; pass < 2; pass++)
+        for(seg = 0; seg < kv_nsegs; seg++)
+            if(!blank[seg] && kv_segs[seg].retiring == pass)
+                if((ret=kv_scan(seg)) != MSEL_OK)
+                    return ret;
+
+    /* Never used (or the header was lost): start it off as worn as the
+     * worst, since its real count is unknown */
+    for(seg = 0; seg < kv_nsegs; seg++)
+    {
+        if(blank[seg])
+        {
+            if((ret=kv_format(seg, most_worn)) != MSEL_OK)
+                return ret;
+        }
+        else
+        {
+            kv_segs[seg].state = kv_segs[seg].gen ? KV_SEG_FULL : KV_SEG_ERASED;
+        }
+    }
+
+    /* Carry on in the most recently activated segment with room left */
+    best = KV_NONE;
+    for(seg = 0; seg < kv_nsegs; seg++)
+        if(kv_segs[seg].state == KV_SEG_FULL && !kv_segs[seg].retiring &&
+           kv_segs[seg].used + KV_REC_MAX <= kv_seg_size &&
+           (best == KV_NONE || kv_segs[seg].gen > kv_segs[best].gen))
+            best = seg;
+
+    if(best != KV_NONE)
+    {
+        kv_segs[best].state = KV_SEG_ACTIVE;
+        kv_active = best;
+    }
+    else
+    {
+        best = kv_least_worn_erased();
+        if(best == KV_NONE)
+            return MSEL_ENOMEM;
+        if((ret=kv_activate(best)) != MSEL_OK)
+            return ret;
+    }
+
+    /* Finish garbage collection cut short by a reset */
+    for(seg = 0; seg < kv_nsegs; seg++)
+        if(kv_segs[seg].retiring && seg != kv_active)
+            if((ret=kv_collect(seg)) != MSEL_OK)
+                return ret;
+
+    while(!kv_have_spare())
+        if((ret=kv_gc()) != MSEL_OK)
+            return ret;
+
+    return MSEL_OK;
+}
+
+static msel_status kv_ready()
+{
+    uint8_t     mkey[MASTER_KEY_SIZE];
+    kv_sha_ctx  ctx;
+    msel_status ret;
+
+    if(kv_loaded)
+        return MSEL_OK;
+
+    if((ret=msel_master_key_read(mkey)) != MSEL_OK)
+        return ret;
+
+    kv_sha_init(&ctx);
+    kv_sha_update(&ctx, "msel kv", 7);
+    kv_sha_update(&ctx, mkey, sizeof(mkey));
+    kv_sha_final(&ctx, kv_root);
+    msel_memset(mkey, 0, sizeof(mkey));
+
+    if((ret=kv_load()) != MSEL_OK)
+        return ret;
+
+    kv_loaded = 1;
+    return MSEL_OK;
+}
+
+/* Sleep until no erase is in flight, then msel_main restarts the
+ * syscall */
+static msel_status kv_sleep(msel_svc_number svcnum, msel_kv_args *args)
+{
+    msel_active_task->wait_op         = MSEL_TASK_WAIT_KV;
+    msel_active_task->state.kv.svcnum = svcnum;
+    msel_active_task->state.kv.args   = args;
+    msel_task_schedule();
+    return MSEL_ESUSP;
+}
+
+/* The store can't be read or written while a segment is erasing.
+ * msel_main can't sleep, so it waits. */
+static msel_status kv_wait_erase(msel_svc_number svcnum, msel_kv_args *args)
+{
+    if(kv_erase_poll() != MSEL_EBUSY)
+        return MSEL_OK;
+
+    if(msel_active_task_num != 0)
+        return kv_sleep(svcnum, args);
+
+    while(kv_erase_poll() == MSEL_EBUSY);
+    return MSEL_OK;
+}
+
+void msel_kv_worker()
+{
+    kv_erase_poll();
+}
+
+int msel_kv_erasing()
+{
+    return kv_erasing != KV_NONE;
+}
+
+/*** System calls ***/
+
+static inline int kv_key_valid(const msel_kv_args *args)
+{
+    return args->key != NULL && args->key_len > 0 && args->key_len <= MSEL_KV_KEY_MAX;
+}
+
+/* Records may replace one another, but two segments are kept back: one
+ * to write into and one for the garbage collector to empty */
+static int kv_fits(const kv_slot *old, uint32_t size)
+{
+    uint32_t live = 0;
+    size_t   seg;
+
+    for(seg = 0; seg < kv_nsegs; seg++)
+        live += kv_segs[seg].live;
+    if(old->state != KV_SLOT_FREE)
+        live -= old->size;
+
+    return live + size <= (kv_nsegs - 2) * (kv_seg_size - sizeof(kv_seg_hdr));
+}
+
+/* Encrypt and append a record for the active task's namespace. val is
+ * NULL for a tombstone. */
+static msel_status kv_append(const kv_ns *ns, uint32_t id, const msel_kv_args *args,
+                             const void *val, size_t val_len)
+{
+    kv_rec_hdr *hdr  = (kv_rec_hdr*)kv_buf;
+    uint8_t    *body = (uint8_t*)(hdr + 1);
+    uint32_t    size = KV_REC_SIZE(args->key_len, val_len);
+    uint32_t    off;
+    msel_status ret;
+
+    /* Make room first, garbage collection needs kv_buf. Once it has
+     * started an erase, a task sleeps and tries again (MSEL_EBUSY). */
+    if(kv_segs[kv_active].used + size > kv_seg_size)
+    {
+        if((ret=kv_next_active()) != MSEL_OK)
+            return ret;
+        if(kv_erasing != KV_NONE && msel_active_task_num != 0)
+            return MSEL_EBUSY;
+        while(kv_erase_poll() == MSEL_EBUSY);
+    }
+
+    msel_memset(kv_buf, 0xff, size);
+    hdr->magic    = KV_REC_MAGIC;
+    hdr->flags    = val ? 0xff : (uint8_t)~KV_FLAG_LIVE;
+    hdr->key_len  = args->key_len;
+    hdr->val_len  = val_len;
+    hdr->reserved = 0;
+    hdr->seq      = kv_seq++;
+    hdr->ns       = ns->id;
+    hdr->id       = id;
+
+    msel_memcpy(body, args->key, args->key_len);
+    if(val)
+        msel_memcpy(body + args->key_len, val, val_len);
+    kv_ctr(ns, hdr, body, args->key_len + val_len);
+    kv_tag(ns, hdr, hdr->tag);
+
+    if((ret=kv_write_rec(hdr, size, &off)) == MSEL_OK)
+        ret = kv_index_apply(hdr, kv_active, off, size);
+
+    msel_memset(kv_buf, 0, size);
+    return ret;
+}
+
+/* Read, check and decrypt a slot's record into kv_buf, which the
+ * caller wipes. MSEL_EBADF if it is for another key with the same id. */
+static msel_status kv_read_rec(const kv_ns *ns, const kv_slot *slot, const msel_kv_args *args)
+{
+    kv_rec_hdr *hdr  = (kv_rec_hdr*)kv_buf;
+    uint8_t    *body = (uint8_t*)(hdr + 1);
+    uint8_t     tag[8];
+    msel_status ret;
+
+    if((ret=arch_nvm_read(slot->seg, slot->off, kv_buf, slot->size)) != MSEL_OK)
+        return ret;
+
+    kv_tag(ns, hdr, tag);
+    if(msel_memcmp(tag, hdr->tag, sizeof(tag)) != 0)
+        return MSEL_EUNKNOWN;
+
+    /* Decrypted in place; the key is checked in case another key
+     * hashed to the same id */
+    kv_ctr(ns, hdr, body, hdr->key_len + hdr->val_len);
+    if(hdr->key_len != args->key_len || msel_memcmp(body, args->key, args->key_len) != 0)
+        return MSEL_EBADF;
+    return MSEL_OK;
+}
+
+msel_status msel_kv_do_put(msel_kv_args *args)
+{
+    kv_ns       ns;
+    kv_slot    *slot;
+    uint32_t    id;
+    msel_status ret;
+
+    if(!kv_key_valid(args) || args->val == NULL || args->val_len > MSEL_KV_VAL_MAX)
+        return MSEL_EINVAL;
+
+    if((ret=kv_ready()) != MSEL_OK ||
+       (ret=kv_wait_erase(MSEL_SVC_KV_PUT, args)) != MSEL_OK)
+        return ret;
+
+    kv_namespace(&ns);
+    id   = kv_key_id(&ns, args->key, args->key_len);
+    slot = &kv_index[kv_index_find(ns.id, id)];
+
+    /* Only replace a live record if it really is for this key. The
+     * index can't hold two keys with one id, so the other one wins. */
+    if(slot->state == KV_SLOT_LIVE)
+    {
+        ret = kv_read_rec(&ns, slot, args);
+        msel_memset(kv_buf, 0, sizeof(kv_buf));
+        if(ret == MSEL_EBADF)
+            ret = MSEL_EEXIST;
+        if(ret != MSEL_OK)
+            goto done;
+    }
+
+    if(slot->state == KV_SLOT_FREE && kv_index_used >= KV_INDEX_SLOTS - 1)
+        ret = MSEL_ERESOURCE;
+    else if(!kv_fits(slot, KV_REC_SIZE(args->key_len, args->val_len)))
+        ret = MSEL_ENOMEM;
+    else
+        ret = kv_append(&ns, id, args, args->val, args->val_len);
+
+done:
+    msel_memset(&ns, 0, sizeof(ns));
+    if(ret == MSEL_EBUSY)
+        ret = kv_sleep(MSEL_SVC_KV_PUT, args);
+    return ret;
+}
+
+msel_status msel_kv_do_get(msel_kv_args *args)
+{
+    kv_rec_hdr *hdr  = (kv_rec_hdr*)kv_buf;
+    uint8_t    *body = (uint8_t*)(hdr + 1);
+    kv_ns       ns;
+    kv_slot    *slot;
+    msel_status ret;
+
+    if(!kv_key_valid(args))
+        return MSEL_EINVAL;
+
+    if((ret=kv_ready()) != MSEL_OK ||
+       (ret=kv_wait_erase(MSEL_SVC_KV_GET, args)) != MSEL_OK)
+        return ret;
+
+    kv_namespace(&ns);
+    slot = &kv_index[kv_index_find(ns.id, kv_key_id(&ns, args->key, args->key_len))];
+
+    if(slot->state != KV_SLOT_LIVE)
+    {
+        ret = MSEL_EBADF;
+        goto done;
+    }
+
+    if((ret=kv_read_rec(&ns, slot, args)) != MSEL_OK)
+        goto done;
+
+    if(args->val == NULL || args->val_len < hdr->val_len)
+    {
+        ret = MSEL_ENOMEM;
+    }
+    else
+    {
+        msel_memcpy(args->val, body + hdr->key_len, hdr->val_len);
+        ret = MSEL_OK;
+    }
+    args->val_len = hdr->val_len;
+
+done:
+    msel_memset(kv_buf, 0, sizeof(kv_buf));
+    msel_memset(&ns, 0, sizeof(ns));
+    return ret;
+}
+
+msel_status msel_kv_do_delete(msel_kv_args *args)
+{
+    kv_ns       ns;
+    kv_slot    *slot;
+    uint32_t    id;
+    msel_status ret;
+
+    if(!kv_key_valid(args))
+        return MSEL_EINVAL;
+
+    if((ret=kv_ready()) != MSEL_OK ||
+       (ret=kv_wait_erase(MSEL_SVC_KV_DELETE, args)) != MSEL_OK)
+        return ret;
+
+    kv_namespace(&ns);
+    id   = kv_key_id(&ns, args->key, args->key_len);
+    slot = &kv_index[kv_index_find(ns.id, id)];
+
+    /* The tombstone is no bigger than the record it replaces, so it
+     * always fits. It must be this key's record it replaces, though. */
+    if(slot->state != KV_SLOT_LIVE)
+    {
+        ret = MSEL_EBADF;
+    }
+    else
+    {
+        ret = kv_read_rec(&ns, slot, args);
+        msel_memset(kv_buf, 0, sizeof(kv_buf));
+        if(ret == MSEL_OK)
+            ret = kv_append(&ns, id, args, NULL, 0);
+    }
+
+    msel_memset(&ns, 0, sizeof(ns));
+    if(ret == MSEL_EBUSY)
+        ret = kv_sleep(MSEL_SVC_KV_DELETE, args);
+    return ret;
+}
+
+msel_status msel_kv_put(const void *key, size_t key_len, const void *val, size_t val_len)
+{
+    msel_kv_args args;
+
+    args.key     = key;
+    args.key_len = key_len;
+    args.val     = (void*)val;
+    args.val_len = val_len;
+    return msel_svc(MSEL_SVC_KV_PUT, &args);
+}
+
+msel_status msel_kv_get(const void *key, size_t key_len, void *val, size_t *val_len)
+{
+    msel_kv_args args;
+    msel_status  ret;
+
+    if(!val_len)
+        return MSEL_EINVAL;
+
+    args.key     = key;
+    args.key_len = key_len;
+    args.val     = val;
+    args.val_len = *val_len;
+    ret = msel_svc(MSEL_SVC_KV_GET, &args);
+    if(ret == MSEL_OK || ret == MSEL_ENOMEM)
+        *val_len = args.val_len;
+    return ret;
+}
+
+msel_status msel_kv_delete(const void *key, size_t key_len)
+{
+    msel_kv_args args;
+
+    args.key     = key;
+    args.key_len = key_len;
+    args.val     = NULL;
+    args.val_len = 0;
+    return msel_svc(MSEL_SVC_KV_DELETE, &args);
+}
@@ -0,0 +1,53 @@
+/** @file kvstore.h */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MSEL_DRIVER_KVSTORE_H_
+#define _MSEL_DRIVER_KVSTORE_H_
+
+#include <msel.h>
+#include <msel/kv.h>
+#include <msel/syscalls.h>
+
+/* Kernel side of the key-value store (see include/msel/kv.h), kept on
+ * the storage behind arch_nvm_*. The index is built by one pass over
+ * the log the first time the store is used after a reset. */
+
+/** @brief Most keys (including recently deleted ones) the index holds */
+#define KV_INDEX_SLOTS 64
+
+/** @brief Erase count difference at which garbage collection moves
+    cold data off the least worn segment */
+#define KV_WEAR_SPREAD 16
+
+/** @brief What a task sleeping in MSEL_TASK_WAIT_KV asked for */
+typedef struct {
+    msel_svc_number svcnum;
+    msel_kv_args*   args;
+} msel_ws_kv;
+
+msel_status msel_kv_do_put(msel_kv_args *args);
+msel_status msel_kv_do_get(msel_kv_args *args);
+msel_status msel_kv_do_delete(msel_kv_args *args);
+
+/** @brief Finish a garbage collection erase once the flash is done
+    with it. Called from msel_svc_worker. */
+void msel_kv_worker();
+
+/** @brief Whether calls sleeping in MSEL_TASK_WAIT_KV must wait on */
+int msel_kv_erasing();
+
+#endif
@@ -17,11 +17,195 @@
 #include <msel/syscalls.h>
 #include <msel/mtc.h>
 
+#include "os/task.h"
+#include "mtc.h"
 #include "arch.h"
 
+/* The flash is written while the calling task sleeps. Only one
+ * reservation is in progress at a time; it belongs to mtc_owner and the
+ * other callers wait their turn, in order of arrival. */
+
+#define MTC_NO_OWNER 0xff
+
+static uint8_t  mtc_owner = MTC_NO_OWNER;
+static uint32_t mtc_owner_count; /* what the owner asked for */
+static uint32_t mtc_ticket;
+
+/* Each flash write reserves at least MTC_BLOCK values. Whatever the
+ * caller doesn't need is kept here and handed out from RAM until it
+ * runs out, so most increments never touch the flash. Values still
+ * left at reset are skipped like any other unused reservation. */
+#define MTC_BLOCK 64
+#define MTC_WANT(count) ((count) < MTC_BLOCK ? MTC_BLOCK : (count))
+
+static mtc_t    mtc_block_next;
+static uint32_t mtc_block_left;
+
+static int mtc_from_block(uint32_t count, mtc_t* first)
+{
+    if(count > mtc_block_left)
+        return 0;
+
+    *first = mtc_block_next;
+    mtc_block_next += count;
+    mtc_block_left -= count;
+    return 1;
+}
+
+/* Start a flash reservation for count values plus a new block. The
+ * block is only replaced once the write is done, and everything in it
+ * is below what the write reserves, so values still come out in
+ * increasing order. */
+static msel_status mtc_block_reserve(uint32_t count, mtc_t* first)
+{
+    msel_status ret;
+
+    mtc_owner_count = count;
+    ret = arch_mtc_reserve(MTC_WANT(count), first);
+    if(ret == MSEL_OK)
+    {
+        mtc_block_next = *first + count;
+        mtc_block_left = MTC_WANT(count) - count;
+    }
+    return ret;
+}
+
+static msel_status mtc_block_poll(mtc_t* first)
+{
+    msel_status ret;
+
+    ret = arch_mtc_poll(first);
+    if(ret == MSEL_OK)
+    {
+        mtc_block_next = *first + mtc_owner_count;
+        mtc_block_left = MTC_WANT(mtc_owner_count) - mtc_owner_count;
+    }
+    return ret;
+}
+
+/* Finish a sleeping task's syscall */
+static void mtc_complete(size_t tnum, msel_status ret, mtc_t first)
+{
+    msel_tcb *task = &msel_task_list[tnum];
+
+    /* It may have been killed while it slept; the values are skipped */
+    if(!msel_task_is_waiting(task) || task->wait_op != MSEL_TASK_WAIT_FLASH)
+        return;
+
+    if(ret == MSEL_OK)
+        *task->state.mtc.first = first;
+    arch_task_set_result(task, ret);
+    msel_task_resume(task);
+}
+
+/* The task that has waited longest for its turn, MSEL_TASKS_MAX if none */
+static size_t mtc_oldest_waiter()
+{
+    size_t    tnum, best = MSEL_TASKS_MAX;
+    msel_tcb *task;
+
+    for(tnum = 1; tnum < MSEL_TASKS_MAX; tnum++)
+    {
+        task = &msel_task_list[tnum];
+        if(tnum == mtc_owner || !msel_task_is_waiting(task) ||
+           task->wait_op != MSEL_TASK_WAIT_FLASH)
+            continue;
+
+        if(best == MSEL_TASKS_MAX ||
+           (int32_t)(task->state.mtc.ticket - msel_task_list[best].state.mtc.ticket) < 0)
+            best = tnum;
+    }
+    return best;
+}
+
+/* Wait for the reservation in progress (if any) and hand it over */
+static void mtc_finish_owner(int wait)
+{
+    msel_status ret;
+    mtc_t       first;
+
+    if(mtc_owner == MTC_NO_OWNER)
+        return;
+
+    while((ret = mtc_block_poll(&first)) == MSEL_EBUSY)
+        if(!wait)
+            return;
+
+    mtc_complete(mtc_owner, ret, first);
+    mtc_owner = MTC_NO_OWNER;
+}
+
+void msel_mtc_worker()
+{
+    size_t      tnum;
+    msel_status ret;
+    mtc_t       first;
+
+    mtc_finish_owner(0);
+    if(mtc_owner != MTC_NO_OWNER)
+        return;
+
+    /* Start the next one. Those the block covers, or that fail straight
+     * away, are done. */
+    while((tnum = mtc_oldest_waiter()) != MSEL_TASKS_MAX)
+    {
+        if(mtc_from_block(msel_task_list[tnum].state.mtc.count, &first))
+        {
+            mtc_complete(tnum, MSEL_OK, first);
+            continue;
+        }
+
+        ret = mtc_block_reserve(msel_task_list[tnum].state.mtc.count, &first);
+        if(ret == MSEL_EBUSY)
+        {
+            mtc_owner = tnum;
+            return;
+        }
+        mtc_complete(tnum, ret, first);
+    }
+}
+
+static msel_status mtc_request(uint32_t count, mtc_t* first)
+{
+    msel_status ret;
+
+    if(!first || count == 0)
+        return MSEL_EINVAL;
+
+    if(mtc_from_block(count, first))
+        return MSEL_OK;
+
+    /* msel_main can't sleep, so it waits for the flash instead */
+    if(msel_active_task_num == MSEL_TASK_MAIN)
+    {
+        mtc_finish_owner(1);
+        if(mtc_from_block(count, first))
+            return MSEL_OK;
+        ret = mtc_block_reserve(count, first);
+        while(ret == MSEL_EBUSY)
+            ret = mtc_block_poll(first);
+        return ret;
+    }
+
+    if(mtc_owner == MTC_NO_OWNER && mtc_oldest_waiter() == MSEL_TASKS_MAX)
+    {
+        ret = mtc_block_reserve(count, first);
+        if(ret != MSEL_EBUSY)
+            return ret;
+        mtc_owner = msel_active_task_num;
+    }
+
+    msel_active_task->wait_op            = MSEL_TASK_WAIT_FLASH;
+    msel_active_task->state.mtc.count    = count;
+    msel_active_task->state.mtc.first    = first;
+    msel_active_task->state.mtc.ticket   = mtc_ticket++;
+    msel_task_schedule();
+    return MSEL_ESUSP;
+}
+
 msel_status msel_mtc_read_increment(mtc_t* val)
 {
-    return arch_mtc_read_increment(val);
+    return mtc_request(1, val);
 }
 
 msel_status mtc_read_increment(mtc_t* val)
@@ -31,5 +215,28 @@ msel_status mtc_read_increment(mtc_t* val)
 
 msel_status msel_mtc_write(mtc_t* val)
 {
+    /* Nothing reserved before the write may be handed out after it */
+    mtc_finish_owner(1);
+    mtc_block_left = 0;
     return arch_mtc_write(val);
 }
+
+msel_status msel_mtc_reserve(msel_mtc_reserve_args* args)
+{
+    return mtc_request(args->count, &args->first);
+}
+
+msel_status mtc_reserve(uint32_t count, mtc_t* first)
+{
+    msel_mtc_reserve_args args;
+    msel_status ret;
+
+    if(!first)
+        return MSEL_EINVAL;
+
+    args.count = count;
+    ret = msel_svc(MSEL_SVC_MTC_RESERVE, &args);
+    if(ret == MSEL_OK)
+        *first = args.first;
+    return ret;
+}
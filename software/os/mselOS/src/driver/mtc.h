@@ -20,8 +20,20 @@
 #include <msel.h>
 #include <msel/mtc.h>
 
+/** @brief What a task sleeping in MSEL_TASK_WAIT_FLASH asked for */
+typedef struct {
+    uint32_t count;  /* values to reserve */
+    mtc_t*   first;  /* where the first of them goes */
+    uint32_t ticket; /* order of arrival */
+} msel_ws_mtc;
+
 msel_status msel_mtc_read_increment(mtc_t* val);
 msel_status msel_mtc_write(mtc_t* val);
+msel_status msel_mtc_reserve(msel_mtc_reserve_args* args);
+
+/** @brief Finish a reservation once the flash is done with it and
+    start the next. Called from msel_svc_worker. */
+void msel_mtc_worker();
 
 
 #endif
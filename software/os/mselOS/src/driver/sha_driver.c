@@ -45,5 +45,35 @@ msel_status msel_do_sha(sha_data_t *data)
 #endif
 }
 
+msel_status msel_do_sha_blocks(sha_blocks_t *ctx)
+{
+    if (ctx->block_count > SHA256_BLOCKS_MAX) return MSEL_EINVAL;
+    if (ctx->block_count == 0) return MSEL_OK;
+
+#ifdef USE_SW_SHA2
+    // Convert the IV once for the whole run rather than once a block
+    uint32_t iv32[8];
+    c8to32(ctx->iv, iv32);
+    sha256_transform_blocks(iv32, ctx->din, ctx->block_count);
+    c32to8(iv32, ctx->iv);
+    msel_memset(iv32, 0, sizeof(iv32));
+    return MSEL_OK;
+#else /* USE_SW_SHA2 */
+    // The core takes one block at a time
+    sha_data_t data;
+    msel_status ret = MSEL_OK;
+    uint32_t i;
+    msel_memcpy(data.iv, ctx->iv, sizeof(data.iv));
+    for (i = 0; i < ctx->block_count && ret == MSEL_OK; i++) {
+      msel_memcpy(data.din, ctx->din + i * sizeof(data.din), sizeof(data.din));
+      ret = arch_do_hw_sha(&data);
+    }
+    if (ret == MSEL_OK)
+      msel_memcpy(ctx->iv, data.iv, sizeof(data.iv));
+    msel_memset(&data, 0, sizeof(data));
+    return ret;
+#endif
+}
+
 
 
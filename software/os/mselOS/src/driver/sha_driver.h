@@ -43,6 +43,17 @@
  */
 msel_status msel_do_sha(sha_data_t* ctx);
 
+/** @brief Compute the SHA-256 transform over consecutive blocks of data,
+ *  carrying the IV from one to the next.
+ *  Call this function using the MSEL_SVC_SHA_BLOCKS syscall
+ *
+ *  @param ctx Input/output parameters for SHA
+ *  @return MSEL status value:
+ *    - MSEL_OK for succesful operation
+ *    - MSEL_EINVAL if there are more than SHA256_BLOCKS_MAX blocks
+ */
+msel_status msel_do_sha_blocks(sha_blocks_t* ctx);
+
 /** @} */
 
 /** @} */
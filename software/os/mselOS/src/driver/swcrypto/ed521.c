@@ -92,6 +92,283 @@ const uint32_t ED521_order[ED521_LIMBS] = {
 	0x0000007f
 };
 
+/* Fixed-base comb for point_scalar_base: bit k * ED521_COMB_SPACING + i
+ * of the scalar is tooth k of column i, so each of the
+ * ED521_COMB_SPACING columns costs one doubling and one addition of a
+ * table entry. 5 * 109 covers all 544 bits of a scalar. */
+#define ED521_COMB_TEETH   5
+#define ED521_COMB_SPACING 109
+
+/* ED521_comb[i] is the sum of 2^(ED521_COMB_SPACING * k) * G over the
+ * bits k set in i, in affine coordinates (x, y) */
+static const uint32_t ED521_comb[1 << ED521_COMB_TEETH][2][ED521_LIMBS] = {
+	{
+		{ 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		  0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		  0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+		{ 0x00000001, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		  0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		  0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000 }
+	},
+	{
+		{ 0x2f19ba6c, 0x302a940a, 0x364838aa, 0x59d0fb13, 0x8fc99c60, 0xae949d56,
+		  0xc72434b1, 0xf6ecc5cc, 0xc6203913, 0x8bf3c9c0, 0xc6c818ec, 0xbfd9f42f,
+		  0x6b2878a3, 0xf90cb229, 0x648b189d, 0x2cb45c48, 0x00000075 },
+		{ 0x0000000c, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		  0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		  0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000 }
+	},
+	{
+		{ 0x4d9bd251, 0x262fe422, 0x163a47a9, 0x73d6b2d0, 0xe7146e7e, 0xf92e1a77,
+		  0xffa991b9, 0x58db916c, 0x2ce790db, 0x54a0e7cd, 0xed213457, 0x83da7282,
+		  0x22959b37, 0xc42713c9, 0x7b5b5847, 0xdf2d8a4d, 0x000000ee },
+		{ 0xedceee0d, 0xc75bc7c9, 0xe4f4c64c, 0xede9e5c1, 0xc02d179c, 0x6da9888c,
+		  0x32bd4486, 0x9ba09547, 0x4af42c7a, 0xd837bba1, 0x773f74d2, 0x8b12686a,
+		  0x4437fc86, 0xceff8a01, 0x002e7cf1, 0x9f3025f1, 0x000001d7 }
+	},
+	{
+		{ 0x4b6132e6, 0x4cd38c5c, 0x45839a06, 0x88e7812e, 0x8ee1e9df, 0x5b4efc09,
+		  0xc52c2591, 0x4ea42264, 0xea3499db, 0xeb354e42, 0xfe555210, 0x69e5ec14,
+		  0xe0620fa4, 0x5c4e8234, 0x150f644b, 0x0dbf9eba, 0x000000f2 },
+		{ 0x4def35a9, 0x5be6954f, 0x5020dbc2, 0x4d367ce3, 0xa822a349, 0x94e8249a,
+		  0xc32d8365, 0x279aaa71, 0xcb8f012a, 0x58fcd9e5, 0x3a7b7f55, 0x2b6151d9,
+		  0xe527891d, 0x5b91ce5e, 0xf0c6be05, 0x537e493b, 0x00000184 }
+	},
+	{
+		{ 0x9ba2f9f2, 0xedee2436, 0x32586a37, 0xb40aeb68, 0xcf3da400, 0x9e4f13b7,
+		  0x620de681, 0x7e936251, 0x6153e0ed, 0xc3b36d59, 0x6c9b7d40, 0xe60c00ed,
+		  0x0bdfe193, 0xab7918ef, 0x21dfba2b, 0x067ce60c, 0x00000149 },
+		{ 0xf26f9c2d, 0x081e59a8, 0x8d776336, 0xa00255c2, 0x2b0b3f1e, 0xf76e188c,
+		  0x56ff124b, 0x52cbadda, 0xd615489b, 0x63c95156, 0x6a460c5b, 0x09b3c67d,
+		  0xfe39d5ed, 0x7a3dd91a, 0x5b8a9d32, 0xcb2d3435, 0x000001b0 }
+	},
+	{
+		{ 0x5434aaf8, 0x55d3e24d, 0xb3acc4c4, 0x17c1d0d2, 0x0c1f1bd3, 0x8a74f679,
+		  0x4f7d47ac, 0x1ea8d190, 0x20d78c40, 0x14b4359c, 0xa8860d8a, 0x3440530f,
+		  0x70083e95, 0xcf29e285, 0x7812978e, 0xa3601951, 0x0000004d },
+		{ 0x22a5cb18, 0x743305cf, 0x6890e022, 0xb0d37c24, 0x4d527e86, 0x51447c50,
+		  0x3f1d9134, 0x3064efb5, 0x548c4b0f, 0x779ae86f, 0xabf593f1, 0x1f3b8ddd,
+		  0x9991b7d5, 0x07aba52f, 0x6f22d62f, 0x5faffc93, 0x000000ca }
+	},
+	{
+		{ 0x6976e335, 0x9bef8596, 0x06070e50, 0x5fc9697f, 0x28c05b74, 0x79860264,
+		  0x13385edb, 0xf72d51db, 0x6d7400ff, 0x6c5e98fb, 0xd2a63e45, 0xa68d7572,
+		  0x18d4fca7, 0x72acb37d, 0x648c30fc, 0xeba953af, 0x000000c0 },
+		{ 0xe8e04f71, 0x51946a83, 0x6a8fe532, 0x964f0e71, 0xe2ccae24, 0x41dd6d04,
+		  0x5c9de632, 0x996d71d6, 0x75daad24, 0xd8d96fe1, 0x0fb0ba53, 0x07c9dae8,
+		  0x4acd166c, 0xbc73dabc, 0xea840dc1, 0xf5ce7099, 0x00000105 }
+	},
+	{
+		{ 0xb183ffc5, 0x7510a965, 0xe273711b, 0x86dbf9ad, 0xdb2e699e, 0x83e50662,
+		  0x30541508, 0x73fc4581, 0xe151fdb7, 0x987c3cf4, 0xe8b29294, 0xf5691864,
+		  0x1c908882, 0x9588edc9, 0xfce186ab, 0xf8e1e24e, 0x000000ea },
+		{ 0x11f5377b, 0xe63218b3, 0x9db1c3cf, 0xcbb7534d, 0xab44e8e1, 0x3f7df6f6,
+		  0xc0ba0c52, 0xd025718c, 0xecde673c, 0x4747b85c, 0x15636aac, 0x718b85e1,
+		  0xa6abde95, 0x61e49a47, 0x8a32b24d, 0xd29d0da1, 0x00000174 }
+	},
+	{
+		{ 0x89dc34a7, 0x3501f5e7, 0x65ab3e9e, 0x8208e5cd, 0x6d86abcf, 0xfb1276f6,
+		  0x150bd42e, 0x3d30a63c, 0x8071614f, 0x240dc330, 0x73067d06, 0x6fa95a24,
+		  0x97b9fb9d, 0x496b1eee, 0x12fc8f46, 0x117a59d4, 0x00000050 },
+		{ 0x0c698071, 0x2e8e61b0, 0xa7e43bbc, 0xadf8222a, 0xdb96e365, 0x3b41d738,
+		  0xa6af1d72, 0xecca5cdd, 0xf99f2e34, 0x84bd5e2f, 0xbd8a179c, 0x2d93c2f1,
+		  0x72b0a299, 0x986b4693, 0xcb940dc4, 0x402b6920, 0x00000168 }
+	},
+	{
+		{ 0x83a22f52, 0x42b3401d, 0xe14b06b6, 0x1e78a8d4, 0x7e4e179a, 0x2a985cef,
+		  0x98e59c6d, 0xdbd40dc3, 0x37fed981, 0xd55c7ae2, 0x8811d631, 0x18b733d5,
+		  0x02453c90, 0x9e8b11ce, 0x716093b9, 0x42d01697, 0x000001e9 },
+		{ 0x0f40aa47, 0xc2733bab, 0x11940477, 0x124385d0, 0xb1978020, 0x6aaf056a,
+		  0xd3df928b, 0x8e4e541b, 0x82fee67d, 0xbfe37747, 0x5daf2859, 0xb8b25576,
+		  0xee2b6069, 0x3a3400fb, 0xd29ab266, 0x01bb2fd8, 0x0000002e }
+	},
+	{
+		{ 0x1075c686, 0xaa51ad25, 0x3db15268, 0x044e8227, 0xb5e4e45f, 0xf672bbbc,
+		  0x4e138c6b, 0xb55e9828, 0x4415eb0d, 0xb340356a, 0x8efae610, 0xf567d20a,
+		  0xc0685317, 0x779fa3f4, 0x78676a7c, 0x34a6b175, 0x00000164 },
+		{ 0xc1dd46da, 0xca07ea0f, 0x28685540, 0xb59545c0, 0x5ebbb4dd, 0xd2b7a1fc,
+		  0xb796bf94, 0xb187cab5, 0x5e7a01f8, 0x3a02afb9, 0xa0094d7b, 0x156dd6ac,
+		  0x9a640461, 0x45dcf692, 0xf8c9a9fb, 0x78bbe27a, 0x0000000a }
+	},
+	{
+		{ 0x7ddd78a0, 0x04132df9, 0x3136d146, 0xf7161bdb, 0xd729e532, 0x36531508,
+		  0x95bcb4a9, 0x8f9c31b6, 0xa59a3593, 0xd70cedee, 0x2afe8ce2, 0xd22355aa,
+		  0x5c1ec5a4, 0x3451cd7b, 0x96e1e824, 0x706e8364, 0x0000011b },
+		{ 0xf63c4adb, 0x3e364b94, 0x20dbd4ee, 0x4e95cea1, 0xa75555fc, 0xa1ebabe9,
+		  0xa4ec5200, 0xe934bf63, 0x1c7976b8, 0x9223d876, 0x40ac318e, 0xa9aa8b91,
+		  0xbc8efadc, 0x9afcd7ed, 0xad1beb77, 0xaff00305, 0x000000cb }
+	},
+	{
+		{ 0x22aff7da, 0x47c2ae34, 0xf7a2199b, 0xdff8b8a6, 0x124489d3, 0xf5180499,
+		  0x76aad70d, 0xd636b15c, 0x1cf9580d, 0xb88de265, 0xa5aec596, 0x79b84080,
+		  0x492d2439, 0x5b9b08f1, 0x5beabb31, 0xaef3fab9, 0x0000007f },
+		{ 0xdb380072, 0x8b44ae83, 0x5a038e9b, 0xeb930bbe, 0x9569fe44, 0xb11da608,
+		  0x31bc90a9, 0xd484ff8f, 0xcd717445, 0xf363c527, 0x3b71e18d, 0x7c762321,
+		  0x9f830502, 0xe1f23aee, 0x26c4ead3, 0xbf616af1, 0x000001b8 }
+	},
+	{
+		{ 0xa7e96259, 0x8ba3b9ba, 0xc98d77c9, 0xe5f2acb2, 0x72f000e3, 0x751a8637,
+		  0xb273da61, 0x814dba85, 0x2e6832e5, 0xf34a3c65, 0xb3964189, 0x617a5b9b,
+		  0x9ffb4450, 0x4581a5cd, 0x86f68fcf, 0xe1e6114b, 0x0000011a },
+		{ 0x7ac011b3, 0xb4a4b422, 0xc2dea648, 0xa3ba3e3c, 0x7a7ce252, 0x6d4666f5,
+		  0x86880769, 0xddb61f9b, 0x5990a595, 0xc4f9384c, 0xd76b9c60, 0xc915b99e,
+		  0x15d14b30, 0xd298ee71, 0x70541686, 0xe0a2d0b9, 0x000000fe }
+	},
+	{
+		{ 0xe2b1a3a0, 0x4c87a8e7, 0x663748ce, 0x4e7dc350, 0x4c9c42f3, 0xc9891b28,
+		  0x9707d4c6, 0x19db4b9d, 0x6b00d427, 0xcca314e0, 0x0d4cc377, 0xf23373a9,
+		  0x75249310, 0x8051915c, 0x593f3830, 0xdc49dfd5, 0x000001b8 },
+		{ 0x07ea030f, 0x96a288c4, 0x8de8d086, 0x0df0f1c7, 0x8349afaf, 0x601db176,
+		  0x0abde415, 0x48651ed6, 0x131fd12b, 0xe6f1e79e, 0x7cc4ad83, 0x9440a729,
+		  0xc1da173f, 0xc5aac91b, 0x414c86bf, 0xfc1f8e22, 0x000000d8 }
+	},
+	{
+		{ 0x74f4d6b4, 0x7c5c977e, 0x7ea149b7, 0x49db943c, 0x89ff86ab, 0xe516975c,
+		  0xd6f2a65e, 0x746fca6e, 0x9f3d6092, 0xb6426ebc, 0xd0846075, 0xc6acf068,
+		  0x214dc432, 0x1c9e3809, 0x4b0cc408, 0xb2c158dc, 0x000001e3 },
+		{ 0xecae6c1f, 0x4ff328e6, 0x14e5bb4c, 0x06132ef5, 0x3e741150, 0x4994441f,
+		  0x0f7f5f10, 0xb55f8440, 0x50d904c7, 0xd7fbcbf2, 0x1a2cf4ae, 0x2bc61fc3,
+		  0x2cbe5bca, 0xedee1828, 0x31ea84c3, 0x502bf7a6, 0x000001d0 }
+	},
+	{
+		{ 0x1a9134ee, 0x1d54b2f8, 0x4b67a024, 0x13ea948e, 0x3b211e5f, 0xb92db77c,
+		  0x31290958, 0xebb23629, 0x0b27b7b3, 0x80fff53c, 0xe944acac, 0x68ca1d0e,
+		  0xf6ebd107, 0xfc7c04f0, 0x29623348, 0x716df8b6, 0x0000002d },
+		{ 0xcbbc9919, 0xcc6355b9, 0x821de0c4, 0x758ad437, 0x6dc3f45b, 0xc18dfbbe,
+		  0xc9399598, 0xce8a49a6, 0xd1d033c6, 0x1f22ba3a, 0x91dc48c3, 0x28b80e91,
+		  0xa157d22b, 0xf097435a, 0x52c4bd30, 0x276e5a82, 0x000000a9 }
+	},
+	{
+		{ 0x1c73cd6c, 0x71f60bf2, 0xfb19e399, 0xae5d40e6, 0xec16c7d5, 0x0257dbe1,
+		  0x4a517072, 0x0399962f, 0x3d120440, 0xa46113cf, 0x621506d8, 0x3537e61f,
+		  0x0fb53fd9, 0x0161c125, 0x773b28c6, 0x450c5c5e, 0x000000fc },
+		{ 0xd53c83e4, 0x696aa25b, 0xcc186011, 0xb99f7301, 0xa823e887, 0x7a334ae2,
+		  0xf40eb9f5, 0x6086c2b7, 0xea24e866, 0x07bf2e66, 0x669ef285, 0xdcea2e5a,
+		  0x858b51cd, 0xfcb0c54c, 0x94571978, 0xa17509a1, 0x00000166 }
+	},
+	{
+		{ 0x5f3a0cb0, 0xaed37148, 0x25156599, 0xbbeb4a30, 0x65fc0cfb, 0xd05f6640,
+		  0xcdd65376, 0x71ac413f, 0x2b395788, 0xd5cd3d84, 0xaa807c64, 0x75c876b0,
+		  0x9994d17d, 0x8a40c1da, 0xab55876b, 0x75ee1924, 0x000001ac },
+		{ 0xa072ab64, 0xf985c8dd, 0x22d1fa08, 0xa4ec1e70, 0x65c924c1, 0x13d5152c,
+		  0xe727533d, 0x81b9aa68, 0x376ad95d, 0x15982152, 0x0db8617f, 0xf8bf68bb,
+		  0x8160b63e, 0x00659df2, 0xfd3f5108, 0x5bfa5166, 0x0000015c }
+	},
+	{
+		{ 0x20b8872d, 0xf9a2d916, 0xa779a7e2, 0x097291cd, 0xd59c90d5, 0x7621f4fb,
+		  0x39717d67, 0x1e462614, 0xb5f114c2, 0x63d7c74b, 0x792463bd, 0xc2c40263,
+		  0xf22e3ba5, 0x23ebc396, 0x58e51c61, 0xd305a208, 0x000001af },
+		{ 0x2cf76958, 0xe435a09f, 0x5f2c2d25, 0xeeb64d57, 0xea2328cd, 0x5d2501a4,
+		  0xeb6482ec, 0xb5e8bcb7, 0x5530d6c2, 0x6475cd61, 0xdfef4d27, 0xbc2cd299,
+		  0x272f3280, 0x48a2f993, 0x5277992b, 0x1ae38faf, 0x00000033 }
+	},
+	{
+		{ 0x1a7e4fbd, 0x318ffd4f, 0xba27fe3c, 0xab67c47c, 0xcd2f1392, 0x108b7495,
+		  0xd3867e93, 0x09195c33, 0xc788607c, 0x74f2df53, 0xe7ace8a0, 0x381d4695,
+		  0x53f501de, 0xc5b347e6, 0x3a91ab1c, 0x3cd52450, 0x00000028 },
+		{ 0xa05102f7, 0x877a0b6b, 0xe1e9a81c, 0xfb412f7e, 0x60dcc29d, 0x41503cc2,
+		  0xec4f8f9d, 0x520bcbc1, 0x14a85e2a, 0x82083a6d, 0x6e3a3751, 0xb7a09468,
+		  0x9b5741fc, 0x4d8f34e4, 0xc57649df, 0xf981c99d, 0x000000ff }
+	},
+	{
+		{ 0xdfcd845f, 0x1da616a5, 0x8c5ebb3b, 0x5fc8d361, 0x1ba6030c, 0xff59d01c,
+		  0x278d6f14, 0xd59d2ca6, 0x6c8b9bde, 0xec5f8d78, 0xc3ccf600, 0x0e8fc9cd,
+		  0xff08d6ae, 0xc53972c2, 0xa20be1a7, 0x8eee8629, 0x000001a7 },
+		{ 0x921a3a9e, 0xdef72a02, 0xa1eaad74, 0x2d577710, 0xcd70ff65, 0x738878ef,
+		  0x7bdeb582, 0xb252a4f3, 0x68cf3825, 0xf1635a59, 0x590e1a67, 0x76cb6f40,
+		  0x8be305da, 0x1db6b112, 0x775a87c6, 0x8bc118c5, 0x000001a0 }
+	},
+	{
+		{ 0x083342f0, 0x368ab6d2, 0x4f3d8d9b, 0xe71ed33f, 0xdf0596c4, 0x8c5a8b72,
+		  0xb67b5565, 0x426247a2, 0x7fb741f8, 0xb59725de, 0xe88f5271, 0x195f1bdd,
+		  0x431afe3f, 0x0a5b90c1, 0x39a1dd02, 0xb979606a, 0x0000007f },
+		{ 0xe1bec50a, 0x064c106b, 0x3ba6194e, 0x0d742f55, 0x8d1f87c7, 0xf42d777d,
+		  0x03044146, 0xb36c5d97, 0xcd0259d7, 0x49aa68b3, 0xdee6e298, 0x3759160e,
+		  0x9d5fdb1c, 0xaebc8354, 0xf678ca9d, 0x69cb0eba, 0x00000075 }
+	},
+	{
+		{ 0xe189eb74, 0x70f841b1, 0x1a73afe3, 0x85204803, 0x4cd96e7f, 0xd242442a,
+		  0xcb06fe12, 0x825b3edc, 0x4b5e9fee, 0xea27a774, 0x5fe9e224, 0x8c1b09d5,
+		  0x808d69af, 0x0135e231, 0xe8420f83, 0xa7c2a3af, 0x000000e9 },
+		{ 0x4737a72f, 0xb5fd8ec6, 0xde83c660, 0x78acccd1, 0x29d82abc, 0xd2ad6a83,
+		  0xec6cc889, 0x778d040c, 0x80bbacb7, 0xdb6619a2, 0x05b4fdff, 0x5c24d5bc,
+		  0x4ff0b35a, 0x7f444da2, 0x80ab4ed2, 0xc3022e14, 0x000001fe }
+	},
+	{
+		{ 0x63009ec8, 0xaf488eed, 0x12e155b3, 0x47e9f8d0, 0xbcedbb45, 0x7c74ecfd,
+		  0xbf457241, 0xb358032f, 0x867675b3, 0x2a9963d8, 0x4e178a69, 0x4a420543,
+		  0x462af06c, 0xfc7956c6, 0x59188213, 0xf4f30e82, 0x000000c7 },
+		{ 0xd0d1c58d, 0xcb77b855, 0x157d3a97, 0x64b0eeaa, 0x3d70ca98, 0xc54bcdfd,
+		  0x129f0c00, 0xb17a8891, 0xa1239396, 0x93b91ec5, 0x2f28904b, 0x8386edb7,
+		  0x431f9e4e, 0x1b72faee, 0xfd34274d, 0xb83526c3, 0x00000010 }
+	},
+	{
+		{ 0xb8a2b8f3, 0xd55be119, 0x92ba64b7, 0xb36f1182, 0xe6547724, 0x5f693642,
+		  0x63789fd6, 0x10f7ee35, 0xb5cb0dbd, 0xa930ee06, 0x9418719b, 0x20de1a6d,
+		  0x549b822f, 0x748f5ed3, 0xde5fc5a8, 0x85b1dad9, 0x00000036 },
+		{ 0xcc7aced9, 0xfe90f657, 0x0d23337d, 0x0f27ac1a, 0xb6dff402, 0x402ff070,
+		  0x57327fb9, 0x0659813a, 0x10d8d940, 0x8a8e6e6e, 0xeb053635, 0x03d7104b,
+		  0x56e983df, 0x7a5ffb2c, 0xb83d091a, 0x68b957e5, 0x0000007e }
+	},
+	{
+		{ 0xe6e51154, 0xae0f192c, 0xdee64ae0, 0xc570907d, 0xe3974e61, 0x0e583ddb,
+		  0x394ec1d3, 0xcda89d1e, 0x172af6d5, 0xbe145fba, 0x9e43cabd, 0x5c29126c,
+		  0xdb7a6adc, 0x22e73f56, 0xdc5fda39, 0x41f04039, 0x000001a8 },
+		{ 0xb0523705, 0xbf6eba40, 0x94483df2, 0x84b25699, 0x7f8ea56a, 0x228bab73,
+		  0x7cc2d192, 0x2bf9e055, 0x2e062a5a, 0xf03aff8e, 0xe72587c0, 0xe6ad22ab,
+		  0x15ebed45, 0xdb1a619f, 0xc089bbc8, 0x2b8419ea, 0x0000011e }
+	},
+	{
+		{ 0xb0d40822, 0x4bf45327, 0x7592b1c2, 0x9658c558, 0x5385219a, 0x5e139217,
+		  0x7346e9cb, 0x2c189eb6, 0x157a0328, 0x7edc33cf, 0x9a083cdf, 0x2538095a,
+		  0x7cb849c1, 0xe52111ae, 0x74acf08c, 0x0b34e960, 0x00000180 },
+		{ 0x5f6bc3f4, 0x63dfca26, 0xb4fd167d, 0x33c8f517, 0xa3e1d8a2, 0xf1ced4ba,
+		  0xac439f79, 0xc5affa27, 0xcb6be0f2, 0x504bc458, 0x087431bc, 0x1a2e3c59,
+		  0x14ef88a5, 0xf9972942, 0x8a141d46, 0x3a1d121f, 0x000001bd }
+	},
+	{
+		{ 0xa8e6e463, 0x61182250, 0x641c7990, 0xf1f41dd7, 0xbbcfe357, 0x380192d6,
+		  0x78f7f8a3, 0xfba57126, 0xb8b69bf6, 0x932742aa, 0x130329c1, 0x321aa4d7,
+		  0x1fb58881, 0x57fbb6ab, 0xb8f20785, 0x06cb9e70, 0x0000010b },
+		{ 0xc96a81d6, 0x447f9fcc, 0x2112ced0, 0x459f5627, 0x1d31e9c3, 0x2ec8c15d,
+		  0x9b31e36c, 0x937a6095, 0x0ce64677, 0x52c34711, 0xb82c5a71, 0x94651f52,
+		  0x261a08e8, 0xee668a0d, 0x46fb2e80, 0x7c068309, 0x00000054 }
+	},
+	{
+		{ 0xb0ce1873, 0x41ac482a, 0x095aa45e, 0xe52c0c2c, 0xd97a7b13, 0xb3cd2dd3,
+		  0x0255ee46, 0xf27fd46f, 0x497d41fc, 0xc4224b84, 0x4bf0a153, 0x28b09468,
+		  0xfacd9d97, 0xc29d4770, 0x9ed450c8, 0x297d2507, 0x000000ce },
+		{ 0x1ec67d04, 0xe7f857db, 0xe90500f5, 0x1b137c64, 0xb71c9b62, 0xbb1cc14d,
+		  0xc4bf7da5, 0x5fa6f2e9, 0x9b727059, 0xe46e99d7, 0x0f37206a, 0x4f4a57a5,
+		  0x6b7fbd12, 0xfdd7d15d, 0xacc9a4d3, 0xd02be56f, 0x000001b5 }
+	},
+	{
+		{ 0x0f1e6cd1, 0x8ce9920e, 0xd39658a6, 0x339064a1, 0x933cc161, 0x9386d301,
+		  0xf42b3793, 0x0cad57a8, 0xeb0e2b46, 0x3ba3d77e, 0xabcb0374, 0x2ea36777,
+		  0x70b871f4, 0x6ff3ac8f, 0x613f9def, 0xb8cc9be9, 0x00000139 },
+		{ 0x3d357210, 0x21bed160, 0xc75ed522, 0xc0b464a9, 0x06e4d0fe, 0xa5be6635,
+		  0x3125a358, 0x08f667e2, 0xf7314bf1, 0x20c7384c, 0x230ae17c, 0xedc1cd0b,
+		  0xeccc103a, 0x16a481d1, 0x4e577cb0, 0x90cbbc35, 0x00000035 }
+	},
+	{
+		{ 0x543dc58d, 0xbe35d0a9, 0x43ca9ecb, 0x76e31966, 0xf332b646, 0xc0cf5c21,
+		  0xf6e111b0, 0xb656b8a1, 0x9a52ca4c, 0x0b5cabd8, 0x2996c7a9, 0xd46395a3,
+		  0xceee5d83, 0x8f013b9b, 0xe19e0f32, 0xd6fe24e7, 0x0000018b },
+		{ 0x9bab4a47, 0xb621c96d, 0xcfb4f156, 0xf294f488, 0x714824ef, 0xcfb4f227,
+		  0xa62acf66, 0x7c1e2e02, 0x901490e9, 0x520925d3, 0x33917f33, 0x03ba9a75,
+		  0xd321f605, 0x376259b3, 0xd79ab188, 0xcac27e3a, 0x000001a8 }
+	}
+};
+
+
+/* Window width of point_scalar, in bits (a divisor of 32) */
+#define ED521_WINDOW 4
+
+/* The multiples 0 to 2^ED521_WINDOW - 1 of the point point_scalar is
+ * working on. Static rather than on the stack, like the driver's points,
+ * and cleared again afterwards. */
+static ec_point_t point_table[1 << ED521_WINDOW];
+
 
 void make_mp(uint32_t* out, uint8_t* in, unsigned size)
 {
@@ -251,58 +528,155 @@ static void mp_modmul2(uint32_t *d, const uint32_t *a)
 	return;
 }
 
+/* p = 2^521 - 1, so 2^521 = 1 (mod p): the bits of a double-length
+ * product from bit 521 up are folded back down by adding them to the
+ * bits below */
+static void mp_reduce(uint32_t *d, uint32_t *tmp)
+{
+	int i, j;
+
+	for(i = 0, j = ED521_LIMBS - 1; i < ED521_LIMBS; i++, j++)
+		d[i] = (tmp[j] >> 9) + (tmp[j + 1] << (32 - 9));
+	tmp[ED521_LIMBS - 1] &= 0x1ff;
+	mp_modadd(d, d, tmp);
+	return;
+}
+
 static void mp_modmul(uint32_t *d, const uint32_t *a, const uint32_t *b)
 {
-	int i, j, k;
+	int i, k;
 	uint32_t tmp[ED521_LIMBS * 2];
-	uint64_t v;
-
-	for(i = 0; i < sizeof(tmp) / sizeof(tmp[0]); i++)
-		tmp[i] = 0;
+	uint64_t v, p;
+	uint32_t c;
 
-	for(i = 0; i < ED521_LIMBS; i++)
+	/* Product scanning: one output word at a time, summing its column
+	 * of partial products into the 96-bit (c, v) */
+	for(k = 0, v = 0, c = 0; k < ED521_LIMBS * 2 - 1; k++)
 	{
-		for(j = 0, k = i, v = 0; j < ED521_LIMBS; j++, k++)
+		for(i = (k < ED521_LIMBS) ? 0 : k - (ED521_LIMBS - 1); i <= k && i < ED521_LIMBS; i++)
 		{
-			v = (uint64_t) a[i] * b[j] + v + tmp[k];
-			tmp[k] = v;
-			v >>= 32;
+			p = (uint64_t) a[i] * b[k - i];
+			v += p;
+			c += (v < p);
 		}
 		tmp[k] = v;
+		v = (v >> 32) | ((uint64_t) c << 32);
+		c = 0;
 	}
+	tmp[k] = v;
 
-	for(i = 0, j = ED521_LIMBS - 1; i < ED521_LIMBS; i++, j++)
-		d[i] = (tmp[j] >> 9) + (tmp[j + 1] << (32 - 9));
-	tmp[ED521_LIMBS - 1] &= 0x1ff;
-	mp_modadd(d, d, tmp);
+	mp_reduce(d, tmp);
 	return;
 }
 
-/* find a quadratic residue of a mod p */
-static void mp_modsqrt(uint32_t *r1, const uint32_t *a)
+static void mp_modsqr(uint32_t *d, const uint32_t *a)
 {
-	int i;
+	int i, j, k;
+	uint32_t tmp[ED521_LIMBS * 2];
+	uint64_t v, x, p;
+	uint32_t c, xc;
+
+	/* As mp_modmul, but a[i] * a[j] and a[j] * a[i] are the same, so
+	 * each column's cross products are summed once and doubled */
+	for(k = 0, v = 0, c = 0; k < ED521_LIMBS * 2 - 1; k++)
+	{
+		i = (k < ED521_LIMBS) ? 0 : k - (ED521_LIMBS - 1);
+		for(j = k - i, x = 0, xc = 0; i < j; i++, j--)
+		{
+			p = (uint64_t) a[i] * a[j];
+			x += p;
+			xc += (x < p);
+		}
+		xc = (xc << 1) | (uint32_t) (x >> 63);
+		x <<= 1;
+		if((k & 1) == 0)
+		{
+			p = (uint64_t) a[k / 2] * a[k / 2];
+			x += p;
+			xc += (x < p);
+		}
+
+		v += x;
+		c += xc + (v < x);
+		tmp[k] = v;
+		v = (v >> 32) | ((uint64_t) c << 32);
+		c = 0;
+	}
+	tmp[k] = v;
 
-	mp_set(r1, a);
-	for(i = 1; i < 520; i++)
-		mp_modmul(r1, r1, r1);
+	mp_reduce(d, tmp);
 	return;
 }
 
-static void mp_modinv(uint32_t *d, uint32_t *a)
+/* d = a^(2^n) (mod p) */
+static void mp_modsqr_n(uint32_t *d, const uint32_t *a, int n)
+{
+	mp_modsqr(d, a);
+	while(--n > 0)
+		mp_modsqr(d, d);
+	return;
+}
+
+/* d = a * b (mod p) for b below 2^22, which keeps the product within
+ * the 17 words */
+static void mp_modmul_ui(uint32_t *d, const uint32_t *a, const uint32_t b)
 {
 	int i;
-	uint32_t t[ED521_LIMBS];
+	uint64_t v;
+	uint32_t hi;
+
+	for(i = 0, v = 0; i < ED521_LIMBS; i++, v >>= 32)
+	{
+		v = (uint64_t) a[i] * b + v;
+		d[i] = v;
+	}
+
+	/* Fold twice: the first can carry back into bit 521 */
+	hi = d[ED521_LIMBS - 1] >> 9;
+	d[ED521_LIMBS - 1] &= 0x1ff;
+	mp_add_ui(d, d, hi);
+	hi = d[ED521_LIMBS - 1] >> 9;
+	d[ED521_LIMBS - 1] &= 0x1ff;
+	mp_add_ui(d, d, hi);
+	return;
+}
 
-	mp_set(t, a);
-	mp_set(d, a);
+/* find a quadratic residue of a mod p: p = 3 (mod 4), so it is
+ * a^((p + 1) / 4) = a^(2^519) */
+static void mp_modsqrt(uint32_t *r1, const uint32_t *a)
+{
+	mp_modsqr_n(r1, a, 519);
+	return;
+}
 
-	mp_modmul(t, t, t);
-	for(i = 2; i < 521; i++)
+/* d = a^(p - 2) = 1/a (mod p). p - 2 = (2^519 - 1) * 4 + 1, and
+ * x_n = a^(2^n - 1) is built up with x_(m+n) = x_m^(2^n) * x_n, for 520
+ * squarings and 13 multiplications whatever a is */
+static void mp_modinv(uint32_t *d, uint32_t *a)
+{
+	int n;
+	uint32_t x3[ED521_LIMBS], x7[ED521_LIMBS];
+	uint32_t t[ED521_LIMBS], u[ED521_LIMBS];
+
+	mp_modsqr(t, a);
+	mp_modmul(t, t, a);      // x2
+	mp_modsqr(t, t);
+	mp_modmul(x3, t, a);     // x3
+	mp_modsqr(t, x3);
+	mp_modmul(t, t, a);      // x4
+	mp_modsqr_n(t, t, 3);
+	mp_modmul(x7, t, x3);    // x7
+	mp_modsqr(t, x7);
+	mp_modmul(t, t, a);      // x8
+	for(n = 8; n < 512; n *= 2)
 	{
-		mp_modmul(t, t, t);
-		mp_modmul(d, d, t);
+		mp_modsqr_n(u, t, n);
+		mp_modmul(t, u, t);  // x(2n)
 	}
+	mp_modsqr_n(t, t, 7);
+	mp_modmul(t, t, x7);     // x519
+	mp_modsqr_n(t, t, 2);
+	mp_modmul(d, t, a);
 	return;
 }
 
@@ -314,6 +688,15 @@ static void point_set(ec_point_t *d, const ec_point_t *a)
 	return;
 }
 
+/* The neutral element (0, 1) */
+static void point_set_neutral(ec_point_t *d)
+{
+	mp_set_ui(d->x, 0);
+	mp_set_ui(d->y, 1);
+	mp_set_ui(d->z, 1);
+	return;
+}
+
 static int point_make_affine(ec_point_t *d, ec_point_t *a)
 {
 	uint32_t t[ED521_LIMBS];
@@ -332,7 +715,7 @@ int point_uncompress(ec_point_t *p, uint32_t *x, int y_sign)
 
 	ret = 0;
 	mp_set(p->x, x);
-	mp_modmul(p->z, p->x, p->x);
+	mp_modsqr(p->z, p->x);
 
 	/* t = 1/((X^2 * 376014) + 1) (mod P) */
 	mp_set_ui(t, 376014);
@@ -353,7 +736,7 @@ int point_uncompress(ec_point_t *p, uint32_t *x, int y_sign)
 	mp_modsqrt(p->y, t);
 
 	/* check modsqrt */
-	mp_modmul(p->z, p->y, p->y);
+	mp_modsqr(p->z, p->y);
 	if(mp_cmp(p->z, t) != 0)
 		ret = -1;
 
@@ -381,11 +764,11 @@ static void point_double(ec_point_t *d, ec_point_t *a)
 	mp_set(d->y, a->y); // R2 = Y1
 	mp_set(d->z, a->z); // R3 = Z1
 	// R3 = c*R3 : c = 1 for ed521
-	mp_modmul(R4, d->x, d->x); // R4 = R1^2
+	mp_modsqr(R4, d->x); // R4 = R1^2
 	mp_modadd(d->x, d->x, d->y); // R1 = R1 + R2
-	mp_modmul(d->x, d->x, d->x); // R1 = R1^2
-	mp_modmul(d->y, d->y, d->y); // R2 = R2^2
-	mp_modmul(d->z, d->z, d->z); // R3 = R3^2
+	mp_modsqr(d->x, d->x); // R1 = R1^2
+	mp_modsqr(d->y, d->y); // R2 = R2^2
+	mp_modsqr(d->z, d->z); // R3 = R3^2
 	mp_modmul2(d->z, d->z); // R3 = 2 * R3
 	mp_modadd(R4, d->y, R4); // R4 = R2 + R4
 	mp_modmul2(d->y, d->y); // R2 = 2 * R2
@@ -405,7 +788,6 @@ static void point_double(ec_point_t *d, ec_point_t *a)
 
 static void point_add(ec_point_t *d, ec_point_t *a, ec_point_t *b)
 {
-	int i;
 	uint32_t R4[ED521_LIMBS], R5[ED521_LIMBS];
 	uint32_t R7[ED521_LIMBS], R8[ED521_LIMBS];
 
@@ -425,16 +807,12 @@ static void point_add(ec_point_t *d, ec_point_t *a, ec_point_t *b)
 	mp_modsub(R7, R7, d->y); // R7 = R7-R2
 	mp_modmul(R7, R7, d->z); // R7 = R7*R3
 	mp_modmul(R8, d->x, d->y); // R8 = R1*R2
-
-	R4[0] = ED521_P[0] + ED521_D;
-	for(i = 1; i < ED521_LIMBS; i++)
-		R4[i] = ED521_P[i];
-	mp_modmul(R8, R8, R4); // R8 = d*R8
+	mp_modmul_ui(R8, R8, -(ED521_D)); // R8 = -d*R8 : d is small and negative
 	mp_modsub(d->y, d->y, d->x); // R2 = R2-R1
 	mp_modmul(d->y, d->y, d->z); // R2 = R2*R3
-	mp_modmul(d->z, d->z, d->z); // R3 = R3^2
-	mp_modsub(d->x, d->z, R8); // R1 = R3-R8
-	mp_modadd(d->z, d->z, R8); // R3 = R3+R8
+	mp_modsqr(d->z, d->z); // R3 = R3^2
+	mp_modadd(d->x, d->z, R8); // R1 = R3-d*R8
+	mp_modsub(d->z, d->z, R8); // R3 = R3+d*R8
 	mp_modmul(d->y, d->y, d->z); // R2 = R2*R3
 	mp_modmul(d->z, d->z, d->x); // R3 = R3*R1
 	mp_modmul(d->x, d->x, R7); // R1 = R1*R7
@@ -445,35 +823,114 @@ static void point_add(ec_point_t *d, ec_point_t *a, ec_point_t *b)
 	return;
 }
 
+/* d = table[idx], reading every entry so that neither the branches nor
+ * the memory accesses depend on idx */
+static void point_select(ec_point_t *d, const ec_point_t *table, uint32_t n, uint32_t idx)
+{
+	uint32_t i, j, m;
+
+	for(j = 0; j < ED521_LIMBS; j++)
+		d->x[j] = d->y[j] = d->z[j] = 0;
+
+	for(i = 0; i < n; i++)
+	{
+		m = i ^ idx;
+		m = ((m | (0 - m)) >> 31) - 1; /* all ones if i == idx */
+		for(j = 0; j < ED521_LIMBS; j++)
+		{
+			d->x[j] |= table[i].x[j] & m;
+			d->y[j] |= table[i].y[j] & m;
+			d->z[j] |= table[i].z[j] & m;
+		}
+	}
+	return;
+}
+
+/* Fixed window: the Edwards addition is complete, so adding the neutral
+ * element for a zero window needs no special case, and every window
+ * costs the same */
 void point_scalar(ec_point_t *d, const ec_point_t *a, const uint32_t *s)
 {
 	int i, j;
-	uint32_t v, b;
-	ec_point_t tmp;
-	ec_point_t *p[2];
+	uint32_t w, bit;
+	ec_point_t t;
 
-	p[0] = d;
-	p[1] = &tmp;
+	point_set_neutral(&point_table[0]);
+	point_set(&point_table[1], a);
+	for(i = 2; i < (1 << ED521_WINDOW); i++)
+	{
+		if(i & 1)
+			point_add(&point_table[i], &point_table[i - 1], &point_table[1]);
+		else
+			point_double(&point_table[i], &point_table[i / 2]);
+	}
 
-	point_set(p[1], a);
-	mp_set_ui(p[0]->x, 0);
-	mp_set_ui(p[0]->y, 1);
-	mp_set_ui(p[0]->z, 1);
+	point_set_neutral(d);
+	for(i = (ED521_LIMBS * 32) / ED521_WINDOW - 1; i >= 0; i--)
+	{
+		for(j = 0; j < ED521_WINDOW; j++)
+			point_double(d, d);
 
-	for(i = ED521_LIMBS - 1; i >= 0; i--)
+		bit = i * ED521_WINDOW;
+		w = (s[bit / 32] >> (bit % 32)) & ((1 << ED521_WINDOW) - 1);
+		point_select(&t, point_table, 1 << ED521_WINDOW, w);
+		point_add(d, d, &t);
+	}
+
+	for(i = 0; i < (1 << ED521_WINDOW); i++)
+		point_set_neutral(&point_table[i]);
+	point_set_neutral(&t);
+	w = 0;
+	return;
+}
+
+void point_scalar_base(ec_point_t *d, const uint32_t *s)
+{
+	int i, k;
+	uint32_t idx, bit, e, j, m;
+	ec_point_t t;
+
+	point_set_neutral(d);
+	for(i = ED521_COMB_SPACING - 1; i >= 0; i--)
 	{
-		v = s[i];
-		for(j = 0; j < 32; j++)
+		point_double(d, d);
+
+		for(k = 0, idx = 0; k < ED521_COMB_TEETH; k++)
 		{
-			b = (v >> 31);
-			point_add(p[b ^ 1], p[0], p[1]);
-			point_double(p[b], p[b]);
-			v <<= 1;
+			bit = k * ED521_COMB_SPACING + i;
+			if(bit < ED521_LIMBS * 32)
+				idx |= ((s[bit / 32] >> (bit % 32)) & 1) << k;
 		}
+
+		/* As point_select, from the affine table in flash */
+		for(j = 0; j < ED521_LIMBS; j++)
+			t.x[j] = t.y[j] = 0;
+		for(e = 0; e < (1 << ED521_COMB_TEETH); e++)
+		{
+			m = e ^ idx;
+			m = ((m | (0 - m)) >> 31) - 1;
+			for(j = 0; j < ED521_LIMBS; j++)
+			{
+				t.x[j] |= ED521_comb[e][0][j] & m;
+				t.y[j] |= ED521_comb[e][1][j] & m;
+			}
+		}
+		mp_set_ui(t.z, 1);
+		point_add(d, d, &t);
 	}
+
+	point_set_neutral(&t);
+	idx = 0;
 	return;
 }
 
+int point_is_base(const ec_point_t *a)
+{
+	return mp_cmp(a->x, ED521_Gx) == 0 &&
+		mp_cmp_ui(a->y, ED521_Gy) == 0 &&
+		mp_cmp_ui(a->z, 1) == 0;
+}
+
 #ifdef ECC_TEST
 static void mpz_set_mp(mpz_t d, const uint32_t *s)
 {
@@ -503,6 +960,61 @@ static void mp_set_mpz(uint32_t *d, mpz_t s)
 	return;
 }
 
+/* Scalar, x and y of scalar * G, computed independently */
+static const uint32_t scalar_base_vectors[][3][ED521_LIMBS] = {
+	{
+		{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+		  0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+		  0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+		{ 0xf9bd2cfe, 0x16bf49dc, 0x5b3a7050, 0xe64afedf, 0xa9dedbcc, 0xf476227c,
+		  0xb3df8376, 0x6a3744e6, 0x28ce327f, 0x1ab0bb37, 0x613b835c, 0x1bcbdbdc,
+		  0x8ce5768e, 0xede0bd52, 0x3aabbc6a, 0xbd83463f, 0x000001f6 },
+		{ 0x19207917, 0x794fe82c, 0xa9768f0f, 0xdb6f174d, 0x1720607d, 0xb5f78a9c,
+		  0x8d13a660, 0x2095ab34, 0x423f8541, 0x1878165a, 0x0fb8d745, 0xf913739f,
+		  0x72bb227e, 0xbe88db94, 0x41083830, 0xc47dfe17, 0x000001b1 }
+	},
+	{
+		{ 0x198f7eb9, 0x00179ea0, 0xdbbda106, 0x4f0f8fec, 0x4056c2b4, 0x68d8fa9f,
+		  0xcba3eaf4, 0xb66cb7ea, 0xc63c0cd6, 0xdd88272d, 0xfaacd706, 0x2d736535,
+		  0xcf58db82, 0x5b0d046e, 0xde30f538, 0x5b246f35, 0x0000f853 },
+		{ 0x9b6667e0, 0xf1953919, 0x2b8925a7, 0x8d6c6bf0, 0xb9738503, 0x75b81bb0,
+		  0x14bc9943, 0xeac796fb, 0x38b29137, 0x79575caa, 0xd3a74fd9, 0xcf6f437a,
+		  0xc22108f1, 0xc2c27a8d, 0xa3a2a539, 0x2de8bd32, 0x00000169 },
+		{ 0x31c35d32, 0x06697bb0, 0xcc9f4568, 0x9770cc44, 0x37e051d5, 0xc35dd6d9,
+		  0x7c2ea4d3, 0x68e3f312, 0x53efd292, 0x29be065c, 0x5b7b75af, 0x3b083e16,
+		  0xee976440, 0x350471f9, 0xddc657c1, 0xc6f8dc28, 0x0000013a }
+	}
+};
+
+/* Plain double-and-add, to check point_scalar and point_scalar_base */
+static void point_scalar_ref(ec_point_t *d, const ec_point_t *a, const uint32_t *s)
+{
+	int i;
+	ec_point_t t;
+
+	point_set(&t, a);
+	point_set_neutral(d);
+	for(i = ED521_LIMBS * 32 - 1; i >= 0; i--)
+	{
+		point_double(d, d);
+		if((s[i / 32] >> (i % 32)) & 1)
+			point_add(d, d, &t);
+	}
+	return;
+}
+
+static void point_check(const char *what, int i, ec_point_t *a, ec_point_t *b)
+{
+	point_make_affine(a, a);
+	point_make_affine(b, b);
+	if(mp_cmp(a->x, b->x) != 0 || mp_cmp(a->y, b->y) != 0)
+	{
+		gmp_printf("%s mismatch %d\n", what, i);
+		exit(-1);
+	}
+	return;
+}
+
 int mp_test()
 {
 	int i, j, y_sign;
@@ -605,28 +1117,6 @@ int mp_test()
 		}
 	}
 
-	for(i = 0; i < 100000; i++)
-	{
-		mpz_urandomm(X, rnd, P);
-		mpz_urandomm(Y, rnd, P);
-		mpz_mul(Z, X, Y);
-		mpz_mod(Z, Z, P);
-
-		mp_set_mpz(x, X);
-		mp_set_mpz(y, Y);
-
-		mp_modmul(z, x, y);
-
-		mpz_set_mp(Zmp, z);
-		if(mpz_cmp(Z, Zmp) != 0)
-		{
-			gmp_printf("mp_modmul mismatch %d\nexp: %Zx\ngot: %Zx\n", i, Z, Zmp);
-			mpz_mod(Zmp, Zmp, P);
-			gmp_printf("rst: %Zx\n", P);
-			exit(-1);
-		}
-	}
-
 	for(i = 0; i < 10000; i++)
 	{
 		mpz_urandomm(X, rnd, P);
@@ -812,6 +1302,200 @@ int mp_test()
 		}
 	}
 
+	for(i = 0; i < 100000; i++)
+	{
+		mpz_urandomm(X, rnd, P);
+		mpz_mul(Z, X, X);
+		mpz_mod(Z, Z, P);
+
+		mp_set_mpz(x, X);
+		mp_modsqr(z, x);
+
+		mpz_set_mp(Zmp, z);
+		if(mpz_cmp(Z, Zmp) != 0)
+		{
+			gmp_printf("mp_modsqr mismatch %d\nexp: %Zx\ngot: %Zx\n", i, Z, Zmp);
+			exit(-1);
+		}
+
+		mpz_mul_ui(Z, X, 376014);
+		mpz_mod(Z, Z, P);
+		mp_modmul_ui(z, x, 376014);
+
+		mpz_set_mp(Zmp, z);
+		if(mpz_cmp(Z, Zmp) != 0)
+		{
+			gmp_printf("mp_modmul_ui mismatch %d\nexp: %Zx\ngot: %Zx\n", i, Z, Zmp);
+			exit(-1);
+		}
+	}
+
+	for(i = 0; i < 100000; i++)
+	{
+		mpz_urandomm(X, rnd, P);
+		mpz_urandomm(Y, rnd, P);
+		/* every fourth pair has the top limb of both operands full */
+		if((i & 3) == 0)
+		{
+			mpz_setbit(X, 520); mpz_setbit(X, 512);
+			mpz_setbit(Y, 520); mpz_setbit(Y, 512);
+			if(mpz_cmp(X, P) >= 0)
+				mpz_sub_ui(X, X, 1);
+			if(mpz_cmp(Y, P) >= 0)
+				mpz_sub_ui(Y, Y, 1);
+		}
+		mpz_mul(Z, X, Y);
+		mpz_mod(Z, Z, P);
+
+		mp_set_mpz(x, X);
+		mp_set_mpz(y, Y);
+
+		mp_modmul(z, x, y);
+
+		mpz_set_mp(Zmp, z);
+		if(mpz_cmp(Z, Zmp) != 0)
+		{
+			gmp_printf("mp_modmul mismatch %d\nexp: %Zx\ngot: %Zx\n", i, Z, Zmp);
+			exit(-1);
+		}
+	}
+
+	/* Edge operands 0, 1, p - 1 and p - 2, and ones with only the top
+	 * limb set, against each other and random values. p may stand in
+	 * for 0 in the result */
+	{
+		static const char *edges[] = { "0", "1",
+			"1fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffe",
+			"1ff00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000",
+			"100000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000",
+			"1fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffd" };
+		int nedges = sizeof(edges) / sizeof(edges[0]);
+
+		for(i = 0; i < nedges; i++)
+		{
+			for(j = 0; j < nedges + 100; j++)
+			{
+				mpz_set_str(X, edges[i], 16);
+				if(j < nedges)
+					mpz_set_str(Y, edges[j], 16);
+				else
+					mpz_urandomm(Y, rnd, P);
+				mpz_mul(Z, X, Y);
+				mpz_mod(Z, Z, P);
+
+				mp_set_mpz(x, X);
+				mp_set_mpz(y, Y);
+
+				mp_modmul(z, x, y);
+
+				mpz_set_mp(Zmp, z);
+				if(mpz_cmp(Zmp, P) == 0)
+					mpz_set_ui(Zmp, 0);
+				if(mpz_cmp(Z, Zmp) != 0)
+				{
+					gmp_printf("mp_modmul edge mismatch %d %d\nexp: %Zx\ngot: %Zx\n", i, j, Z, Zmp);
+					exit(-1);
+				}
+			}
+
+			mpz_mul(Z, X, X);
+			mpz_mod(Z, Z, P);
+			mp_modsqr(z, x);
+
+			mpz_set_mp(Zmp, z);
+			if(mpz_cmp(Zmp, P) == 0)
+				mpz_set_ui(Zmp, 0);
+			if(mpz_cmp(Z, Zmp) != 0)
+			{
+				gmp_printf("mp_modsqr edge mismatch %d\nexp: %Zx\ngot: %Zx\n", i, Z, Zmp);
+				exit(-1);
+			}
+		}
+	}
+
+	/* The largest value the folding can leave, 2^521 - 1 */
+	mp_set(x, ED521_P);
+	mp_modsqr(z, x);
+	mp_modmul(y, x, x);
+	if(mp_cmp(y, z) != 0 || (mp_cmp_ui(z, 0) != 0 && mp_cmp(z, ED521_P) != 0))
+	{
+		gmp_printf("mp_modsqr of p mismatch\n");
+		exit(-1);
+	}
+
+	for(i = 0; i < 1000; i++)
+	{
+		mpz_urandomm(X, rnd, P);
+		mp_set_mpz(x, X);
+
+		mpz_invert(Y, X, P);
+		mp_modinv(y, x);
+
+		mpz_set_mp(Zmp, y);
+		if(mpz_cmp(Y, Zmp) != 0)
+		{
+			gmp_printf("mp_modinv mismatch %d\nexp: %Zx\ngot: %Zx\n", i, Y, Zmp);
+			exit(-1);
+		}
+	}
+
+	for(i = 0; i < 20; i++)
+	{
+		ec_point_t pt_a, pt_b, pt_c;
+
+		for(j = 0; j < ED521_LIMBS; j++)
+			x[j] = random();
+		x[ED521_LIMBS - 1] &= 0x1ff;
+		if(point_uncompress(&pt_a, x, 0) < 0)
+			continue;
+		for(j = 0; j < ED521_LIMBS; j++)
+			y[j] = random();
+
+		point_scalar(&pt_b, &pt_a, y);
+		point_scalar_ref(&pt_c, &pt_a, y);
+		point_check("point_scalar", i, &pt_b, &pt_c);
+	}
+
+	{
+		ec_point_t pt_g, pt_b, pt_c;
+
+		if(point_uncompress(&pt_g, (uint32_t *) ED521_Gx, 0) < 0 || !point_is_base(&pt_g))
+		{
+			gmp_printf("uncompress of generator failed\n");
+			exit(-1);
+		}
+
+		for(i = 0; i < 20; i++)
+		{
+			for(j = 0; j < ED521_LIMBS; j++)
+				y[j] = random() ^ (random() << 16);
+
+			point_scalar_base(&pt_b, y);
+			point_scalar(&pt_c, &pt_g, y);
+			point_check("point_scalar_base", i, &pt_b, &pt_c);
+		}
+
+		point_scalar_base(&pt_b, ED521_order);
+		point_make_affine(&pt_b, &pt_b);
+		if(mp_cmp_ui(pt_b.x, 0) != 0 || mp_cmp_ui(pt_b.y, 1) != 0)
+		{
+			gmp_printf("order * G is not the neutral element\n");
+			exit(-1);
+		}
+
+		for(i = 0; i < sizeof(scalar_base_vectors) / sizeof(scalar_base_vectors[0]); i++)
+		{
+			point_scalar_base(&pt_b, scalar_base_vectors[i][0]);
+			point_scalar(&pt_c, &pt_g, scalar_base_vectors[i][0]);
+			mp_set(pt_g.x, scalar_base_vectors[i][1]);
+			mp_set(pt_g.y, scalar_base_vectors[i][2]);
+			mp_set_ui(pt_g.z, 1);
+			point_check("scalar_base_vectors", i, &pt_b, &pt_g);
+			point_check("scalar_base_vectors", i, &pt_c, &pt_g);
+			point_uncompress(&pt_g, (uint32_t *) ED521_Gx, 0);
+		}
+	}
+
 /*
 	{
 		ec_point_t pt_a, pt_b;
@@ -93,7 +93,8 @@ int point_uncompress(ec_point_t *p, uint32_t *x, int y_sign);
  */
 int point_compress(uint32_t *x, int *y_sign, ec_point_t *p);
 
-/** @brief Perform a point-scalar multiplcation on the curve
+/** @brief Perform a point-scalar multiplcation on the curve, in constant
+ *  time, four bits of the scalar at a time
  *
  *  @param[out] d The result of the multiplication
  *  @param a The input point
@@ -101,6 +102,23 @@ int point_compress(uint32_t *x, int *y_sign, ec_point_t *p);
  */
 void point_scalar(ec_point_t *d, const ec_point_t *a, const uint32_t *s);
 
+/** @brief Multiply the curve's base point by a scalar, in constant time,
+ *  with a precomputed comb table (several times faster than point_scalar)
+ *
+ *  @param[out] d The result of the multiplication
+ *  @param s The input scalar
+ */
+void point_scalar_base(ec_point_t *d, const uint32_t *s);
+
+/** @brief Check whether a point is the base point, as point_uncompress
+ *  leaves it
+ *
+ *  @param a The point to check
+ *
+ *  @return Non-zero if a is the base point with z = 1
+ */
+int point_is_base(const ec_point_t *a);
+
 /** @} */
 
 /** @} */
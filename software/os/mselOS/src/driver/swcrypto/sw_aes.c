@@ -24,33 +24,36 @@
 
 /* AES sbox logic due to Rene Peralta, et. al
  * https://eprint.iacr.org/2011/332
+ *
+ * Only XOR, AND and NOT, so it works on 32 bits at a time: U[0] holds
+ * the most significant bit of 32 different inputs, U[7] the least, and
+ * the results replace them.
  */
-uint8_t aes_sbox(uint8_t U, int inv)
+void aes_sbox_bs(uint32_t *U, int inv)
 {
-  uint8_t S;
-  uint8_t U0, U1, U2, U3, U4, U5, U6, U7;
-  uint8_t S0, S1, S2, S3, S4, S5, S6, S7;
-  uint8_t Y5;
-  uint8_t T1, T2, T3, T4, T6, T8, T9, T10, T13, T14, T15, T16, T17, T19;
-  uint8_t T20, T22, T23, T24, T25, T26, T27;
-  uint8_t M1, M2, M3, M4, M5, M6, M7, M8, M9, M10, M11, M12, M13, M14;
-  uint8_t M15, M16, M17, M18, M19, M20, M21, M22, M23, M24, M25, M26, M27;
-  uint8_t M28, M29, M30, M31, M32, M33, M34, M35, M36, M37, M38, M39, M40;
-  uint8_t M41, M42, M43, M44, M45, M46, M47, M48, M49, M50, M51, M52, M53;
-  uint8_t M54, M55, M56, M57, M58, M59, M60, M61, M62, M63;
-
-  U0 = (U >> 7) & 1;
-  U1 = (U >> 6) & 1;
-  U2 = (U >> 5) & 1;
-  U3 = (U >> 4) & 1;
-  U4 = (U >> 3) & 1;
-  U5 = (U >> 2) & 1;
-  U6 = (U >> 1) & 1;
-  U7 = (U >> 0) & 1;
+  uint32_t U0, U1, U2, U3, U4, U5, U6, U7;
+  uint32_t S0, S1, S2, S3, S4, S5, S6, S7;
+  uint32_t Y5;
+  uint32_t T1, T2, T3, T4, T6, T8, T9, T10, T13, T14, T15, T16, T17, T19;
+  uint32_t T20, T22, T23, T24, T25, T26, T27;
+  uint32_t M1, M2, M3, M4, M5, M6, M7, M8, M9, M10, M11, M12, M13, M14;
+  uint32_t M15, M16, M17, M18, M19, M20, M21, M22, M23, M24, M25, M26, M27;
+  uint32_t M28, M29, M30, M31, M32, M33, M34, M35, M36, M37, M38, M39, M40;
+  uint32_t M41, M42, M43, M44, M45, M46, M47, M48, M49, M50, M51, M52, M53;
+  uint32_t M54, M55, M56, M57, M58, M59, M60, M61, M62, M63;
+
+  U0 = U[0];
+  U1 = U[1];
+  U2 = U[2];
+  U3 = U[3];
+  U4 = U[4];
+  U5 = U[5];
+  U6 = U[6];
+  U7 = U[7];
 
   if(!inv)
   {
-    uint8_t T5, T7, T11, T12, T18, T21;
+    uint32_t T5, T7, T11, T12, T18, T21;
 
     T1 = U0 ^ U3; /* T1 = U0 + U3 */
     T2 = U0 ^ U5; /* T2 = U0 + U5 */
@@ -83,7 +86,7 @@ uint8_t aes_sbox(uint8_t U, int inv)
   }
   else
   {
-    uint8_t R5, R13, R17, R18, R19;
+    uint32_t R5, R13, R17, R18, R19;
 
     T23 = U0 ^ U3;
     T22 = ~(U1 ^ U3);
@@ -180,9 +183,9 @@ uint8_t aes_sbox(uint8_t U, int inv)
 
   if(!inv)
   {
-    uint8_t L0, L1, L2, L3, L4, L5, L6, L7, L8, L9, L10, L11, L12, L13, L14;
-    uint8_t L15, L16, L17, L18, L19, L20, L21, L22, L23, L24, L25, L26, L27;
-    uint8_t L28, L29;
+    uint32_t L0, L1, L2, L3, L4, L5, L6, L7, L8, L9, L10, L11, L12, L13, L14;
+    uint32_t L15, L16, L17, L18, L19, L20, L21, L22, L23, L24, L25, L26, L27;
+    uint32_t L28, L29;
 
     L0 = M61 ^ M62; /* L0 = M61 + M62 */
     L1 = M50 ^ M56; /* L1 = M50 + M56 */
@@ -226,9 +229,9 @@ uint8_t aes_sbox(uint8_t U, int inv)
   }
   else
   {
-    uint8_t P0, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11, P12, P13, P14;
-    uint8_t P15, P16, P17, P18, P19, P20, P22, P23, P24, P25, P26, P27;
-    uint8_t P28, P29;
+    uint32_t P0, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11, P12, P13, P14;
+    uint32_t P15, P16, P17, P18, P19, P20, P22, P23, P24, P25, P26, P27;
+    uint32_t P28, P29;
 
     P0 = M52 ^ M61;
     P1 = M58 ^ M59;
@@ -270,14 +273,31 @@ uint8_t aes_sbox(uint8_t U, int inv)
     S7 = P9 ^ P16;
   }
 
-  S =   ((S0 & 1) << 7)
-    | ((S1 & 1) << 6)
-    | ((S2 & 1) << 5)
-    | ((S3 & 1) << 4)
-    | ((S4 & 1) << 3)
-    | ((S5 & 1) << 2)
-    | ((S6 & 1) << 1)
-    | ((S7 & 1) << 0);
+  U[0] = S0;
+  U[1] = S1;
+  U[2] = S2;
+  U[3] = S3;
+  U[4] = S4;
+  U[5] = S5;
+  U[6] = S6;
+  U[7] = S7;
+  return;
+}
+
+/* One byte through the circuit above, a bit per word */
+uint8_t aes_sbox(uint8_t U, int inv)
+{
+  uint32_t bits[8];
+  uint32_t i;
+  uint8_t S;
+
+  for(i = 0; i < 8; i++)
+    bits[i] = (U >> (7 - i)) & 1;
+
+  aes_sbox_bs(bits, inv);
+
+  for(i = 0, S = 0; i < 8; i++)
+    S |= (bits[i] & 1) << (7 - i);
   return S;
 }
 
@@ -581,3 +601,24 @@ void sw_aes_ecb_decrypt(sw_aes_ctx_t *ctx, void *data_in, void *data_out)
   return;
 }
 
+#if !defined(SW_AES_TTABLE) && !defined(SW_AES_BITSLICED)
+
+void sw_aes_ecb_encrypt_blocks(sw_aes_ctx_t *ctx, const uint8_t *data_in, uint32_t block_count, uint8_t *data_out)
+{
+  uint32_t i;
+
+  for(i = 0; i < block_count; i++)
+    sw_aes_ecb_encrypt(ctx, (void *) &data_in[i * AES_BLOCK_SIZE], &data_out[i * AES_BLOCK_SIZE]);
+  return;
+}
+
+void sw_aes_ecb_decrypt_blocks(sw_aes_ctx_t *ctx, const uint8_t *data_in, uint32_t block_count, uint8_t *data_out)
+{
+  uint32_t i;
+
+  for(i = 0; i < block_count; i++)
+    sw_aes_ecb_decrypt(ctx, (void *) &data_in[i * AES_BLOCK_SIZE], &data_out[i * AES_BLOCK_SIZE]);
+  return;
+}
+
+#endif
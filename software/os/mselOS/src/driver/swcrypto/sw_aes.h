@@ -75,6 +75,9 @@ typedef struct sw_aes_ctx_s {
 /** @brief The AES sbox. */
 uint8_t aes_sbox(uint8_t U, int inv);
 
+/** @brief The AES sbox on 32 bytes at once, bitsliced: U[0] holds the most significant bits, U[7] the least. */
+void aes_sbox_bs(uint32_t *U, int inv);
+
 /** @brief Sets the key in the given context. */
 void sw_aes_setkey(sw_aes_ctx_t *ctx, aes_algo_t algo, void *key);
 
@@ -84,6 +87,16 @@ void sw_aes_ecb_encrypt(sw_aes_ctx_t *ctx, void *data_in, void *data_out);
 /** @brief Performs decryption (electronic codebook mode) of the given data in the given context. */
 void sw_aes_ecb_decrypt(sw_aes_ctx_t *ctx, void *data_in, void *data_out);
 
+/** @brief Encrypts block_count blocks (electronic codebook mode). The
+ *  implementation is picked at configure time (--with-swaes-impl):
+ *  the byte-wise reference code above, 32-bit T-tables (sw_aes_ttable.c)
+ *  or constant-time bitslicing of two blocks at a time (sw_aes_bitsliced.c).
+ *  Neither buffer needs to be aligned. */
+void sw_aes_ecb_encrypt_blocks(sw_aes_ctx_t *ctx, const uint8_t *data_in, uint32_t block_count, uint8_t *data_out);
+
+/** @brief Decrypts block_count blocks (electronic codebook mode). See sw_aes_ecb_encrypt_blocks. */
+void sw_aes_ecb_decrypt_blocks(sw_aes_ctx_t *ctx, const uint8_t *data_in, uint32_t block_count, uint8_t *data_out);
+
 /** @} */
 
 /** @} */
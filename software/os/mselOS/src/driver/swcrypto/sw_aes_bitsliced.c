@@ -0,0 +1,295 @@
+/** @file sw_aes_bitsliced.c
+ *
+ *  Constant-time AES, two blocks at a time, for USE_SW_AES builds
+ *  configured with --with-swaes-impl=bitsliced
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* The two blocks are spread over eight words q[0..7], q[b] holding bit
+ * b of all 32 bytes (the same layout as BearSSL's aes_ct). Within a
+ * word, bits 8r..8r+7 are row r of the state, two bits (one per block)
+ * for each column. That makes
+ *
+ *   SubBytes    the Boyar-Peralta circuit from sw_aes.c on whole words
+ *   ShiftRows   a rotation within each byte of every word
+ *   MixColumns  rotations by a byte (the next row) and XORs
+ *
+ * with no table lookups or branches on the data or key. An odd block
+ * out is paired with a block of zeros, so one block costs as much as
+ * two. */
+
+#include "sw_aes.h"
+#include <msel/stdc.h>
+
+#ifdef SW_AES_BITSLICED
+
+#define Nb 4
+
+#define SWAPN(cl, ch, s, x, y) do { \
+    uint32_t a_ = (x), b_ = (y);      \
+    (x) = (a_ & (cl)) | ((b_ & (cl)) << (s)); \
+    (y) = ((a_ & (ch)) >> (s)) | (b_ & (ch)); \
+  } while(0)
+
+#define SWAP2(x, y) SWAPN(0x55555555, 0xAAAAAAAA, 1, x, y)
+#define SWAP4(x, y) SWAPN(0x33333333, 0xCCCCCCCC, 2, x, y)
+#define SWAP8(x, y) SWAPN(0x0F0F0F0F, 0xF0F0F0F0, 4, x, y)
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define GETLE32(p) ((uint32_t) (p)[0] | ((uint32_t) (p)[1] << 8) | ((uint32_t) (p)[2] << 16) | ((uint32_t) (p)[3] << 24))
+#define PUTLE32(p, v) do { (p)[0] = (v); (p)[1] = (v) >> 8; (p)[2] = (v) >> 16; (p)[3] = (v) >> 24; } while(0)
+
+/* Into (and, being its own inverse, out of) the bitsliced layout */
+static void bs_ortho(uint32_t *q)
+{
+  SWAP2(q[0], q[1]); SWAP2(q[2], q[3]); SWAP2(q[4], q[5]); SWAP2(q[6], q[7]);
+  SWAP4(q[0], q[2]); SWAP4(q[1], q[3]); SWAP4(q[4], q[6]); SWAP4(q[5], q[7]);
+  SWAP8(q[0], q[4]); SWAP8(q[1], q[5]); SWAP8(q[2], q[6]); SWAP8(q[3], q[7]);
+  return;
+}
+
+/* Two blocks in; the second may be NULL */
+static void bs_load(uint32_t *q, const uint8_t *b0, const uint8_t *b1)
+{
+  uint32_t i;
+
+  for(i = 0; i < 4; i++)
+  {
+    q[2 * i] = GETLE32(&b0[4 * i]);
+    q[2 * i + 1] = b1 ? GETLE32(&b1[4 * i]) : 0;
+  }
+  bs_ortho(q);
+  return;
+}
+
+static void bs_store(uint32_t *q, uint8_t *b0, uint8_t *b1)
+{
+  uint32_t i;
+
+  bs_ortho(q);
+  for(i = 0; i < 4; i++)
+  {
+    PUTLE32(&b0[4 * i], q[2 * i]);
+    if(b1)
+      PUTLE32(&b1[4 * i], q[2 * i + 1]);
+  }
+  return;
+}
+
+/* The round keys from sw_aes_setkey, each repeated for both blocks */
+static void bs_expand_key(sw_aes_ctx_t *ctx, uint32_t *sk)
+{
+  uint32_t Nr = (ctx->algo * 2) + 10;
+  uint8_t rk[AES_BLOCK_SIZE];
+  uint32_t round, i;
+
+  for(round = 0; round <= Nr; round++)
+  {
+    for(i = 0; i < Nb; i++)
+    {
+      rk[4 * i + 0] = ctx->ks[round * Nb + i] >> 24;
+      rk[4 * i + 1] = ctx->ks[round * Nb + i] >> 16;
+      rk[4 * i + 2] = ctx->ks[round * Nb + i] >> 8;
+      rk[4 * i + 3] = ctx->ks[round * Nb + i];
+    }
+    bs_load(&sk[round * 8], rk, rk);
+  }
+  msel_memset(rk, 0, sizeof(rk));
+  return;
+}
+
+/* The circuit numbers its bits from the most significant */
+static void bs_sbox(uint32_t *q, int inv)
+{
+  uint32_t U[8];
+  uint32_t i;
+
+  for(i = 0; i < 8; i++)
+    U[i] = q[7 - i];
+  aes_sbox_bs(U, inv);
+  for(i = 0; i < 8; i++)
+    q[7 - i] = U[i];
+  return;
+}
+
+static void bs_add_round_key(uint32_t *q, const uint32_t *sk)
+{
+  uint32_t i;
+
+  for(i = 0; i < 8; i++)
+    q[i] ^= sk[i];
+  return;
+}
+
+static void bs_shift_rows(uint32_t *q)
+{
+  uint32_t i, x;
+
+  for(i = 0; i < 8; i++)
+  {
+    x = q[i];
+    q[i] = (x & 0x000000FF)
+      | ((x & 0x0000FC00) >> 2) | ((x & 0x00000300) << 6)
+      | ((x & 0x00F00000) >> 4) | ((x & 0x000F0000) << 4)
+      | ((x & 0xC0000000) >> 6) | ((x & 0x3F000000) << 2);
+  }
+  return;
+}
+
+static void bs_inv_shift_rows(uint32_t *q)
+{
+  uint32_t i, x;
+
+  for(i = 0; i < 8; i++)
+  {
+    x = q[i];
+    q[i] = (x & 0x000000FF)
+      | ((x & 0x00003F00) << 2) | ((x & 0x0000C000) >> 6)
+      | ((x & 0x000F0000) << 4) | ((x & 0x00F00000) >> 4)
+      | ((x & 0x03000000) << 6) | ((x & 0xFC000000) >> 2);
+  }
+  return;
+}
+
+/* Multiply every byte by x: shift the bit planes up and fold bit 7
+ * back in as 0x1b */
+static void bs_xtime(uint32_t *q)
+{
+  uint32_t q7 = q[7];
+
+  q[7] = q[6];
+  q[6] = q[5];
+  q[5] = q[4];
+  q[4] = q[3] ^ q7;
+  q[3] = q[2] ^ q7;
+  q[2] = q[1];
+  q[1] = q[0] ^ q7;
+  q[0] = q7;
+  return;
+}
+
+/* FIPS 197, Section 5.1.3, as in sw_aes.c: each byte gets
+ * xtime(a ^ next) ^ (sum of its column) ^ a, where the next row is a
+ * byte further along the word */
+static void bs_mix_columns(uint32_t *q)
+{
+  uint32_t t[8], sum[8];
+  uint32_t i, r;
+
+  for(i = 0; i < 8; i++)
+  {
+    r = ROTR(q[i], 8);
+    t[i] = q[i] ^ r;
+    sum[i] = t[i] ^ ROTR(t[i], 16);
+  }
+  bs_xtime(t);
+  for(i = 0; i < 8; i++)
+    q[i] ^= t[i] ^ sum[i];
+  return;
+}
+
+/* InvMixColumns is MixColumns after adding {04}.(a ^ the byte two rows
+ * on) to every byte */
+static void bs_inv_mix_columns(uint32_t *q)
+{
+  uint32_t u[8];
+  uint32_t i;
+
+  for(i = 0; i < 8; i++)
+    u[i] = q[i] ^ ROTR(q[i], 16);
+  bs_xtime(u);
+  bs_xtime(u);
+  for(i = 0; i < 8; i++)
+    q[i] ^= u[i];
+  bs_mix_columns(q);
+  return;
+}
+
+void sw_aes_ecb_encrypt_blocks(sw_aes_ctx_t *ctx, const uint8_t *data_in, uint32_t block_count, uint8_t *data_out)
+{
+  uint32_t Nr = (ctx->algo * 2) + 10;
+  uint32_t sk[8 * 15];
+  uint32_t q[8];
+  uint32_t round, pair;
+
+  bs_expand_key(ctx, sk);
+
+  for(; block_count > 0; block_count -= pair)
+  {
+    pair = (block_count > 1) ? 2 : 1;
+    bs_load(q, data_in, (pair == 2) ? data_in + AES_BLOCK_SIZE : NULL);
+
+    bs_add_round_key(q, &sk[0]);
+    for(round = 1; round < Nr; round++)
+    {
+      bs_sbox(q, 0);
+      bs_shift_rows(q);
+      bs_mix_columns(q);
+      bs_add_round_key(q, &sk[round * 8]);
+    }
+    bs_sbox(q, 0);
+    bs_shift_rows(q);
+    bs_add_round_key(q, &sk[Nr * 8]);
+
+    bs_store(q, data_out, (pair == 2) ? data_out + AES_BLOCK_SIZE : NULL);
+    data_in += pair * AES_BLOCK_SIZE;
+    data_out += pair * AES_BLOCK_SIZE;
+  }
+
+  msel_memset(sk, 0, sizeof(sk));
+  msel_memset(q, 0, sizeof(q));
+  return;
+}
+
+void sw_aes_ecb_decrypt_blocks(sw_aes_ctx_t *ctx, const uint8_t *data_in, uint32_t block_count, uint8_t *data_out)
+{
+  uint32_t Nr = (ctx->algo * 2) + 10;
+  uint32_t sk[8 * 15];
+  uint32_t q[8];
+  uint32_t round, pair;
+
+  bs_expand_key(ctx, sk);
+
+  for(; block_count > 0; block_count -= pair)
+  {
+    pair = (block_count > 1) ? 2 : 1;
+    bs_load(q, data_in, (pair == 2) ? data_in + AES_BLOCK_SIZE : NULL);
+
+    bs_add_round_key(q, &sk[Nr * 8]);
+    for(round = Nr - 1; round > 0; round--)
+    {
+      bs_inv_shift_rows(q);
+      bs_sbox(q, 1);
+      bs_add_round_key(q, &sk[round * 8]);
+      bs_inv_mix_columns(q);
+    }
+    bs_inv_shift_rows(q);
+    bs_sbox(q, 1);
+    bs_add_round_key(q, &sk[0]);
+
+    bs_store(q, data_out, (pair == 2) ? data_out + AES_BLOCK_SIZE : NULL);
+    data_in += pair * AES_BLOCK_SIZE;
+    data_out += pair * AES_BLOCK_SIZE;
+  }
+
+  msel_memset(sk, 0, sizeof(sk));
+  msel_memset(q, 0, sizeof(q));
+  return;
+}
+
+#endif /* SW_AES_BITSLICED */
@@ -84,27 +84,54 @@ static const uint32_t sha256_K[64] = {
     0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 };
 
-/** @brief Perform a single iteration of the SHA-256 transform
-
-    @param iv An 8-byte initialization vector for the transform
-      (also contains the output from the completed transform)
-    @param bptr A pointer to the data to be run through the transform
- */
-void sha256_transform(uint32_t* iv, uint8_t* bptr)
+/* One round, with the working variables renamed instead of shifted
+ * along: d and h are the only ones that change */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, k, w) do { \
+		T1 = (h) + S1_32(e) + Ch((e), (f), (g)) + (k) + (w); \
+		(d) += T1; \
+		(h) = T1 + S0_32(a) + Maj((a), (b), (c)); \
+	} while(0)
+
+/* Message schedule word t (t >= 16) in a 16-word ring, replacing
+ * word t - 16 */
+#define W_NEXT(j) (W[(j)] += s1_32(W[((j) + 14) & 15]) + W[((j) + 9) & 15] + s0_32(W[((j) + 1) & 15]))
+#define W_FIRST(j) (W[(j)])
+
+/* Sixteen rounds from round i on, with the schedule words from W_ */
+#define SHA256_ROUNDS16(W_) do { \
+		SHA256_ROUND(a, b, c, d, e, f, g, h, sha256_K[i +  0], W_( 0)); \
+		SHA256_ROUND(h, a, b, c, d, e, f, g, sha256_K[i +  1], W_( 1)); \
+		SHA256_ROUND(g, h, a, b, c, d, e, f, sha256_K[i +  2], W_( 2)); \
+		SHA256_ROUND(f, g, h, a, b, c, d, e, sha256_K[i +  3], W_( 3)); \
+		SHA256_ROUND(e, f, g, h, a, b, c, d, sha256_K[i +  4], W_( 4)); \
+		SHA256_ROUND(d, e, f, g, h, a, b, c, sha256_K[i +  5], W_( 5)); \
+		SHA256_ROUND(c, d, e, f, g, h, a, b, sha256_K[i +  6], W_( 6)); \
+		SHA256_ROUND(b, c, d, e, f, g, h, a, sha256_K[i +  7], W_( 7)); \
+		SHA256_ROUND(a, b, c, d, e, f, g, h, sha256_K[i +  8], W_( 8)); \
+		SHA256_ROUND(h, a, b, c, d, e, f, g, sha256_K[i +  9], W_( 9)); \
+		SHA256_ROUND(g, h, a, b, c, d, e, f, sha256_K[i + 10], W_(10)); \
+		SHA256_ROUND(f, g, h, a, b, c, d, e, sha256_K[i + 11], W_(11)); \
+		SHA256_ROUND(e, f, g, h, a, b, c, d, sha256_K[i + 12], W_(12)); \
+		SHA256_ROUND(d, e, f, g, h, a, b, c, sha256_K[i + 13], W_(13)); \
+		SHA256_ROUND(c, d, e, f, g, h, a, b, sha256_K[i + 14], W_(14)); \
+		SHA256_ROUND(b, c, d, e, f, g, h, a, sha256_K[i + 15], W_(15)); \
+	} while(0)
+
+/* Load a block as big-endian words. or1k is big-endian itself, so an
+ * aligned block is read a word at a time (it faults on unaligned words) */
+static void sha256_load(uint32_t* W, const uint8_t* bptr)
 {
 	uint32_t i;
-	uint32_t a, b, c, d, e, f, g, h;
-	uint32_t T1, T2;
-	uint32_t W[64 + 16];
-
-	a = iv[0];
-	b = iv[1];
-	c = iv[2];
-	d = iv[3];
-	e = iv[4];
-	f = iv[5];
-	g = iv[6];
-	h = iv[7];
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	if((((uintptr_t) bptr) & 3) == 0)
+	{
+		const uint32_t* wptr = (const uint32_t*) bptr;
+		for(i = 0; i < 16; i++)
+			W[i] = wptr[i];
+		return;
+	}
+#endif
 
 	for(i = 0; i < 16; i++, bptr += 4)
 	{
@@ -113,37 +140,62 @@ void sha256_transform(uint32_t* iv, uint8_t* bptr)
 				| (((uint32_t) bptr[2]) <<  8)
 				| (((uint32_t) bptr[3]) <<  0);
 	}
+	return;
+}
+
+/** @brief Run the SHA-256 transform over consecutive blocks
 
-	for(i = 0; i < 64; i++)
+    @param iv The eight state words, updated in place
+    @param bptr The data, block_count 64-byte blocks
+    @param block_count Number of blocks at bptr
+ */
+void sha256_transform_blocks(uint32_t* iv, const uint8_t* bptr, uint32_t block_count)
+{
+	uint32_t i;
+	uint32_t a, b, c, d, e, f, g, h;
+	uint32_t T1;
+	uint32_t W[16];
+
+	for(; block_count > 0; block_count--, bptr += 64)
 	{
-		/* S1 + K[i] + W[i] can be computed ahead of time in FPGA */
-		/* W[i + 16] can be computed ahead of time in FPGA */
-		/* a, b, c, d, e, f, g, and h can be moved to a shift register
-		 * if synthesis is too "simple" to pick up the pattern
-		 */
-		T1 = h + S1_32(e) + Ch(e, f, g) + sha256_K[i] + W[i];
-		T2 = S0_32(a) + Maj(a, b, c);
-		h = g;
-		g = f;
-		f = e;
-		e = d + T1;
-		d = c;
-		c = b;
-		b = a;
-		a = T1 + T2;
-
-		W[i + 16] = s1_32(W[i + 16 - 2]) + W[i + 16 - 7] + s0_32(W[i + 16 - 15]) + W[i + 16 - 16];
+		a = iv[0];
+		b = iv[1];
+		c = iv[2];
+		d = iv[3];
+		e = iv[4];
+		f = iv[5];
+		g = iv[6];
+		h = iv[7];
+
+		sha256_load(W, bptr);
+
+		i = 0;
+		SHA256_ROUNDS16(W_FIRST);
+		for(i = 16; i < 64; i += 16)
+			SHA256_ROUNDS16(W_NEXT);
+
+		iv[0] += a;
+		iv[1] += b;
+		iv[2] += c;
+		iv[3] += d;
+		iv[4] += e;
+		iv[5] += f;
+		iv[6] += g;
+		iv[7] += h;
 	}
 
-	iv[0] += a;
-	iv[1] += b;
-	iv[2] += c;
-	iv[3] += d;
-	iv[4] += e;
-	iv[5] += f;
-	iv[6] += g;
-	iv[7] += h;
+	msel_memset(W, 0, sizeof(W));
 	return;
 }
 
+/** @brief Perform a single iteration of the SHA-256 transform
 
+    @param iv An 8-byte initialization vector for the transform
+      (also contains the output from the completed transform)
+    @param bptr A pointer to the data to be run through the transform
+ */
+void sha256_transform(uint32_t* iv, uint8_t* bptr)
+{
+	sha256_transform_blocks(iv, bptr, 1);
+	return;
+}
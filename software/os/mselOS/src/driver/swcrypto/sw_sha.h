@@ -34,6 +34,7 @@
 void c8to32(uint8_t* iv8, uint32_t* iv32);
 void c32to8(uint32_t* iv32, uint8_t* iv8);
 void sha256_transform(uint32_t* iv, uint8_t* bptr);
+void sha256_transform_blocks(uint32_t* iv, const uint8_t* bptr, uint32_t block_count);
 
 /** @} */
 
@@ -1,33 +1,254 @@
-/** @file trng_driver.c
-
-    This file contains the syscall to access the TRNG 
-*/
-/*
-   Copyright 2015, Google Inc.
-
-   Licensed under the Apache License, Version 2.0 (the "License");
-   you may not use this file except in compliance with the License.
-   You may obtain a copy of the License at
-
-       http://www.apache.org/licenses/LICENSE-2.0
-
-   Unless required by applicable law or agreed to in writing, software
-   distributed under the License is distributed on an "AS IS" BASIS,
-   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-   See the License for the specific language governing permissions and
-   limitations under the License.
-*/
-
-#include <stdint.h>
-#include <msel.h>
-#include "arch.h"
-#include "trng_driver.h"
-
-/** @brief read a new random byte from the RNG*/
-msel_status msel_trng_read(uint8_t* out)
-{
-    return arch_trng_read(out);
-}
-
-
-
+/** @file trng_driver.c
+
+    This file contains the syscalls to access the TRNG, and the entropy
+    pool in front of it
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <msel.h>
+#include <msel/stdc.h>
+#include <msel/syscalls.h>
+#include "arch.h"
+#include "system.h"
+#include "trng_driver.h"
+#include "sha_driver.h"
+
+/* No task may read the pool or the state that tells where in it the
+ * next bytes are. msel_init_trng sets all of it up. */
+static uint8_t  trng_pool[TRNG_POOL_BYTES] MSEL_KERNEL_PRIVATE;
+static size_t   trng_pool_head MSEL_KERNEL_PRIVATE;   /* next byte to hand out */
+static size_t   trng_pool_count MSEL_KERNEL_PRIVATE;
+
+/* Running health test state */
+static uint8_t  trng_rct_last MSEL_KERNEL_PRIVATE;
+static uint8_t  trng_rct_count MSEL_KERNEL_PRIVATE;
+static uint8_t  trng_apt_ref MSEL_KERNEL_PRIVATE;
+static uint16_t trng_apt_count MSEL_KERNEL_PRIVATE;
+static uint16_t trng_apt_seen MSEL_KERNEL_PRIVATE;
+static int      trng_started MSEL_KERNEL_PRIVATE;
+
+/* Set by a failed sample until the caller clears it */
+static msel_status trng_failed MSEL_KERNEL_PRIVATE;
+
+/* SHA-256 of exactly TRNG_RAW_BYTES: the final block is all padding */
+static const uint8_t trng_sha_iv[32] =
+  { 0x6a, 0x09, 0xe6, 0x67, 0xbb, 0x67, 0xae, 0x85,
+    0x3c, 0x6e, 0xf3, 0x72, 0xa5, 0x4f, 0xf5, 0x3a,
+    0x51, 0x0e, 0x52, 0x7f, 0x9b, 0x05, 0x68, 0x8c,
+    0x1f, 0x83, 0xd9, 0xab, 0x5b, 0xe0, 0xcd, 0x19
+  };
+
+void msel_init_trng()
+{
+    msel_memset(trng_pool, 0, sizeof(trng_pool));
+    trng_pool_head  = 0;
+    trng_pool_count = 0;
+
+    trng_rct_last  = 0;
+    trng_rct_count = 0;
+    trng_apt_ref   = 0;
+    trng_apt_count = 0;
+    trng_apt_seen  = 0;
+    trng_started   = 0;
+    trng_failed    = MSEL_OK;
+}
+
+/* Read one raw byte and run the health tests on it */
+static uint8_t trng_sample()
+{
+    uint8_t     b = 0;
+    msel_status ret;
+
+    if((ret=arch_trng_read(&b)) != MSEL_OK)
+    {
+        trng_failed = ret;
+        return 0;
+    }
+
+    /* Repetition count: the same byte too many times in a row */
+    if(b == trng_rct_last)
+    {
+        if(++trng_rct_count >= TRNG_RCT_CUTOFF)
+            trng_failed = MSEL_EUNKNOWN;
+    }
+    else
+    {
+        trng_rct_last  = b;
+        trng_rct_count = 1;
+    }
+
+    /* Adaptive proportion: the first byte of a window turning up too
+     * often in the rest of it */
+    if(trng_apt_seen == 0)
+    {
+        trng_apt_ref   = b;
+        trng_apt_count = 0;
+    }
+    else if(b == trng_apt_ref && ++trng_apt_count >= TRNG_APT_CUTOFF)
+    {
+        trng_failed = MSEL_EUNKNOWN;
+    }
+    if(++trng_apt_seen == TRNG_APT_WINDOW)
+        trng_apt_seen = 0;
+
+    return b;
+}
+
+/* Condition TRNG_RAW_BYTES raw bytes into TRNG_OUT_BYTES at out */
+static msel_status trng_block(uint8_t *out)
+{
+    sha_data_t sha;
+    size_t     i, j;
+    int        tries;
+
+    for(tries = 0; tries < TRNG_RETRY_MAX; tries++)
+    {
+        trng_failed = MSEL_OK;
+        msel_memcpy(sha.iv, trng_sha_iv, sizeof(sha.iv));
+
+        for(i = 0; i < TRNG_RAW_BYTES; i += sizeof(sha.din))
+        {
+            for(j = 0; j < sizeof(sha.din); j++)
+                sha.din[j] = trng_sample();
+            msel_do_sha(&sha);
+        }
+
+        if(trng_failed == MSEL_ENOTIMPL)
+            break;
+        if(trng_failed != MSEL_OK)
+            continue;
+
+        /* 0x80, zeros, then the length in bits */
+        msel_memset(sha.din, 0, sizeof(sha.din));
+        sha.din[0]  = 0x80;
+        sha.din[62] = (TRNG_RAW_BYTES * 8) >> 8;
+        sha.din[63] = (TRNG_RAW_BYTES * 8) & 0xff;
+        msel_do_sha(&sha);
+
+        msel_memcpy(out, sha.iv, TRNG_OUT_BYTES);
+        msel_memset(&sha, 0, sizeof(sha));
+        return MSEL_OK;
+    }
+
+    msel_memset(&sha, 0, sizeof(sha));
+    return trng_failed;
+}
+
+/* Add a block to the pool, if it has room */
+static msel_status trng_fill()
+{
+    size_t      tail;
+    int         i;
+    msel_status ret;
+
+    if(!trng_started)
+    {
+        /* Start-up test: the source has to pass for a while before
+         * anything it produces is used */
+        for(i = 0; i < TRNG_RETRY_MAX; i++)
+        {
+            trng_failed = MSEL_OK;
+            for(tail = 0; tail < TRNG_STARTUP_BYTES && trng_failed != MSEL_ENOTIMPL; tail++)
+                trng_sample();
+            if(trng_failed == MSEL_OK || trng_failed == MSEL_ENOTIMPL)
+                break;
+        }
+        if(trng_failed != MSEL_OK)
+            return trng_failed;
+        trng_started = 1;
+    }
+
+    if(trng_pool_count + TRNG_OUT_BYTES > TRNG_POOL_BYTES)
+        return MSEL_OK;
+
+    /* Blocks are whole and the pool a multiple of them, so a block
+     * never wraps */
+    tail = (trng_pool_head + trng_pool_count) % TRNG_POOL_BYTES;
+    if((ret=trng_block(&trng_pool[tail])) != MSEL_OK)
+        return ret;
+
+    trng_pool_count += TRNG_OUT_BYTES;
+    return MSEL_OK;
+}
+
+/* Hand out len bytes, refilling as needed */
+static msel_status trng_take(uint8_t *out, size_t len)
+{
+    size_t      n;
+    msel_status ret;
+
+    while(len > 0)
+    {
+        if(trng_pool_count == 0 && (ret=trng_fill()) != MSEL_OK)
+            return ret;
+
+        n = TRNG_POOL_BYTES - trng_pool_head;
+        if(n > trng_pool_count)
+            n = trng_pool_count;
+        if(n > len)
+            n = len;
+
+        msel_memcpy(out, &trng_pool[trng_pool_head], n);
+        msel_memset(&trng_pool[trng_pool_head], 0, n);
+        trng_pool_head   = (trng_pool_head + n) % TRNG_POOL_BYTES;
+        trng_pool_count -= n;
+        out += n;
+        len -= n;
+    }
+    return MSEL_OK;
+}
+
+msel_status msel_trng_read_byte(uint8_t* out)
+{
+    return trng_take(out, 1);
+}
+
+msel_status msel_trng_do_read(msel_trng_args* args)
+{
+    if(args->buf == NULL || args->len > MSEL_TRNG_READ_MAX)
+        return MSEL_EINVAL;
+
+    return trng_take(args->buf, args->len);
+}
+
+void msel_trng_worker()
+{
+    trng_fill();
+}
+
+msel_status msel_trng_read(void *buf, size_t len)
+{
+    msel_trng_args args;
+    msel_status    ret;
+    size_t         n;
+
+    if(buf == NULL)
+        return MSEL_EINVAL;
+
+    while(len > 0)
+    {
+        n = len < MSEL_TRNG_READ_MAX ? len : MSEL_TRNG_READ_MAX;
+        args.buf = buf;
+        args.len = n;
+        if((ret=msel_svc(MSEL_SVC_TRNG_READ, &args)) != MSEL_OK)
+            return ret;
+        buf  = (uint8_t*)buf + n;
+        len -= n;
+    }
+    return MSEL_OK;
+}
@@ -1,49 +1,103 @@
-/** @file trng_driver.h
-
-    Declares routines for accessing the hardware random number generator
-
-*/
-/*
-   Copyright 2015, Google Inc.
-
-   Licensed under the Apache License, Version 2.0 (the "License");
-   you may not use this file except in compliance with the License.
-   You may obtain a copy of the License at
-
-       http://www.apache.org/licenses/LICENSE-2.0
-
-   Unless required by applicable law or agreed to in writing, software
-   distributed under the License is distributed on an "AS IS" BASIS,
-   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-   See the License for the specific language governing permissions and
-   limitations under the License.
-*/
-
-#ifndef _MSEL_TRNG_H_
-#define _MSEL_TRNG_H_
-
-#include <stdlib.h>
-#include "msel.h"
-
-/** @addtogroup driver
- *  @{
- */
-
-/** @defgroup True RNG driver
- *  @{
- */
-
-/** @brief Return a random number via the hardware RNG
- *  Call this function using the MSEL_SVC_TRNG syscall
- *
- *  @param[out] out An 8-byte random value
- *  @return MSEL status value: 
- *    - MSEL_OK for succesful operation
- */
-msel_status msel_trng_read(uint8_t* out);
-
-/** @} */
-
-/** @} */
-
-#endif
+/** @file trng_driver.h
+
+    Declares routines for accessing the hardware random number generator
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MSEL_TRNG_H_
+#define _MSEL_TRNG_H_
+
+#include <stdlib.h>
+#include "msel.h"
+#include <msel/trng.h>
+
+/** @addtogroup driver
+ *  @{
+ */
+
+/** @defgroup True RNG driver
+
+    Raw bytes from the hardware RNG are run through two running health
+    tests (a repetition count and an adaptive proportion test, after
+    SP 800-90B), then every TRNG_RAW_BYTES of them are hashed with
+    SHA-256 into TRNG_OUT_BYTES for the pool. The worker keeps the pool
+    topped up; a read that finds it short fills it on the spot. Bytes
+    are wiped from the pool as they are handed out.
+
+ *  @{
+ */
+
+/** @brief Bytes of conditioned output the pool holds */
+#define TRNG_POOL_BYTES 128
+
+/** @brief Raw bytes hashed into each TRNG_OUT_BYTES of output. Each
+    raw byte is assumed to hold 4 bits of entropy, so this is twice
+    what the output needs. */
+#define TRNG_RAW_BYTES  128
+#define TRNG_OUT_BYTES  32
+
+/** @brief Identical raw bytes in a row that fail the repetition count
+    test (1 + 20/H for H = 4 bits per byte) */
+#define TRNG_RCT_CUTOFF 6
+
+/** @brief Raw bytes per adaptive proportion test window, and how many
+    more bytes in the window equal to its first fail it (a false alarm
+    rate below 2^-20 for H = 4) */
+#define TRNG_APT_WINDOW 512
+#define TRNG_APT_CUTOFF 62
+
+/** @brief Raw bytes tested and thrown away before the first output */
+#define TRNG_STARTUP_BYTES 1024
+
+/** @brief Failed blocks in a row after which reads give up */
+#define TRNG_RETRY_MAX 4
+
+/** @brief Return a random byte from the entropy pool
+ *  Call this function using the MSEL_SVC_TRNG syscall
+ *
+ *  @param[out] out A random byte
+ *  @return MSEL status value: 
+ *    - MSEL_OK for succesful operation
+ *    - MSEL_EUNKNOWN if the hardware RNG keeps failing its health tests
+ */
+msel_status msel_trng_read_byte(uint8_t* out);
+
+/** @brief Fill a buffer from the entropy pool
+ *  Call this function using the MSEL_SVC_TRNG_READ syscall
+ *
+ *  @param args The buffer and its length
+ *  @return MSEL status value:
+ *    - MSEL_OK for succesful operation
+ *    - MSEL_EINVAL for a NULL buffer or too long a read
+ *    - MSEL_EUNKNOWN if the hardware RNG keeps failing its health tests
+ */
+msel_status msel_trng_do_read(msel_trng_args* args);
+
+/** @brief Refill the pool by one block if it has room. Called from
+    msel_svc_worker. */
+void msel_trng_worker();
+
+/** @brief Empty the pool and reset the health tests. Called from
+    msel_init, since the state lives in .kernel_private. */
+void msel_init_trng();
+
+/** @} */
+
+/** @} */
+
+#endif
@@ -25,16 +25,36 @@
 #include <msel/stdc.h>
 
 #include "os/syscall.h"
+#include "os/task.h"
+#include "os/util.h"
 #include "uart.h"
 #include "arch.h"
 
+/* Everything sent is first copied into a ring in kernel memory, which
+ * the TX-empty interrupt drains a FIFO's worth at a time. Nothing but
+ * uart_write_now (i.e. msel_panic) waits for the UART. */
+
+#define UART_TX_MASK (UART_TX_RING_SZ - 1)
+
+/* Bytes the 16550 takes once it reports its transmitter empty */
+#define UART_TX_FIFO_DEPTH 16
+
+/* Length of one "uart lost 0x........\r\n" line */
+#define UART_LOST_LEN 22
+
 uart_queue_entry uart_queue[MSEL_TASKS_MAX]; 
 
 int uart_enabled = 0;
 
+static uint8_t  uart_tx_ring[UART_TX_RING_SZ];
+static uint32_t uart_tx_head;    /* next byte to queue */
+static uint32_t uart_tx_tail;    /* next byte to send */
+static uint32_t uart_tx_dropped; /* kernel log bytes that didn't fit, not yet reported */
+
 void msel_init_uart()
 {
     msel_memset(uart_queue, 0, sizeof(uart_queue));
+    uart_tx_head = uart_tx_tail = uart_tx_dropped = 0;
     uart_enabled = arch_init_uart();
 }
 
@@ -57,41 +77,120 @@ int uart_print_now(const char* data)
     return uart_write_now(data, msel_strlen(data));
 }
 
-int uart_send_next_byte()
+/* Hand the UART as much of the ring as its FIFO takes */
+static void uart_tx_fill()
+{
+    size_t n;
+
+    if(!arch_uart_is_writable())
+        return;
+
+    for(n = 0; n < UART_TX_FIFO_DEPTH && uart_tx_tail != uart_tx_head; n++)
+        arch_uart_putc(uart_tx_ring[uart_tx_tail++ & UART_TX_MASK]);
+}
+
+/* Copy into the ring and make sure the interrupt will pick it up */
+static void uart_tx_queue(const uint8_t* data, size_t len)
+{
+    while(len--)
+        uart_tx_ring[uart_tx_head++ & UART_TX_MASK] = *data++;
+
+    uart_tx_fill();
+    arch_uart_tx_irq(uart_tx_tail != uart_tx_head);
+}
+
+void uart_tx_isr()
+{
+    uart_tx_fill();
+
+    /* Leaving it enabled with nothing to send would fire forever */
+    if(uart_tx_tail == uart_tx_head)
+        arch_uart_tx_irq(0);
+}
+
+void uart_tx_flush_now()
+{
+    while(uart_tx_tail != uart_tx_head)
+        uart_tx_fill();
+}
+
+size_t uart_log_space()
 {
-    /* make starting task num static to round robin */
-    static size_t task=0;
+    return UART_TX_RING_SZ - (uart_tx_head - uart_tx_tail);
+}
 
-    size_t modidx;
+size_t uart_task_space()
+{
+    size_t space = uart_log_space();
+    return space > UART_TX_RESERVE ? space - UART_TX_RESERVE : 0;
+}
+
+/* Room a kernel log write of len bytes needs, counting the report of
+ * earlier drops that has to go out ahead of it */
+static size_t uart_log_need(size_t len)
+{
+    return uart_tx_dropped ? len + UART_LOST_LEN : len;
+}
 
-    for(modidx=0; modidx<MSEL_TASKS_MAX; modidx++)
+msel_status uart_log_write(const char* data, size_t len)
+{
+    char lost[UART_LOST_LEN];
+
+    if(!uart_enabled)
+        return MSEL_ERESOURCE;
+
+    /* All or nothing, so the log is never missing half a line */
+    if(uart_log_need(len) > uart_log_space())
     {
-        size_t n = (task + modidx) % MSEL_TASKS_MAX;
-        
-        if(uart_queue[n].args.buf)
-        {
-            if(uart_queue[n].offset < uart_queue[n].args.len)
-            {
-                uint8_t* buf = uart_queue[n].args.buf;
-                size_t*  off = &(uart_queue[n].offset);
-                arch_uart_putc(buf[(*(off))++]);
-                task = n; /* save place for faster search next time */
-                return 1;
-            }
-        }
+        uart_tx_dropped += len;
+        return MSEL_ERESOURCE;
+    }
+
+    /* Say how much went missing before anything newer */
+    if(uart_tx_dropped)
+    {
+        msel_memcpy(lost, "uart lost 0x", 12);
+        fmt_hex(lost + 12, uart_tx_dropped, 8);
+        lost[20] = '\r';
+        lost[21] = '\n';
+        uart_tx_queue((const uint8_t*)lost, UART_LOST_LEN);
+        uart_tx_dropped = 0;
     }
-    return 0;
+
+    uart_tx_queue((const uint8_t*)data, len);
+    return MSEL_OK;
 }
 
-/* Send as much data off of the queue as is currently possible */
-void uart_flush_queue()
+msel_status uart_log(const char* msg)
 {
-    while(arch_uart_is_writable() && uart_send_next_byte());
+    return uart_log_write(msg, msel_strlen(msg));
+}
+
+void uart_log_drain(char* (*next_line)(char *out), size_t line_len, size_t max)
+{
+    char line[UART_LOG_LINE_MAX];
+    char *end;
+    size_t n;
+
+    for(n = 0; n < max && uart_log_need(line_len) <= uart_log_space(); n++)
+    {
+        if((end = next_line(line)) == NULL)
+            return;
+        uart_log_write(line, end - line);
+    }
 }
 
 msel_status msel_uart_write(msel_uart_write_args *wr_args)
 {
     msel_status ret = MSEL_EUNKNOWN;
+    uart_queue_entry *q = &uart_queue[msel_active_task_num];
+    size_t n;
+
+    if(!uart_enabled)
+    {
+        ret = MSEL_ERESOURCE;
+        goto cleanup;
+    }
 
     /* Sanity check user supplied arguments */
     if(!wr_args->buf || !wr_args->len)
@@ -101,36 +200,43 @@ msel_status msel_uart_write(msel_uart_write_args *wr_args)
     }
     
     /* Save in queue if this is a new reqest */
-    if(!uart_queue[msel_active_task_num].args.buf)
+    if(!q->args.buf)
     {
-        msel_memcpy(&(uart_queue[msel_active_task_num].args), wr_args, sizeof(*wr_args));
-        uart_queue[msel_active_task_num].offset = 0;
+        msel_memcpy(&(q->args), wr_args, sizeof(*wr_args));
+        q->offset = 0;
     }
 
     /* else assume this is a resume... a task suspended in another
      * write can not send again, after all... */
 
-    /* Try to flush it all out now, if possible */
+    /* Copy as much as fits, the rest waits for the ring to drain */
 retry:
-    uart_flush_queue();
+    n = q->args.len - q->offset;
+    if(n > uart_task_space())
+        n = uart_task_space();
+    uart_tx_queue(q->args.buf + q->offset, n);
+    q->offset += n;
 
-    if(uart_queue[msel_active_task_num].offset < uart_queue[msel_active_task_num].args.len)
+    if(q->offset < q->args.len)
     {
-        /* Main can never block, spin until empty */
+        /* Main can never block, push the ring out by hand */
         if(msel_active_task_num == MSEL_TASK_MAIN)
+        {
+            uart_tx_fill();
             goto retry;
+        }
 
-        /* Else suspend the syscall for later resume */
+        /* Else suspend the syscall for msel_main to restart */
         msel_active_task->wait_op = MSEL_TASK_WAIT_UART;
         msel_task_schedule();
         ret = MSEL_ESUSP;
         goto cleanup;
     }
 
-    /* Else all bytes for this call have been sent already, return success */
-    uart_queue[msel_active_task_num].args.buf = NULL;
-    uart_queue[msel_active_task_num].args.len = 0;
-    uart_queue[msel_active_task_num].offset   = 0;
+    /* Else all bytes for this call have been queued, return success */
+    q->args.buf = NULL;
+    q->args.len = 0;
+    q->offset   = 0;
     
     ret = MSEL_OK;
 cleanup:
@@ -26,6 +26,15 @@
 #include "msel.h"
 #include "msel/debug.h" /* Task-callable definitions here */
 
+/** @brief Size of the kernel's UART transmit ring (a power of two) */
+#ifndef UART_TX_RING_SZ
+#define UART_TX_RING_SZ 1024
+#endif
+
+/** @brief Ring space task writes leave free, so kernel logging still
+    gets through while tasks are printing */
+#define UART_TX_RESERVE 128
+
 typedef struct {
     uint8_t* buf;
     size_t  len;
@@ -37,6 +46,8 @@ typedef struct
     size_t offset;             /* current write progress */
 } uart_queue_entry;
 
+extern uart_queue_entry uart_queue[MSEL_TASKS_MAX];
+
 void msel_init_uart();
 //msel_status msel_uart_read(void *dst, size_t len, size_t *rdlen);
 //msel_status msel_uart_write(const void const* src, const size_t len);
@@ -44,6 +55,31 @@ void msel_init_uart();
 
 msel_status msel_uart_write(msel_uart_write_args *wr_args);
 
+/* Non-blocking output for the kernel. The message is copied into the
+ * transmit ring whole, or dropped (MSEL_ERESOURCE) if there isn't room
+ * for it. The next message that fits is preceded by a "uart lost 0x..."
+ * line giving the number of bytes dropped. Safe to call from any
+ * interrupt context, including the scheduler. */
+
+msel_status uart_log_write(const char* data, size_t len);
+msel_status uart_log(const char* msg);
+size_t      uart_log_space();
+
+/** @brief Longest line uart_log_drain formats */
+#define UART_LOG_LINE_MAX 32
+
+/* Log up to max lines from a kernel buffer, each formatted at out by
+ * next_line, which returns the end of the line or NULL once the buffer
+ * is empty. Stops early while the ring has less than line_len bytes
+ * free, so lines stay in their buffer until the UART catches up. */
+void        uart_log_drain(char* (*next_line)(char *out), size_t line_len, size_t max);
+
+/* Ring space a task write may use right now */
+size_t      uart_task_space();
+
+/* Called from the UART interrupt when the transmitter is empty */
+void        uart_tx_isr();
+
 /* These are *BLOCKING* and only to be called in an interrupt
  * context... and probably only from msel_panic when everything else
  * is hosed or at boot before tasking starts */
@@ -51,4 +87,8 @@ msel_status msel_uart_write(msel_uart_write_args *wr_args);
 int         uart_write_now(const char* data, size_t len);
 int         uart_print_now(const char* data);
 
+/* Sends whatever is still in the transmit ring, blocking, so that it
+ * comes out before a uart_print_now */
+void        uart_tx_flush_now();
+
 #endif
@@ -50,6 +50,36 @@ void aes_ecb_encrypt(aes_ctx_t *ctx, void *data_in, void *data_out) {
   msel_svc(MSEL_SVC_AES, &driver_ctx);
 }
 
+/** @brief Encrypt several blocks with AES at once, which saves a
+ *  system call and a key load per block
+ *
+ *  @param ctx Pointer to a valid AES context with a set key
+ *  @param data_in The data to be encrypted
+ *  @param block_count The size of the data, in AES blocks
+ *  @param data_out The resulting encrypted data
+ */
+void aes_ecb_encrypt_blocks(aes_ctx_t *ctx, void *data_in, uint32_t block_count, void *data_out) {
+  aes_driver_ctx_t driver_ctx;
+  driver_ctx.enc = 1;
+  driver_ctx.key_size = ctx->algo;
+  driver_ctx.key = ctx->key;
+  driver_ctx.data_len = block_count * AES_BLOCK_SIZE;
+  driver_ctx.din = data_in;
+  driver_ctx.dout = data_out;
+  msel_svc(MSEL_SVC_AES, &driver_ctx);
+}
+
+void aes_ecb_decrypt_blocks(aes_ctx_t *ctx, void *data_in, uint32_t block_count, void *data_out) {
+  aes_driver_ctx_t driver_ctx;
+  driver_ctx.enc = 0;
+  driver_ctx.key_size = ctx->algo;
+  driver_ctx.key = ctx->key;
+  driver_ctx.data_len = block_count * AES_BLOCK_SIZE;
+  driver_ctx.din = data_in;
+  driver_ctx.dout = data_out;
+  msel_svc(MSEL_SVC_AES, &driver_ctx);
+}
+
 /** @brief Decrypt data with AES
  *
  *  @param ctx Pointer to a valid AES context with a set key
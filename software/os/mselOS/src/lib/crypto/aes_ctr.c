@@ -0,0 +1,133 @@
+/** @file aes_ctr.c
+ *
+ *  Functions to use AES-CTR
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <crypto/aes_ctr.h>
+#include <msel/stdc.h>
+
+/** @brief Add one to a 128-bit big-endian counter block
+ *
+ *  @param ctr The counter block
+ */
+void aes_ctr_inc(uint8_t *ctr)
+{
+  uint32_t i;
+
+  for(i = AES_BLOCK_SIZE; i > 0; i--)
+  {
+    if(++ctr[i - 1] != 0)
+      break;
+  }
+  return;
+}
+
+/** @brief Encrypt a run of counter blocks, AES_CTR_BATCH_BLOCKS to a
+ *  system call
+ *
+ *  @param ctx A valid AES context, with a set key
+ *  @param ctr The first counter block. On return, the one after the last
+ *    used.
+ *  @param block_count How many blocks of keystream to make
+ *  @param data_out The keystream
+ */
+void aes_ctr_keystream(aes_ctx_t *ctx, uint8_t *ctr, uint32_t block_count, void *data_out)
+{
+  uint8_t *dout_ptr = (uint8_t *) data_out;
+  uint32_t i, n;
+
+  while(block_count > 0)
+  {
+    n = (block_count < AES_CTR_BATCH_BLOCKS) ? block_count : AES_CTR_BATCH_BLOCKS;
+
+    /* The counter blocks go where the keystream will, and are
+       encrypted in place */
+    for(i = 0; i < n; i++)
+    {
+      msel_memcpy(&dout_ptr[i * AES_BLOCK_SIZE], ctr, AES_BLOCK_SIZE);
+      aes_ctr_inc(ctr);
+    }
+    aes_ecb_encrypt_blocks(ctx, dout_ptr, n, dout_ptr);
+
+    dout_ptr += n * AES_BLOCK_SIZE;
+    block_count -= n;
+  }
+  return;
+}
+
+/** @brief Set the key and initial counter block for AES CTR mode
+ *
+ *  @param ctx A pointer to the AES-CTR context to be initialized
+ *  @param algo One of AES_128, AES_192, or AES_256
+ *  @param key A pointer to the key data, which must stay valid while the
+ *    context is used
+ *  @param iv The initial counter block (AES_BLOCK_SIZE bytes)
+ */
+void aes_ctr_setkey(aes_ctr_ctx_t *ctx, aes_algo_t algo, void *key, void *iv)
+{
+  aes_setkey(&ctx->e_ctx, algo, key);
+  msel_memcpy(ctx->ctr, iv, AES_BLOCK_SIZE);
+  ctx->ks_pos = sizeof(ctx->ks);
+  return;
+}
+
+/** @brief Encrypt or decrypt data using AES CTR mode
+ *
+ *  Keystream is made a batch at a time and what is left over is kept
+ *  for the next call, so the data may be split up any way at all.
+ *
+ *  @param ctx A valid AES_CTR context, with a set key
+ *  @param data_in The data to encrypt or decrypt
+ *  @param data_len The size of the data, in bytes
+ *  @param data_out The result. May be the same as data_in.
+ */
+void aes_ctr_crypt(aes_ctr_ctx_t *ctx, void *data_in, uint32_t data_len, void *data_out)
+{
+  uint8_t *din_ptr = (uint8_t *) data_in;
+  uint8_t *dout_ptr = (uint8_t *) data_out;
+  uint32_t i;
+
+  while(data_len > 0)
+  {
+    if(ctx->ks_pos == sizeof(ctx->ks))
+    {
+      aes_ctr_keystream(&ctx->e_ctx, ctx->ctr, AES_CTR_BATCH_BLOCKS, ctx->ks);
+      ctx->ks_pos = 0;
+    }
+
+    for(i = ctx->ks_pos; i < sizeof(ctx->ks) && data_len > 0; i++, data_len--)
+    {
+      *(dout_ptr++) = *(din_ptr++) ^ ctx->ks[i];
+      ctx->ks[i] = 0;
+    }
+    ctx->ks_pos = i;
+  }
+  return;
+}
+
+/** @brief Wipe the keystream and counter from an AES CTR context
+ *
+ *  @param ctx The context
+ */
+void aes_ctr_clear(aes_ctr_ctx_t *ctx)
+{
+  msel_memset(ctx->ks, 0, sizeof(ctx->ks));
+  msel_memset(ctx->ctr, 0, sizeof(ctx->ctr));
+  ctx->ks_pos = sizeof(ctx->ks);
+  return;
+}
@@ -56,21 +56,14 @@ void aes_xts_setkey(aes_xts_ctx_t *ctx, aes_xts_algo_t algo, void *key)
 /* IEEE 1619 - Annex C.2 */
 static const uint8_t gf_mulx_reduce[] = { 0x00, 0x87 };
 
-/** @brief Encrypt a block of data using AES XTS mode
- *
- *  @param ctx A valid AES_XTS context, with a set key
- *  @param data_in The data to encrypt
- *  @param block_count The size of the data to encrypt, in terms of 
- *    number of AES blocks
- *  @param sequence The location/sequence ID of the data to encrypt (e.g.,
- *    the sector ID when encrypting a filesystem)
- *  @param data_out The resulting encrypted data
- */
-void aes_xts_encrypt(aes_xts_ctx_t *ctx, void *data_in, uint32_t block_count,
-    uint64_t sequence, void *data_out)
+/* Every tweak of a run is known up front, so up to AES_XTS_BATCH_BLOCKS
+ * blocks are masked, sent through AES in one call and unmasked */
+static void aes_xts_crypt(aes_xts_ctx_t *ctx, int enc, void *data_in,
+    uint32_t block_count, uint64_t sequence, void *data_out)
 {
-  uint32_t i,j;
-  uint8_t T[AES_BLOCK_SIZE], x[AES_BLOCK_SIZE];
+  uint32_t i, j, n;
+  uint8_t T[AES_XTS_BATCH_BLOCKS + 1][AES_BLOCK_SIZE];
+  uint8_t x[AES_XTS_BATCH_BLOCKS][AES_BLOCK_SIZE];
   uint8_t Cin, Cout;
   uint8_t *din_ptr, *dout_ptr;
 
@@ -79,33 +72,64 @@ void aes_xts_encrypt(aes_xts_ctx_t *ctx, void *data_in, uint32_t block_count,
 
   for(j = 0; j < AES_BLOCK_SIZE; j++)
   {
-    T[j] = sequence;
+    T[0][j] = sequence;
     sequence >>= 8;
   }
 
-  aes_ecb_encrypt(&ctx->t_ctx, T, T);
+  aes_ecb_encrypt(&ctx->t_ctx, T[0], T[0]);
 
-  for(i = 0; i < block_count; i++)
+  while(block_count > 0)
   {
-    for(j = 0; j < AES_BLOCK_SIZE; j++)
-      x[j] = *(din_ptr++) ^ T[j];
-
-    aes_ecb_encrypt(&ctx->e_ctx, x, x);
+    n = (block_count < AES_XTS_BATCH_BLOCKS) ? block_count : AES_XTS_BATCH_BLOCKS;
 
-    for(j = 0; j < AES_BLOCK_SIZE; j++)
-      *(dout_ptr++) = x[j] ^ T[j];
-
-    for(j = 0, Cin = 0; j < AES_BLOCK_SIZE; j++)
+    for(i = 0; i < n; i++)
     {
-      Cout = T[j] >> 7;
-      T[j] = (T[j] << 1) | Cin;
-      Cin = Cout;
+      for(j = 0; j < AES_BLOCK_SIZE; j++)
+        x[i][j] = *(din_ptr++) ^ T[i][j];
+
+      /* T[i+1] = T[i] * x */
+      for(j = 0, Cin = 0; j < AES_BLOCK_SIZE; j++)
+      {
+        Cout = T[i][j] >> 7;
+        T[i + 1][j] = (T[i][j] << 1) | Cin;
+        Cin = Cout;
+      }
+      T[i + 1][0] ^= gf_mulx_reduce[Cout];
     }
-    T[0] ^= gf_mulx_reduce[Cout];
+
+    if(enc)
+      aes_ecb_encrypt_blocks(&ctx->e_ctx, x, n, x);
+    else
+      aes_ecb_decrypt_blocks(&ctx->e_ctx, x, n, x);
+
+    for(i = 0; i < n; i++)
+      for(j = 0; j < AES_BLOCK_SIZE; j++)
+        *(dout_ptr++) = x[i][j] ^ T[i][j];
+
+    /* the next batch starts from the tweak after the last block */
+    for(j = 0; j < AES_BLOCK_SIZE; j++)
+      T[0][j] = T[n][j];
+    block_count -= n;
   }
   return;
 }
 
+/** @brief Encrypt a block of data using AES XTS mode
+ *
+ *  @param ctx A valid AES_XTS context, with a set key
+ *  @param data_in The data to encrypt
+ *  @param block_count The size of the data to encrypt, in terms of 
+ *    number of AES blocks
+ *  @param sequence The location/sequence ID of the data to encrypt (e.g.,
+ *    the sector ID when encrypting a filesystem)
+ *  @param data_out The resulting encrypted data
+ */
+void aes_xts_encrypt(aes_xts_ctx_t *ctx, void *data_in, uint32_t block_count,
+    uint64_t sequence, void *data_out)
+{
+  aes_xts_crypt(ctx, 1, data_in, block_count, sequence, data_out);
+}
+
 /** @brief Decrypt a block of data using AES XTS mode
  *
  *  @param ctx A valid AES_XTS context, with a set key
@@ -119,38 +143,5 @@ void aes_xts_encrypt(aes_xts_ctx_t *ctx, void *data_in, uint32_t block_count,
 void aes_xts_decrypt(aes_xts_ctx_t *ctx, void *data_in, uint32_t block_count,
     uint64_t sequence, void *data_out)
 {
-  uint32_t i, j;
-  uint8_t T[AES_BLOCK_SIZE], x[AES_BLOCK_SIZE];
-  uint8_t Cin, Cout;
-  uint8_t *din_ptr, *dout_ptr;
-
-  din_ptr = (uint8_t *) data_in;
-  dout_ptr = (uint8_t *) data_out;
-
-  for(j = 0; j < AES_BLOCK_SIZE; j++)
-  {
-    T[j] = sequence;
-    sequence >>= 8;
-  }
-
-  aes_ecb_encrypt(&ctx->t_ctx, T, T);
-  for(i = 0; i < block_count; i++)
-  {
-    for(j = 0; j < AES_BLOCK_SIZE; j++)
-      x[j] = *(din_ptr++) ^ T[j];
-
-    aes_ecb_decrypt(&ctx->e_ctx, x, x);
-
-    for(j = 0; j < AES_BLOCK_SIZE; j++)
-      *(dout_ptr++) = x[j] ^ T[j];
-
-    for(j = 0, Cin = 0; j < AES_BLOCK_SIZE; j++)
-    {
-      Cout = T[j] >> 7;
-      T[j] = (T[j] << 1) | Cin;
-      Cin = Cout;
-    }
-    T[0] ^= gf_mulx_reduce[Cout];
-  }
-  return;
+  aes_xts_crypt(ctx, 0, data_in, block_count, sequence, data_out);
 }
@@ -0,0 +1,160 @@
+/** @file ctr_drbg.c
+ *
+ *  CTR_DRBG from NIST SP 800-90A, with AES and no derivation function
+ */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <crypto/ctr_drbg.h>
+#include <msel/stdc.h>
+
+/* CTR_DRBG_Update: run the counter for a seed's worth of blocks, mix in
+   provided (if any), and take the new key and V from the result. V
+   should already have been incremented to the first block to use. */
+static void ctr_drbg_update(ctr_drbg_ctx_t *ctx, const uint8_t *provided)
+{
+  uint8_t temp[CTR_DRBG_SEED_MAX + AES_BLOCK_SIZE];
+  uint32_t key_len = ctx->seed_len - AES_BLOCK_SIZE;
+  uint32_t i;
+
+  aes_ctr_keystream(&ctx->aes, ctx->v, (ctx->seed_len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE, temp);
+
+  if(provided)
+  {
+    for(i = 0; i < ctx->seed_len; i++)
+      temp[i] ^= provided[i];
+  }
+
+  msel_memcpy(ctx->key, temp, key_len);
+  msel_memcpy(ctx->v, &temp[key_len], AES_BLOCK_SIZE);
+
+  msel_memset(temp, 0, sizeof(temp));
+  return;
+}
+
+/** @brief Instantiate a CTR_DRBG
+ *
+ *  @param ctx The context to set up
+ *  @param algo One of AES_128, AES_192, or AES_256
+ *  @param entropy CTR_DRBG_SEED_SIZE(algo) bytes of full-entropy input
+ *  @param pers An optional personalization string of the same length,
+ *    or NULL
+ */
+void ctr_drbg_init(ctr_drbg_ctx_t *ctx, aes_algo_t algo, const void *entropy, const void *pers)
+{
+  uint8_t seed[CTR_DRBG_SEED_MAX];
+  const uint8_t *e = (const uint8_t *) entropy;
+  const uint8_t *p = (const uint8_t *) pers;
+  uint32_t i;
+
+  ctx->seed_len = CTR_DRBG_SEED_SIZE(algo);
+  for(i = 0; i < ctx->seed_len; i++)
+    seed[i] = e[i] ^ (p ? p[i] : 0);
+
+  msel_memset(ctx->key, 0, sizeof(ctx->key));
+  msel_memset(ctx->v, 0, sizeof(ctx->v));
+  aes_setkey(&ctx->aes, algo, ctx->key);
+  aes_ctr_inc(ctx->v);
+  ctr_drbg_update(ctx, seed);
+
+  ctx->reseed_counter = 1;
+  ctx->buf_pos = sizeof(ctx->buf);
+  msel_memset(seed, 0, sizeof(seed));
+  return;
+}
+
+/** @brief Reseed a CTR_DRBG
+ *
+ *  Output buffered from before is thrown away.
+ *
+ *  @param ctx A context set up by ctr_drbg_init
+ *  @param entropy The seed's worth of full-entropy input
+ *  @param add Optional additional input of the same length, or NULL
+ */
+void ctr_drbg_reseed(ctr_drbg_ctx_t *ctx, const void *entropy, const void *add)
+{
+  uint8_t seed[CTR_DRBG_SEED_MAX];
+  const uint8_t *e = (const uint8_t *) entropy;
+  const uint8_t *a = (const uint8_t *) add;
+  uint32_t i;
+
+  for(i = 0; i < ctx->seed_len; i++)
+    seed[i] = e[i] ^ (a ? a[i] : 0);
+  ctx->aes.key = ctx->key;
+  aes_ctr_inc(ctx->v);
+  ctr_drbg_update(ctx, seed);
+
+  ctx->reseed_counter = 1;
+  msel_memset(ctx->buf, 0, sizeof(ctx->buf));
+  ctx->buf_pos = sizeof(ctx->buf);
+  msel_memset(seed, 0, sizeof(seed));
+  return;
+}
+
+/** @brief Generate random bytes
+ *
+ *  @param ctx A context set up by ctr_drbg_init
+ *  @param data_out Where the bytes go
+ *  @param data_len How many to make
+ *  @return 0, or -1 if the DRBG needs reseeding first (nothing is
+ *    written then)
+ */
+int ctr_drbg_generate(ctr_drbg_ctx_t *ctx, void *data_out, uint32_t data_len)
+{
+  uint8_t *dout_ptr = (uint8_t *) data_out;
+  uint32_t n;
+
+  while(data_len > 0)
+  {
+    if(ctx->buf_pos == sizeof(ctx->buf))
+    {
+      if(ctx->reseed_counter > CTR_DRBG_RESEED_INTERVAL)
+        return -1;
+
+      /* One batch of output, then an update so that the state it came
+         from is gone. The batch leaves V at the block after it, where
+         the update starts. */
+      ctx->aes.key = ctx->key;
+      aes_ctr_inc(ctx->v);
+      aes_ctr_keystream(&ctx->aes, ctx->v, AES_CTR_BATCH_BLOCKS, ctx->buf);
+      ctr_drbg_update(ctx, NULL);
+      ctx->reseed_counter++;
+      ctx->buf_pos = 0;
+    }
+
+    n = sizeof(ctx->buf) - ctx->buf_pos;
+    if(n > data_len)
+      n = data_len;
+
+    msel_memcpy(dout_ptr, &ctx->buf[ctx->buf_pos], n);
+    msel_memset(&ctx->buf[ctx->buf_pos], 0, n);
+    ctx->buf_pos += n;
+    dout_ptr += n;
+    data_len -= n;
+  }
+  return 0;
+}
+
+/** @brief Wipe a CTR_DRBG context
+ *
+ *  @param ctx The context
+ */
+void ctr_drbg_clear(ctr_drbg_ctx_t *ctx)
+{
+  msel_memset(ctx, 0, sizeof(*ctx));
+  ctx->buf_pos = sizeof(ctx->buf);
+  return;
+}
@@ -31,18 +31,9 @@ void prng_init(prng_ctx_t *ctx, aes_algo_t algo, uint8_t *k, uint64_t v_lo, uint
   aes_setkey(&ctx->aes, algo, k);
 }
 
-void prng_output(prng_ctx_t *ctx, uint8_t *data_out) {
-  /* assert(NULL != ctx); */
-  /* assert(NULL != data_out); */
-  uint64_t *R = (uint64_t *)data_out;
+/* One output block R from I = E(DT), updating v */
+static void prng_step(prng_ctx_t *ctx, const uint64_t *I, uint64_t *R) {
   uint64_t t[2];
-  uint64_t I[2];
-  msel_memset(t, 0, sizeof(t));
-  msel_memset(I, 0, sizeof(t));
-
-  aes_ecb_encrypt(&ctx->aes, ctx->dt, I);
-  ctx->dt[0] += 1;
-  ctx->dt[1] += (0 == ctx->dt[0]) ? 1 : 0; /* add carry to hi if low overflowed to 0 */
 
   t[0] = I[0] ^ ctx->v[0];
   t[1] = I[1] ^ ctx->v[1];
@@ -51,4 +42,55 @@ void prng_output(prng_ctx_t *ctx, uint8_t *data_out) {
   t[0] = R[0] ^ I[0];
   t[1] = R[1] ^ I[1];
   aes_ecb_encrypt(&ctx->aes, t, ctx->v);
+  msel_memset(t, 0, sizeof(t));
+}
+
+static void prng_next_dt(prng_ctx_t *ctx) {
+  ctx->dt[0] += 1;
+  ctx->dt[1] += (0 == ctx->dt[0]) ? 1 : 0; /* add carry to hi if low overflowed to 0 */
+}
+
+void prng_output(prng_ctx_t *ctx, uint8_t *data_out) {
+  /* assert(NULL != ctx); */
+  /* assert(NULL != data_out); */
+  uint64_t I[2];
+
+  aes_ecb_encrypt(&ctx->aes, ctx->dt, I);
+  prng_next_dt(ctx);
+
+  prng_step(ctx, I, (uint64_t *)data_out);
+  msel_memset(I, 0, sizeof(I));
+}
+
+void prng_generate(prng_ctx_t *ctx, uint8_t *data_out, uint32_t data_len) {
+  /* assert(NULL != ctx); */
+  /* assert(NULL != data_out); */
+  uint64_t dt[PRNG_BATCH_BLOCKS][2];
+  uint64_t I[PRNG_BATCH_BLOCKS][2];
+  uint64_t R[2];
+  uint32_t i, n, len;
+
+  while (data_len > 0) {
+    /* The DT values are known ahead, so their encryptions go in one call */
+    n = (data_len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+    if (n > PRNG_BATCH_BLOCKS)
+      n = PRNG_BATCH_BLOCKS;
+    for (i = 0; i < n; i++) {
+      dt[i][0] = ctx->dt[0];
+      dt[i][1] = ctx->dt[1];
+      prng_next_dt(ctx);
+    }
+    aes_ecb_encrypt_blocks(&ctx->aes, dt, n, I);
+
+    for (i = 0; i < n; i++) {
+      prng_step(ctx, I[i], R);
+      len = (data_len < AES_BLOCK_SIZE) ? data_len : AES_BLOCK_SIZE;
+      msel_memcpy(data_out, R, len);
+      data_out += len;
+      data_len -= len;
+    }
+  }
+
+  msel_memset(I, 0, sizeof(I));
+  msel_memset(R, 0, sizeof(R));
 }
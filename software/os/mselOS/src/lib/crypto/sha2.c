@@ -52,8 +52,29 @@ static void sha2_update(sha2_ctx_t *ctx, const void *buf, uint64_t len)
 	uint32_t ncpy;
 	uint64_t Ntmp;
 	const uint8_t *bptr = (const uint8_t *) buf;
+	sha_blocks_t blocks;
 	while(len)
 	{
+		/* Whole blocks are hashed straight from buf, many to a call */
+		if(ctx->pos == 0 && len >= SHA256_INPUT_SIZE)
+		{
+			blocks.iv = ctx->data.iv;
+			blocks.din = bptr;
+			blocks.block_count = len / SHA256_INPUT_SIZE;
+			if(blocks.block_count > SHA256_BLOCKS_MAX)
+				blocks.block_count = SHA256_BLOCKS_MAX;
+			msel_svc(MSEL_SVC_SHA_BLOCKS, &blocks);
+
+			ncpy = blocks.block_count * SHA256_INPUT_SIZE;
+			bptr += ncpy;
+			len -= ncpy;
+
+			Ntmp = ctx->Nl + ((uint64_t) ncpy << 3);
+			ctx->Nh += (Ntmp < ctx->Nl) ? 1 : 0;
+			ctx->Nl = Ntmp;
+			continue;
+		}
+
 		ncpy = (SHA256_INPUT_SIZE - ctx->pos);
 		ncpy = (ncpy > len) ? len : ncpy;
 		msel_memcpy(&ctx->data.din[ctx->pos], bptr, ncpy);
@@ -90,11 +111,8 @@ static void sha2_final(sha2_ctx_t *ctx, void *buf)
 	}
 
 	msel_memset(&ctx->data.din[ctx->pos], 0, SHA256_INPUT_SIZE - ctx->pos);
-	for(i = 0, Ntmp = ctx->Nh, bptr = &ctx->data.din[SHA256_INPUT_SIZE - 15]; i < 8; i++)
-	{
-		*(bptr++) = (Ntmp >> 56);
-		Ntmp <<= 8;
-	}
+	/* SHA-256 has a 64-bit length; writing Nh as well would overwrite
+	 * the last bytes of the message */
 	for(i = 0, Ntmp = ctx->Nl, bptr = &ctx->data.din[SHA256_INPUT_SIZE - 8]; i < 8; i++)
 	{
 		*(bptr++) = (Ntmp >> 56);
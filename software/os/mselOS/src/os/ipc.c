@@ -0,0 +1,489 @@
+/** @file ipc.c
+
+    Bounded message channels between tasks. Small messages are copied
+    into the channel. Bigger ones can lend a page of the sender's heap
+    instead, which the receiver maps read-only in place. A task that
+    has to wait sleeps in MSEL_TASK_WAIT_IPC, and the call on the other
+    end of the channel finishes its syscall for it and wakes it.
+
+    The kernel may touch any task's RAM, so a sleeping task's buffers
+    are read and written directly whichever task is running.
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <msel/stdc.h>
+#include <msel/syscalls.h>
+
+#include "ipc.h"
+#include "task.h"
+#include "taskmem.h"
+#include "syscall.h"
+#include "arch.h"
+
+/** @brief Owner or borrower of a lent page that has neither */
+#define IPC_NOBODY 0xff
+
+/** @brief Marks a message that was copied rather than lent */
+#define IPC_NO_LEND 0xff
+
+/** @brief Marks a lent message whose owner died before it was received */
+#define IPC_DROPPED 0xfe
+
+typedef struct {
+    uint8_t  lend;                    /* index into ipc_lends, IPC_NO_LEND or IPC_DROPPED */
+    uint16_t len;
+    uint8_t  data[MSEL_IPC_MSG_MAX];
+} ipc_msg;
+
+/* Queued messages are only for their receiver, so the channels are kept
+ * out of .bss where every task could read them */
+static struct {
+    uint8_t used;
+    uint8_t head;                     /* oldest message */
+    uint8_t count;
+    ipc_msg msgs[MSEL_IPC_DEPTH];
+} ipc_chans[MSEL_IPC_CHANNELS] MSEL_KERNEL_PRIVATE;
+
+/* A page is out on loan from the time its message is queued until the
+ * receiver returns it, or until the owner dies while it is queued */
+static struct {
+    uint8_t* page;                    /* NULL if the slot is free */
+    uint8_t  owner;
+    uint8_t  borrower;                /* IPC_NOBODY while queued */
+} ipc_lends[MSEL_IPC_LENDS];
+
+static uint32_t ipc_ticket;
+
+void msel_init_ipc()
+{
+    msel_memset(ipc_chans, 0, sizeof(ipc_chans));
+    msel_memset(ipc_lends, 0, sizeof(ipc_lends));
+    ipc_ticket = 0;
+}
+
+msel_status msel_ipc_create(msel_ipc_id *ch)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_IPC_CHANNELS; i++)
+    {
+        if(ipc_chans[i].used)
+            continue;
+
+        ipc_chans[i].used  = 1;
+        ipc_chans[i].head  = 0;
+        ipc_chans[i].count = 0;
+        *ch = i;
+        return MSEL_OK;
+    }
+    return MSEL_ERESOURCE;
+}
+
+static inline int ipc_valid(const msel_ipc_args *args)
+{
+    return args->ch < MSEL_IPC_CHANNELS && ipc_chans[args->ch].used;
+}
+
+/* The slot a page is lent from, or with page NULL a free slot. -1 if
+ * there is none. */
+static int ipc_find_lend(const void *page)
+{
+    int i;
+
+    for(i = 0; i < MSEL_IPC_LENDS; i++)
+        if(ipc_lends[i].page == page)
+            return i;
+    return -1;
+}
+
+/* Put the active task to sleep on a channel. msel_main has to keep
+ * running, so it gets MSEL_EBUSY instead. */
+static msel_status ipc_sleep(msel_ipc_args *args, uint8_t op)
+{
+    if(msel_active_task_num == MSEL_TASK_MAIN)
+        return MSEL_EBUSY;
+
+    msel_active_task->wait_op          = MSEL_TASK_WAIT_IPC;
+    msel_active_task->state.ipc.args   = args;
+    msel_active_task->state.ipc.op     = op;
+    msel_active_task->state.ipc.ticket = ipc_ticket++;
+    msel_task_schedule();
+    return MSEL_ESUSP;
+}
+
+/* The task that has slept longest waiting to do op on a channel (or,
+ * for IPC_WAIT_RECLAIM, on a page). MSEL_TASKS_MAX if there is none. */
+static size_t ipc_oldest_waiter(uint8_t op, msel_ipc_id ch, const void *page)
+{
+    size_t    tnum, best = MSEL_TASKS_MAX;
+    msel_tcb *task;
+
+    for(tnum = 1; tnum < MSEL_TASKS_MAX; tnum++)
+    {
+        task = &msel_task_list[tnum];
+        if(!msel_task_is_waiting(task) || task->wait_op != MSEL_TASK_WAIT_IPC ||
+           task->state.ipc.op != op)
+            continue;
+
+        if(op == IPC_WAIT_RECLAIM ? task->state.ipc.args->buf != page
+                                  : task->state.ipc.args->ch != ch)
+            continue;
+
+        if(best == MSEL_TASKS_MAX ||
+           (int32_t)(task->state.ipc.ticket - msel_task_list[best].state.ipc.ticket) < 0)
+            best = tnum;
+    }
+    return best;
+}
+
+/* Finish a sleeping task's syscall successfully and let it run again */
+static void ipc_wake(size_t tnum)
+{
+    arch_task_set_result(&msel_task_list[tnum], MSEL_OK);
+    msel_task_resume(&msel_task_list[tnum]);
+}
+
+/* A lent page goes back to its owner */
+static void ipc_unlend(int idx)
+{
+    uint8_t *page = ipc_lends[idx].page;
+    size_t   owner;
+
+    if(ipc_lends[idx].borrower != IPC_NOBODY)
+        arch_mm_page_borrow(ipc_lends[idx].borrower, page, 0);
+    if(ipc_lends[idx].owner != IPC_NOBODY)
+        arch_mm_page_readonly(ipc_lends[idx].owner, page, 0);
+
+    ipc_lends[idx].page = NULL;
+
+    owner = ipc_oldest_waiter(IPC_WAIT_RECLAIM, 0, page);
+    if(owner != MSEL_TASKS_MAX)
+        ipc_wake(owner);
+}
+
+/* Add a message to a channel with room for it. A lend has been
+ * checked and has a free slot waiting. */
+static void ipc_enqueue(msel_ipc_id ch, uint8_t from, const msel_ipc_args *args, int lend)
+{
+    ipc_msg *msg = &ipc_chans[ch].msgs[(ipc_chans[ch].head + ipc_chans[ch].count) % MSEL_IPC_DEPTH];
+    int      idx;
+
+    msg->len = args->len;
+    msg->lend = IPC_NO_LEND;
+
+    if(lend)
+    {
+        idx = ipc_find_lend(NULL);
+        ipc_lends[idx].page     = args->buf;
+        ipc_lends[idx].owner    = from;
+        ipc_lends[idx].borrower = IPC_NOBODY;
+        arch_mm_page_readonly(from, args->buf, 1);
+        msg->lend = idx;
+    }
+    else
+    {
+        msel_memcpy(msg->data, args->buf, args->len);
+    }
+
+    ipc_chans[ch].count++;
+}
+
+/* Hand the oldest message to a receiver. Returns 0 if there is none. */
+static int ipc_dequeue(msel_ipc_id ch, uint8_t to, msel_ipc_args *args)
+{
+    ipc_msg *msg;
+
+    while(ipc_chans[ch].count > 0)
+    {
+        msg = &ipc_chans[ch].msgs[ipc_chans[ch].head];
+        ipc_chans[ch].head = (ipc_chans[ch].head + 1) % MSEL_IPC_DEPTH;
+        ipc_chans[ch].count--;
+
+        if(msg->lend == IPC_NO_LEND)
+        {
+            if(args->len > msg->len)
+                args->len = msg->len;
+            msel_memcpy(args->buf, msg->data, args->len);
+            args->lent = 0;
+            return 1;
+        }
+
+        /* The owner died before this was received */
+        if(msg->lend == IPC_DROPPED)
+            continue;
+
+        ipc_lends[msg->lend].borrower = to;
+        arch_mm_page_borrow(to, ipc_lends[msg->lend].page, 1);
+        args->buf  = ipc_lends[msg->lend].page;
+        args->len  = msg->len;
+        args->lent = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/* Move messages along for as long as sleeping senders have room and
+ * sleeping receivers have messages. Senders and lenders go in the order
+ * they arrived, except that a lender waiting for a free lend slot can't
+ * hold up senders behind it. */
+static void ipc_pump(msel_ipc_id ch)
+{
+    size_t tnum, lender;
+    int    progress;
+
+    do {
+        progress = 0;
+
+        if(ipc_chans[ch].count < MSEL_IPC_DEPTH)
+        {
+            tnum   = ipc_oldest_waiter(IPC_WAIT_SEND, ch, NULL);
+            lender = MSEL_TASKS_MAX;
+            if(ipc_find_lend(NULL) >= 0)
+                lender = ipc_oldest_waiter(IPC_WAIT_LEND, ch, NULL);
+
+            if(lender != MSEL_TASKS_MAX &&
+               (tnum == MSEL_TASKS_MAX ||
+                (int32_t)(msel_task_list[lender].state.ipc.ticket -
+                          msel_task_list[tnum].state.ipc.ticket) < 0))
+                tnum = lender;
+
+            if(tnum != MSEL_TASKS_MAX)
+            {
+                ipc_enqueue(ch, tnum, msel_task_list[tnum].state.ipc.args,
+                            msel_task_list[tnum].state.ipc.op == IPC_WAIT_LEND);
+                ipc_wake(tnum);
+                progress = 1;
+            }
+        }
+
+        if(ipc_chans[ch].count > 0)
+        {
+            tnum = ipc_oldest_waiter(IPC_WAIT_RECV, ch, NULL);
+            if(tnum != MSEL_TASKS_MAX &&
+               ipc_dequeue(ch, tnum, msel_task_list[tnum].state.ipc.args))
+            {
+                ipc_wake(tnum);
+                progress = 1;
+            }
+        }
+    } while(progress);
+}
+
+/* After a lend slot frees up, any channel may have a lender waiting */
+static void ipc_pump_all()
+{
+    size_t ch;
+
+    for(ch = 0; ch < MSEL_IPC_CHANNELS; ch++)
+        if(ipc_chans[ch].used)
+            ipc_pump(ch);
+}
+
+msel_status msel_ipc_do_send(msel_ipc_args *args)
+{
+    if(!ipc_valid(args) || args->buf == NULL ||
+       args->len == 0 || args->len > MSEL_IPC_MSG_MAX)
+        return MSEL_EINVAL;
+
+    if(ipc_chans[args->ch].count == MSEL_IPC_DEPTH)
+        return ipc_sleep(args, IPC_WAIT_SEND);
+
+    ipc_enqueue(args->ch, msel_active_task_num, args, 0);
+    ipc_pump(args->ch);
+    return MSEL_OK;
+}
+
+msel_status msel_ipc_do_lend(msel_ipc_args *args)
+{
+    uint8_t *page  = args->buf;
+    uint8_t *start = msel_active_task->heap;
+    uint8_t *end   = taskmem_heap_end(msel_active_task_num);
+
+    if(!ipc_valid(args) || args->len == 0 || args->len > PAGE_SIZE)
+        return MSEL_EINVAL;
+
+    /* Only whole pages of the caller's heap can be protected on their
+     * own, and each page can only be out once */
+    if(((uintptr_t)page & (PAGE_SIZE - 1)) != 0 ||
+       page < start || page + PAGE_SIZE > end || ipc_find_lend(page) >= 0)
+        return MSEL_EINVAL;
+
+    if(ipc_chans[args->ch].count == MSEL_IPC_DEPTH || ipc_find_lend(NULL) < 0)
+        return ipc_sleep(args, IPC_WAIT_LEND);
+
+    ipc_enqueue(args->ch, msel_active_task_num, args, 1);
+    ipc_pump(args->ch);
+    return MSEL_OK;
+}
+
+msel_status msel_ipc_do_recv(msel_ipc_args *args)
+{
+    if(!ipc_valid(args))
+        return MSEL_EINVAL;
+
+    if(!ipc_dequeue(args->ch, msel_active_task_num, args))
+        return ipc_sleep(args, IPC_WAIT_RECV);
+
+    /* Room for anyone waiting to send */
+    ipc_pump(args->ch);
+    return MSEL_OK;
+}
+
+msel_status msel_ipc_do_return(msel_ipc_args *args)
+{
+    int idx = ipc_find_lend(args->buf);
+
+    if(args->buf == NULL || idx < 0 || ipc_lends[idx].borrower != msel_active_task_num)
+        return MSEL_EINVAL;
+
+    ipc_unlend(idx);
+    ipc_pump_all();
+    return MSEL_OK;
+}
+
+msel_status msel_ipc_do_reclaim(msel_ipc_args *args)
+{
+    int idx = ipc_find_lend(args->buf);
+
+    if(args->buf == NULL || idx < 0 || ipc_lends[idx].owner != msel_active_task_num)
+        return MSEL_OK;
+
+    return ipc_sleep(args, IPC_WAIT_RECLAIM);
+}
+
+void* msel_ipc_task_page(uint8_t tasknum, size_t idx)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_IPC_LENDS; i++)
+    {
+        if(ipc_lends[i].page == NULL ||
+           (ipc_lends[i].owner != tasknum && ipc_lends[i].borrower != tasknum))
+            continue;
+        if(idx-- == 0)
+            return ipc_lends[i].page;
+    }
+    return NULL;
+}
+
+/* Drop the queued message that lends slot idx, freeing the slot */
+static void ipc_drop_lend(int idx)
+{
+    size_t ch, i;
+    ipc_msg *msg;
+
+    for(ch = 0; ch < MSEL_IPC_CHANNELS; ch++)
+    {
+        for(i = 0; i < ipc_chans[ch].count; i++)
+        {
+            msg = &ipc_chans[ch].msgs[(ipc_chans[ch].head + i) % MSEL_IPC_DEPTH];
+            if(msg->lend == idx)
+                msg->lend = IPC_DROPPED;
+        }
+    }
+    ipc_lends[idx].page = NULL;
+}
+
+void msel_ipc_release_task(uint8_t tasknum)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_IPC_LENDS; i++)
+    {
+        if(ipc_lends[i].page == NULL)
+            continue;
+
+        if(ipc_lends[i].borrower == tasknum)
+        {
+            ipc_unlend(i);
+        }
+        else if(ipc_lends[i].owner == tasknum)
+        {
+            /* The page is about to be given to some other task */
+            if(ipc_lends[i].borrower != IPC_NOBODY)
+            {
+                ipc_lends[i].owner = IPC_NOBODY;
+                ipc_unlend(i);
+            }
+            else
+            {
+                /* Still queued, so nobody has it mapped. Free the slot
+                 * now rather than when the message is received. */
+                ipc_drop_lend(i);
+            }
+        }
+    }
+
+    ipc_pump_all();
+}
+
+/* Task-callable wrappers */
+
+msel_status msel_ipc_send(msel_ipc_id ch, const void *buf, size_t len)
+{
+    msel_ipc_args args;
+
+    args.ch  = ch;
+    args.buf = (void*)buf;
+    args.len = len;
+    return msel_svc(MSEL_SVC_IPC_SEND, &args);
+}
+
+msel_status msel_ipc_lend(msel_ipc_id ch, const void *page, size_t len)
+{
+    msel_ipc_args args;
+
+    args.ch  = ch;
+    args.buf = (void*)page;
+    args.len = len;
+    return msel_svc(MSEL_SVC_IPC_LEND, &args);
+}
+
+msel_status msel_ipc_recv(msel_ipc_id ch, void *buf, size_t *len, const void **lent)
+{
+    msel_ipc_args args;
+    msel_status   ret;
+
+    args.ch   = ch;
+    args.buf  = buf;
+    args.len  = *len;
+    args.lent = 0;
+    ret = msel_svc(MSEL_SVC_IPC_RECV, &args);
+
+    if(ret == MSEL_OK)
+    {
+        *len  = args.len;
+        *lent = args.lent ? args.buf : NULL;
+    }
+    return ret;
+}
+
+msel_status msel_ipc_return(const void *page)
+{
+    msel_ipc_args args;
+
+    args.buf = (void*)page;
+    return msel_svc(MSEL_SVC_IPC_RETURN, &args);
+}
+
+msel_status msel_ipc_reclaim(const void *page)
+{
+    msel_ipc_args args;
+
+    args.buf = (void*)page;
+    return msel_svc(MSEL_SVC_IPC_RECLAIM, &args);
+}
@@ -0,0 +1,70 @@
+/** @file ipc.h
+
+    Kernel side of the message channels (see include/msel/ipc.h)
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MSEL_IPC_H_
+#define _MSEL_IPC_H_
+
+#include <stdint.h>
+
+#include <msel.h>
+#include <msel/ipc.h>
+
+/** @brief Number of channels */
+#define MSEL_IPC_CHANNELS 4
+
+/** @brief Messages a channel holds before senders have to wait */
+#define MSEL_IPC_DEPTH 4
+
+/** @brief Pages that may be out on loan at once */
+#define MSEL_IPC_LENDS 8
+
+/** @brief What a task sleeping on a channel is waiting to do */
+typedef enum {
+    IPC_WAIT_SEND,
+    IPC_WAIT_LEND,
+    IPC_WAIT_RECV,
+    IPC_WAIT_RECLAIM
+} msel_ipc_wait_op;
+
+/** @brief State of a task sleeping on a channel */
+typedef struct
+{
+    msel_ipc_args* args;   /* the suspended call's argument */
+    uint8_t        op;     /* msel_ipc_wait_op */
+    uint32_t       ticket; /* order of arrival, oldest goes first */
+} msel_ws_ipc;
+
+/* Syscall handlers */
+msel_status msel_ipc_do_send(msel_ipc_args *args);
+msel_status msel_ipc_do_lend(msel_ipc_args *args);
+msel_status msel_ipc_do_recv(msel_ipc_args *args);
+msel_status msel_ipc_do_return(msel_ipc_args *args);
+msel_status msel_ipc_do_reclaim(msel_ipc_args *args);
+
+/** @brief The idx'th page lent by or to a task, for the memory
+    protection code. NULL once there are no more. */
+void* msel_ipc_task_page(uint8_t tasknum, size_t idx);
+
+/** @brief Take back everything a task lent or borrowed, on its way out */
+void msel_ipc_release_task(uint8_t tasknum);
+
+void msel_init_ipc();
+
+#endif
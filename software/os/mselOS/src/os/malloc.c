@@ -48,13 +48,38 @@ inline void msel_free(void* ptr)
     heap_free(malloc_get_task_heap(),ptr);
 }
 
+/* Objects carved out of each new slab, by size class. Kept small since
+ * the whole slab stays allocated while any one of its objects is in use. */
+static const uint8_t slab_objs[SLAB_CLASS_COUNT] = { 8, 8, 4, 4, 2 };
+
 static inline uint32_t get_bucket_idx(uint32_t size)
 {
 	uint32_t ret;
 
-	ret = size >> BUCKET_SHIFT;
-	if(ret >= BUCKET_COUNT)
-		ret = BUCKET_COUNT - 1;
+	ret = 0;
+	size >>= BUCKET_SHIFT + 1;
+	while(size && ret < BUCKET_COUNT - 1)
+	{
+		size >>= 1;
+		ret++;
+	}
+	return ret;
+}
+
+static inline uint32_t get_slab_cls(uint32_t size)
+{
+	uint32_t ret;
+
+	ret = 0;
+	if(size > ALIGN_SIZE)
+	{
+		size = (size - 1) >> BUCKET_SHIFT;
+		while(size)
+		{
+			size >>= 1;
+			ret++;
+		}
+	}
 	return ret;
 }
 
@@ -162,15 +187,15 @@ static void chunk_split(HEAP *heap, HEADER *hdr, uint32_t size)
 	return;
 }
 
-void heap_init(void *base_ptr, void *end_ptr)
+/* Everything heap_init writes except the footer of the free chunk,
+ * which lies at the far end of the heap. Returns the free chunk. */
+static HEADER *heap_init_header(void *base_ptr, void *end_ptr)
 {
 	int i;
 	uint8_t *ptr, *eptr;
 	uint32_t bucket_idx;
 	HEAP *heap;
 	HEADER *hdr;
-	FOOTER *ftr;
-
 
 	ptr = (uint8_t *) base_ptr;
 	eptr = (uint8_t *) end_ptr;
@@ -180,11 +205,15 @@ void heap_init(void *base_ptr, void *end_ptr)
 	heap = (HEAP *) base_ptr;
 	for(i = 0; i < BUCKET_COUNT; i++)
 		heap->free_list[i] = NULL;
+	for(i = 0; i < SLAB_CLASS_COUNT; i++)
+		heap->slabs[i] = NULL;
 
 	ptr += HEAP_SIZE;
 
 	heap->start = ptr;
 	heap->end = eptr;
+	msel_memset(&heap->stats, 0, sizeof(heap->stats));
+	heap->stats.size = eptr - ptr;
 
 	hdr = (HEADER *) ptr;
 
@@ -192,13 +221,53 @@ void heap_init(void *base_ptr, void *end_ptr)
 	eptr -= sizeof(FOOTER);
 
 	HEAP_ASSERT(eptr - ptr >= ALIGN_SIZE);
-	ftr = (FOOTER *) eptr;
-	ftr->s.size = hdr->s.size = (eptr - ptr) | CHUNK_FREE;
+	hdr->s.size = (eptr - ptr) | CHUNK_FREE;
 	hdr->s.next = hdr->s.prev = NULL;
 
 	bucket_idx = get_bucket_idx(hdr->s.size);
 	heap->free_list[bucket_idx] = hdr;
-	return;
+	return hdr;
+}
+
+void heap_init(void *base_ptr, void *end_ptr)
+{
+	HEADER *hdr;
+	FOOTER *ftr;
+
+	hdr = heap_init_header(base_ptr, end_ptr);
+	ftr = get_footer_from_header(hdr);
+	ftr->s.size = hdr->s.size;
+}
+
+void heap_template(void *tmpl, uint32_t size)
+{
+	heap_init_header(tmpl, (uint8_t *) tmpl + size);
+}
+
+void heap_init_from(void *base_ptr, const void *tmpl)
+{
+	int i;
+	uintptr_t delta;
+	HEAP *heap;
+	HEADER *hdr;
+	FOOTER *ftr;
+
+	/* The header only points into the heap itself, so moving it is a
+	 * matter of adding the distance to every pointer */
+	msel_memcpy(base_ptr, tmpl, HEAP_TEMPLATE_SIZE);
+	delta = (uintptr_t) base_ptr - (uintptr_t) tmpl;
+	heap = (HEAP *) base_ptr;
+	heap->start = (uint8_t *) heap->start + delta;
+	heap->end = (uint8_t *) heap->end + delta;
+	for(i = 0; i < BUCKET_COUNT; i++)
+	{
+		if(heap->free_list[i])
+			heap->free_list[i] = (HEADER *) ((uint8_t *) heap->free_list[i] + delta);
+	}
+
+	hdr = (HEADER *) heap->start;
+	ftr = get_footer_from_header(hdr);
+	ftr->s.size = hdr->s.size;
 }
 
 #ifdef HEAP_DEBUG
@@ -207,6 +276,7 @@ void heap_print(void *base_ptr)
 	int i;
 	HEAP *heap;
 	HEADER *hdr;
+	SLAB *slab;
 	FOOTER *ftr;
 
 	heap = (HEAP *) base_ptr;
@@ -219,6 +289,14 @@ void heap_print(void *base_ptr)
 			printf("\t\tchk: %p prev: %p next: %p\n", hdr, hdr->s.prev, hdr->s.next);
 		}
 	}
+	for(i = 0; i < SLAB_CLASS_COUNT; i++)
+	{
+		printf("\tslabs[%u]: %p\n", i, heap->slabs[i]);
+		for(slab = heap->slabs[i]; slab; slab = slab->s.next)
+		{
+			printf("\t\tslab: %p used: %u free: %p\n", slab, slab->s.used, slab->s.free);
+		}
+	}
 
 	printf("heap:");
 	for(hdr = heap->start; hdr < (HEADER *) heap->end; hdr = get_next_chunk(hdr))
@@ -267,7 +345,7 @@ int valid_fail(void *base_ptr, void **ptrs, uint32_t n_ptrs, void *fail_ptr, uin
 			}
 			HEAP_ASSERT(chk != NULL);
 		}
-		else
+		else if(!(flags & CHUNK_SLAB))
 		{
 			/* chunk hdr is marked as in use, make sure it is in the list of pointers */
 			for(i = 0; i < n_ptrs; i++)
@@ -291,6 +369,10 @@ int valid_fail(void *base_ptr, void **ptrs, uint32_t n_ptrs, void *fail_ptr, uin
 		flags = CHUNK_FLAGS(hdr);
 		HEAP_ASSERT((flags & CHUNK_FREE) == 0);
 
+		/* slab objects are checked against the chunk holding their slab */
+		if(flags & CHUNK_OBJ)
+			hdr = get_header_from_ptr(hdr->o.slab);
+
 		for(chk = heap->start; chk < (HEADER *) heap->end; chk = get_next_chunk(chk))
 		{
 			if(chk == hdr)
@@ -299,7 +381,7 @@ int valid_fail(void *base_ptr, void **ptrs, uint32_t n_ptrs, void *fail_ptr, uin
 		HEAP_ASSERT(chk < (HEADER *) heap->end);
 	}
 
-	if(fail_ptr)
+	if(fail_ptr && !(CHUNK_FLAGS(get_header_from_ptr(fail_ptr)) & CHUNK_OBJ))
 	{
 		/* check why realloc failed */
 		hdr = get_header_from_ptr(fail_ptr);
@@ -319,34 +401,211 @@ int valid_fail(void *base_ptr, void **ptrs, uint32_t n_ptrs, void *fail_ptr, uin
 	{
 		HEAP_ASSERT(CHUNK_SIZE(hdr) < fail_alloc);
 	}
+	for(bucket_idx++; bucket_idx < BUCKET_COUNT; bucket_idx++)
+		HEAP_ASSERT(heap->free_list[bucket_idx] == NULL);
 	return 0;
 }
 #endif /* HEAP_DEBUG */
 
-void *heap_malloc(void *base_ptr, uint32_t size)
+/* Take a chunk of at least size bytes (already aligned) off the free lists */
+static void *chunk_alloc(HEAP *heap, uint32_t size)
 {
 	uint32_t bucket_idx;
 	uint8_t *ptr;
-	HEAP *heap;
 	HEADER *hdr;
 
-	size = (size + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
-	heap = (HEAP *) base_ptr;
-	for(bucket_idx = get_bucket_idx(size); bucket_idx < BUCKET_COUNT; bucket_idx++)
+	/* only the smallest bucket that may fit needs searching, since any
+	 * chunk in a larger bucket is big enough */
+	bucket_idx = get_bucket_idx(size);
+	for(hdr = heap->free_list[bucket_idx]; hdr; hdr = hdr->s.next)
 	{
-		for(hdr = heap->free_list[bucket_idx]; hdr; hdr = hdr->s.next)
+		if(CHUNK_SIZE(hdr) >= size)
+			break;
+	}
+	for(bucket_idx++; !hdr && bucket_idx < BUCKET_COUNT; bucket_idx++)
+		hdr = heap->free_list[bucket_idx];
+	if(!hdr)
+		return NULL;
+
+	/* count the whole chunk as used, chunk_split gives back any remainder */
+	freelist_unlink(heap, hdr);
+	heap->stats.in_use += CHUNK_SIZE(hdr) + sizeof(HEADER) + sizeof(FOOTER);
+	chunk_split(heap, hdr, size);
+	if(heap->stats.in_use > heap->stats.peak)
+		heap->stats.peak = heap->stats.in_use;
+
+	ptr = (uint8_t *) hdr;
+	ptr += sizeof(HEADER);
+	return ((void *) ptr);
+}
+
+static void slab_unlink(HEAP *heap, SLAB *slab)
+{
+	if(slab->s.prev)
+		slab->s.prev->s.next = slab->s.next;
+	else
+		heap->slabs[slab->s.cls] = slab->s.next;
+	if(slab->s.next)
+		slab->s.next->s.prev = slab->s.prev;
+	slab->s.next = slab->s.prev = NULL;
+}
+
+static void slab_link(HEAP *heap, SLAB *slab)
+{
+	slab->s.prev = NULL;
+	slab->s.next = heap->slabs[slab->s.cls];
+	if(slab->s.next)
+		slab->s.next->s.prev = slab;
+	heap->slabs[slab->s.cls] = slab;
+}
+
+static SLAB *slab_create(HEAP *heap, uint32_t cls)
+{
+	uint32_t i, obj_size;
+	uint8_t *ptr;
+	SLAB *slab;
+	HEADER *hdr, **link;
+	FOOTER *ftr;
+
+	obj_size = ALIGN_SIZE << cls;
+	slab = chunk_alloc(heap, sizeof(SLAB) + slab_objs[cls] * (sizeof(HEADER) + obj_size));
+	if(!slab)
+		return NULL;
+
+	hdr = get_header_from_ptr(slab);
+	ftr = get_footer_from_header(hdr);
+	hdr->s.size |= CHUNK_SLAB;
+	ftr->s.size = hdr->s.size;
+
+	slab->s.cls = cls;
+	slab->s.used = 0;
+	link = &slab->s.free;
+	ptr = (uint8_t *) slab + sizeof(SLAB);
+	for(i = 0; i < slab_objs[cls]; i++)
+	{
+		hdr = (HEADER *) ptr;
+		hdr->o.size = obj_size | CHUNK_OBJ | CHUNK_FREE;
+		hdr->o.slab = slab;
+		*link = hdr;
+		link = &hdr->o.next;
+		ptr += sizeof(HEADER) + obj_size;
+	}
+	*link = NULL;
+
+	slab_link(heap, slab);
+	return slab;
+}
+
+static void slab_destroy(HEAP *heap, SLAB *slab)
+{
+	HEADER *hdr;
+	FOOTER *ftr;
+
+	slab_unlink(heap, slab);
+	hdr = get_header_from_ptr(slab);
+	ftr = get_footer_from_header(hdr);
+	hdr->s.size &= ~CHUNK_SLAB;
+	ftr->s.size = hdr->s.size;
+	heap_free(heap, slab);
+}
+
+/* Hand back every cached empty slab to the general heap, returning
+ * non-zero if anything was released */
+static int slab_reclaim(HEAP *heap)
+{
+	int ret;
+	uint32_t i;
+	SLAB *slab, *next;
+
+	ret = 0;
+	for(i = 0; i < SLAB_CLASS_COUNT; i++)
+	{
+		for(slab = heap->slabs[i]; slab; slab = next)
 		{
-			if(CHUNK_SIZE(hdr) >= size)
+			next = slab->s.next;
+			if(slab->s.used == 0)
 			{
-				freelist_unlink(heap, hdr);
-				chunk_split(heap, hdr, size);
-				ptr = (uint8_t *) hdr;
-				ptr += sizeof(HEADER);
-				return ((void *) ptr);
+				slab_destroy(heap, slab);
+				ret = 1;
 			}
 		}
 	}
-	return NULL;
+	return ret;
+}
+
+static void *slab_alloc(HEAP *heap, uint32_t size)
+{
+	uint32_t cls;
+	SLAB *slab;
+	HEADER *hdr;
+
+	cls = get_slab_cls(size);
+	slab = heap->slabs[cls];
+	if(!slab)
+	{
+		slab = slab_create(heap, cls);
+		if(!slab)
+			return NULL;
+	}
+
+	hdr = slab->s.free;
+	HEAP_ASSERT(hdr && (CHUNK_FLAGS(hdr) & CHUNK_FREE));
+	slab->s.free = hdr->o.next;
+	slab->s.used++;
+	hdr->o.size &= ~CHUNK_FREE;
+
+	/* full slabs drop off the list until something in them is freed */
+	if(!slab->s.free)
+		slab_unlink(heap, slab);
+	return ((void *) (hdr + 1));
+}
+
+static void slab_free(HEAP *heap, HEADER *hdr)
+{
+	SLAB *slab;
+
+	HEAP_ASSERT((hdr->o.size & CHUNK_FREE) == 0);
+	slab = hdr->o.slab;
+	hdr->o.size |= CHUNK_FREE;
+
+	if(!slab->s.free)
+		slab_link(heap, slab);
+	hdr->o.next = slab->s.free;
+	slab->s.free = hdr;
+
+	/* keep one empty slab per class around so that a task allocating and
+	 * freeing a single object doesn't carve a new slab every time */
+	if(--slab->s.used == 0 && (slab->s.next || slab->s.prev))
+		slab_destroy(heap, slab);
+}
+
+void *heap_malloc(void *base_ptr, uint32_t size)
+{
+	void *ptr;
+	HEAP *heap;
+
+	size = (size + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
+	heap = (HEAP *) base_ptr;
+
+	if(size <= SLAB_MAX_SIZE)
+	{
+		ptr = slab_alloc(heap, size);
+		if(ptr)
+		{
+			heap->stats.allocs++;
+			return ptr;
+		}
+	}
+
+	ptr = chunk_alloc(heap, size);
+	if(!ptr && slab_reclaim(heap))
+		ptr = chunk_alloc(heap, size);
+
+	if(ptr)
+		heap->stats.allocs++;
+	else
+		heap->stats.failed++;
+	return ptr;
 }
 
 void *heap_realloc(void *base_ptr, void *ptr, uint32_t size)
@@ -362,6 +621,20 @@ void *heap_realloc(void *base_ptr, void *ptr, uint32_t size)
 	p -= sizeof(HEADER);
 	hdr = (HEADER *) p;
 
+	/* slab objects can't grow in place */
+	if(CHUNK_FLAGS(hdr) & CHUNK_OBJ)
+	{
+		HEAP_ASSERT((hdr->o.size & CHUNK_FREE) == 0);
+		if(CHUNK_SIZE(hdr) >= size)
+			return ptr;
+		p = heap_malloc(base_ptr, size);
+		if(!p)
+			return NULL;
+		msel_memcpy(p, ptr, CHUNK_SIZE(hdr));
+		slab_free(heap, hdr);
+		return ((void *) p);
+	}
+
 #ifdef HEAP_DEBUG
 	HEAP_ASSERT((hdr->s.size & CHUNK_FREE) == 0);
 	ftr = get_footer_from_header(hdr);
@@ -379,6 +652,7 @@ void *heap_realloc(void *base_ptr, void *ptr, uint32_t size)
 			hdr->s.size += CHUNK_SIZE(chk_hdr) + sizeof(HEADER) + sizeof(FOOTER);
 			ftr = get_footer_from_header(hdr);
 			ftr->s.size = hdr->s.size;
+			heap->stats.in_use += CHUNK_SIZE(chk_hdr) + sizeof(HEADER) + sizeof(FOOTER);
 		}
 
 		/* if the current chunk is still too small, allocate new memory
@@ -389,7 +663,7 @@ void *heap_realloc(void *base_ptr, void *ptr, uint32_t size)
 			p = heap_malloc(base_ptr, size);
 			if(!p)
 				return NULL;
-			msel_memcpy(p, ptr, size);
+			msel_memcpy(p, ptr, CHUNK_SIZE(hdr));
 			heap_free(base_ptr, ptr);
 			return ((void *) p);
 		}
@@ -398,6 +672,8 @@ void *heap_realloc(void *base_ptr, void *ptr, uint32_t size)
 	}
 
 	chunk_split(heap, hdr, size);
+	if(heap->stats.in_use > heap->stats.peak)
+		heap->stats.peak = heap->stats.in_use;
 	return ptr;
 }
 
@@ -410,6 +686,11 @@ void heap_free(void *base_ptr, void *ptr)
 
 	heap = (HEAP *) base_ptr;
 	hdr = get_header_from_ptr(ptr);
+	if(CHUNK_FLAGS(hdr) & CHUNK_OBJ)
+	{
+		slab_free(heap, hdr);
+		return;
+	}
 	ftr = get_footer_from_header(hdr);
 
 	HEAP_ASSERT(hdr >= (HEADER *) heap->start);
@@ -417,6 +698,7 @@ void heap_free(void *base_ptr, void *ptr)
 	HEAP_ASSERT((hdr->s.size & CHUNK_FREE) == 0);
 	HEAP_ASSERT(hdr->s.size == ftr->s.size);
 
+	heap->stats.in_use -= CHUNK_SIZE(hdr) + sizeof(HEADER) + sizeof(FOOTER);
 	hdr->s.size |= CHUNK_FREE;
 	ftr->s.size = hdr->s.size;
 
@@ -454,3 +736,53 @@ void heap_free(void *base_ptr, void *ptr)
 	heap->free_list[bucket_idx] = hdr;
 	return;
 }
+
+/* Fill in largest_free from the largest non-empty bucket, trusting no
+ * free chunk to lie outside lo..hi. The list can't hold more chunks than
+ * fit there, which stops a walk round a loop. 0 if the list is broken. */
+static int heap_largest_free(HEAP *heap, uint8_t *lo, uint8_t *hi, heap_stats_t *stats)
+{
+	int i;
+	uint32_t left;
+	HEADER *hdr;
+
+	stats->largest_free = 0;
+	for(i = BUCKET_COUNT - 1; i >= 0 && !heap->free_list[i]; i--)
+		;
+	if(i < 0)
+		return 1;
+
+	left = (hi - lo) / (sizeof(HEADER) + sizeof(FOOTER));
+	for(hdr = heap->free_list[i]; hdr; hdr = hdr->s.next)
+	{
+		if(left-- == 0 || (uint8_t *) hdr < lo || ((uintptr_t) hdr & (ALIGN_SIZE - 1)) ||
+		   (uint8_t *) hdr > hi - sizeof(HEADER) - sizeof(FOOTER) ||
+		   CHUNK_SIZE(hdr) > (uint32_t) (hi - (uint8_t *) hdr - sizeof(HEADER) - sizeof(FOOTER)))
+		{
+			stats->largest_free = 0;
+			return 0;
+		}
+		if(CHUNK_SIZE(hdr) > stats->largest_free)
+			stats->largest_free = CHUNK_SIZE(hdr);
+	}
+	return 1;
+}
+
+void heap_stats(void *base_ptr, heap_stats_t *stats)
+{
+	HEAP *heap;
+
+	heap = (HEAP *) base_ptr;
+	msel_memcpy(stats, &heap->stats, sizeof(*stats));
+	heap_largest_free(heap, heap->start, heap->end, stats);
+	return;
+}
+
+int heap_stats_checked(void *base_ptr, void *lo, void *hi, heap_stats_t *stats)
+{
+	HEAP *heap;
+
+	heap = (HEAP *) base_ptr;
+	msel_memcpy(stats, &heap->stats, sizeof(*stats));
+	return heap_largest_free(heap, lo, hi, stats);
+}
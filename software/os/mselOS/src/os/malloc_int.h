@@ -28,9 +28,20 @@
 #define HEAP_ASSERT(x) {}
 #endif
 
-#define BUCKET_COUNT 4
-#define BUCKET_SHIFT 7
+/* Free chunks are kept in power of two size classes: bucket n holds
+ * chunks of (ALIGN_SIZE << n) up to (ALIGN_SIZE << (n + 1)) - 1 bytes,
+ * and the last bucket holds everything larger */
+#define BUCKET_COUNT 10
+#define BUCKET_SHIFT 4 /* log2(ALIGN_SIZE) */
+
 #define CHUNK_FREE	1
+#define CHUNK_SLAB	2 /* chunk holds a slab of small objects */
+#define CHUNK_OBJ	4 /* header belongs to a slab object, not a chunk */
+
+/* Small requests are served from slabs of same-sized objects, one size
+ * class per power of two from ALIGN_SIZE up to SLAB_MAX_SIZE */
+#define SLAB_CLASS_COUNT 5
+#define SLAB_MAX_SIZE (ALIGN_SIZE << (SLAB_CLASS_COUNT - 1))
 
 typedef union _HEADER {
 	struct {
@@ -38,6 +49,11 @@ typedef union _HEADER {
 		union _HEADER *next;
 		union _HEADER *prev;
 	} s;
+	struct {
+		uint32_t size; /* object size | CHUNK_OBJ */
+		union _SLAB *slab;
+		union _HEADER *next; /* next free object in the slab */
+	} o;
 	uint8_t x[ALIGN_SIZE];
 } HEADER;
 
@@ -51,11 +67,43 @@ typedef union _FOOTER {
 	uint8_t x[ALIGN_SIZE];
 } FOOTER;
 
+/* A slab lives at the start of an ordinary heap chunk and is followed by
+ * its objects, each with a HEADER but no FOOTER */
+typedef union _SLAB {
+	struct {
+		union _SLAB *next; /* slabs of the same class with free objects */
+		union _SLAB *prev;
+		HEADER *free;
+		uint16_t cls;
+		uint16_t used;
+	} s;
+	uint8_t x[ALIGN_SIZE];
+} SLAB;
+
 typedef struct _HEAP {
 	HEADER *free_list[BUCKET_COUNT];
+	SLAB *slabs[SLAB_CLASS_COUNT];
 	void *start, *end; // start of heap, end of heap
+	heap_stats_t stats; // largest_free is only filled in by heap_stats
 } HEAP;
 
 #define HEAP_SIZE ((sizeof(HEAP) + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1))
 
+/* The part of a new heap heap_init writes at its start: the HEAP and the
+ * header of its one free chunk */
+#define HEAP_TEMPLATE_SIZE (HEAP_SIZE + sizeof(HEADER))
+
+/* Build in tmpl the start of a new heap of size bytes, as heap_init
+ * would, so that heap_init_from can copy it for any heap of that size */
+void heap_template(void *tmpl, uint32_t size);
+
+/* heap_init for a heap of the size tmpl was built for, by copying */
+void heap_init_from(void *base_ptr, const void *tmpl);
+
+/* heap_stats for a heap whose owner may have scribbled on it: free list
+ * pointers are only followed within lo..hi (the owner's own memory), and
+ * only as far as a list could reach there. 0 if the list is broken, in
+ * which case largest_free is 0. */
+int heap_stats_checked(void *base_ptr, void *lo, void *hi, heap_stats_t *stats);
+
 #endif /* MALLOC_INT_H_ */
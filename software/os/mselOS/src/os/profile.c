@@ -0,0 +1,115 @@
+/* @file profile.c
+
+   Tick driven sampling profiler, see profile.h. Samples are only taken
+   from the timer interrupt and drained by the worker syscall, both
+   with interrupts off, so the ring needs no locking.
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <msel/stdc.h>
+
+#include "profile.h"
+#include "task.h"
+#include "util.h"
+
+#include "driver/uart.h"
+
+#include "arch.h"
+
+#if PROFILE_SAMPLES_PER_TICK > 0
+
+#define PROFILE_MASK (PROFILE_BUF_ENTRIES - 1)
+
+/* Length of one "prof TT PPPPPPPP\r\n" line, and of "prof lost NNNNNNNN\r\n" */
+#define PROFILE_LINE_LEN 18
+#define PROFILE_LOST_LEN 20
+
+static uint32_t sample_pc[PROFILE_BUF_ENTRIES];
+static uint8_t  sample_task[PROFILE_BUF_ENTRIES];
+static uint32_t sample_head;  /* next slot to write */
+static uint32_t sample_tail;  /* next slot to drain */
+static uint32_t sample_lost;  /* dropped since the last report */
+static uint32_t subtick;
+
+int msel_profile_sample()
+{
+    uint32_t slot;
+
+    if(sample_head - sample_tail < PROFILE_BUF_ENTRIES)
+    {
+        slot = sample_head++ & PROFILE_MASK;
+        sample_pc[slot]   = arch_task_pc(msel_active_task);
+        sample_task[slot] = msel_active_task_num;
+    }
+    else
+    {
+        sample_lost++;
+    }
+
+    if(++subtick < PROFILE_SAMPLES_PER_TICK)
+        return 0;
+
+    subtick = 0;
+    return 1;
+}
+
+/* Format a loss report, then the oldest sample, for uart_log_drain */
+static char* profile_line(char *out)
+{
+    uint32_t slot;
+
+    if(sample_lost)
+    {
+        msel_memcpy(out, "prof lost ", 10);
+        out = fmt_hex(out + 10, sample_lost, 8);
+        sample_lost = 0;
+    }
+    else
+    {
+        if(sample_tail == sample_head)
+            return NULL;
+        slot = sample_tail++ & PROFILE_MASK;
+
+        msel_memcpy(out, "prof ", 5);
+        out = fmt_hex(out + 5, sample_task[slot], 2);
+        *out++ = ' ';
+        out = fmt_hex(out, sample_pc[slot], 8);
+    }
+    *out++ = '\r';
+    *out++ = '\n';
+    return out;
+}
+
+void msel_profile_drain()
+{
+    /* The loss report is the longer line, and takes no sample's place */
+    uart_log_drain(profile_line, PROFILE_LOST_LEN, PROFILE_DRAIN_MAX + (sample_lost != 0));
+}
+
+#else
+
+int msel_profile_sample()
+{
+    return 1;
+}
+
+void msel_profile_drain()
+{
+}
+
+#endif
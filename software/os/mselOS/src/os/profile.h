@@ -0,0 +1,73 @@
+/** @file profile.h */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef _MSEL_PROFILE_H_
+#define _MSEL_PROFILE_H_
+
+#include <stdint.h>
+
+#include "config.h"
+
+/** @defgroup profile Sampling Profiler
+
+    When built with --with-profile=N, the system timer interrupts N
+    times per system tick, and every interrupt records the PC and
+    number of the task it interrupted. Only every Nth interrupt goes on
+    to count a system tick and run the scheduler, so timing seen by
+    tasks doesn't change.
+
+    msel_svc_worker prints the samples on the UART as lines of the form
+
+        prof TT PPPPPPPP
+
+    (task number and PC in hex). profsym matches them against the
+    mselOS ELF and prints a flat profile per task. If the UART can't
+    keep up, samples are dropped and reported as "prof lost N".
+
+ *  @{
+ */
+
+#ifndef PROFILE_SAMPLES_PER_TICK
+#define PROFILE_SAMPLES_PER_TICK 0
+#endif
+
+/** @brief Timer interrupts per system tick */
+#if PROFILE_SAMPLES_PER_TICK > 0
+#define PROFILE_TIMER_DIV PROFILE_SAMPLES_PER_TICK
+#else
+#define PROFILE_TIMER_DIV 1
+#endif
+
+/** @brief Number of samples buffered between worker runs (a power of two) */
+#ifndef PROFILE_BUF_ENTRIES
+#define PROFILE_BUF_ENTRIES 256
+#endif
+
+/** @brief Most samples printed by one call to msel_profile_drain */
+#define PROFILE_DRAIN_MAX 32
+
+/** @brief Sample the active task, called on every timer interrupt.
+
+    @return non-zero if this interrupt is also a system tick */
+int msel_profile_sample();
+
+/** @brief Print up to PROFILE_DRAIN_MAX samples on the UART. Called
+    from msel_svc_worker. */
+void msel_profile_drain();
+
+/** @} */
+
+#endif
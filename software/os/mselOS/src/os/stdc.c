@@ -18,42 +18,8 @@
 
 #include <msel/stdc.h>
 
-void* msel_memset(void *dst, int val, size_t sz)
-{
-    uint8_t* dst_c = dst;
-    size_t   idx;
-
-    for(idx=0; idx<sz; idx++)
-        dst_c[idx] = (uint8_t)val;
-    
-    return dst;
-}
-
-void* msel_memcpy(void *dst, const void *src, size_t sz)
-{
-    const uint8_t* src_c = src;
-    uint8_t* dst_c = dst;
-    size_t   idx;
-
-    for(idx=0; idx<sz; idx++)
-        dst_c[idx] = src_c[idx];
-    return NULL;
-}
-
-int msel_memcmp(const void *a, const void *b, size_t sz)
-{
-    const uint8_t* a_c = a;
-    const uint8_t* b_c = b;
-    size_t idx = 0;
-    while(idx < sz - 1 && a_c[idx] == b_c[idx])
-        idx++;
-
-    if(a_c[idx] < b_c[idx])
-        return -1;
-    if(b_c[idx] < a_c[idx])
-        return 1;
-    return 0;
-}
+/* msel_memset, msel_memcpy and msel_memcmp are on every hot path, so
+ * each architecture provides its own (see arch/$(OS_ARCH)/string.*) */
 
 size_t msel_strlen(const char *src)
 {
@@ -0,0 +1,339 @@
+/** @file sync.c
+
+    Mutexes, counting semaphores and event flags. Objects live in a
+    small kernel table and tasks name them by index. A task that has to
+    wait sleeps in MSEL_TASK_WAIT_SYNC, and whoever releases the object
+    hands it over and wakes the task directly, oldest waiter first.
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <msel/stdc.h>
+#include <msel/syscalls.h>
+
+#include "sync.h"
+#include "task.h"
+#include "syscall.h"
+#include "arch.h"
+
+typedef enum {
+    SYNC_FREE = 0,
+    SYNC_MUTEX,
+    SYNC_SEM,
+    SYNC_EVENT
+} sync_type;
+
+/** @brief owner of an unlocked mutex */
+#define SYNC_NO_OWNER 0xff
+
+static struct {
+    uint8_t  type;   /* sync_type */
+    uint8_t  owner;  /* mutex: task holding it */
+    uint16_t count;  /* semaphore: units available */
+    uint32_t flags;  /* event group: flags set */
+} sync_objs[MSEL_SYNC_MAX];
+
+/** @brief handed out to sleeping tasks to keep wakeups in FIFO order */
+static uint32_t sync_ticket;
+
+void msel_init_sync()
+{
+    msel_memset(sync_objs, 0, sizeof(sync_objs));
+    sync_ticket = 0;
+}
+
+static msel_status sync_create(uint8_t type, uint16_t count, msel_sync_id *id)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_SYNC_MAX; i++)
+    {
+        if(sync_objs[i].type != SYNC_FREE)
+            continue;
+
+        sync_objs[i].type  = type;
+        sync_objs[i].owner = SYNC_NO_OWNER;
+        sync_objs[i].count = count;
+        sync_objs[i].flags = 0;
+        *id = i;
+        return MSEL_OK;
+    }
+    return MSEL_ERESOURCE;
+}
+
+msel_status msel_mutex_create(msel_sync_id *id)
+{
+    return sync_create(SYNC_MUTEX, 0, id);
+}
+
+msel_status msel_sem_create(msel_sync_id *id, uint16_t count)
+{
+    return sync_create(SYNC_SEM, count, id);
+}
+
+msel_status msel_event_create(msel_sync_id *id)
+{
+    return sync_create(SYNC_EVENT, 0, id);
+}
+
+static inline int sync_is(const msel_sync_args *args, uint8_t type)
+{
+    return args->id < MSEL_SYNC_MAX && sync_objs[args->id].type == type;
+}
+
+static inline int event_ready(uint32_t flags, const msel_ws_sync *ws)
+{
+    uint32_t got = flags & ws->mask;
+    return (ws->mode & MSEL_EVENT_ALL) ? got == ws->mask : got != 0;
+}
+
+static inline void event_consume(uint32_t *flags, const msel_ws_sync *ws)
+{
+    if(ws->mode & MSEL_EVENT_CLEAR)
+        *flags &= ~ws->mask;
+}
+
+/* Put the active task to sleep on an object. msel_main has to keep
+ * running, so it gets MSEL_EBUSY instead. */
+static msel_status sync_sleep(const msel_sync_args *args)
+{
+    if(msel_active_task_num == MSEL_TASK_MAIN)
+        return MSEL_EBUSY;
+
+    msel_active_task->wait_op           = MSEL_TASK_WAIT_SYNC;
+    msel_active_task->state.sync.id     = args->id;
+    msel_active_task->state.sync.mode   = args->mode;
+    msel_active_task->state.sync.mask   = args->mask;
+    msel_active_task->state.sync.ticket = sync_ticket++;
+    msel_task_schedule();
+    return MSEL_ESUSP;
+}
+
+/* The task that has slept longest on an object, and for an event group
+ * whose wait is satisfied. MSEL_TASKS_MAX if there is none. */
+static size_t sync_oldest_waiter(msel_sync_id id)
+{
+    size_t    tnum, best = MSEL_TASKS_MAX;
+    msel_tcb *task;
+
+    for(tnum = 1; tnum < MSEL_TASKS_MAX; tnum++)
+    {
+        task = &msel_task_list[tnum];
+        if(!msel_task_is_waiting(task) || task->wait_op != MSEL_TASK_WAIT_SYNC ||
+           task->state.sync.id != id)
+            continue;
+
+        if(sync_objs[id].type == SYNC_EVENT &&
+           !event_ready(sync_objs[id].flags, &task->state.sync))
+            continue;
+
+        if(best == MSEL_TASKS_MAX ||
+           (int32_t)(task->state.sync.ticket - msel_task_list[best].state.sync.ticket) < 0)
+            best = tnum;
+    }
+    return best;
+}
+
+/* Finish a sleeping task's syscall successfully and let it run again */
+static void sync_wake(size_t tnum)
+{
+    arch_task_set_result(&msel_task_list[tnum], MSEL_OK);
+    msel_task_resume(&msel_task_list[tnum]);
+}
+
+/* Give an unlocked mutex to the oldest waiter, if any */
+static void mutex_handoff(msel_sync_id id)
+{
+    size_t next = sync_oldest_waiter(id);
+
+    if(next == MSEL_TASKS_MAX)
+    {
+        sync_objs[id].owner = SYNC_NO_OWNER;
+        return;
+    }
+
+    sync_objs[id].owner = next;
+    sync_wake(next);
+}
+
+msel_status msel_sync_mutex_lock(msel_sync_args *args)
+{
+    if(!sync_is(args, SYNC_MUTEX))
+        return MSEL_EINVAL;
+
+    if(sync_objs[args->id].owner == SYNC_NO_OWNER)
+    {
+        sync_objs[args->id].owner = msel_active_task_num;
+        return MSEL_OK;
+    }
+
+    if(sync_objs[args->id].owner == msel_active_task_num)
+        return MSEL_EINVAL;
+
+    /* Tasks have no priorities yet, so there is nothing for the owner
+     * to inherit. Round-robin gets it to the unlock soon enough. */
+    return sync_sleep(args);
+}
+
+msel_status msel_sync_mutex_unlock(msel_sync_args *args)
+{
+    if(!sync_is(args, SYNC_MUTEX))
+        return MSEL_EINVAL;
+
+    if(sync_objs[args->id].owner != msel_active_task_num)
+        return MSEL_EBADF;
+
+    mutex_handoff(args->id);
+    return MSEL_OK;
+}
+
+msel_status msel_sync_sem_wait(msel_sync_args *args)
+{
+    if(!sync_is(args, SYNC_SEM))
+        return MSEL_EINVAL;
+
+    if(sync_objs[args->id].count > 0)
+    {
+        sync_objs[args->id].count--;
+        return MSEL_OK;
+    }
+
+    return sync_sleep(args);
+}
+
+msel_status msel_sync_sem_post(msel_sync_args *args)
+{
+    size_t next;
+
+    if(!sync_is(args, SYNC_SEM))
+        return MSEL_EINVAL;
+
+    /* A waiter takes the unit straight away */
+    next = sync_oldest_waiter(args->id);
+    if(next != MSEL_TASKS_MAX)
+    {
+        sync_wake(next);
+        return MSEL_OK;
+    }
+
+    if(sync_objs[args->id].count == UINT16_MAX)
+        return MSEL_ERESOURCE;
+
+    sync_objs[args->id].count++;
+    return MSEL_OK;
+}
+
+msel_status msel_sync_event_wait(msel_sync_args *args)
+{
+    msel_ws_sync ws;
+
+    if(!sync_is(args, SYNC_EVENT) || args->mask == 0)
+        return MSEL_EINVAL;
+
+    ws.mode = args->mode;
+    ws.mask = args->mask;
+    if(event_ready(sync_objs[args->id].flags, &ws))
+    {
+        event_consume(&sync_objs[args->id].flags, &ws);
+        return MSEL_OK;
+    }
+
+    return sync_sleep(args);
+}
+
+msel_status msel_sync_event_set(msel_sync_args *args)
+{
+    size_t next;
+
+    if(!sync_is(args, SYNC_EVENT))
+        return MSEL_EINVAL;
+
+    sync_objs[args->id].flags |= args->mask;
+
+    /* Oldest first, since a wake may clear flags a later waiter wanted */
+    while((next = sync_oldest_waiter(args->id)) != MSEL_TASKS_MAX)
+    {
+        event_consume(&sync_objs[args->id].flags, &msel_task_list[next].state.sync);
+        sync_wake(next);
+    }
+    return MSEL_OK;
+}
+
+msel_status msel_sync_event_clear(msel_sync_args *args)
+{
+    if(!sync_is(args, SYNC_EVENT))
+        return MSEL_EINVAL;
+
+    sync_objs[args->id].flags &= ~args->mask;
+    return MSEL_OK;
+}
+
+void msel_sync_release_task(uint8_t tasknum)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_SYNC_MAX; i++)
+        if(sync_objs[i].type == SYNC_MUTEX && sync_objs[i].owner == tasknum)
+            mutex_handoff(i);
+}
+
+/* Task-callable wrappers */
+
+static msel_status sync_call(msel_svc_number svcnum, msel_sync_id id,
+                             uint32_t mask, uint8_t mode)
+{
+    msel_sync_args args;
+
+    args.id   = id;
+    args.mode = mode;
+    args.mask = mask;
+    return msel_svc(svcnum, &args);
+}
+
+msel_status msel_mutex_acquire(msel_sync_id id)
+{
+    return sync_call(MSEL_SVC_MUTEX_LOCK, id, 0, 0);
+}
+
+msel_status msel_mutex_release(msel_sync_id id)
+{
+    return sync_call(MSEL_SVC_MUTEX_UNLOCK, id, 0, 0);
+}
+
+msel_status msel_sem_wait(msel_sync_id id)
+{
+    return sync_call(MSEL_SVC_SEM_WAIT, id, 0, 0);
+}
+
+msel_status msel_sem_post(msel_sync_id id)
+{
+    return sync_call(MSEL_SVC_SEM_POST, id, 0, 0);
+}
+
+msel_status msel_event_wait(msel_sync_id id, uint32_t mask, uint8_t mode)
+{
+    return sync_call(MSEL_SVC_EVENT_WAIT, id, mask, mode);
+}
+
+msel_status msel_event_set(msel_sync_id id, uint32_t mask)
+{
+    return sync_call(MSEL_SVC_EVENT_SET, id, mask, 0);
+}
+
+msel_status msel_event_clear(msel_sync_id id, uint32_t mask)
+{
+    return sync_call(MSEL_SVC_EVENT_CLEAR, id, mask, 0);
+}
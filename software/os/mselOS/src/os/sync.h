@@ -0,0 +1,56 @@
+/** @file sync.h
+
+    Kernel side of the task synchronization objects (see
+    include/msel/sync.h)
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MSEL_SYNC_H_
+#define _MSEL_SYNC_H_
+
+#include <stdint.h>
+
+#include <msel.h>
+#include <msel/sync.h>
+
+/** @brief Number of mutexes, semaphores and event groups, combined */
+#define MSEL_SYNC_MAX 16
+
+/** @brief State of a task sleeping on a synchronization object */
+typedef struct
+{
+    msel_sync_id id;     /* what it waits on */
+    uint8_t      mode;   /* MSEL_EVENT_* for event waits */
+    uint32_t     mask;   /* flags for event waits */
+    uint32_t     ticket; /* order of arrival, oldest is woken first */
+} msel_ws_sync;
+
+/* Syscall handlers */
+msel_status msel_sync_mutex_lock(msel_sync_args *args);
+msel_status msel_sync_mutex_unlock(msel_sync_args *args);
+msel_status msel_sync_sem_wait(msel_sync_args *args);
+msel_status msel_sync_sem_post(msel_sync_args *args);
+msel_status msel_sync_event_wait(msel_sync_args *args);
+msel_status msel_sync_event_set(msel_sync_args *args);
+msel_status msel_sync_event_clear(msel_sync_args *args);
+
+/** @brief Unlock every mutex a task holds, on its way out */
+void msel_sync_release_task(uint8_t tasknum);
+
+void msel_init_sync();
+
+#endif
@@ -20,12 +20,18 @@
 */
 
 
+#include <msel/stdc.h>
 #include <msel/master_key.h>
 #include <msel/provision.h>
 
 #include "system.h"
 #include "syscall.h"
 #include "task.h"
+#include "taskmem.h"
+#include "trace.h"
+#include "profile.h"
+#include "sync.h"
+#include "ipc.h"
 
 #include "driver/aes_driver.h"
 #include "driver/ecc_driver.h"
@@ -33,6 +39,7 @@
 #include "driver/trng_driver.h"
 #include "driver/ffs_session.h"
 #include "driver/mtc.h"
+#include "driver/kvstore.h"
 #include "driver/pol_int.h"
 #include "driver/uart.h"
 
@@ -54,6 +61,10 @@
 */
 msel_status msel_svc_handler(msel_svc_number svcnum, void *arg) {
     msel_status retval = MSEL_EUNKNOWN;
+    /* the active task may have changed by the time the call returns */
+    uint8_t     caller = msel_active_task_num;
+
+    MSEL_TRACE_TASK(TRACE_CAT_SVC, TRACE_SVC_ENTER, caller, svcnum);
 
     switch(svcnum) {
     case MSEL_SVC_DEBUG:
@@ -85,10 +96,70 @@ msel_status msel_svc_handler(msel_svc_number svcnum, void *arg) {
         msel_task_force_kill(msel_active_task_num, "exited");
         retval = MSEL_OK;
         goto end;
+    case MSEL_SVC_HEAP_STATS:
+        retval = msel_taskmem_heap_stats((msel_heap_stats_args*)arg);
+        goto end;
+    case MSEL_SVC_TASK_STATS:
+        retval = msel_task_read_stats((msel_task_stats_args*)arg);
+        goto end;
+
+    /* Synchronization */
+    case MSEL_SVC_MUTEX_LOCK:
+        retval = msel_sync_mutex_lock((msel_sync_args*)arg);
+        goto end;
+    case MSEL_SVC_MUTEX_UNLOCK:
+        retval = msel_sync_mutex_unlock((msel_sync_args*)arg);
+        goto end;
+    case MSEL_SVC_SEM_WAIT:
+        retval = msel_sync_sem_wait((msel_sync_args*)arg);
+        goto end;
+    case MSEL_SVC_SEM_POST:
+        retval = msel_sync_sem_post((msel_sync_args*)arg);
+        goto end;
+    case MSEL_SVC_EVENT_WAIT:
+        retval = msel_sync_event_wait((msel_sync_args*)arg);
+        goto end;
+    case MSEL_SVC_EVENT_SET:
+        retval = msel_sync_event_set((msel_sync_args*)arg);
+        goto end;
+    case MSEL_SVC_EVENT_CLEAR:
+        retval = msel_sync_event_clear((msel_sync_args*)arg);
+        goto end;
+
+    /* Inter-task messages */
+    case MSEL_SVC_IPC_SEND:
+        retval = msel_ipc_do_send((msel_ipc_args*)arg);
+        goto end;
+    case MSEL_SVC_IPC_LEND:
+        retval = msel_ipc_do_lend((msel_ipc_args*)arg);
+        goto end;
+    case MSEL_SVC_IPC_RECV:
+        retval = msel_ipc_do_recv((msel_ipc_args*)arg);
+        goto end;
+    case MSEL_SVC_IPC_RETURN:
+        retval = msel_ipc_do_return((msel_ipc_args*)arg);
+        goto end;
+    case MSEL_SVC_IPC_RECLAIM:
+        retval = msel_ipc_do_reclaim((msel_ipc_args*)arg);
+        goto end;
+
+    /* Persistent storage */
+    case MSEL_SVC_KV_PUT:
+        retval = msel_kv_do_put((msel_kv_args*)arg);
+        goto end;
+    case MSEL_SVC_KV_GET:
+        retval = msel_kv_do_get((msel_kv_args*)arg);
+        goto end;
+    case MSEL_SVC_KV_DELETE:
+        retval = msel_kv_do_delete((msel_kv_args*)arg);
+        goto end;
 
     /* MMIO syscalls */
     case MSEL_SVC_TRNG:
-        retval = msel_trng_read((uint8_t*)arg);
+        retval = msel_trng_read_byte((uint8_t*)arg);
+        goto end;
+    case MSEL_SVC_TRNG_READ:
+        retval = msel_trng_do_read((msel_trng_args*)arg);
         goto end;
     case MSEL_SVC_AES:
         retval = msel_do_aes((aes_driver_ctx_t*)arg);
@@ -96,6 +167,9 @@ msel_status msel_svc_handler(msel_svc_number svcnum, void *arg) {
     case MSEL_SVC_SHA:
         retval = msel_do_sha((sha_data_t*)arg);
         goto end;
+    case MSEL_SVC_SHA_BLOCKS:
+        retval = msel_do_sha_blocks((sha_blocks_t*)arg);
+        goto end;
     case MSEL_SVC_ECC:
         retval = msel_ecc_mul((ecc_ctx_t*)arg);
         goto end;
@@ -105,6 +179,18 @@ msel_status msel_svc_handler(msel_svc_number svcnum, void *arg) {
     case MSEL_SVC_FFS_SESSION_RECV:
         retval = msel_ffs_session_recv((ffs_packet_t*)arg);
         goto end;
+    case MSEL_SVC_FFS_SESSION_RECV_LEND:
+        retval = msel_ffs_session_recv_lend((ffs_packet_t**)arg);
+        goto end;
+    case MSEL_SVC_FFS_PKT_ALLOC:
+        retval = msel_ffs_pkt_alloc((ffs_packet_t**)arg);
+        goto end;
+    case MSEL_SVC_FFS_PKT_RELEASE:
+        retval = msel_ffs_pkt_release((ffs_packet_t*)arg);
+        goto end;
+    case MSEL_SVC_FFS_SESSION_STATS:
+        retval = msel_ffs_session_stats((ffs_session_stats_t*)arg);
+        goto end;
 
     case MSEL_SVC_UART_WRITE:
         retval = msel_uart_write((msel_uart_write_args*)arg);
@@ -113,6 +199,9 @@ msel_status msel_svc_handler(msel_svc_number svcnum, void *arg) {
     case MSEL_SVC_MTC_READ_INC:
         retval = msel_mtc_read_increment((mtc_t*)arg);
         goto end;
+    case MSEL_SVC_MTC_RESERVE:
+        retval = msel_mtc_reserve((msel_mtc_reserve_args*)arg);
+        goto end;
 
     case MSEL_SVC_PROVISION:
         retval = msel_provision((struct provision_args*)arg);
@@ -127,7 +216,8 @@ msel_status msel_svc_handler(msel_svc_number svcnum, void *arg) {
     }
     
 end:
-    
+    MSEL_TRACE_TASK(TRACE_CAT_SVC, TRACE_SVC_EXIT, caller, retval);
+
     return retval;
 }
 
@@ -200,6 +290,24 @@ msel_status msel_svc_worker()
 	/* Handle any background tasks here */   
 //	msel_session_worker();
 //	msel_pktbuf_worker();
+	msel_taskmem_sweep();
+	msel_mtc_worker();
+	msel_kv_worker();
+	msel_trng_worker();
+#if HEAP_STATS_DUMP_TICKS > 0
+	static uint64_t last_heap_dump = 0;
+	if(msel_systicks - last_heap_dump >= HEAP_STATS_DUMP_TICKS)
+	{
+	    last_heap_dump = msel_systicks;
+	    msel_taskmem_dump_stats();
+	}
+#endif
+#if TRACE_CATEGORIES
+	msel_trace_drain();
+#endif
+#if PROFILE_SAMPLES_PER_TICK > 0
+	msel_profile_drain();
+#endif
     }
 
     retval = MSEL_OK;
@@ -30,15 +30,22 @@
 #include "task.h"
 #include "taskmem.h"
 #include "mutex.h"
+#include "sync.h"
+#include "ipc.h"
+#include "profile.h"
 
 #include "driver/uart.h"
 #include "driver/ffs_session.h"
-#include "driver/uart.h"
+#include "driver/kvstore.h"
+#include "driver/trng_driver.h"
 #include "driver/led.h"
 
 /* Global number of ticks since boot */
 uint64_t msel_systicks;
 
+/* Timer interrupts, which is more than msel_systicks while profiling */
+uint32_t msel_timer_irqs;
+
 /* Function definitions */
 
 /** @brief this is the main task in the system 
@@ -69,6 +76,26 @@ void msel_main()
                         msel_svc(MSEL_SVC_RESTART, &rs_args);
                         break;
                         
+                    case MSEL_TASK_WAIT_UART:
+                        /* Carry on once the ring has drained a bit */
+                        if(uart_task_space() == 0)
+                            break;
+                        rs_args.tasknum = task_idx;
+                        rs_args.svcnum = MSEL_SVC_UART_WRITE;
+                        rs_args.arg = &uart_queue[task_idx].args;
+                        msel_svc(MSEL_SVC_RESTART, &rs_args);
+                        break;
+
+                    case MSEL_TASK_WAIT_KV:
+                        /* Carry on once the erase is done */
+                        if(msel_kv_erasing())
+                            break;
+                        rs_args.tasknum = task_idx;
+                        rs_args.svcnum = task->state.kv.svcnum;
+                        rs_args.arg = task->state.kv.args;
+                        msel_svc(MSEL_SVC_RESTART, &rs_args);
+                        break;
+
                     case MSEL_TASK_WAIT_TIME:
                         /* NOT IMPL, just resume for now */
                         msel_task_resume(task);
@@ -113,8 +140,11 @@ void msel_init() {
     /* Initialize sub-components */
     msel_init_led();
     msel_init_taskmem();
+    msel_init_sync();
+    msel_init_ipc();
     msel_init_task();
     msel_init_pol();
+    msel_init_trng();
     
     ARCH_ENABLE_INTERRUPTS();
 }
@@ -132,6 +162,15 @@ void msel_start() {
 /** @brief handle the systick timer */
 void msel_systick_handler() {
 
+    msel_timer_irqs++;
+
+    /* While profiling, only some timer interrupts are system ticks */
+    if(!msel_profile_sample())
+    {
+        arch_systick_handler();
+        return;
+    }
+
     /* Increment the system 'timer' */
     msel_systicks++;
 
@@ -139,7 +178,7 @@ void msel_systick_handler() {
 
     msel_set_status_leds();
 
-    msel_task_schedule();
+    msel_task_preempt();
 }
 
 /* Blink leds for each task with freq proportional to runtime */
@@ -168,6 +207,7 @@ void msel_set_status_leds()
 void msel_panic(const char *what)
 {
     /** TODO: do something more useful and ensure tasking is halted properly */
+    uart_tx_flush_now();
     uart_print_now(what);
 
     /* lock the cpu */
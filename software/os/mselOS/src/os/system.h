@@ -40,8 +40,16 @@
 /** @brief maximum size of the task lists structure */
 #define MSEL_TASKS_MAX 5
 
+/** @brief Put a kernel variable in the .kernel_private section, which no
+ *  user task can read (unlike .data and .bss). The section isn't cleared
+ *  at boot, so its owner has to initialize it. */
+#define MSEL_KERNEL_PRIVATE __attribute__((section(".kernel_private")))
+
 /** System management ASM macros, most are privileged operations */
 
+/** @brief count of system timer interrupts */
+extern uint32_t msel_timer_irqs;
+
 /* fn decls */
 
 void        msel_mss_init();
@@ -31,10 +31,12 @@
 #include "taskmem.h"
 #include "system.h"
 #include "syscall.h"
+#include "trace.h"
 #include "util.h"
 #include "arch.h"
 
 #include "driver/uart.h"
+#include "driver/ffs_pool.h"
 
 /* Global variables */
 
@@ -50,6 +52,22 @@ uint8_t msel_active_task_num = 0;
 /** @brief direct pointer to the current tcb structure */
 msel_tcb* msel_active_task = 0;
 
+/** @brief memory profiles registered for particular entry points */
+static struct {
+    msel_thread_entry entry;
+    msel_task_profile profile;
+} task_profiles[MSEL_TASKS_MAX];
+
+/** @brief CPU time accounting: the task the time since acct_mark is
+ * charged to, and the time of the last user/kernel transition */
+static uint8_t  acct_task = 0;
+static uint32_t acct_mark = 0;
+
+/** @brief cycles acct_task has used since it was switched to, for the
+ * trace */
+static uint32_t slice_user   = 0;
+static uint32_t slice_kernel = 0;
+
 /* Function definitions */
 
 /** @brief initialize anything that needs to be inside the tasking
@@ -78,9 +96,11 @@ void msel_init_task()
     return value is MSEL_EINVAL, if nothing is able to be awoken
     return MSEL_EBUSY
 */
-msel_status msel_task_schedule() {
+static msel_status task_schedule(int preempt) {
     msel_status retval = MSEL_EUNKNOWN;
     size_t tnum;
+    size_t prev = msel_active_task_num;
+    int    prev_live = !msel_task_is_killed(&msel_task_list[prev]);
     /* Sanity checks */
     if(msel_num_tasks == 0) {
 	retval = MSEL_EINVAL;
@@ -92,13 +112,21 @@ msel_status msel_task_schedule() {
     {
         if(msel_task_is_killed(&(msel_task_list[tnum])))
         {
-            char c = tnum + '0';
-            /* FIXME: we really shouldn't block here for so long */
-            uart_print_now("Killed task ");
-            uart_write_now(&c, 1);
-            uart_print_now(". REASON: ");
-            uart_print_now(msel_task_list[tnum].reason);
-            uart_print_now("\r\n");
+            /* One write, so the line goes out whole or not at all */
+            char line[96];
+            char *out = line;
+            size_t n = msel_strlen(msel_task_list[tnum].reason);
+
+            msel_memcpy(out, "Killed task ", 12);
+            out = fmt_dec(out + 12, tnum);
+            msel_memcpy(out, ". REASON: ", 10);
+            out += 10;
+            n = min(n, sizeof(line) - 2 - (out - line));
+            msel_memcpy(out, msel_task_list[tnum].reason, n);
+            out += n;
+            *out++ = '\r';
+            *out++ = '\n';
+            uart_log_write(line, out - line);
             msel_task_cleanup(&(msel_task_list[tnum]));
         }
     }
@@ -109,6 +137,16 @@ msel_status msel_task_schedule() {
         msel_active_task = &msel_task_list[msel_active_task_num];
     } while(!msel_task_is_valid(msel_active_task));
 
+    if(msel_active_task_num != prev)
+    {
+        MSEL_TRACE(TRACE_CAT_SCHED, TRACE_SWITCH, prev);
+
+        if(prev_live && preempt)
+            msel_task_list[prev].ctrs.stats.involuntary++;
+        else if(prev_live)
+            msel_task_list[prev].ctrs.stats.voluntary++;
+    }
+
     /* Make sure the memory region permissions are accurate */
     msel_task_setup_mm(msel_active_task);
 
@@ -119,11 +157,23 @@ msel_status msel_task_schedule() {
     return retval;
 }
 
+msel_status msel_task_schedule() {
+    return task_schedule(0);
+}
+
+/** @brief switch to the next available thread because the active one
+    has used up its time slice. Same as msel_task_schedule, but the
+    switch is counted as involuntary. */
+msel_status msel_task_preempt() {
+    return task_schedule(1);
+}
+
 /** @brief allows for termination of an errant task */
 void msel_task_force_kill(size_t tasknum, char *reason)
 {
     msel_task_list[tasknum].killed = 1;
     msel_task_list[tasknum].reason = reason;
+    MSEL_TRACE_TASK(TRACE_CAT_TASK, TRACE_TASK_KILL, tasknum, 0);
     msel_task_schedule();
 }
     
@@ -131,6 +181,7 @@ void msel_task_force_kill(size_t tasknum, char *reason)
 /** @brief launches into thread mode with a new stack from an ISR */
 void msel_task_launch_main()
 {
+    acct_mark = arch_timestamp();
     msel_task_setup_mm(&(msel_task_list[0]));
     arch_task_launch_main((msel_tcb*)&(msel_task_list[0]));
 }
@@ -158,8 +209,41 @@ inline void msel_task_resume(msel_tcb* tcb)
     /* don't clear state here, these will get used as arguments to the resumed system call */
 }
 
-/* Create a new task and ready for launch */
+msel_status msel_task_register_profile(const msel_thread_entry entry, const msel_task_profile *profile)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_TASKS_MAX; i++)
+    {
+        if(task_profiles[i].entry == entry || task_profiles[i].entry == NULL)
+        {
+            task_profiles[i].entry = entry;
+            msel_memcpy(&task_profiles[i].profile, profile, sizeof(*profile));
+            return MSEL_OK;
+        }
+    }
+    return MSEL_ERESOURCE;
+}
+
+/* Create a new task with the memory registered for its entry point */
 msel_status msel_task_create(const msel_thread_entry entry, void *arg, size_t arg_sz, uint8_t* tid) 
+{
+    msel_task_profile profile;
+    size_t i;
+
+    for(i = 0; i < MSEL_TASKS_MAX && task_profiles[i].entry; i++)
+    {
+        if(task_profiles[i].entry == entry)
+            return msel_task_create_profile(entry, arg, arg_sz, &task_profiles[i].profile, tid);
+    }
+
+    taskmem_default_profile(&profile);
+    return msel_task_create_profile(entry, arg, arg_sz, &profile, tid);
+}
+
+/* Create a new task and ready for launch */
+msel_status msel_task_create_profile(const msel_thread_entry entry, void *arg, size_t arg_sz,
+                                     const msel_task_profile *profile, uint8_t* tid)
 {
     msel_status        ret            = MSEL_EUNKNOWN;
     msel_tcb*          task           = NULL;
@@ -180,11 +264,19 @@ msel_status msel_task_create(const msel_thread_entry entry, void *arg, size_t ar
         goto cleanup;
     }
     
-    if(!entry || (arg && !arg_sz) || arg_sz > taskmem_heap_size(tasknum)) {
+    if(!entry || !profile || (arg && !arg_sz) || arg_sz > profile->heap_sz) {
         ret = MSEL_EINVAL;
         goto cleanup;
     }
 
+    /* Task 0's memory is fixed, everyone else's is carved out here */
+    if(tasknum != MSEL_TASK_MAIN)
+    {
+        ret = taskmem_alloc(tasknum, profile);
+        if(ret != MSEL_OK)
+            goto cleanup;
+    }
+
     /* Initialize all relevant data structures */
     task = &msel_task_list[tasknum];
     msel_memset(task, 0, sizeof(msel_tcb));
@@ -231,6 +323,9 @@ msel_status msel_task_create(const msel_thread_entry entry, void *arg, size_t ar
     msel_num_tasks++;
     if (tid) *tid = tasknum;
     ret = MSEL_OK;
+
+    /* arg: the task that created it */
+    MSEL_TRACE_TASK(TRACE_CAT_TASK, TRACE_TASK_CREATE, tasknum, msel_active_task_num);
     
  cleanup:
     if(ret != MSEL_OK && task) 
@@ -238,6 +333,7 @@ msel_status msel_task_create(const msel_thread_entry entry, void *arg, size_t ar
         /* Ensure task is re-marked as available if error */
         if (NULL != task)
           task->valid = 0;
+        taskmem_free(tasknum);
     }
     return ret;
 }
@@ -245,6 +341,10 @@ msel_status msel_task_create(const msel_thread_entry entry, void *arg, size_t ar
 void msel_task_cleanup(msel_tcb* task)
 {
     arch_task_cleanup(task);
+    msel_ffs_pool_release_task(task->num);
+    msel_sync_release_task(task->num);
+    msel_ipc_release_task(task->num);
+    taskmem_free(task->num);
     msel_memset(task,0,sizeof(*task));
 }
 
@@ -258,8 +358,69 @@ void msel_task_exit()
     (void)msel_svc(MSEL_SVC_EXIT, NULL);
 }
 
+/** @brief Charge the time since the last resume to the active task as
+    user time. Called on every exception entry, before the handler. */
+void msel_task_update_ctrs_enter()
+{
+    uint32_t now   = arch_timestamp();
+    uint32_t delta = now - acct_mark;
+
+    acct_mark = now;
+    acct_task = msel_active_task_num;
+    msel_task_list[acct_task].ctrs.stats.user_cycles += delta;
+    slice_user += delta;
+}
+
+/* Report a finished time slice, in units of 256 cycles */
+static void trace_slice(uint8_t task)
+{
+    MSEL_TRACE_TASK(TRACE_CAT_SCHED, TRACE_CPU_USER, task,
+                    slice_user >> 24 ? 0xffff : slice_user >> 8);
+    MSEL_TRACE_TASK(TRACE_CAT_SCHED, TRACE_CPU_KERNEL, task,
+                    slice_kernel >> 24 ? 0xffff : slice_kernel >> 8);
+    slice_user   = 0;
+    slice_kernel = 0;
+}
+
+/** @brief Charge the time spent in the kernel to the task that was
+    interrupted, whichever task is resumed. Called on every return
+    to a task. */
 void msel_task_update_ctrs_resume()
 {
+    uint32_t now   = arch_timestamp();
+    uint32_t delta = now - acct_mark;
+
+    /* A task killed in the handler has already been cleaned up */
+    if(msel_task_list[acct_task].valid)
+        msel_task_list[acct_task].ctrs.stats.kernel_cycles += delta;
+    slice_kernel += delta;
+
+    if(acct_task != msel_active_task_num)
+        trace_slice(acct_task);
+
+    acct_mark = arch_timestamp();
+    acct_task = msel_active_task_num;
+
     msel_task_list[msel_active_task_num].ctrs.runs = msel_task_list[msel_active_task_num].ctrs.runs + 1;
 }
 
+/** @brief Implements the MSEL_SVC_TASK_STATS syscall, reading the CPU
+    time counters of a live task.
+
+    @return MSEL_OK, or MSEL_EINVAL if there is no such task
+*/
+msel_status msel_task_read_stats(msel_task_stats_args *args)
+{
+    msel_tcb *task;
+
+    if(args->tasknum >= MSEL_TASKS_MAX)
+        return MSEL_EINVAL;
+
+    task = &msel_task_list[args->tasknum];
+    if(!task->valid || msel_task_is_killed(task))
+        return MSEL_EINVAL;
+
+    args->stats = task->ctrs.stats;
+    return MSEL_OK;
+}
+
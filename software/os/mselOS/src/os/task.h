@@ -26,7 +26,11 @@
 
 #include "config.h"
 #include "system.h"
+#include "sync.h"
+#include "ipc.h"
 #include "driver/pol_int.h"
+#include "driver/mtc.h"
+#include "driver/kvstore.h"
 
 /** @brief The msel_main task is always first on the list (for now) */
 #define MSEL_TASK_MAIN 0
@@ -38,6 +42,10 @@ typedef enum {
     MSEL_TASK_WAIT_NONE,
     MSEL_TASK_WAIT_TIME,
     MSEL_TASK_WAIT_UART,
+    MSEL_TASK_WAIT_SYNC,
+    MSEL_TASK_WAIT_IPC,
+    MSEL_TASK_WAIT_FLASH,
+    MSEL_TASK_WAIT_KV,
     
     MSEL_TASK_WAIT_POL
 } msel_task_wait_op;
@@ -50,7 +58,10 @@ typedef struct {
     uint8_t*             stack;       /* saved stack ptr is always the
                                        * first item for easy access
                                        * (MUST be 4-byte aligned). In effect this is (saved_regs*) */
-    uint8_t*             stack_top;   /* the top of the allocated stack */
+    uint8_t*             stack_top;   /* the top of the allocated stack
+                                       * (stack, stack_top and stack_sz
+                                       * offsets are also known to the
+                                       * or1k exception entry) */
     size_t               stack_sz;    /* the size of the stack -- NOTE
                                        * free(stack_top-stack_sz) on
                                        * thread exit, dont mod these
@@ -76,6 +87,10 @@ typedef struct {
     {
         int              __reserved; /* Didn't you see the underscores?!?! */
         msel_ws_pol      pol;        /* Waiting for user to prove physical presence */
+        msel_ws_sync     sync;       /* Waiting on a mutex, semaphore or event */
+        msel_ws_ipc      ipc;        /* Waiting on a message channel */
+        msel_ws_mtc      mtc;        /* Waiting for the MTC to be written to flash */
+        msel_ws_kv       kv;         /* Waiting for a key-value store erase */
     } state;
 
     /* Let each architecture add their special sauce */
@@ -91,6 +106,7 @@ typedef struct {
     /* Save some performance/logging counters */
     struct _ctrs {
         uint32_t runs; /* Records how many times task has been resumed */
+        msel_task_stats stats; /* CPU time accounting, see task.c */
     } ctrs;
 
     size_t num; /* Task number */
@@ -100,13 +116,16 @@ void        msel_init_task();
 void        msel_task_setup_mm(msel_tcb*);
 void        msel_task_launch_main();
 msel_status msel_task_schedule();
+msel_status msel_task_preempt();
 int         msel_task_is_waiting(const msel_tcb const*);
 int         msel_task_is_killed(const msel_tcb const*);
 int         msel_task_is_valid(const msel_tcb const*);
 void        msel_task_force_kill(size_t tasknum, char *reason); 
 void        msel_task_resume(msel_tcb *);
 void        msel_task_cleanup(msel_tcb*);
+void        msel_task_update_ctrs_enter();
 void        msel_task_update_ctrs_resume();
+msel_status msel_task_read_stats(msel_task_stats_args*);
 
 /* Export these globals unless included from task.c, where they are defined */
 #ifndef _TASK_EXPORTS
@@ -29,46 +29,237 @@
 #include <stdint.h>
 #include "msel/stdc.h"
 #include "msel/malloc.h"
+#include "malloc_int.h"
 #include "system.h"
 #include "taskmem.h"
+#include "task.h"
 #include "util.h"
 #include "arch.h"
 
+#include "driver/uart.h"
+
 /* Pull in info about the static tasks memory blocks from the linker script */
 extern uint32_t tasks_start;
+extern uint32_t tasks_end;
 extern uint32_t tasks_size;
 extern uint32_t tasks_stack_size;
 extern uint32_t tasks_heap_size;
 
+/* Task 0 always gets the first tasks_size bytes, since its stack is the
+ * one the system booted on. Everything after that up to tasks_end is
+ * handed out to other tasks as they are created. */
+typedef struct {
+    uint8_t* base;     /* start of the region, the stack grows down to here */
+    size_t   size;     /* total size, 0 if the task has no memory */
+    size_t   stack_sz; /* the heap takes up the rest */
+} taskmem_region;
+
+static taskmem_region regions[MSEL_TASKS_MAX];
+
+/* Free RAM that may still hold an old task's data. msel_taskmem_sweep
+ * zeroes it a little at a time in the background, and taskmem_alloc
+ * won't hand it out until it has, so creating a task never has to clear
+ * memory itself. */
+typedef struct {
+    uint8_t* base;
+    size_t   size;     /* 0 if the slot is unused */
+} taskmem_extent;
+
+/* One per freed task, with some spares */
+#define TASKMEM_DIRTY_MAX (2 * MSEL_TASKS_MAX)
+
+static taskmem_extent dirty[TASKMEM_DIRTY_MAX];
+
+/* Remember that [base, base+size) needs zeroing before its next use.
+ * If there's nowhere to put it, zero it now instead. */
+static void taskmem_mark_dirty(uint8_t *base, size_t size)
+{
+    size_t i;
+
+    if(size == 0)
+        return;
+
+    for(i = 0; i < TASKMEM_DIRTY_MAX; i++)
+    {
+        if(dirty[i].size == 0)
+        {
+            dirty[i].base = base;
+            dirty[i].size = size;
+            return;
+        }
+    }
+    msel_memset(base, 0, size);
+}
+
+/* Check that none of [base, base+size) is waiting to be swept */
+static int region_is_clean(const uint8_t *base, size_t size)
+{
+    size_t i;
+
+    for(i = 0; i < TASKMEM_DIRTY_MAX; i++)
+    {
+        if(dirty[i].size &&
+           base < dirty[i].base + dirty[i].size &&
+           dirty[i].base < base + size)
+            return 0;
+    }
+    return 1;
+}
+
+/* A new heap's header, prebuilt for heaps of heap_tmpl_sz bytes (the
+ * default profile's) so that taskmem_init only has to copy it */
+static uint8_t heap_tmpl[HEAP_TEMPLATE_SIZE] __attribute__((aligned(ALIGN_SIZE)));
+static size_t  heap_tmpl_sz;
+
+/* The stack size and region size a profile ends up with */
+static void taskmem_layout(const msel_task_profile *profile, size_t *stack_sz,
+                           size_t *size, size_t *align, size_t *span)
+{
+    /* Keep the heap aligned for heap_init and leave room for its header */
+    *stack_sz = (profile->stack_sz + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
+
+    /* Round up to something the MMU/MPU can protect on its own; any
+     * slack is left to the heap */
+    *size = arch_taskmem_region_size(*stack_sz + profile->heap_sz, align, span);
+}
+
 void msel_init_taskmem() 
 {
+    msel_task_profile profile;
+    size_t   stack_sz, size, align, span;
+    uint8_t *free_start;
+
+    msel_memset(regions, 0, sizeof(regions));
+    msel_memset(dirty, 0, sizeof(dirty));
+
+    regions[0].base = (uint8_t*)&tasks_start;
+    regions[0].size = (size_t)&tasks_size;
+    regions[0].stack_sz = (size_t)&tasks_stack_size;
+
+    /* Nothing after task 0 has been cleared since reset. Boot is the
+     * one time there's nobody waiting on it. */
+    free_start = regions[0].base + regions[0].size;
+    msel_memset(free_start, 0, (uint8_t*)&tasks_end - free_start);
+
+    taskmem_default_profile(&profile);
+    taskmem_layout(&profile, &stack_sz, &size, &align, &span);
+    heap_tmpl_sz = size - stack_sz;
+    heap_template(heap_tmpl, heap_tmpl_sz);
+
     /* Task 0 is the only task setup with ram by default */
     taskmem_init(0);
 }
 
+void taskmem_default_profile(msel_task_profile *profile)
+{
+    profile->stack_sz = (size_t)&tasks_stack_size;
+    profile->heap_sz  = (size_t)&tasks_heap_size;
+}
+
+/* Check that no other task's region overlaps [base, base+size) */
+static int region_is_free(const uint8_t *base, size_t size)
+{
+    size_t i;
+
+    for(i = 0; i < MSEL_TASKS_MAX; i++)
+    {
+        if(regions[i].size &&
+           base < regions[i].base + regions[i].size &&
+           regions[i].base < base + size)
+            return 0;
+    }
+    return 1;
+}
+
+msel_status taskmem_alloc(size_t tasknum, const msel_task_profile *profile)
+{
+    size_t    stack_sz, size, align, span;
+    uintptr_t base, last;
+    int       unswept = 0;
+
+    if(tasknum == 0 || tasknum >= MSEL_TASKS_MAX || regions[tasknum].size)
+        return MSEL_EINVAL;
+
+    taskmem_layout(profile, &stack_sz, &size, &align, &span);
+    if(stack_sz == 0 || profile->heap_sz < TASKMEM_HEAP_MIN)
+        return MSEL_EINVAL;
+
+    /* First fit, at the alignment the hardware needs, among the gaps
+     * that have been swept already */
+    base = ((uintptr_t)&tasks_start + (size_t)&tasks_size + align - 1) & ~(align - 1);
+    last = (uintptr_t)&tasks_end;
+    for(; base + size <= last; base += align)
+    {
+        if(span && (base & ~(span - 1)) != ((base + size - 1) & ~(span - 1)))
+            continue;
+        if(!region_is_free((uint8_t*)base, size))
+            continue;
+        if(region_is_clean((uint8_t*)base, size))
+            break;
+        unswept = 1;
+    }
+    if(base + size > last)
+        return unswept ? MSEL_EBUSY : MSEL_ENOMEM;
+
+    regions[tasknum].base = (uint8_t*)base;
+    regions[tasknum].size = size;
+    regions[tasknum].stack_sz = stack_sz;
+    return MSEL_OK;
+}
+
+void taskmem_free(size_t tasknum)
+{
+    if(tasknum == 0 || tasknum >= MSEL_TASKS_MAX || !regions[tasknum].size)
+        return;
+
+    /* Don't leave the old owner's permissions cached for whoever gets
+     * the memory next */
+    arch_mm_invalidate(regions[tasknum].base, regions[tasknum].size);
+    taskmem_mark_dirty(regions[tasknum].base, regions[tasknum].size);
+    regions[tasknum].size = 0;
+}
+
 void taskmem_init(size_t tasknum)
 {
-    /* Zero all task-owned mem (DO NOT reset task 0 stack, for it is the current stack) */
-    if(tasknum != 0)
-        msel_memset(taskmem_stack_bottom(tasknum), 0, ((size_t)&tasks_size));
+    /* Task memory is already zero: taskmem_alloc only hands out RAM
+     * that was cleared at boot or has been swept since. Tasks with the
+     * default heap size get a copy of the prebuilt header. */
+    if(taskmem_heap_size(tasknum) == heap_tmpl_sz)
+        heap_init_from(taskmem_heap_start(tasknum), heap_tmpl);
+    else
+        heap_init(taskmem_heap_start(tasknum),taskmem_heap_end(tasknum));
+}
+
+void msel_taskmem_sweep()
+{
+    size_t i, n;
+
+    for(i = 0; i < TASKMEM_DIRTY_MAX; i++)
+    {
+        if(dirty[i].size == 0)
+            continue;
 
-    /* Pre-initialize heap for task */
-    heap_init(taskmem_heap_start(tasknum),taskmem_heap_end(tasknum));
+        /* Work back from the end so only the size changes */
+        n = dirty[i].size < TASKMEM_SWEEP_BYTES ? dirty[i].size : TASKMEM_SWEEP_BYTES;
+        dirty[i].size -= n;
+        msel_memset(dirty[i].base + dirty[i].size, 0, n);
+        return;
+    }
 }
 
 inline void* taskmem_stack_top(size_t tasknum)
 {
-    return (void *)(((uint32_t)&tasks_start) + ((uint32_t)&tasks_size)*tasknum + ((uint32_t)&tasks_stack_size));
+    return regions[tasknum].base + regions[tasknum].stack_sz;
 }
 
 inline void* taskmem_stack_bottom(size_t tasknum)
 {
-    return (void *)(((uint32_t)&tasks_start) + ((uint32_t)&tasks_size)*tasknum);
+    return regions[tasknum].base;
 }
 
 inline size_t taskmem_stack_size(size_t tasknum)
 {
-    return ((size_t)&tasks_stack_size);
+    return regions[tasknum].stack_sz;
 }
 
 inline void* taskmem_heap_start(size_t tasknum)
@@ -78,12 +269,71 @@ inline void* taskmem_heap_start(size_t tasknum)
 
 inline void* taskmem_heap_end(size_t tasknum)
 {
-    return (void *)(((uint32_t)&tasks_start) + ((uint32_t)&tasks_size)*tasknum + ((uint32_t)&tasks_size));
+    return regions[tasknum].base + regions[tasknum].size;
 }
 
 inline size_t taskmem_heap_size(size_t tasknum)
 {
-    return (size_t)&tasks_heap_size;
+    return regions[tasknum].size - regions[tasknum].stack_sz;
 }
 
+msel_status msel_taskmem_heap_stats(msel_heap_stats_args *args)
+{
+    msel_tcb *task;
+
+    if(args->tasknum >= MSEL_TASKS_MAX)
+        return MSEL_EINVAL;
 
+    task = &msel_task_list[args->tasknum];
+    if(!task->valid || msel_task_is_killed(task))
+        return MSEL_EINVAL;
+
+    /* The heap is in the task's own memory, where it can write anything */
+    if(!heap_stats_checked(taskmem_heap_start(args->tasknum), taskmem_heap_start(args->tasknum),
+                           taskmem_heap_end(args->tasknum), &args->stats))
+        return MSEL_EUNKNOWN;
+    return MSEL_OK;
+}
+
+/* Append " name=0x........" to a dump line, in hex to avoid division */
+static char* dump_field(char *out, const char *name, uint32_t val)
+{
+    *out++ = ' ';
+    while(*name)
+        *out++ = *name++;
+    *out++ = '=';
+    *out++ = '0';
+    *out++ = 'x';
+    return fmt_hex(out, val, 8);
+}
+
+void msel_taskmem_dump_stats()
+{
+    char line[128];
+    msel_heap_stats_args args;
+    char *out;
+
+    for(args.tasknum = 0; args.tasknum < MSEL_TASKS_MAX; args.tasknum++)
+    {
+        if(msel_taskmem_heap_stats(&args) != MSEL_OK)
+            continue;
+
+        out = line;
+        msel_memcpy(out, "heap task", 9);
+        out += 9;
+        *out++ = ' ';
+        out = fmt_dec(out, args.tasknum);
+        out = dump_field(out, "used", args.stats.in_use);
+        out = dump_field(out, "peak", args.stats.peak);
+        out = dump_field(out, "size", args.stats.size);
+        out = dump_field(out, "maxfree", args.stats.largest_free);
+        out = dump_field(out, "allocs", args.stats.allocs);
+        out = dump_field(out, "failed", args.stats.failed);
+        *out++ = '\r';
+        *out++ = '\n';
+
+        /* The next dump will have fresher numbers anyway */
+        if(uart_log_write(line, out - line) != MSEL_OK)
+            return;
+    }
+}
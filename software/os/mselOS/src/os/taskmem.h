@@ -18,13 +18,49 @@
 #define _MSEL_TASKMEM_H_
 
 #include <stdlib.h>
+#include <msel.h>
+#include <msel/malloc.h>
+#include <msel/tasks.h>
+
+/** @brief The smallest heap a task may be created with */
+#define TASKMEM_HEAP_MIN 512
+
+/** @brief Most freed task RAM zeroed by one call to msel_taskmem_sweep */
+#ifndef TASKMEM_SWEEP_BYTES
+#define TASKMEM_SWEEP_BYTES 1024
+#endif
 
 /** @brief called at boot time to initialize this module */
 void msel_init_taskmem();
 
-/** @brief Initialize the RAM for a newly created task, by task number. */
+/** @brief Fill in the stack and heap sizes used when a task doesn't ask
+    for anything else (one of the linker script's task slots) */
+void taskmem_default_profile(msel_task_profile *profile);
+
+/** @brief Reserve RAM for a new task, by task number.
+
+    The region is rounded up to what the memory protection hardware can
+    map by itself, and any slack is added to the heap.
+
+    Freed RAM is only handed out again once msel_taskmem_sweep has
+    zeroed it.
+
+    @return MSEL_OK, MSEL_EINVAL for a bad task number or profile,
+    MSEL_EBUSY if the only large enough gaps are still being swept, or
+    MSEL_ENOMEM if no large enough gap is left */
+msel_status taskmem_alloc(size_t, const msel_task_profile *profile);
+
+/** @brief Give a task's RAM back for use by later tasks */
+void taskmem_free(size_t);
+
+/** @brief Initialize the RAM for a newly created task, by task number.
+    The RAM is zero already, so this only sets up the heap header. */
 void taskmem_init(size_t);
 
+/** @brief Zero up to TASKMEM_SWEEP_BYTES of freed task RAM. Called
+    from msel_svc_worker. */
+void msel_taskmem_sweep();
+
 /** @brief Location of end of stack section for given task */
 void* taskmem_stack_top(size_t);
 
@@ -40,8 +76,18 @@ void* taskmem_heap_start(size_t);
 /** @brief Location of the end of heap for a given task */
 void* taskmem_heap_end(size_t);
 
-/** @brief Size of the heap area for a given task (this excludes area for the mspace val) */
+/** @brief Size of the heap area for a given task (this includes the area for the HEAP header) */
 size_t taskmem_heap_size(size_t);
 
+/** @brief Implements the MSEL_SVC_HEAP_STATS syscall, reading the heap
+    counters of any live task.
+
+    @return MSEL_OK, MSEL_EINVAL if the task doesn't exist, or
+    MSEL_EUNKNOWN if its free lists have been overwritten */
+msel_status msel_taskmem_heap_stats(msel_heap_stats_args *args);
+
+/** @brief Write a line of heap counters for every live task to the UART */
+void msel_taskmem_dump_stats();
+
 #endif
 
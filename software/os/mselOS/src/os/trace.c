@@ -0,0 +1,117 @@
+/* @file trace.c
+
+   Kernel event trace buffer, see trace.h. Events are only ever
+   recorded from the kernel with interrupts off, so the ring needs no
+   locking.
+
+*/
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <msel/stdc.h>
+
+#include "trace.h"
+#include "task.h"
+#include "util.h"
+
+#include "driver/uart.h"
+
+#include "arch.h"
+
+#if TRACE_CATEGORIES
+
+#define TRACE_MASK (TRACE_BUF_ENTRIES - 1)
+
+/* Length of one "trace TTTTTTTT EETTAAAA\r\n" line */
+#define TRACE_LINE_LEN 25
+
+static msel_trace_rec trace_buf[TRACE_BUF_ENTRIES];
+static uint32_t       trace_head;  /* next slot to write */
+static uint32_t       trace_tail;  /* next slot to drain */
+static uint32_t       trace_lost;  /* dropped since the last TRACE_LOST */
+
+static void trace_put(uint8_t event, uint8_t task, uint16_t arg)
+{
+    msel_trace_rec *rec = &trace_buf[trace_head & TRACE_MASK];
+
+    rec->time  = arch_timestamp();
+    rec->event = event;
+    rec->task  = task;
+    rec->arg   = arg;
+    trace_head++;
+}
+
+void msel_trace_record(uint8_t event, uint8_t task, uint16_t arg)
+{
+    /* A loss has to be reported before anything newer */
+    uint32_t need = trace_lost ? 2 : 1;
+
+    /* Keep the oldest events, they're the ones that explain the rest */
+    if(trace_head - trace_tail + need > TRACE_BUF_ENTRIES)
+    {
+        if(trace_lost < 0xffff)
+            trace_lost++;
+        return;
+    }
+
+    if(trace_lost)
+    {
+        trace_put(TRACE_LOST, msel_active_task_num, (uint16_t)trace_lost);
+        trace_lost = 0;
+    }
+
+    trace_put(event, task, arg);
+}
+
+/* Format the oldest event for uart_log_drain */
+static char* trace_line(char *out)
+{
+    msel_trace_rec *rec;
+
+    if(trace_tail == trace_head)
+        return NULL;
+    rec = &trace_buf[trace_tail++ & TRACE_MASK];
+
+    msel_memcpy(out, "trace ", 6);
+    out = fmt_hex(out + 6, rec->time, 8);
+    *out++ = ' ';
+    out = fmt_hex(out, rec->event, 2);
+    out = fmt_hex(out, rec->task, 2);
+    out = fmt_hex(out, rec->arg, 4);
+    *out++ = '\r';
+    *out++ = '\n';
+    return out;
+}
+
+void msel_trace_drain()
+{
+    uart_log_drain(trace_line, TRACE_LINE_LEN, TRACE_DRAIN_MAX);
+}
+
+#else
+
+void msel_trace_record(uint8_t event, uint8_t task, uint16_t arg)
+{
+    (void)event;
+    (void)task;
+    (void)arg;
+}
+
+void msel_trace_drain()
+{
+}
+
+#endif
@@ -0,0 +1,129 @@
+/** @file trace.h */
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef _MSEL_TRACE_H_
+#define _MSEL_TRACE_H_
+
+/* This header is shared with the host-side decoder (tracedec.c), which
+ * defines MSEL_TRACE_HOST and only uses the event numbers and the line
+ * format. */
+
+#include <stdint.h>
+
+#ifndef MSEL_TRACE_HOST
+#include "config.h"
+#include "task.h"
+#endif
+
+/** @defgroup trace Kernel Event Tracing
+
+    Kernel events are stamped with arch_timestamp() and kept in a ring
+    buffer in RAM, which msel_svc_worker drains over the UART as lines
+    of the form
+
+        trace TTTTTTTT EETTAAAA
+
+    holding the timestamp, event number, task number and argument in
+    hex. tracedec turns a captured UART log into Chrome trace JSON.
+
+    Each category is enabled at build time (--with-trace), and the
+    calls for disabled categories compile away. When the worker can't
+    keep up, new events are dropped and counted, and a TRACE_LOST
+    event reports how many once there is room again.
+
+ *  @{
+ */
+
+/** @name Trace Categories
+ *  @{
+ */
+#define TRACE_CAT_SVC    0x01 /**< syscall entry and exit */
+#define TRACE_CAT_SCHED  0x02 /**< context switches */
+#define TRACE_CAT_ISR    0x04 /**< interrupt entry and exit */
+#define TRACE_CAT_FFS    0x08 /**< FFS packet routing */
+#define TRACE_CAT_TASK   0x10 /**< task creation and termination */
+/** @} */
+
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES 0
+#endif
+
+/** @brief Number of events the ring buffer holds (a power of two) */
+#ifndef TRACE_BUF_ENTRIES
+#define TRACE_BUF_ENTRIES 256
+#endif
+
+/** @brief Most events printed by one call to msel_trace_drain */
+#define TRACE_DRAIN_MAX 32
+
+/** @brief Trace event numbers. Don't renumber these, captured logs
+    depend on them. */
+typedef enum {
+    TRACE_LOST        = 0x00, /**< arg: number of events dropped */
+
+    TRACE_SVC_ENTER   = 0x01, /**< arg: svc number */
+    TRACE_SVC_EXIT    = 0x02, /**< arg: result (msel_status) */
+
+    TRACE_SWITCH      = 0x10, /**< task: the task switched to, arg: the previous task */
+    TRACE_CPU_USER    = 0x11, /**< task: the task switched away from, arg: user cycles/256 in its slice */
+    TRACE_CPU_KERNEL  = 0x12, /**< task: the task switched away from, arg: kernel cycles/256 in its slice */
+
+    TRACE_ISR_ENTER   = 0x20, /**< arg: vector/exception number */
+    TRACE_ISR_EXIT    = 0x21, /**< arg: vector/exception number */
+
+    TRACE_FFS_IN      = 0x30, /**< arg: session an incoming packet was queued for */
+    TRACE_FFS_IN_FAIL = 0x31, /**< arg: session of an incoming packet that was refused */
+    TRACE_FFS_QUEUE   = 0x32, /**< arg: session an outgoing packet was queued for */
+    TRACE_FFS_OUT     = 0x33, /**< arg: session of a packet written to RFILE */
+
+    TRACE_TASK_CREATE = 0x40, /**< task: the new task */
+    TRACE_TASK_KILL   = 0x41, /**< task: the killed task */
+} msel_trace_event;
+
+/** @brief One recorded event */
+typedef struct {
+    uint32_t time;  /**< arch_timestamp() */
+    uint8_t  event; /**< msel_trace_event */
+    uint8_t  task;  /**< task the event belongs to */
+    uint16_t arg;   /**< event specific */
+} msel_trace_rec;
+
+/** @} */
+
+#ifndef MSEL_TRACE_HOST
+
+/** @brief Record an event for the active task if its category is enabled */
+#define MSEL_TRACE(cat, event, arg) \
+    MSEL_TRACE_TASK(cat, event, msel_active_task_num, arg)
+
+/** @brief Record an event for a given task if its category is enabled */
+#define MSEL_TRACE_TASK(cat, event, task, arg)                         \
+    do {                                                                \
+        if(TRACE_CATEGORIES & (cat))                                    \
+            msel_trace_record((event), (uint8_t)(task), (uint16_t)(arg)); \
+    } while(0)
+
+/** @brief Append an event to the ring buffer. Only call from the
+    kernel, see MSEL_TRACE. */
+void msel_trace_record(uint8_t event, uint8_t task, uint16_t arg);
+
+/** @brief Print up to TRACE_DRAIN_MAX buffered events on the UART.
+    Called from msel_svc_worker. */
+void msel_trace_drain();
+
+#endif
+
+#endif
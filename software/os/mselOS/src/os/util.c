@@ -34,3 +34,36 @@ inline int ilog2(uint32_t op)
     /* round up */
     return (op != (1<<last)) ? -1 : last;
 }
+
+/* By subtraction, so the log paths don't pull in a software divide */
+char* fmt_dec(char *out, uint8_t val)
+{
+    static const uint8_t powers[] = { 100, 10 };
+    int i, started = 0;
+
+    for(i = 0; i < 2; i++)
+    {
+        char digit = '0';
+        while(val >= powers[i])
+        {
+            val -= powers[i];
+            digit++;
+        }
+        if(started || digit != '0')
+        {
+            *out++ = digit;
+            started = 1;
+        }
+    }
+    *out++ = '0' + val;
+    return out;
+}
+
+char* fmt_hex(char *out, uint32_t val, int digits)
+{
+    int shift;
+
+    for(shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+        *out++ = "0123456789abcdef"[(val >> shift) & 0xf];
+    return out;
+}
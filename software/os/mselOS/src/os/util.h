@@ -28,4 +28,10 @@
 
 int ilog2(uint32_t);
 
+/* Write val in decimal at out, returning the end of the digits */
+char* fmt_dec(char *out, uint8_t val);
+
+/* Write the low digits hex digits of val at out, returning their end */
+char* fmt_hex(char *out, uint32_t val, int digits);
+
 #endif
@@ -16,6 +16,8 @@
 #include <msel/debug.h>
 
 #include <crypto/aes.h>
+#include <crypto/aes_ctr.h>
+#include <crypto/aes_xts.h>
 
 void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
         uint16_t *port, const uint8_t* data)
@@ -91,6 +93,119 @@ void aes_task(void *arg, const size_t arg_sz)
                 uart_print("ERROR!\n");
         }
     }
+
+    // Several blocks in one call, in place, against one block at a time.
+    // Three blocks leaves the bitsliced code an odd one out.
+    {
+        aes_driver_ctx_t aes;
+        uint8_t one[64];
+        uint8_t buf[64];
+        int n, bad = 0;
+
+        for (i = 0; i < 3; ++i)
+        {
+            aes.key_size = i;
+            aes.key = key[i];
+
+            aes.enc = 1;
+            aes.data_len = 16;
+            for (j = 0; j < 4; ++j)
+            {
+                aes.din = din[j];
+                aes.dout = one + j * 16;
+                msel_svc(MSEL_SVC_AES, &aes);
+            }
+
+            for (n = 3; n <= 4; ++n)
+            {
+                msel_memcpy(buf, din, sizeof(buf));
+                aes.enc = 1;
+                aes.data_len = n * 16;
+                aes.din = buf;
+                aes.dout = buf;
+                msel_svc(MSEL_SVC_AES, &aes);
+                if (msel_memcmp(buf, one, n * 16) != 0)
+                    bad = 1;
+
+                aes.enc = 0;
+                msel_svc(MSEL_SVC_AES, &aes);
+                if (msel_memcmp(buf, din, n * 16) != 0)
+                    bad = 1;
+            }
+        }
+
+        if (bad)
+            uart_print("ERROR!\n");
+        else
+            uart_print("ECB BATCH OK\n");
+    }
+
+    // CTR mode (SP 800-38A F.5.1), in uneven pieces
+    {
+        aes_ctr_ctx_t ctr;
+        uint8_t iv[16];
+        uint8_t buf[64];
+
+        for (k = 0; k < 16; ++k)
+            iv[k] = 0xf0 + k;
+        msel_memcpy(buf, din, sizeof(buf));
+
+        aes_ctr_setkey(&ctr, AES_128, key[0], iv);
+        aes_ctr_crypt(&ctr, buf, 7, buf);
+        aes_ctr_crypt(&ctr, buf + 7, sizeof(buf) - 7, buf + 7);
+        for (j = 0; j < 4; ++j)
+        {
+            for (k = 0; k < 16; ++k)
+            {
+                byte_to_string(buf[j * 16 + k], str);
+                uart_write(str, 2);
+            }
+            uart_print("\n");
+        }
+
+        aes_ctr_setkey(&ctr, AES_128, key[0], iv);
+        aes_ctr_crypt(&ctr, buf, sizeof(buf), buf);
+        if (msel_memcmp(buf, din, sizeof(buf)) != 0)
+            uart_print("ERROR!\n");
+        else
+            uart_print("CTR OK\n");
+        aes_ctr_clear(&ctr);
+    }
+
+    // XTS (IEEE 1619 vector 2, carried on to 20 blocks so it spans batches)
+    {
+        aes_xts_ctx_t xts;
+        uint8_t xts_key[32];
+        uint8_t xts_buf[20 * 16];   // runs longer than one batch
+        int bad = 0;
+
+        msel_memset(xts_key, 0x11, 16);
+        msel_memset(xts_key + 16, 0x22, 16);
+        msel_memset(xts_buf, 0x44, sizeof(xts_buf));
+
+        aes_xts_setkey(&xts, AES_XTS_128, xts_key);
+        aes_xts_encrypt(&xts, xts_buf, 20, 0x3333333333ULL, xts_buf);
+        for (j = 0; j < 20; ++j)
+        {
+            if (j != 0 && j != 1 && j != 8 && j != 19)
+                continue;
+            for (k = 0; k < 16; ++k)
+            {
+                byte_to_string(xts_buf[j * 16 + k], str);
+                uart_write(str, 2);
+            }
+            uart_print("\n");
+        }
+
+        aes_xts_decrypt(&xts, xts_buf, 20, 0x3333333333ULL, xts_buf);
+        for (j = 0; j < sizeof(xts_buf); ++j)
+            if (xts_buf[j] != 0x44)
+                bad = 1;
+        if (bad)
+            uart_print("ERROR!\n");
+        else
+            uart_print("XTS OK\n");
+    }
 }
 
 /** @brief Runs immediately after reset and gcc init. initializes system and never returns
@@ -13,9 +13,12 @@
 #include <msel/malloc.h>
 #include <msel/uuid.h>
 #include <msel/stdc.h>
+#include <msel/trng.h>
 #include <msel/debug.h>
 
 #include <crypto/ecc.h>
+#include <crypto/kdf.h>
+#include <crypto/prng.h>
 
 void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
         uint16_t *port, const uint8_t* data)
@@ -37,6 +40,56 @@ static void byte_to_string(uint8_t byte, uint8_t* str)
 static uint8_t base_point[128] = { 0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0, 0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0, 0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0, 0x75,0x2c,0xb4,0x5c,0x48,0x64,0x8b,0x18,0x9d,0xf9,0x0c,0xb2,0x29,0x6b,0x28,0x78, 0xa3,0xbf,0xd9,0xf4,0x2f,0xc6,0xc8,0x18,0xec,0x8b,0xf3,0xc9,0xc0,0xc6,0x20,0x39, 0x13,0xf6,0xec,0xc5,0xcc,0xc7,0x24,0x34,0xb1,0xae,0x94,0x9d,0x56,0x8f,0xc9,0x9c, 0x60,0x59,0xd0,0xfb,0x13,0x36,0x48,0x38,0xaa,0x30,0x2a,0x94,0x0a,0x2f,0x19,0xba,0x6c };
 static uint8_t group_order[128] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfd, 0x15, 0xb6, 0xc6, 0x47, 0x46, 0xfc, 0x85, 0xf7, 0x36, 0xb8, 0xaf, 0x5e, 0x7e, 0xc5, 0x3f, 0x04, 0xfb, 0xd8, 0xc4, 0x56, 0x9a, 0x8f, 0x1f, 0x45, 0x40, 0xea, 0x24, 0x35, 0xf5, 0x18, 0x0d, 0x6b };
 
+// Known answers: kat_scalar1 * base, then kat_scalar2 * that (right-aligned)
+static uint8_t kat_scalar1[66] = { 0xf8, 0x53, 0x5b, 0x24, 0x6f, 0x35, 0xde, 0x30, 0xf5, 0x38, 0x5b, 0x0d, 0x04, 0x6e, 0xcf, 0x58, 0xdb, 0x82, 0x2d, 0x73, 0x65, 0x35, 0xfa, 0xac, 0xd7, 0x06, 0xdd, 0x88, 0x27, 0x2d, 0xc6, 0x3c, 0x0c, 0xd6, 0xb6, 0x6c, 0xb7, 0xea, 0xcb, 0xa3, 0xea, 0xf4, 0x68, 0xd8, 0xfa, 0x9f, 0x40, 0x56, 0xc2, 0xb4, 0x4f, 0x0f, 0x8f, 0xec, 0xdb, 0xbd, 0xa1, 0x06, 0x00, 0x17, 0x9e, 0xa0, 0x19, 0x8f, 0x7e, 0xb9 };
+static uint8_t kat_scalar2[16] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+
+// Known answer for the applications' key generation: kdf over master 00..1f,
+// protocol 20..3f and seed 40..5f, the prng stream as the scalar, then the
+// public key's x (right-aligned). The prng's DT counter is a native integer.
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+static uint8_t kat_keygen_pub[66] = { 0x01, 0xdd, 0x94, 0x2d, 0x28, 0xcf, 0x8b, 0xbb, 0x4a, 0x4a, 0xca, 0xcb, 0x41, 0x46, 0x19, 0x63, 0x26, 0xe0, 0xa4, 0xcb, 0x90, 0xda, 0xed, 0xd1, 0x1a, 0xca, 0x39, 0x27, 0x4c, 0x35, 0xff, 0x7a, 0xf8, 0xc7, 0xf4, 0x4e, 0x89, 0x7f, 0xb8, 0xed, 0x3b, 0xd6, 0x47, 0xfd, 0x66, 0x90, 0x29, 0x36, 0xbb, 0xe4, 0x3e, 0xe1, 0x06, 0x98, 0x8b, 0xc5, 0x19, 0x06, 0xbb, 0xd4, 0x1e, 0xb0, 0x9f, 0x9f, 0xd2, 0xe8 };
+#else
+static uint8_t kat_keygen_pub[66] = { 0x01, 0x19, 0x56, 0x0e, 0x85, 0xbf, 0x00, 0x95, 0x8b, 0x94, 0x4d, 0x29, 0x94, 0x79, 0xb9, 0xfa, 0x92, 0x1e, 0x36, 0x65, 0x76, 0xfc, 0x81, 0x57, 0x32, 0x5b, 0xcc, 0xf6, 0x1d, 0x53, 0xb3, 0xcf, 0x94, 0x00, 0x1f, 0x7f, 0xae, 0xb0, 0xc2, 0x3e, 0xec, 0x44, 0xdd, 0xef, 0x4c, 0x43, 0x10, 0x83, 0xd9, 0x0f, 0xd8, 0x4a, 0x04, 0x82, 0x90, 0x7e, 0xce, 0xeb, 0xcc, 0xe1, 0x68, 0xdb, 0x8a, 0x9b, 0xa8, 0x52 };
+#endif
+
+// Derives a key pair the way bulkencryption_ecc_genkey does
+static int keygen_test(void)
+{
+    uint8_t master[32], protocol[32], seed[32], tmp[32];
+    uint8_t prv[128], pub[128];
+    prng_ctx_t prng;
+    ecc_ctx_t ecc_ctx;
+    unsigned i;
+
+    for (i = 0; i < 32; ++i)
+    {
+        master[i] = i;
+        protocol[i] = 0x20 + i;
+        seed[i] = 0x40 + i;
+    }
+
+    kdf_getkey(master, sizeof(master), protocol, sizeof(protocol), seed, tmp);
+    prng_init(&prng, AES_128, tmp, ((uint64_t*)tmp)[2], ((uint64_t*)tmp)[3]);
+    prng_generate(&prng, prv, ECC_SCALAR_LEN);
+
+    msel_memcpy(pub, base_point, ECC_POINT_LEN);
+    ecc_ctx.scalar = prv;
+    ecc_ctx.point = pub;
+    msel_svc(MSEL_SVC_ECC, &ecc_ctx);
+
+    // The sign of y is in the first byte, x is right-aligned
+    if (pub[0] != 0x01)
+        return 0;
+    for (i = 1; i < ECC_POINT_LEN - sizeof(kat_keygen_pub); ++i)
+        if (pub[i] != 0)
+            return 0;
+    for (i = 0; i < sizeof(kat_keygen_pub); ++i)
+        if (pub[ECC_POINT_LEN - sizeof(kat_keygen_pub) + i] != kat_keygen_pub[i])
+            return 0;
+    return 1;
+}
+
 void ecc_task(void *arg, const size_t arg_sz) {
 
     uint8_t str[2];
@@ -60,6 +113,29 @@ void ecc_task(void *arg, const size_t arg_sz) {
         uart_write(str, 2);
     }
     uart_print("\n");
+
+    msel_memcpy(point1, base_point, 128);
+    msel_memset(scalar1, 0, 128);
+    msel_memcpy(scalar1 + 128 - sizeof(kat_scalar1), kat_scalar1, sizeof(kat_scalar1));
+    msel_svc(MSEL_SVC_ECC, &ecc_ctx);
+    for (i = 0; i < 128; ++i)
+    {
+        byte_to_string(point1[i], str);
+        uart_write(str, 2);
+    }
+    uart_print("\n");
+
+    msel_memset(scalar1, 0, 128);
+    msel_memcpy(scalar1 + 128 - sizeof(kat_scalar2), kat_scalar2, sizeof(kat_scalar2));
+    msel_svc(MSEL_SVC_ECC, &ecc_ctx);
+    for (i = 0; i < 128; ++i)
+    {
+        byte_to_string(point1[i], str);
+        uart_write(str, 2);
+    }
+    uart_print("\n");
+
+    uart_print(keygen_test() ? "KEYGEN OK\n" : "KEYGEN ERROR\n");
     
     unsigned j = 0;
     while (j++ < 5)
@@ -68,11 +144,8 @@ void ecc_task(void *arg, const size_t arg_sz) {
         msel_memset(scalar2, 0, 128);
 
         // Make up two random numbers and do some multiplies;
-        for (i = 63; i < 128; ++i)
-        {
-            msel_svc(MSEL_SVC_TRNG, scalar1 + i);
-            msel_svc(MSEL_SVC_TRNG, scalar2 + i);
-        }
+        msel_trng_read(scalar1 + 63, 65);
+        msel_trng_read(scalar2 + 63, 65);
 
         // Print out the scalars in case something breaks
         uart_print("n1 = ");
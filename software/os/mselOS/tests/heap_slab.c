@@ -0,0 +1,148 @@
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/stdc.h>
+#include <msel/malloc.h>
+#include <msel/debug.h>
+#include "malloc_int.h"
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+/* The slab tests run against a private heap so the layout is known. It
+ * is carved out of the task's own heap, since the task can't write .bss. */
+#define TEST_HEAP_SIZE 4096
+#define MAX_OBJS (TEST_HEAP_SIZE / (sizeof(HEADER) + ALIGN_SIZE))
+
+static int is_slab_obj(void *ptr)
+{
+    HEADER *hdr = ((HEADER *) ptr) - 1;
+    return (CHUNK_FLAGS(hdr) & CHUNK_OBJ) != 0;
+}
+
+/* Small objects come out of a slab, and a freed object is handed out again */
+static int test_reuse(void *h)
+{
+    void *a, *b, *c;
+    heap_stats_t before, after;
+
+    heap_init(h, (uint8_t *) h + TEST_HEAP_SIZE);
+
+    a = heap_malloc(h, 24);
+    if(!a || !is_slab_obj(a))
+        return 0;
+
+    /* the second object of the class fits in the slab already carved */
+    heap_stats(h, &before);
+    b = heap_malloc(h, 24);
+    heap_stats(h, &after);
+    if(!b || !is_slab_obj(b) || after.in_use != before.in_use)
+        return 0;
+
+    heap_free(h, a);
+    c = heap_malloc(h, 24);
+    if(c != a)
+        return 0;
+
+    heap_free(h, b);
+    heap_free(h, c);
+    return 1;
+}
+
+/* Allocating until the heap runs dry fails cleanly, and freeing everything
+ * gives the space back, including the empty slab kept for reuse */
+static int test_exhaustion(void *h, void **objs)
+{
+    size_t n, i;
+    heap_stats_t stats;
+
+    heap_init(h, (uint8_t *) h + TEST_HEAP_SIZE);
+    heap_stats(h, &stats);
+
+    for(n = 0; n < MAX_OBJS; n++)
+    {
+        objs[n] = heap_malloc(h, ALIGN_SIZE);
+        if(!objs[n])
+            break;
+    }
+    if(n == 0 || n == MAX_OBJS)
+        return 0;
+
+    heap_stats(h, &stats);
+    if(stats.failed != 1 || stats.allocs != n || stats.in_use > stats.size)
+        return 0;
+
+    for(i = 0; i < n; i++)
+        heap_free(h, objs[i]);
+
+    objs[0] = heap_malloc(h, TEST_HEAP_SIZE / 2);
+    if(!objs[0] || is_slab_obj(objs[0]))
+        return 0;
+    heap_free(h, objs[0]);
+    return 1;
+}
+
+/* With too little room left to carve a slab, small requests are served
+ * straight from the general heap */
+static int test_fallback(void *h)
+{
+    void *big, *p;
+    heap_stats_t stats;
+
+    heap_init(h, (uint8_t *) h + TEST_HEAP_SIZE);
+    heap_stats(h, &stats);
+
+    /* leave one free chunk of 4 * ALIGN_SIZE, too small for any slab */
+    big = heap_malloc(h, stats.largest_free - 4 * ALIGN_SIZE - sizeof(HEADER) - sizeof(FOOTER));
+    heap_stats(h, &stats);
+    if(!big || stats.largest_free != 4 * ALIGN_SIZE)
+        return 0;
+
+    p = heap_malloc(h, ALIGN_SIZE);
+    heap_stats(h, &stats);
+    if(!p || is_slab_obj(p) || stats.failed != 0)
+        return 0;
+
+    heap_free(h, p);
+    heap_free(h, big);
+    heap_stats(h, &stats);
+    return stats.in_use == 0;
+}
+
+void task1(void *arg, const size_t arg_sz)
+{
+    void *test_heap = msel_malloc(TEST_HEAP_SIZE);
+    void **objs = msel_malloc(MAX_OBJS * sizeof(void *));
+
+    if(!test_heap || ((uintptr_t) test_heap & (ALIGN_SIZE - 1)) || !objs)
+    {
+        uart_print("SLAB ERROR: no test heap\r\n");
+        return;
+    }
+
+    while(1)
+    {
+        uart_print("SLAB TEST STARTING\r\n");
+
+        uart_print(test_reuse(test_heap) ? "SLAB REUSE OK\r\n" : "SLAB ERROR: reuse\r\n");
+        uart_print(test_exhaustion(test_heap, objs) ? "SLAB EXHAUSTION OK\r\n" : "SLAB ERROR: exhaustion\r\n");
+        uart_print(test_fallback(test_heap) ? "SLAB FALLBACK OK\r\n" : "SLAB ERROR: fallback\r\n");
+
+        uart_print("SLAB TEST COMPLETE\r\n");
+    }
+}
+
+int main()
+{
+    msel_init();
+
+    msel_task_create(task1, NULL, 0, NULL);
+
+    msel_start();
+
+    /* never reached */
+    while(1);
+}
@@ -0,0 +1,69 @@
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/kv.h>
+#include <msel/stdc.h>
+#include <msel/debug.h>
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+static const char key[] = "counter";
+
+/* Each task has its own namespace, so both store under the same key */
+void kv_user(void *arg, const size_t arg_sz)
+{
+    uint32_t    val, got;
+    size_t      len;
+    msel_status ret;
+
+    for(val = 0; val < 100; val++)
+    {
+        if(msel_kv_put(key, sizeof(key), &val, sizeof(val)) != MSEL_OK)
+        {
+            uart_print("KV PUT ERROR");
+            msel_task_exit();
+        }
+
+        len = sizeof(got);
+        ret = msel_kv_get(key, sizeof(key), &got, &len);
+        if(ret != MSEL_OK || len != sizeof(got) || got != val)
+        {
+            uart_print("KV GET ERROR");
+            msel_task_exit();
+        }
+    }
+
+    /* Too small a buffer says how big it needs to be */
+    len = 1;
+    if(msel_kv_get(key, sizeof(key), &got, &len) != MSEL_ENOMEM || len != sizeof(got))
+        uart_print("KV SIZE ERROR");
+
+    if(msel_kv_delete(key, sizeof(key)) != MSEL_OK)
+        uart_print("KV DELETE ERROR");
+
+    len = sizeof(got);
+    if(msel_kv_get(key, sizeof(key), &got, &len) != MSEL_EBADF ||
+       msel_kv_delete(key, sizeof(key)) != MSEL_EBADF)
+        uart_print("KV STILL THERE ERROR");
+    else
+        uart_print("KV OK");
+
+    msel_task_exit();
+}
+
+int main()
+{
+    msel_init();
+
+    msel_task_create(kv_user, NULL, 0, NULL);
+    msel_task_create(kv_user, NULL, 0, NULL);
+
+    msel_start();
+
+    /* never reached */
+    while(1);
+}
@@ -37,6 +37,15 @@ void mtc_reader(void *arg, const size_t arg_sz)
             uart_print("MTC INC OK");
 
         prev = val;
+
+        /* A whole range comes after everything before it */
+        ret = mtc_reserve(16, &val);
+        if(ret != MSEL_OK || val <= prev)
+            uart_print("MTC RESERVE ERROR!");
+        else
+            uart_print("MTC RESERVE OK");
+
+        prev = val + 15;
     }
 }
 
@@ -38,11 +38,17 @@ static uint8_t din1[3] = { 'a', 'b', 'c' };
 static uint8_t din2[56] = { 'a', 'b', 'c', 'd', 'b', 'c', 'd', 'e', 'c', 'd', 'e', 'f', 'd', 'e', 'f', 'g', 'e', 'f', 'g', 'h', 'f', 'g', 'h', 'i', 'g', 'h', 'i', 'j', 'h', 'i', 'j', 'k', 'i', 'j', 'k', 'l', 'j', 'k', 'l', 'm', 'k', 'l', 'm', 'n', 'l', 'm', 'n', 'o', 'm', 'n', 'o', 'p', 'n', 'o', 'p', 'q' };
 static uint8_t din3[112] = { 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u' };
 
+// Long enough for more than one MSEL_SVC_SHA_BLOCKS call, and one byte
+// in so the blocks aren't word aligned. It lives on the task heap: the
+// task can't write .bss and its stack is too small.
+#define DIN4_SIZE (1 + 5000)
+
 /** @brief task that calls the SHA-256 transform function */
 void sha_task(void *arg, const size_t arg_sz) {
 
     uint8_t str[2];
     uint8_t dout[32];
+    uint8_t *din4;
     unsigned i;
     
     sha256_hash(din1, 3, dout); 
@@ -73,6 +79,28 @@ void sha_task(void *arg, const size_t arg_sz) {
         uart_write(str, 2);
     }
     uart_print("\n");
+    if((din4 = msel_malloc(DIN4_SIZE)) == NULL)
+    {
+        uart_print("MALLOC ERROR\n");
+        return;
+    }
+    msel_memset(din4, 'a', DIN4_SIZE);
+    // The length field mustn't overwrite the end of a 50-55 byte tail
+    sha256_hash(din4 + 1, 55, dout);
+    for (i = 0; i < 32; ++i)
+    {
+        byte_to_string(dout[i], str);
+        uart_write(str, 2);
+    }
+    uart_print("\n");
+    sha256_hash(din4 + 1, 5000, dout);
+    for (i = 0; i < 32; ++i)
+    {
+        byte_to_string(dout[i], str);
+        uart_write(str, 2);
+    }
+    uart_print("\n");
+    msel_free(din4);
 }
 
 /** @brief Runs immediately after reset and gcc init. initializes system and never returns
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/stdc.h>
+#include <msel/debug.h>
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+#define BUF_SZ  96
+#define MAX_LEN 72
+
+static void fill(uint8_t *buf, uint8_t seed)
+{
+    size_t i;
+    for(i=0;i<BUF_SZ;i++)
+        buf[i] = (uint8_t)(seed + i*7);
+}
+
+static int same(const uint8_t *a, const uint8_t *b)
+{
+    size_t i;
+    for(i=0;i<BUF_SZ;i++)
+        if(a[i] != b[i]) return 0;
+    return 1;
+}
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+/* Run every routine over every head/tail alignment, checking against
+ * plain byte loops. The buffers are on the stack, since a task can't
+ * write .bss. */
+void stdc_test(void *arg, const size_t arg_sz)
+{
+    uint8_t src[BUF_SZ], dst[BUF_SZ], ref[BUF_SZ];
+    size_t doff, soff, len, i;
+    int fail = 0;
+
+    for(doff=0; doff<4; doff++)
+    for(soff=0; soff<4; soff++)
+    for(len=0; len<=MAX_LEN; len++)
+    {
+        /* memcpy */
+        fill(src, 0x11); fill(dst, 0x80); fill(ref, 0x80);
+        for(i=0;i<len;i++)
+            ref[doff+i] = src[soff+i];
+        if(msel_memcpy(dst+doff, src+soff, len) != dst+doff || !same(dst, ref))
+            fail = 1;
+
+        /* memset */
+        fill(dst, 0x80); fill(ref, 0x80);
+        for(i=0;i<len;i++)
+            ref[doff+i] = 0xa5;
+        if(msel_memset(dst+doff, 0x1a5, len) != dst+doff || !same(dst, ref))
+            fail = 1;
+
+        /* memcmp of src+soff against a copy of it at dst+doff: equal,
+         * then differing at the first, middle and last byte */
+        fill(dst, 0x80);
+        for(i=0;i<len;i++)
+            dst[doff+i] = src[soff+i];
+        if(msel_memcmp(dst+doff, src+soff, len) != 0)
+            fail = 1;
+        for(i=0; len>0 && i<3; i++)
+        {
+            size_t at = (i == 0 ? 0 : (i == 1 ? len/2 : len-1));
+            dst[doff+at] ^= 0x80;
+            if(sign(msel_memcmp(dst+doff, src+soff, len)) != (dst[doff+at] < src[soff+at] ? -1 : 1))
+                fail = 1;
+            dst[doff+at] ^= 0x80;
+        }
+    }
+
+    if(fail)
+        uart_print("STDC FAIL\r\n");
+    else
+        uart_print("STDC OK\r\n");
+}
+
+int main() {
+    msel_status ret;
+
+    /* let msel initialize itself */
+    msel_init();
+
+    /* create threads here */
+    if((ret = msel_task_create(stdc_test,NULL,0,NULL)) != MSEL_OK)
+        goto err;
+
+    /* give control over to msel */
+    msel_start();
+    
+err:
+    while(1);
+
+    /* never reached */
+    return 0;
+}
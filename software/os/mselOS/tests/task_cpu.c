@@ -0,0 +1,68 @@
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/debug.h>
+#include <msel/syscalls.h>
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+#define NUM_YIELDS 8
+
+/* Task 1: yields a few times, then checks its own and task 2's counters */
+void check_task(void *arg, const size_t arg_sz)
+{
+    msel_task_stats_args args;
+    int ok = 1;
+    int i;
+
+    for(i = 0; i < NUM_YIELDS; i++)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+
+    args.tasknum = 1;
+    if(msel_svc(MSEL_SVC_TASK_STATS, &args) != MSEL_OK ||
+       args.stats.syscalls < NUM_YIELDS || args.stats.voluntary < NUM_YIELDS ||
+       args.stats.user_cycles == 0 || args.stats.kernel_cycles == 0)
+        ok = 0;
+
+    /* task 2 never gives up the CPU, so it only loses it to the tick */
+    args.tasknum = 2;
+    if(msel_svc(MSEL_SVC_TASK_STATS, &args) != MSEL_OK ||
+       args.stats.syscalls != 0 || args.stats.voluntary != 0 ||
+       args.stats.involuntary == 0 || args.stats.user_cycles == 0)
+        ok = 0;
+
+    args.tasknum = 200;
+    if(msel_svc(MSEL_SVC_TASK_STATS, &args) != MSEL_EINVAL)
+        ok = 0;
+
+    uart_print(ok ? "CPU STATS OK\r\n" : "CPU STATS ERROR\r\n");
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+/* Task 2: spins */
+void spin_task(void *arg, const size_t arg_sz)
+{
+    volatile uint32_t ctr = 0;
+
+    while(1)
+        ctr++;
+}
+
+int main()
+{
+    msel_init();
+
+    msel_task_create(check_task, NULL, 0, NULL);
+    msel_task_create(spin_task, NULL, 0, NULL);
+
+    msel_start();
+
+    /* never reached */
+    while(1);
+}
@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/ipc.h>
+#include <msel/malloc.h>
+#include <msel/debug.h>
+#include <msel/syscalls.h>
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+/* More than fit in the channel at once, so the producer has to sleep */
+#define NUM_MSGS 10
+
+/* The larger of the or1k and ARM page sizes, so it's aligned on both */
+#define LEND_PAGE 8192
+#define LEND_LEN  256
+
+static void fill(uint8_t *buf, size_t len, uint8_t seed)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+        buf[i] = (uint8_t)(seed + i);
+}
+
+static int check(const uint8_t *buf, size_t len, uint8_t seed)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+        if(buf[i] != (uint8_t)(seed + i))
+            return 0;
+    return 1;
+}
+
+/* Task 1: sends copies, then lends a page and takes it back. Last of
+ * all it writes to a page while it is lent, which has to kill it. */
+void producer(void *arg, const size_t arg_sz)
+{
+    const msel_ipc_id *ch = arg;
+    uint8_t msg[MSEL_IPC_MSG_MAX];
+    uint8_t *mem, *page;
+    const void *lent;
+    size_t len;
+    int i;
+
+    for(i = 0; i < NUM_MSGS; i++)
+    {
+        fill(msg, sizeof(msg), i);
+        if(msel_ipc_send(*ch, msg, sizeof(msg)) != MSEL_OK)
+            uart_print("IPC ERROR\r\n");
+    }
+
+    if(msel_ipc_send(*ch, msg, sizeof(msg) + 1) != MSEL_EINVAL)
+        uart_print("IPC ERROR\r\n");
+
+    /* Two pages always hold one whole aligned page */
+    mem = msel_malloc(2 * LEND_PAGE);
+    if(mem == NULL)
+    {
+        uart_print("IPC ERROR\r\n");
+        goto done;
+    }
+    page = (uint8_t*)(((uintptr_t)mem + LEND_PAGE - 1) & ~(uintptr_t)(LEND_PAGE - 1));
+    fill(page, LEND_LEN, 0x5a);
+
+    if(msel_ipc_lend(*ch, page + 1, LEND_LEN) != MSEL_EINVAL ||
+       msel_ipc_lend(*ch, page, LEND_LEN) != MSEL_OK ||
+       msel_ipc_lend(*ch, page, LEND_LEN) != MSEL_EINVAL ||
+       msel_ipc_reclaim(page) != MSEL_OK)
+        uart_print("IPC ERROR\r\n");
+
+    /* Writable again */
+    fill(page, LEND_LEN, 0);
+
+    /* Wait for the consumer to finish, then lend the page to nobody */
+    len = sizeof(msg);
+    if(msel_ipc_recv(*ch, msg, &len, &lent) != MSEL_OK ||
+       msel_ipc_lend(*ch, page, LEND_LEN) != MSEL_OK)
+        uart_print("IPC ERROR\r\n");
+
+    *(volatile uint8_t*)page = 0;
+    uart_print("IPC ERROR: wrote a lent page\r\n");
+
+done:
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+/* Task 2: checks everything arrives in order */
+void consumer(void *arg, const size_t arg_sz)
+{
+    const msel_ipc_id *ch = arg;
+    uint8_t msg[MSEL_IPC_MSG_MAX];
+    const void *lent;
+    size_t len;
+    int ok = 1;
+    int i;
+
+    for(i = 0; i < NUM_MSGS; i++)
+    {
+        len = sizeof(msg);
+        if(msel_ipc_recv(*ch, msg, &len, &lent) != MSEL_OK ||
+           len != sizeof(msg) || lent != NULL || !check(msg, len, i))
+            ok = 0;
+    }
+
+    len = sizeof(msg);
+    if(msel_ipc_recv(*ch, msg, &len, &lent) != MSEL_OK ||
+       len != LEND_LEN || lent == NULL || !check(lent, len, 0x5a))
+        ok = 0;
+
+    if(lent == NULL ||
+       msel_ipc_return(lent) != MSEL_OK ||
+       msel_ipc_return(lent) != MSEL_EINVAL)
+        ok = 0;
+
+    uart_print(ok ? "IPC OK\r\n" : "IPC ERROR\r\n");
+
+    /* Let the producer go on to its last test */
+    msg[0] = 0;
+    if(msel_ipc_send(*ch, msg, 1) != MSEL_OK)
+        uart_print("IPC ERROR\r\n");
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+int main()
+{
+    msel_task_profile big = { 1024, 2 * LEND_PAGE + 1024 };
+    msel_ipc_id ch;
+
+    msel_init();
+
+    if(msel_ipc_create(&ch) != MSEL_OK)
+        goto err;
+
+    msel_task_create_profile(producer, &ch, sizeof(ch), &big, NULL);
+    msel_task_create(consumer, &ch, sizeof(ch), NULL);
+
+    msel_start();
+
+err:
+    while(1);
+
+    /* never reached */
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <msel/stdc.h>
 #include <msel/malloc.h>
 #include <msel/debug.h>
+#include <msel/syscalls.h>
 
 void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
         uint16_t *port, const uint8_t* data)
@@ -54,6 +55,27 @@ void task1(void *arg, const size_t arg_sz)
 
         uart_print("TASK1 TEST COMPLETE\r\n");
 
+        /* Every task has allocated by now, and none of it should have failed */
+        {
+            msel_heap_stats_args args;
+            int ok = 1;
+
+            for(args.tasknum = 1; args.tasknum <= 3; args.tasknum++)
+            {
+                if(msel_svc(MSEL_SVC_HEAP_STATS, &args) != MSEL_OK ||
+                   args.stats.allocs == 0 || args.stats.failed != 0 ||
+                   args.stats.peak < args.stats.in_use ||
+                   args.stats.in_use + args.stats.largest_free > args.stats.size)
+                    ok = 0;
+            }
+
+            args.tasknum = 200;
+            if(msel_svc(MSEL_SVC_HEAP_STATS, &args) != MSEL_EINVAL)
+                ok = 0;
+
+            uart_print(ok ? "TASK1 HEAP STATS OK\r\n" : "HEAP STATS ERROR\r\n");
+        }
+
     }    
 }
 
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/malloc.h>
+#include <msel/debug.h>
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+/* More than the default heap holds on any arch */
+#define BIG_ALLOC (14*1024 + 512)
+
+void big_task(void *arg, const size_t arg_sz)
+{
+    const msel_status *huge = arg;
+    void *p;
+
+    if(arg_sz == sizeof(*huge) && *huge == MSEL_ENOMEM)
+        uart_print("NOMEM OK\r\n");
+    else
+        uart_print("NOMEM FAIL\r\n");
+
+    p = msel_malloc(BIG_ALLOC);
+    uart_print(p ? "BIG HEAP OK\r\n" : "BIG HEAP FAIL\r\n");
+    msel_free(p);
+}
+
+/* Just has to fit alongside big_task */
+void small_task(void *arg, const size_t arg_sz)
+{
+    msel_free(msel_malloc(64));
+}
+
+int main() {
+    msel_task_profile big   = { 1024, 15*1024 };
+    msel_task_profile small = { 1024, 2*1024 };
+    msel_task_profile huge  = { 1024, 1024*1024 };
+    msel_status ret, huge_ret;
+
+    /* let msel initialize itself */
+    msel_init();
+
+    /* this one can never fit, and must not use up a task slot */
+    huge_ret = msel_task_create_profile(small_task,NULL,0,&huge,NULL);
+
+    /* create threads here */
+    if((ret = msel_task_create_profile(big_task,&huge_ret,sizeof(huge_ret),&big,NULL)) != MSEL_OK)
+        goto err;
+
+    if((ret = msel_task_create_profile(small_task,NULL,0,&small,NULL)) != MSEL_OK)
+        goto err;
+
+    /* give control over to msel */
+    msel_start();
+    
+err:
+    while(1);
+
+    /* never reached */
+    return 0;
+}
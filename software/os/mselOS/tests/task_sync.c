@@ -0,0 +1,103 @@
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/sync.h>
+#include <msel/debug.h>
+#include <msel/syscalls.h>
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+#define NUM_ITEMS 8
+
+#define EV_DONE 0x1
+
+typedef struct {
+    msel_sync_id lock;
+    msel_sync_id items;
+    msel_sync_id events;
+} sync_ids;
+
+/* Task 1: takes every item, then waits its turn for the lock */
+void consumer(void *arg, const size_t arg_sz)
+{
+    const sync_ids *ids = arg;
+    int got = 0;
+    int i;
+
+    for(i = 0; i < NUM_ITEMS; i++)
+        if(msel_sem_wait(ids->items) == MSEL_OK)
+            got++;
+
+    /* The producer holds this until it has posted everything */
+    if(got != NUM_ITEMS ||
+       msel_mutex_acquire(ids->lock) != MSEL_OK ||
+       msel_mutex_release(ids->lock) != MSEL_OK)
+        uart_print("SYNC ERROR\r\n");
+
+    msel_event_set(ids->events, EV_DONE);
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+/* Task 2: posts the items with the lock held, then waits for the consumer */
+void producer(void *arg, const size_t arg_sz)
+{
+    const sync_ids *ids = arg;
+    int ok = 1;
+    int i;
+
+    if(msel_mutex_acquire(ids->lock) != MSEL_OK ||
+       msel_mutex_acquire(ids->lock) != MSEL_EINVAL)
+        ok = 0;
+
+    for(i = 0; i < NUM_ITEMS; i++)
+    {
+        if(msel_sem_post(ids->items) != MSEL_OK)
+            ok = 0;
+        msel_svc(MSEL_SVC_YIELD, NULL);
+    }
+
+    if(msel_mutex_release(ids->lock) != MSEL_OK)
+        ok = 0;
+
+    if(msel_event_wait(ids->events, EV_DONE, MSEL_EVENT_ALL | MSEL_EVENT_CLEAR) != MSEL_OK)
+        ok = 0;
+
+    /* The lock went to the consumer, which has let it go again */
+    if(msel_mutex_release(ids->lock) != MSEL_EBADF ||
+       msel_sem_wait(200) != MSEL_EINVAL)
+        ok = 0;
+
+    uart_print(ok ? "SYNC OK\r\n" : "SYNC ERROR\r\n");
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+int main()
+{
+    sync_ids ids;
+
+    msel_init();
+
+    if(msel_mutex_create(&ids.lock) != MSEL_OK ||
+       msel_sem_create(&ids.items, 0) != MSEL_OK ||
+       msel_event_create(&ids.events) != MSEL_OK)
+        goto err;
+
+    msel_task_create(consumer, &ids, sizeof(ids), NULL);
+    msel_task_create(producer, &ids, sizeof(ids), NULL);
+
+    msel_start();
+
+err:
+    while(1);
+
+    /* never reached */
+    return 0;
+}
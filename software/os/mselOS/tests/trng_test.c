@@ -0,0 +1,144 @@
+#include <msel.h>
+#include <msel/tasks.h>
+#include <msel/sync.h>
+#include <msel/trng.h>
+#include <msel/debug.h>
+#include <msel/syscalls.h>
+#include "task.h"
+
+void get_task(const uint8_t **endpoint, void (**task_fn)(void *arg, const size_t arg_sz),
+        uint16_t *port, const uint8_t* data)
+{
+    *endpoint = NULL;
+    *task_fn = NULL;
+}
+
+#define EV_POOL 0x1
+#define EV_RCT  0x2
+
+/* Reads that may be served from what the worker already put in the
+ * pool before one has to refill it */
+#define FAIL_TRIES 16
+
+/* Set up by main before any task runs */
+static uint8_t stuck_tid;
+static uint8_t biased_tid;
+
+/* Stands in for the hardware (and the library's arch_trng_read). Only
+ * ever called by the kernel, so its state may live in .bss. The stuck
+ * task gets the same byte over and over, which the repetition count
+ * catches; the biased task gets 0xa5 two times in three, which is never
+ * too many in a row but too many per window for the adaptive proportion
+ * test (the window is no multiple of three, so some window starts on
+ * one). Everyone else gets xorshift output. */
+msel_status arch_trng_read(uint8_t* out)
+{
+    static uint32_t x = 2463534242u;
+    static uint8_t  n;
+
+    if(msel_active_task_num == stuck_tid)
+    {
+        *out = 0x5a;
+    }
+    else if(msel_active_task_num == biased_tid)
+    {
+        *out = (++n % 3) ? 0xa5 : (n & 0x7f);
+    }
+    else
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *out = x >> 24;
+    }
+    return MSEL_OK;
+}
+
+/* Read until the health tests give up, which they must well before
+ * FAIL_TRIES */
+static msel_status read_until_error(uint8_t *buf)
+{
+    msel_status ret = MSEL_OK;
+    int i;
+
+    for(i = 0; i < FAIL_TRIES && ret == MSEL_OK; i++)
+        ret = msel_trng_read(buf, MSEL_TRNG_READ_MAX);
+    return ret;
+}
+
+/* Task 1: drains the pool past what it holds, so it has to refill */
+void good_reader(void *arg, const size_t arg_sz)
+{
+    const msel_sync_id *events = arg;
+    uint8_t a[MSEL_TRNG_READ_MAX], b[MSEL_TRNG_READ_MAX];
+    int ok = 1;
+    int i, same = 0;
+
+    if(msel_trng_read(a, sizeof(a)) != MSEL_OK ||
+       msel_trng_read(b, sizeof(b)) != MSEL_OK ||
+       msel_trng_read(NULL, 1) != MSEL_EINVAL)
+        ok = 0;
+
+    for(i = 0; i < sizeof(a); i++)
+        same += a[i] == b[i];
+    if(same == sizeof(a))
+        ok = 0;
+
+    uart_print(ok ? "TRNG POOL OK\r\n" : "TRNG POOL ERROR\r\n");
+    msel_event_set(*events, EV_POOL);
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+/* Task 2: its source is stuck */
+void stuck_reader(void *arg, const size_t arg_sz)
+{
+    const msel_sync_id *events = arg;
+    uint8_t buf[MSEL_TRNG_READ_MAX];
+
+    msel_event_wait(*events, EV_POOL, MSEL_EVENT_ALL);
+
+    uart_print(read_until_error(buf) == MSEL_EUNKNOWN ?
+               "TRNG RCT OK\r\n" : "TRNG RCT ERROR\r\n");
+    msel_event_set(*events, EV_RCT);
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+/* Task 3: its source is biased */
+void biased_reader(void *arg, const size_t arg_sz)
+{
+    const msel_sync_id *events = arg;
+    uint8_t buf[MSEL_TRNG_READ_MAX];
+
+    msel_event_wait(*events, EV_RCT, MSEL_EVENT_ALL);
+
+    uart_print(read_until_error(buf) == MSEL_EUNKNOWN ?
+               "TRNG APT OK\r\n" : "TRNG APT ERROR\r\n");
+
+    while(1)
+        msel_svc(MSEL_SVC_YIELD, NULL);
+}
+
+int main()
+{
+    msel_sync_id events;
+
+    msel_init();
+
+    if(msel_event_create(&events) != MSEL_OK ||
+       msel_task_create(good_reader, &events, sizeof(events), NULL) != MSEL_OK ||
+       msel_task_create(stuck_reader, &events, sizeof(events), &stuck_tid) != MSEL_OK ||
+       msel_task_create(biased_reader, &events, sizeof(events), &biased_tid) != MSEL_OK)
+        goto err;
+
+    msel_start();
+
+err:
+    while(1);
+
+    /* never reached */
+    return 0;
+}
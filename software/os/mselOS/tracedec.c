@@ -0,0 +1,218 @@
+/*
+   Copyright 2015, Google Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+   Host-side decoder for the kernel event trace (see src/os/trace.h).
+
+   Reads a captured UART log, picks out the "trace ..." lines and writes
+   them as Chrome trace event JSON, which chrome://tracing or Perfetto
+   can show as a timeline:
+
+     - every task gets a row with its syscalls as slices and its FFS
+       packets, creation and termination as instant events
+     - interrupts get a row of their own
+     - a "cpu" row shows which task was running when, and a counter
+       per task shows the user and kernel cycles of each of its slices
+
+   Build with: cc -o tracedec tracedec.c
+   Usage:      tracedec [-c CYCLES_PER_US] [uart.log] > trace.json
+
+   Timestamps are CPU cycles, so pass the clock rate in MHz with -c to
+   get real time. The 32-bit counter wraps, which is undone here as long
+   as no two events in a row are further apart than one wrap.
+*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MSEL_TRACE_HOST
+#include "src/os/trace.h"
+
+/* Rows that aren't tasks */
+#define TID_ISR 100
+#define TID_CPU 101
+
+#define MAX_TID 256
+
+static double cycles_per_us = 1.0;
+static int    first = 1;
+static int    seen_tid[MAX_TID];
+
+static void emit_begin(const char *ph, uint64_t time, int tid)
+{
+    printf("%s\n  {\"ph\":\"%s\",\"ts\":%.3f,\"pid\":0,\"tid\":%d",
+           first ? "" : ",", ph, (double)time / cycles_per_us, tid);
+    first = 0;
+    if(tid < MAX_TID)
+        seen_tid[tid] = 1;
+}
+
+static void emit_thread_names()
+{
+    int tid;
+
+    for(tid = 0; tid < MAX_TID; tid++)
+    {
+        if(!seen_tid[tid])
+            continue;
+
+        printf(",\n  {\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":", tid);
+        if(tid == TID_ISR)
+            printf("\"isr\"}}");
+        else if(tid == TID_CPU)
+            printf("\"cpu\"}}");
+        else
+            printf("\"task %d\"}}", tid);
+    }
+}
+
+static void decode(uint64_t time, uint8_t event, uint8_t task, uint16_t arg)
+{
+    static int running = -1;
+
+    switch(event)
+    {
+    case TRACE_LOST:
+        emit_begin("i", time, task);
+        printf(",\"s\":\"g\",\"name\":\"lost\",\"args\":{\"events\":%u}}", arg);
+        break;
+
+    case TRACE_SVC_ENTER:
+        emit_begin("B", time, task);
+        printf(",\"cat\":\"svc\",\"name\":\"svc %u\"}", arg);
+        break;
+    case TRACE_SVC_EXIT:
+        emit_begin("E", time, task);
+        printf(",\"cat\":\"svc\",\"args\":{\"result\":%d}}", (int16_t)arg);
+        break;
+
+    case TRACE_SWITCH:
+        if(running >= 0)
+        {
+            emit_begin("E", time, TID_CPU);
+            printf("}");
+        }
+        emit_begin("B", time, TID_CPU);
+        printf(",\"cat\":\"sched\",\"name\":\"task %u\",\"args\":{\"from\":%u}}", task, arg);
+        running = task;
+        break;
+
+    case TRACE_CPU_USER:
+    case TRACE_CPU_KERNEL:
+        /* Counters are per process, so name them after the task */
+        emit_begin("C", time, task);
+        printf(",\"cat\":\"sched\",\"name\":\"task %u %s\",\"args\":{\"cycles\":%u}}",
+               task, event == TRACE_CPU_USER ? "user" : "kernel", (unsigned)arg << 8);
+        break;
+
+    case TRACE_ISR_ENTER:
+        emit_begin("B", time, TID_ISR);
+        printf(",\"cat\":\"isr\",\"name\":\"isr 0x%x\",\"args\":{\"task\":%u}}", arg, task);
+        break;
+    case TRACE_ISR_EXIT:
+        emit_begin("E", time, TID_ISR);
+        printf("}");
+        break;
+
+    case TRACE_FFS_IN:
+    case TRACE_FFS_IN_FAIL:
+    case TRACE_FFS_QUEUE:
+    case TRACE_FFS_OUT:
+        emit_begin("i", time, task);
+        printf(",\"s\":\"t\",\"cat\":\"ffs\",\"name\":\"%s\",\"args\":{\"session\":%u}}",
+               event == TRACE_FFS_IN      ? "ffs in" :
+               event == TRACE_FFS_IN_FAIL ? "ffs in refused" :
+               event == TRACE_FFS_QUEUE   ? "ffs queue" : "ffs out", arg);
+        break;
+
+    case TRACE_TASK_CREATE:
+        emit_begin("i", time, task);
+        printf(",\"s\":\"t\",\"cat\":\"task\",\"name\":\"create\",\"args\":{\"by\":%u}}", arg);
+        break;
+    case TRACE_TASK_KILL:
+        emit_begin("i", time, task);
+        printf(",\"s\":\"t\",\"cat\":\"task\",\"name\":\"kill\"}");
+        break;
+
+    default:
+        emit_begin("i", time, task);
+        printf(",\"s\":\"t\",\"name\":\"event 0x%02x\",\"args\":{\"arg\":%u}}", event, arg);
+        break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE     *in = stdin;
+    char      line[256];
+    char     *rec;
+    unsigned  time, info;
+    uint64_t  wraps = 0;
+    uint32_t  last = 0;
+    int       argi = 1;
+
+    if(argc > 2 && strcmp(argv[1], "-c") == 0)
+    {
+        cycles_per_us = atof(argv[2]);
+        if(cycles_per_us <= 0)
+        {
+            printf("-c should be the CPU clock in MHz\n");
+            exit(-1);
+        }
+        argi = 3;
+    }
+
+    if(argc > argi + 1)
+    {
+        printf("usage: %s [-c CYCLES_PER_US] [uart.log]\n", argv[0]);
+        exit(-1);
+    }
+
+    if(argc == argi + 1)
+    {
+        in = fopen(argv[argi], "r");
+        if(in == NULL)
+        {
+            perror("open log");
+            exit(-1);
+        }
+    }
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    while(fgets(line, sizeof(line), in))
+    {
+        /* The UART is shared with everything else, so trace lines may
+         * come after other output on the same line */
+        rec = strstr(line, "trace ");
+        if(rec == NULL || sscanf(rec, "trace %8x %8x", &time, &info) != 2)
+            continue;
+
+        if((uint32_t)time < last)
+            wraps += (uint64_t)1 << 32;
+        last = time;
+
+        decode(wraps + time, (info >> 24) & 0xff, (info >> 16) & 0xff, info & 0xffff);
+    }
+
+    emit_thread_names();
+    printf("\n]}\n");
+
+    if(in != stdin)
+        fclose(in);
+    return 0;
+}